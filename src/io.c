@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -59,6 +60,9 @@ const char *nc_msgtype2str[] = {
 
 #define BUFFERSIZE 512
 
+/* minimal size of new data read before a message part is passed to a callback */
+#define STREAM_PARTSIZE 4096
+
 static ssize_t
 nc_read(struct nc_session *session, char *buf, uint32_t count, uint32_t inact_timeout, struct timespec *ts_act_timeout)
 {
@@ -272,6 +276,48 @@ nc_read_until(struct nc_session *session, const char *endtag, size_t limit, uint
     return count;
 }
 
+/**
+ * @brief Read the header of the next chunk of a message with chunked framing.
+ *
+ * @param[in] session Session to read from.
+ * @param[in] inact_timeout Inactive read timeout.
+ * @param[in] ts_act_timeout Active read timeout.
+ * @param[out] chunk_len Size of the following chunk.
+ * @return 1 if a chunk follows.
+ * @return 0 on the end of the message.
+ * @return -1 on error.
+ * @return -2 on malformed message error.
+ */
+static int
+nc_read_chunk_header(struct nc_session *session, uint32_t inact_timeout, struct timespec *ts_act_timeout,
+        uint64_t *chunk_len)
+{
+    char *chunk;
+
+    if (nc_read_until(session, "\n#", 0, inact_timeout, ts_act_timeout, NULL) == -1) {
+        return -1;
+    }
+    if (nc_read_until(session, "\n", 0, inact_timeout, ts_act_timeout, &chunk) == -1) {
+        return -1;
+    }
+
+    if (!strcmp(chunk, "#\n")) {
+        /* end of chunked framing message */
+        free(chunk);
+        return 0;
+    }
+
+    /* convert string to the size of the following chunk */
+    *chunk_len = strtoul(chunk, (char **)NULL, 10);
+    free(chunk);
+    if (!*chunk_len) {
+        ERR(session, "Invalid frame chunk size detected, fatal error.");
+        return -2;
+    }
+
+    return 1;
+}
+
 int
 nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, int passing_io_lock)
 {
@@ -316,20 +362,11 @@ nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, i
         break;
     case NC_VERSION_11:
         while (1) {
-            r = nc_read_until(session, "\n#", 0, inact_timeout, &ts_act_timeout, NULL);
-            if (r == -1) {
-                ret = r;
-                goto cleanup;
-            }
-            r = nc_read_until(session, "\n", 0, inact_timeout, &ts_act_timeout, &chunk);
-            if (r == -1) {
+            r = nc_read_chunk_header(session, inact_timeout, &ts_act_timeout, &chunk_len);
+            if (r < 0) {
                 ret = r;
                 goto cleanup;
-            }
-
-            if (!strcmp(chunk, "#\n")) {
-                /* end of chunked framing message */
-                free(chunk);
+            } else if (!r) {
                 if (!data) {
                     ERR(session, "Invalid frame chunk delimiters.");
                     ret = -2;
@@ -338,15 +375,6 @@ nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, i
                 break;
             }
 
-            /* convert string to the size of the following chunk */
-            chunk_len = strtoul(chunk, (char **)NULL, 10);
-            free(chunk);
-            if (!chunk_len) {
-                ERR(session, "Invalid frame chunk size detected, fatal error.");
-                ret = -2;
-                goto cleanup;
-            }
-
             /* now we have size of next chunk, so read the chunk */
             r = nc_read_chunk(session, chunk_len, inact_timeout, &ts_act_timeout, &chunk);
             if (r == -1) {
@@ -389,6 +417,201 @@ cleanup:
     return ret;
 }
 
+/**
+ * @brief Message being read and passed to a callback in parts.
+ */
+struct nc_read_stream {
+    char *buf;                  /**< read data not consumed by the callback yet */
+    size_t len;                 /**< length of the data in buf */
+    size_t size;                /**< allocated size of buf */
+    size_t passed;              /**< length of the data in buf already passed to the callback */
+    nc_read_msg_clb clb;        /**< callback to pass the data to */
+    void *clb_data;             /**< arbitrary callback data */
+    int clb_failed;             /**< the callback failed, the rest of the message is only read */
+};
+
+/**
+ * @brief Read more data of a message being passed to a callback.
+ *
+ * @param[in] session Session to read from.
+ * @param[in] st Message being read.
+ * @param[in] count Number of bytes to read.
+ * @param[in] inact_timeout Inactive read timeout.
+ * @param[in] ts_act_timeout Active read timeout.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_read_stream_append(struct nc_session *session, struct nc_read_stream *st, size_t count, uint32_t inact_timeout,
+        struct timespec *ts_act_timeout)
+{
+    if (st->len + count + 1 > st->size) {
+        /* get more memory */
+        st->size = 2 * (st->len + count + 1);
+        st->buf = nc_realloc(st->buf, st->size);
+        NC_CHECK_ERRMEM_RET(!st->buf, -1);
+    }
+
+    if (nc_read(session, st->buf + st->len, count, inact_timeout, ts_act_timeout) != (ssize_t)count) {
+        return -1;
+    }
+    st->len += count;
+
+    return 0;
+}
+
+/**
+ * @brief Get the number of new bytes to read before the data of a message are passed to the callback again.
+ *
+ * The data not consumed are passed again so the next part is at least as large as them, which keeps
+ * the data from being searched too many times.
+ *
+ * @param[in] st Message being read.
+ * @param[in] hold Length of the data at the end of the buffer that may be framing.
+ * @return Number of new bytes to read, 0 if the data should be passed now.
+ */
+static size_t
+nc_read_stream_missing(const struct nc_read_stream *st, size_t hold)
+{
+    size_t part, fresh;
+
+    part = (st->passed > STREAM_PARTSIZE) ? st->passed : STREAM_PARTSIZE;
+    fresh = st->len - hold - st->passed;
+
+    return (fresh < part) ? part - fresh : 0;
+}
+
+/**
+ * @brief Pass the data of a message read so far to the callback and discard the consumed data.
+ *
+ * @param[in] session Session the data were read from.
+ * @param[in] st Message being read.
+ * @param[in] hold Length of the data at the end of the buffer not to pass yet, they may be framing.
+ * @param[in] last Whether all the data of the message were read.
+ */
+static void
+nc_read_stream_pass(struct nc_session *session, struct nc_read_stream *st, size_t hold, int last)
+{
+    size_t len = st->len - hold;
+    ssize_t consumed = len;
+    char c;
+
+    if (!st->clb_failed) {
+        c = st->buf[len];
+        st->buf[len] = '\0';
+        DBG(session, "Received message part:\n%s\n", st->buf + st->passed);
+
+        consumed = st->clb(st->buf, len, last, st->clb_data);
+        st->buf[len] = c;
+        if (consumed < 0) {
+            /* read the rest of the message only */
+            st->clb_failed = 1;
+            consumed = len;
+        }
+    }
+
+    /* discard the consumed data */
+    memmove(st->buf, st->buf + consumed, st->len - consumed);
+    st->len -= consumed;
+    st->buf[st->len] = '\0';
+    st->passed = len - consumed;
+}
+
+/**
+ * @brief Read a message from the wire and pass it to a callback in parts.
+ *
+ * @param[in] session Session to read from, its IO lock is expected to be held.
+ * @param[in] clb Callback to pass the message data to.
+ * @param[in] clb_data Arbitrary data for @p clb.
+ * @return 1 on success.
+ * @return -1 on error.
+ * @return -2 on malformed message error.
+ */
+static int
+nc_read_msg_stream_io(struct nc_session *session, nc_read_msg_clb clb, void *clb_data)
+{
+    int ret = 1, r;
+    struct nc_read_stream st = {.clb = clb, .clb_data = clb_data};
+    size_t i, count, matched = 0, endtag_len = NC_VERSION_10_ENDTAG_LEN;
+    uint64_t chunk_len, msg_len = 0;
+    /* use timeout in milliseconds instead seconds */
+    uint32_t inact_timeout = NC_READ_INACT_TIMEOUT * 1000;
+    struct timespec ts_act_timeout;
+
+    nc_timeouttime_get(&ts_act_timeout, NC_READ_ACT_TIMEOUT * 1000);
+
+    switch (session->version) {
+    case NC_VERSION_10:
+        /* read at most the rest of the end tag at once to never read past the message */
+        while (matched < endtag_len) {
+            if (nc_read_stream_append(session, &st, endtag_len - matched, inact_timeout, &ts_act_timeout)) {
+                ret = -1;
+                goto cleanup;
+            }
+
+            for (i = endtag_len - matched; i > 0; i--) {
+                if (!strncmp(&NC_VERSION_10_ENDTAG[matched], &st.buf[st.len - i], i)) {
+                    /* part of endtag found */
+                    matched += i;
+                    break;
+                } else {
+                    matched = 0;
+                }
+            }
+
+            if ((matched < endtag_len) && !nc_read_stream_missing(&st, matched)) {
+                /* the data that may be the end tag are kept */
+                nc_read_stream_pass(session, &st, matched, 0);
+            }
+        }
+
+        /* cut off the end tag */
+        st.len -= endtag_len;
+        st.buf[st.len] = '\0';
+        break;
+    case NC_VERSION_11:
+        while (1) {
+            r = nc_read_chunk_header(session, inact_timeout, &ts_act_timeout, &chunk_len);
+            if (r < 0) {
+                ret = r;
+                goto cleanup;
+            } else if (!r) {
+                if (!msg_len) {
+                    ERR(session, "Invalid frame chunk delimiters.");
+                    ret = -2;
+                    goto cleanup;
+                }
+                break;
+            }
+            msg_len += chunk_len;
+
+            /* read the chunk in parts */
+            while (chunk_len) {
+                count = nc_read_stream_missing(&st, 0);
+                if (count > chunk_len) {
+                    count = chunk_len;
+                }
+                if (nc_read_stream_append(session, &st, count, inact_timeout, &ts_act_timeout)) {
+                    ret = -1;
+                    goto cleanup;
+                }
+                chunk_len -= count;
+
+                if (!nc_read_stream_missing(&st, 0)) {
+                    nc_read_stream_pass(session, &st, 0, 0);
+                }
+            }
+        }
+        break;
+    }
+
+    /* the rest of the message */
+    nc_read_stream_pass(session, &st, 0, 1);
+
+cleanup:
+    free(st.buf);
+    return ret;
+}
+
 /* return -1 means either poll error or that session was invalidated (socket error), EINTR is handled inside */
 static int
 nc_read_poll(struct nc_session *session, int io_timeout)
@@ -488,14 +711,20 @@ nc_read_poll(struct nc_session *session, int io_timeout)
     return ret;
 }
 
-int
-nc_read_msg_poll_io(struct nc_session *session, int io_timeout, struct ly_in **msg)
+/**
+ * @brief Lock the IO of a session and wait for data to be read.
+ *
+ * @param[in] session Session to read from.
+ * @param[in] io_timeout Timeout in milliseconds.
+ * @return 1 if there are data to read, the IO lock is held.
+ * @return 0 on timeout.
+ * @return -1 on error.
+ */
+static int
+nc_read_poll_io_lock(struct nc_session *session, int io_timeout)
 {
     int ret;
 
-    assert(msg);
-    *msg = NULL;
-
     if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
         ERR(session, "Invalid session to read from.");
         return -1;
@@ -513,6 +742,21 @@ nc_read_msg_poll_io(struct nc_session *session, int io_timeout, struct ly_in **m
 
         /* SESSION IO UNLOCK */
         nc_session_io_unlock(session, __func__);
+    }
+
+    return ret;
+}
+
+int
+nc_read_msg_poll_io(struct nc_session *session, int io_timeout, struct ly_in **msg)
+{
+    int ret;
+
+    assert(msg);
+    *msg = NULL;
+
+    ret = nc_read_poll_io_lock(session, io_timeout);
+    if (ret < 1) {
         return ret;
     }
 
@@ -520,6 +764,26 @@ nc_read_msg_poll_io(struct nc_session *session, int io_timeout, struct ly_in **m
     return nc_read_msg_io(session, io_timeout, msg, 1);
 }
 
+int
+nc_read_msg_poll_stream_io(struct nc_session *session, int io_timeout, nc_read_msg_clb clb, void *clb_data)
+{
+    int ret;
+
+    assert(clb);
+
+    ret = nc_read_poll_io_lock(session, io_timeout);
+    if (ret < 1) {
+        return ret;
+    }
+
+    ret = nc_read_msg_stream_io(session, clb, clb_data);
+
+    /* SESSION IO UNLOCK */
+    nc_session_io_unlock(session, __func__);
+
+    return ret;
+}
+
 /* does not really log, only fatal errors */
 int
 nc_session_is_connected(const struct nc_session *session)
@@ -570,20 +834,44 @@ struct nc_wclb_arg {
 };
 
 /**
- * @brief Write to a NETCONF session.
+ * @brief Get the file descriptor a NETCONF session can write data to directly, without any transport processing.
  *
- * @param[in] session Session to write to.
- * @param[in] buf Buffer to write.
- * @param[in] count Count of bytes from @p buf to write.
- * @return Number of bytes written.
- * @return -1 on error.
+ * @param[in] session Session to examine.
+ * @return FD to write to, -1 if the data must be written using the transport library.
  */
 static int
-nc_write(struct nc_session *session, const void *buf, uint32_t count)
+nc_session_out_fd(const struct nc_session *session)
 {
-    int c, fd, interrupted;
-    uint32_t written = 0;
+    switch (session->ti_type) {
+    case NC_TI_FD:
+        return session->ti.fd.out;
+    case NC_TI_UNIX:
+        return session->ti.unixsock.sock;
+#ifdef NC_ENABLED_SSH_TLS
+    case NC_TI_TLS:
+        if (session->ti.tls.ktls & NC_TLS_KTLS_TX) {
+            /* records are encrypted by the kernel */
+            return nc_tls_get_fd_wrap(session);
+        }
+        break;
+#endif /* NC_ENABLED_SSH_TLS */
+    default:
+        break;
+    }
+
+    return -1;
+}
 
+/**
+ * @brief Check that a NETCONF session can be written to.
+ *
+ * @param[in] session Session to check.
+ * @return 0 if writing is possible.
+ * @return -1 on error.
+ */
+static int
+nc_write_check(struct nc_session *session)
+{
     if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
         return -1;
     }
@@ -596,14 +884,34 @@ nc_write(struct nc_session *session, const void *buf, uint32_t count)
         return -1;
     }
 
+    return 0;
+}
+
+/**
+ * @brief Write to a NETCONF session.
+ *
+ * @param[in] session Session to write to.
+ * @param[in] buf Buffer to write.
+ * @param[in] count Count of bytes from @p buf to write.
+ * @return Number of bytes written.
+ * @return -1 on error.
+ */
+static int
+nc_write(struct nc_session *session, const void *buf, uint32_t count)
+{
+    int c, fd, interrupted;
+    uint32_t written = 0;
+
+    if (nc_write_check(session)) {
+        return -1;
+    }
+
     DBG(session, "Sending message:\n%.*s\n", (int)count, buf);
 
+    fd = nc_session_out_fd(session);
     do {
         interrupted = 0;
-        switch (session->ti_type) {
-        case NC_TI_FD:
-        case NC_TI_UNIX:
-            fd = session->ti_type == NC_TI_FD ? session->ti.fd.out : session->ti.unixsock.sock;
+        if (fd > -1) {
             c = write(fd, (char *)(buf + written), count - written);
             if ((c < 0) && (errno == EAGAIN)) {
                 c = 0;
@@ -614,37 +922,38 @@ nc_write(struct nc_session *session, const void *buf, uint32_t count)
                 ERR(session, "Socket error (%s).", strerror(errno));
                 return -1;
             }
-            break;
-
+        } else {
+            switch (session->ti_type) {
 #ifdef NC_ENABLED_SSH_TLS
-        case NC_TI_SSH:
-            if (ssh_channel_is_closed(session->ti.libssh.channel) || ssh_channel_is_eof(session->ti.libssh.channel)) {
-                if (ssh_channel_is_closed(session->ti.libssh.channel)) {
-                    ERR(session, "SSH channel unexpectedly closed.");
-                } else {
-                    ERR(session, "SSH channel unexpected EOF.");
+            case NC_TI_SSH:
+                if (ssh_channel_is_closed(session->ti.libssh.channel) || ssh_channel_is_eof(session->ti.libssh.channel)) {
+                    if (ssh_channel_is_closed(session->ti.libssh.channel)) {
+                        ERR(session, "SSH channel unexpectedly closed.");
+                    } else {
+                        ERR(session, "SSH channel unexpected EOF.");
+                    }
+                    session->status = NC_STATUS_INVALID;
+                    session->term_reason = NC_SESSION_TERM_DROPPED;
+                    return -1;
                 }
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_DROPPED;
-                return -1;
-            }
-            c = ssh_channel_write(session->ti.libssh.channel, (char *)(buf + written), count - written);
-            if ((c == SSH_ERROR) || (c == -1)) {
-                ERR(session, "SSH channel write failed.");
-                return -1;
-            }
-            break;
-        case NC_TI_TLS:
-            c = nc_tls_write_wrap(session, (const unsigned char *)(buf + written), count - written);
-            if (c < 0) {
-                /* possible client dc, or some socket/TLS communication error */
+                c = ssh_channel_write(session->ti.libssh.channel, (char *)(buf + written), count - written);
+                if ((c == SSH_ERROR) || (c == -1)) {
+                    ERR(session, "SSH channel write failed.");
+                    return -1;
+                }
+                break;
+            case NC_TI_TLS:
+                c = nc_tls_write_wrap(session, (const unsigned char *)(buf + written), count - written);
+                if (c < 0) {
+                    /* possible client dc, or some socket/TLS communication error */
+                    return -1;
+                }
+                break;
+#endif /* NC_ENABLED_SSH_TLS */
+            default:
+                ERRINT;
                 return -1;
             }
-            break;
-#endif /* NC_ENABLED_SSH_TLS */
-        default:
-            ERRINT;
-            return -1;
         }
 
         if ((c == 0) && !interrupted) {
@@ -659,55 +968,227 @@ nc_write(struct nc_session *session, const void *buf, uint32_t count)
 }
 
 /**
- * @brief Write the start tag and the message part of a chunked-framing NETCONF message.
+ * @brief Write several buffers to a file descriptor of a NETCONF session using a single system call, if possible.
  *
  * @param[in] session Session to write to.
- * @param[in] buf Message buffer to write.
- * @param[in] count Count of bytes from @p buf to write.
+ * @param[in] fd FD of @p session to write to, see ::nc_session_out_fd().
+ * @param[in,out] iov Buffers to write, are modified.
+ * @param[in] iovcnt Count of @p iov buffers.
  * @return Number of bytes written.
  * @return -1 on error.
  */
 static int
-nc_write_starttag_and_msg(struct nc_session *session, const void *buf, uint32_t count)
+nc_writev(struct nc_session *session, int fd, struct iovec *iov, int iovcnt)
 {
-    int ret = 0, r;
-    char chunksize[24];
+    ssize_t c;
+    int i, written = 0;
 
-    if (session->version == NC_VERSION_11) {
-        r = sprintf(chunksize, "\n#%" PRIu32 "\n", count);
+    if (nc_write_check(session)) {
+        return -1;
+    }
 
-        r = nc_write(session, chunksize, r);
-        if (r == -1) {
+    for (i = 0; i < iovcnt; ++i) {
+        DBG(session, "Sending message:\n%.*s\n", (int)iov[i].iov_len, iov[i].iov_base);
+    }
+
+    while (iovcnt) {
+        c = writev(fd, iov, iovcnt);
+        if (c < 0) {
+            if (errno == EAGAIN) {
+                /* we must wait */
+                usleep(NC_TIMEOUT_STEP);
+                continue;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            ERR(session, "Socket error (%s).", strerror(errno));
             return -1;
         }
-        ret += r;
+        written += c;
+
+        /* skip everything written */
+        while (iovcnt && ((size_t)c >= iov->iov_len)) {
+            c -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt) {
+            iov->iov_base = (char *)iov->iov_base + c;
+            iov->iov_len -= c;
+        }
     }
 
-    r = nc_write(session, buf, count);
-    if (r == -1) {
+    return written;
+}
+
+#ifdef NC_ENABLED_SSH_TLS
+
+/**
+ * @brief Get the payload size of the next TLS record to send.
+ *
+ * @param[in] session TLS session.
+ * @return Record payload size.
+ */
+static uint32_t
+nc_tls_record_size(struct nc_session *session)
+{
+    if (!session->ti.tls.drs) {
+        return NC_TLS_RECORD_SIZE;
+    }
+
+    if (-nc_timeouttime_cur_diff(&session->ti.tls.ts_last_write) > NC_TLS_DRS_IDLE_TIMEOUT) {
+        /* idle, the congestion window may have shrunk, start with small records for low latency again */
+        session->ti.tls.drs_sent = 0;
+    }
+
+    return (session->ti.tls.drs_sent < NC_TLS_DRS_SMALL_BYTES) ? NC_TLS_RECORD_SIZE_SMALL : NC_TLS_RECORD_SIZE;
+}
+
+/**
+ * @brief Write all the data coalesced for a TLS session as a single record.
+ *
+ * @param[in] session TLS session.
+ * @return Number of bytes written.
+ * @return -1 on error.
+ */
+static int
+nc_tls_write_flush(struct nc_session *session)
+{
+    int ret;
+
+    if (!session->ti.tls.wbuf_len) {
+        return 0;
+    }
+
+    ret = nc_write(session, session->ti.tls.wbuf, session->ti.tls.wbuf_len);
+    session->ti.tls.wbuf_len = 0;
+    if (ret == -1) {
         return -1;
     }
-    ret += r;
+
+    if (session->ti.tls.drs) {
+        if (session->ti.tls.drs_sent < NC_TLS_DRS_SMALL_BYTES) {
+            session->ti.tls.drs_sent += ret;
+        }
+        nc_timeouttime_get(&session->ti.tls.ts_last_write, 0);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Coalesce data written to a TLS session into full-sized records, write only the full ones.
+ *
+ * @param[in] session TLS session.
+ * @param[in] buf Buffer to write.
+ * @param[in] count Count of bytes from @p buf to write.
+ * @return Number of bytes written or buffered.
+ * @return -1 on error.
+ */
+static int
+nc_tls_write_coalesce(struct nc_session *session, const char *buf, uint32_t count)
+{
+    uint32_t size, len, ret = 0;
+
+    if (!session->ti.tls.wbuf) {
+        session->ti.tls.wbuf = malloc(NC_TLS_RECORD_SIZE);
+        NC_CHECK_ERRMEM_RET(!session->ti.tls.wbuf, -1);
+    }
+
+    while (count) {
+        size = nc_tls_record_size(session);
+        if (session->ti.tls.wbuf_len < size) {
+            len = size - session->ti.tls.wbuf_len;
+            if (len > count) {
+                len = count;
+            }
+            memcpy(session->ti.tls.wbuf + session->ti.tls.wbuf_len, buf, len);
+            session->ti.tls.wbuf_len += len;
+            buf += len;
+            count -= len;
+            ret += len;
+        }
+
+        if ((session->ti.tls.wbuf_len >= size) && (nc_tls_write_flush(session) == -1)) {
+            return -1;
+        }
+    }
 
     return ret;
 }
 
+#endif /* NC_ENABLED_SSH_TLS */
+
 /**
- * @brief Write the end tag part of a chunked-framing NETCONF message.
+ * @brief Write the start tag and the message part of a chunked-framing NETCONF message.
+ *
+ * Sessions written to directly (see ::nc_session_out_fd()) write all the parts using a single system call.
+ * TLS sessions coalesce the parts into full-sized records and send the last one only with the end tag.
  *
  * @param[in] session Session to write to.
+ * @param[in] buf Message buffer to write.
+ * @param[in] count Count of bytes from @p buf to write, 0 to write only the end tag.
+ * @param[in] endtag Whether to also write the message end tag.
  * @return Number of bytes written.
  * @return -1 on error.
  */
 static int
-nc_write_endtag(struct nc_session *session)
+nc_write_starttag_and_msg(struct nc_session *session, const void *buf, uint32_t count, int endtag)
 {
-    int ret;
+    int ret = 0, r, fd, iovcnt = 0;
+    char chunksize[24];
+    struct iovec iov[3];
 
-    if (session->version == NC_VERSION_11) {
-        ret = nc_write(session, "\n##\n", 4);
-    } else {
-        ret = nc_write(session, "]]>]]>", 6);
+    if ((session->version == NC_VERSION_11) && count) {
+        r = sprintf(chunksize, "\n#%" PRIu32 "\n", count);
+        iov[iovcnt].iov_base = chunksize;
+        iov[iovcnt].iov_len = r;
+        ++iovcnt;
+    }
+    if (count) {
+        iov[iovcnt].iov_base = (void *)buf;
+        iov[iovcnt].iov_len = count;
+        ++iovcnt;
+    }
+    if (endtag) {
+        if (session->version == NC_VERSION_11) {
+            iov[iovcnt].iov_base = "\n##\n";
+            iov[iovcnt].iov_len = 4;
+        } else {
+            iov[iovcnt].iov_base = "]]>]]>";
+            iov[iovcnt].iov_len = 6;
+        }
+        ++iovcnt;
+    }
+
+    fd = nc_session_out_fd(session);
+    if (fd > -1) {
+        /* single system call */
+        return nc_writev(session, fd, iov, iovcnt);
+    }
+
+#ifdef NC_ENABLED_SSH_TLS
+    if (session->ti_type == NC_TI_TLS) {
+        for (r = 0; r < iovcnt; ++r) {
+            if (nc_tls_write_coalesce(session, iov[r].iov_base, iov[r].iov_len) == -1) {
+                return -1;
+            }
+            ret += iov[r].iov_len;
+        }
+
+        /* message end, send the last record */
+        if (endtag && (nc_tls_write_flush(session) == -1)) {
+            return -1;
+        }
+        return ret;
+    }
+#endif /* NC_ENABLED_SSH_TLS */
+
+    for (r = 0; r < iovcnt; ++r) {
+        if (nc_write(session, iov[r].iov_base, iov[r].iov_len) == -1) {
+            return -1;
+        }
+        ret += iov[r].iov_len;
     }
 
     return ret;
@@ -717,17 +1198,18 @@ nc_write_endtag(struct nc_session *session)
  * @brief Flush all the data buffered for writing.
  *
  * @param[in] warg Write callback structure to flush.
+ * @param[in] endtag Whether to also write the message end tag.
  * @return Number of written bytes.
  * @return -1 on error.
  */
 static int
-nc_write_clb_flush(struct nc_wclb_arg *warg)
+nc_write_clb_flush(struct nc_wclb_arg *warg, int endtag)
 {
     int ret = 0;
 
     /* flush current buffer */
-    if (warg->len) {
-        ret = nc_write_starttag_and_msg(warg->session, warg->buf, warg->len);
+    if (warg->len || endtag) {
+        ret = nc_write_starttag_and_msg(warg->session, warg->buf, warg->len, endtag);
         warg->len = 0;
     }
 
@@ -752,14 +1234,8 @@ nc_write_clb(void *arg, const void *buf, uint32_t count, int xmlcontent)
     struct nc_wclb_arg *warg = arg;
 
     if (!buf) {
-        c = nc_write_clb_flush(warg);
-        if (c == -1) {
-            return -1;
-        }
-        ret += c;
-
-        /* endtag */
-        c = nc_write_endtag(warg->session);
+        /* flush with the endtag */
+        c = nc_write_clb_flush(warg, 1);
         if (c == -1) {
             return -1;
         }
@@ -770,7 +1246,7 @@ nc_write_clb(void *arg, const void *buf, uint32_t count, int xmlcontent)
 
     if (warg->len && (warg->len + count > WRITE_BUFSIZE)) {
         /* dump current buffer */
-        c = nc_write_clb_flush(warg);
+        c = nc_write_clb_flush(warg, 0);
         if (c == -1) {
             return -1;
         }
@@ -779,7 +1255,7 @@ nc_write_clb(void *arg, const void *buf, uint32_t count, int xmlcontent)
 
     if (!xmlcontent && (count > WRITE_BUFSIZE)) {
         /* write directly */
-        c = nc_write_starttag_and_msg(warg->session, buf, count);
+        c = nc_write_starttag_and_msg(warg->session, buf, count, 0);
         if (c == -1) {
             return -1;
         }
@@ -790,7 +1266,7 @@ nc_write_clb(void *arg, const void *buf, uint32_t count, int xmlcontent)
             for (l = 0; l < count; l++) {
                 if (warg->len + 5 >= WRITE_BUFSIZE) {
                     /* buffer is full */
-                    c = nc_write_clb_flush(warg);
+                    c = nc_write_clb_flush(warg, 0);
                     if (c == -1) {
                         return -1;
                     }
@@ -1087,6 +1563,50 @@ cleanup:
     return ret;
 }
 
+NC_MSG_TYPE
+nc_write_rpc_prepared_io(struct nc_session *session, int io_timeout, const char *rpc_tail, uint32_t rpc_tail_len,
+        uint64_t *msgid)
+{
+    int count, ret;
+    struct nc_wclb_arg arg;
+
+    assert(session && rpc_tail);
+
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        ERR(session, "Invalid session to write to.");
+        return NC_MSG_ERROR;
+    }
+
+    arg.session = session;
+
+    /* SESSION IO LOCK */
+    ret = nc_session_io_lock(session, io_timeout, __func__);
+    if (ret < 0) {
+        return NC_MSG_ERROR;
+    } else if (!ret) {
+        return NC_MSG_WOULDBLOCK;
+    }
+
+    /* <rpc> open with the message-id, the rest is already printed */
+    count = sprintf(arg.buf, "<rpc xmlns=\"%s\" message-id=\"%" PRIu64, NC_NS_BASE, session->opts.client.msgid + 1);
+    arg.len = count;
+    nc_write_clb((void *)&arg, rpc_tail, rpc_tail_len, 0);
+
+    /* flush message */
+    nc_write_clb((void *)&arg, NULL, 0, 0);
+
+    if ((session->status != NC_STATUS_RUNNING) && (session->status != NC_STATUS_STARTING)) {
+        /* error was already written */
+        ret = NC_MSG_ERROR;
+    } else {
+        ret = NC_MSG_RPC;
+        *msgid = ++session->opts.client.msgid;
+    }
+
+    nc_session_io_unlock(session, __func__);
+    return ret;
+}
+
 void *
 nc_realloc(void *ptr, size_t size)
 {
@@ -67,6 +67,11 @@ struct nc_rpc {
     NC_RPC_TYPE type;
 };
 
+struct nc_rpc_prepared {
+    char *rpc_tail;         /**< printed <rpc> following its message-id attribute value */
+    uint32_t rpc_tail_len;  /**< length of rpc_tail */
+};
+
 struct nc_rpc_act_generic {
     NC_RPC_TYPE type;       /**< NC_RPC_ACT_GENERIC */
     int has_data;           /**< 1 for content.data, 0 for content.xml_str */
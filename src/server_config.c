@@ -845,6 +845,7 @@ nc_server_config_del_tls_opts(struct nc_bind *bind, struct nc_server_tls_opts *o
 
     nc_server_config_del_ctns(opts);
     free(opts->ciphers);
+    nc_server_tls_ctx_unref(opts->srv_ctx);
     free(opts);
 }
 
@@ -3522,6 +3523,114 @@ cleanup:
     return ret;
 }
 
+static int
+nc_server_config_session_resumption(const struct lyd_node *node, enum nc_operation op)
+{
+    int ret = 0;
+    struct nc_server_tls_opts *opts;
+    struct nc_ch_client *ch_client = NULL;
+
+    assert(!strcmp(LYD_NAME(node), "session-resumption"));
+
+    /* LOCK */
+    if (is_ch(node) && nc_server_config_get_ch_client_with_lock(node, &ch_client)) {
+        /* to avoid unlock on fail */
+        return 1;
+    }
+
+    if (nc_server_config_get_tls_opts(node, ch_client, &opts)) {
+        ret = 1;
+        goto cleanup;
+    }
+
+    if (op == NC_OP_CREATE) {
+        /* defaults, the child leaves may change them */
+        opts->resumption_lifetime = 7200;
+        opts->ticket_key_rotation = 3600;
+    } else if (op == NC_OP_DELETE) {
+        opts->resumption_lifetime = 0;
+    }
+
+cleanup:
+    if (is_ch(node)) {
+        /* UNLOCK */
+        nc_ch_client_unlock(ch_client);
+    }
+    return ret;
+}
+
+/* leaf with default value */
+static int
+nc_server_config_session_lifetime(const struct lyd_node *node, enum nc_operation op)
+{
+    int ret = 0;
+    struct nc_server_tls_opts *opts;
+    struct nc_ch_client *ch_client = NULL;
+
+    assert(!strcmp(LYD_NAME(node), "session-lifetime"));
+
+    /* LOCK */
+    if (is_ch(node) && nc_server_config_get_ch_client_with_lock(node, &ch_client)) {
+        /* to avoid unlock on fail */
+        return 1;
+    }
+
+    if (nc_server_config_get_tls_opts(node, ch_client, &opts)) {
+        ret = 1;
+        goto cleanup;
+    }
+
+    if ((op == NC_OP_CREATE) || (op == NC_OP_REPLACE)) {
+        opts->resumption_lifetime = ((struct lyd_node_term *)node)->value.uint32;
+    } else {
+        /* delete -> set to default */
+        opts->resumption_lifetime = 7200;
+    }
+
+cleanup:
+    if (is_ch(node)) {
+        /* UNLOCK */
+        nc_ch_client_unlock(ch_client);
+    }
+    return ret;
+}
+
+/* leaf with default value */
+static int
+nc_server_config_ticket_key_rotation(const struct lyd_node *node, enum nc_operation op)
+{
+    int ret = 0;
+    struct nc_server_tls_opts *opts;
+    struct nc_ch_client *ch_client = NULL;
+
+    assert(!strcmp(LYD_NAME(node), "ticket-key-rotation"));
+
+    /* LOCK */
+    if (is_ch(node) && nc_server_config_get_ch_client_with_lock(node, &ch_client)) {
+        /* to avoid unlock on fail */
+        return 1;
+    }
+
+    if (nc_server_config_get_tls_opts(node, ch_client, &opts)) {
+        ret = 1;
+        goto cleanup;
+    }
+
+    if ((op == NC_OP_CREATE) || (op == NC_OP_REPLACE)) {
+        opts->ticket_key_rotation = ((struct lyd_node_term *)node)->value.uint32;
+    } else {
+        /* delete -> set to default */
+        opts->ticket_key_rotation = 3600;
+    }
+
+cleanup:
+    if (is_ch(node)) {
+        /* UNLOCK */
+        nc_ch_client_unlock(ch_client);
+    }
+    return ret;
+}
+
 #endif /* NC_ENABLED_SSH_TLS */
 
 static int
@@ -3990,8 +4099,14 @@ nc_server_config_parse_netconf_server(const struct lyd_node *node, enum nc_opera
         ret = nc_server_config_remote_address(node, op);
     } else if (!strcmp(name, "remote-port")) {
         ret = nc_server_config_remote_port(node, op);
+    } else if (!strcmp(name, "session-lifetime")) {
+        ret = nc_server_config_session_lifetime(node, op);
+    } else if (!strcmp(name, "session-resumption")) {
+        ret = nc_server_config_session_resumption(node, op);
     } else if (!strcmp(name, "ssh")) {
         ret = nc_server_config_ssh(node, op);
+    } else if (!strcmp(name, "ticket-key-rotation")) {
+        ret = nc_server_config_ticket_key_rotation(node, op);
     } else if (!strcmp(name, "tls")) {
         ret = nc_server_config_tls(node, op);
     } else if (!strcmp(name, "tls-version")) {
@@ -4592,6 +4707,9 @@ nc_server_config_setup_diff(const struct lyd_node *data)
     }
 
 #ifdef NC_ENABLED_SSH_TLS
+    /* contexts of the previous configuration must not be used anymore */
+    nc_server_tls_ctx_drop();
+
     /* wake up the cert expiration notif thread if it's running */
     pthread_mutex_lock(&server_opts.cert_exp_notif.lock);
     if (server_opts.cert_exp_notif.thread_running) {
@@ -4603,6 +4721,14 @@ nc_server_config_setup_diff(const struct lyd_node *data)
 cleanup:
     /* UNLOCK */
     pthread_rwlock_unlock(&server_opts.config_lock);
+
+#ifdef NC_ENABLED_SSH_TLS
+    if (!ret) {
+        /* prepare TLS contexts of the new configuration, CRLs are downloaded without the lock */
+        nc_server_tls_ctx_rebuild();
+    }
+#endif /* NC_ENABLED_SSH_TLS */
+
     return ret;
 }
 
@@ -4673,6 +4799,9 @@ nc_server_config_setup_data(const struct lyd_node *data)
     }
 
 #ifdef NC_ENABLED_SSH_TLS
+    /* contexts of the previous configuration must not be used anymore */
+    nc_server_tls_ctx_drop();
+
     /* wake up the cert expiration notif thread if it's running */
     pthread_mutex_lock(&server_opts.cert_exp_notif.lock);
     if (server_opts.cert_exp_notif.thread_running) {
@@ -4684,6 +4813,14 @@ nc_server_config_setup_data(const struct lyd_node *data)
 cleanup:
     /* UNLOCK */
     pthread_rwlock_unlock(&server_opts.config_lock);
+
+#ifdef NC_ENABLED_SSH_TLS
+    if (!ret) {
+        /* prepare TLS contexts of the new configuration, CRLs are downloaded without the lock */
+        nc_server_tls_ctx_rebuild();
+    }
+#endif /* NC_ENABLED_SSH_TLS */
+
     return ret;
 }
 
@@ -774,6 +774,34 @@ int nc_server_config_add_tls_ctn(const struct ly_ctx *ctx, const char *endpt_nam
  */
 int nc_server_config_del_tls_ctn(const char *endpt_name, uint32_t id, struct lyd_node **config);
 
+/**
+ * @brief Creates new YANG configuration data nodes enabling TLS session resumption on an endpoint.
+ *
+ * Clients may then resume their previous sessions (using session tickets or the server session cache)
+ * and skip the key exchange. They are still mapped to a username using their certificate.
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] endpt_name Arbitrary identifier of the endpoint.
+ * If an endpoint with this identifier already exists, its contents will be changed.
+ * @param[in] lifetime Optional lifetime of resumable sessions in seconds, 0 for the default.
+ * @param[in] key_rotation Optional session ticket key rotation interval in seconds, 0 for the default.
+ * Sessions established before a rotation can not be resumed after it.
+ * @param[in,out] config Configuration YANG data tree. If *config is NULL, it will be created.
+ * Otherwise the new YANG data will be added to the previous data and may override it.
+ * @return 0 on success, non-zero otherwise.
+ */
+int nc_server_config_add_tls_session_resumption(const struct ly_ctx *ctx, const char *endpt_name, uint32_t lifetime,
+        uint32_t key_rotation, struct lyd_node **config);
+
+/**
+ * @brief Deletes the TLS session resumption from the YANG data, disabling it.
+ *
+ * @param[in] endpt_name Identifier of an existing endpoint.
+ * @param[in,out] config Modified configuration YANG data tree.
+ * @return 0 on success, non-zero otherwise.
+ */
+int nc_server_config_del_tls_session_resumption(const char *endpt_name, struct lyd_node **config);
+
 /**
  * @} TLS Server Configuration
  */
@@ -1429,6 +1457,34 @@ int nc_server_config_add_ch_tls_ctn(const struct ly_ctx *ctx, const char *client
 int nc_server_config_del_ch_tls_ctn(const char *client_name, const char *endpt_name,
         uint32_t id, struct lyd_node **config);
 
+/**
+ * @brief Creates new YANG configuration data nodes enabling TLS session resumption on a Call Home endpoint.
+ *
+ * @param[in] ctx libyang context.
+ * @param[in] client_name Arbitrary identifier of the Call Home client.
+ * If a Call Home client with this identifier already exists, its contents will be changed.
+ * @param[in] endpt_name Arbitrary identifier of the Call Home client's endpoint.
+ * If a Call Home client's endpoint with this identifier already exists, its contents will be changed.
+ * @param[in] lifetime Optional lifetime of resumable sessions in seconds, 0 for the default.
+ * @param[in] key_rotation Optional session ticket key rotation interval in seconds, 0 for the default.
+ * @param[in,out] config Configuration YANG data tree. If *config is NULL, it will be created.
+ * Otherwise the new YANG data will be added to the previous data and may override it.
+ * @return 0 on success, non-zero otherwise.
+ */
+int nc_server_config_add_ch_tls_session_resumption(const struct ly_ctx *ctx, const char *client_name,
+        const char *endpt_name, uint32_t lifetime, uint32_t key_rotation, struct lyd_node **config);
+
+/**
+ * @brief Deletes the Call Home TLS session resumption from the YANG data, disabling it.
+ *
+ * @param[in] client_name Identifier of an existing Call Home client.
+ * @param[in] endpt_name Identifier of an existing Call Home endpoint that belongs to the given client.
+ * @param[in,out] config Modified configuration YANG data tree.
+ * @return 0 on success, non-zero otherwise.
+ */
+int nc_server_config_del_ch_tls_session_resumption(const char *client_name, const char *endpt_name,
+        struct lyd_node **config);
+
 /**
  * @} TLS Call Home Server Configuration
  */
@@ -788,3 +788,108 @@ nc_server_config_del_tls_endpoint_client_ref(const char *endpt_name, struct lyd_
     return nc_server_config_delete(config, "/ietf-netconf-server:netconf-server/listen/endpoints/endpoint[name='%s']/tls/tls-server-parameters/"
             "client-authentication/libnetconf2-netconf-server:endpoint-reference", endpt_name);
 }
+
+static int
+_nc_server_config_add_tls_session_resumption(const struct ly_ctx *ctx, const char *tree_path, uint32_t lifetime,
+        uint32_t key_rotation, struct lyd_node **config)
+{
+    int ret = 0;
+    char buf[11] = {0};
+
+    NC_CHECK_ARG_RET(NULL, ctx, tree_path, config, 1);
+
+    /* presence container enables the resumption */
+    ret = nc_server_config_create(ctx, config, NULL, "%s", tree_path);
+    if (ret) {
+        goto cleanup;
+    }
+
+    if (lifetime) {
+        /* optional */
+        sprintf(buf, "%" PRIu32, lifetime);
+        ret = nc_server_config_append(ctx, tree_path, "session-lifetime", buf, config);
+        if (ret) {
+            goto cleanup;
+        }
+    }
+
+    if (key_rotation) {
+        /* optional */
+        sprintf(buf, "%" PRIu32, key_rotation);
+        ret = nc_server_config_append(ctx, tree_path, "ticket-key-rotation", buf, config);
+        if (ret) {
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    return ret;
+}
+
+API int
+nc_server_config_add_tls_session_resumption(const struct ly_ctx *ctx, const char *endpt_name, uint32_t lifetime,
+        uint32_t key_rotation, struct lyd_node **config)
+{
+    int ret = 0;
+    char *path = NULL;
+
+    NC_CHECK_ARG_RET(NULL, ctx, endpt_name, config, 1);
+
+    ret = asprintf(&path, "/ietf-netconf-server:netconf-server/listen/endpoints/endpoint[name='%s']/tls/tls-server-parameters/"
+            "libnetconf2-netconf-server:session-resumption", endpt_name);
+    NC_CHECK_ERRMEM_GOTO(ret == -1, path = NULL; ret = 1, cleanup);
+
+    ret = _nc_server_config_add_tls_session_resumption(ctx, path, lifetime, key_rotation, config);
+    if (ret) {
+        ERR(NULL, "Creating new TLS session resumption YANG data failed.");
+        goto cleanup;
+    }
+
+cleanup:
+    free(path);
+    return ret;
+}
+
+API int
+nc_server_config_del_tls_session_resumption(const char *endpt_name, struct lyd_node **config)
+{
+    NC_CHECK_ARG_RET(NULL, endpt_name, config, 1);
+
+    return nc_server_config_delete(config, "/ietf-netconf-server:netconf-server/listen/endpoints/endpoint[name='%s']/tls/tls-server-parameters/"
+            "libnetconf2-netconf-server:session-resumption", endpt_name);
+}
+
+API int
+nc_server_config_add_ch_tls_session_resumption(const struct ly_ctx *ctx, const char *client_name, const char *endpt_name,
+        uint32_t lifetime, uint32_t key_rotation, struct lyd_node **config)
+{
+    int ret = 0;
+    char *path = NULL;
+
+    NC_CHECK_ARG_RET(NULL, ctx, client_name, endpt_name, config, 1);
+
+    ret = asprintf(&path, "/ietf-netconf-server:netconf-server/call-home/netconf-client[name='%s']/"
+            "endpoints/endpoint[name='%s']/tls/tls-server-parameters/libnetconf2-netconf-server:session-resumption",
+            client_name, endpt_name);
+    NC_CHECK_ERRMEM_GOTO(ret == -1, path = NULL; ret = 1, cleanup);
+
+    ret = _nc_server_config_add_tls_session_resumption(ctx, path, lifetime, key_rotation, config);
+    if (ret) {
+        ERR(NULL, "Creating new CH TLS session resumption YANG data failed.");
+        goto cleanup;
+    }
+
+cleanup:
+    free(path);
+    return ret;
+}
+
+API int
+nc_server_config_del_ch_tls_session_resumption(const char *client_name, const char *endpt_name, struct lyd_node **config)
+{
+    NC_CHECK_ARG_RET(NULL, client_name, endpt_name, config, 1);
+
+    return nc_server_config_delete(config, "/ietf-netconf-server:netconf-server/call-home/netconf-client[name='%s']/"
+            "endpoints/endpoint[name='%s']/tls/tls-server-parameters/libnetconf2-netconf-server:session-resumption",
+            client_name, endpt_name);
+}
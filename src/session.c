@@ -23,6 +23,7 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -142,6 +143,35 @@ nc_poll(struct pollfd *pfd, uint16_t pfd_count, int timeout_ms)
     return rc;
 }
 
+int
+nc_sock_wait(int sock, short events, const struct timespec *ts_timeout)
+{
+    struct pollfd pfd;
+    int r, timeout_ms = -1;
+
+    if (ts_timeout) {
+        timeout_ms = nc_timeouttime_cur_diff(ts_timeout);
+        if (timeout_ms < 1) {
+            return 0;
+        }
+    }
+
+    pfd.fd = sock;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    r = nc_poll(&pfd, 1, timeout_ms);
+    if (r == -1) {
+        return -1;
+    } else if (!r) {
+        return 0;
+    } else if ((pfd.revents & (POLLERR | POLLNVAL)) || ((pfd.revents & POLLHUP) && !(pfd.revents & POLLIN))) {
+        return -1;
+    }
+
+    return 1;
+}
+
 #ifdef NC_ENABLED_SSH_TLS
 
 void *
@@ -280,6 +310,8 @@ nc_new_session(NC_SIDE side, int shared_ti)
         sess->opts.server.last_rpc = ts_cur.tv_sec;
     } else {
         pthread_mutex_init(&sess->opts.client.msgs_lock, NULL);
+        sess->opts.client.ntf_wakeup[0] = -1;
+        sess->opts.client.ntf_wakeup[1] = -1;
     }
 
     if (!shared_ti) {
@@ -635,6 +667,55 @@ nc_session_ssh_get_banner(const struct nc_session *session)
     }
 }
 
+API int
+nc_session_tls_get_ktls(const struct nc_session *session)
+{
+    NC_CHECK_ARG_RET(NULL, session, 0);
+
+    if (session->ti_type != NC_TI_TLS) {
+        ERR(NULL, "Cannot get the kernel TLS offload of a non-TLS session.");
+        return 0;
+    }
+
+    return session->ti.tls.ktls;
+}
+
+API int
+nc_session_tls_get_record_stats(const struct nc_session *session, uint64_t *records, uint64_t *bytes)
+{
+    NC_CHECK_ARG_RET(NULL, session, -1);
+
+    if (session->ti_type != NC_TI_TLS) {
+        ERR(NULL, "Cannot get the record statistics of a non-TLS session.");
+        return -1;
+    }
+
+    if (records) {
+        *records = session->ti.tls.records_out;
+    }
+    if (bytes) {
+        *bytes = session->ti.tls.bytes_out;
+    }
+    return 0;
+}
+
+void
+nc_session_tls_established(struct nc_session *session)
+{
+    session->ti.tls.ktls = nc_tls_get_ktls_wrap(session->ti.tls.session);
+    if (session->ti.tls.ktls) {
+        VRB(session, "Kernel TLS offload used for%s%s.", (session->ti.tls.ktls & NC_TLS_KTLS_TX) ? " sending" : "",
+                (session->ti.tls.ktls & NC_TLS_KTLS_RX) ? " receiving" : "");
+    }
+
+    /* only the records sent after the handshake, records sent by the kernel are not counted */
+    session->ti.tls.records_out = 0;
+    session->ti.tls.bytes_out = 0;
+    if (!(session->ti.tls.ktls & NC_TLS_KTLS_TX)) {
+        nc_tls_count_records_wrap(session->ti.tls.session, &session->ti.tls.records_out);
+    }
+}
+
 #endif
 
 API const struct ly_ctx *
@@ -853,7 +934,20 @@ nc_session_free_transport(struct nc_session *session, int *multisession)
         memset(&session->ti.tls.ctx, 0, sizeof session->ti.tls.ctx);
         nc_tls_session_destroy_wrap(session->ti.tls.session);
         session->ti.tls.session = NULL;
-        nc_tls_config_destroy_wrap(session->ti.tls.config);
+        if (session->ti.tls.hs) {
+            free(session->ti.tls.hs->endpt_name);
+            free(session->ti.tls.hs);
+            session->ti.tls.hs = NULL;
+        }
+        free(session->ti.tls.wbuf);
+        session->ti.tls.wbuf = NULL;
+        if (session->ti.tls.srv_ctx) {
+            /* the config is shared, only release the reference */
+            nc_server_tls_ctx_unref(session->ti.tls.srv_ctx);
+            session->ti.tls.srv_ctx = NULL;
+        } else {
+            nc_tls_config_destroy_wrap(session->ti.tls.config);
+        }
         session->ti.tls.config = NULL;
 
         if (session->side == NC_SERVER) {
@@ -877,16 +971,22 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
 {
     int r, i, rpc_locked = 0, msgs_locked = 0, timeout;
     int multisession = 0; /* flag for more NETCONF sessions on a single SSH session */
-    struct nc_msg_cont *contiter;
     struct ly_in *msg;
     struct timespec ts;
-    void *p;
     NC_STATUS status;
 
     if (!session) {
         return;
     }
 
+#ifdef NC_ENABLED_SSH_TLS
+    if ((session->side == NC_SERVER) && (session->ti_type == NC_TI_SSH) && session->ti.libssh.auth &&
+            nc_server_ssh_auth_state_release(session)) {
+        /* an authentication worker still uses the session, it frees it once finished */
+        return;
+    }
+#endif
+
     if ((session->side == NC_SERVER) && (session->flags & NC_SESSION_CALLHOME)) {
         /* CH LOCK */
         pthread_mutex_lock(&session->opts.server.ch_lock);
@@ -914,6 +1014,7 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
     if ((session->side == NC_CLIENT) && ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running)) {
         /* let the threads know they should quit */
         ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 0);
+        nc_client_notif_wakeup(session);
 
         /* wait for them */
         nc_timeouttime_get(&ts, NC_SESSION_FREE_LOCK_TIMEOUT);
@@ -952,14 +1053,12 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
             ERR(session, "Freeing a session while messages are being received.");
         }
 
-        /* cleanup message queue */
-        for (contiter = session->opts.client.msgs; contiter; ) {
-            ly_in_free(contiter->msg, 1);
+        /* cleanup message queues */
+        nc_client_msg_queue_free(session, &session->opts.client.replies);
+        nc_client_msg_queue_free(session, &session->opts.client.notifs);
 
-            p = contiter;
-            contiter = contiter->next;
-            free(p);
-        }
+        /* discard RPCs still waiting for their reply */
+        nc_client_rpc_pending_free_all(session);
 
         if (msgs_locked) {
             /* MSGS UNLOCK */
@@ -984,11 +1083,21 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
             free(session->opts.client.cpblts);
         }
 
+        /* yang-library content-id */
+        free(session->opts.client.content_id);
+
+        /* on-demand module loading */
+        nc_client_lazy_ctx_free(session);
+
+        /* opaque parsing context */
+        ly_ctx_destroy(session->opts.client.opaq_ctx);
+
         /* LY ext data */
 #ifdef NC_ENABLED_SSH_TLS
         struct nc_session *siter;
 
-        if ((session->flags & NC_SESSION_SHAREDCTX) && (session->ti_type == NC_TI_SSH) && session->ti.libssh.next) {
+        if ((session->flags & NC_SESSION_SHAREDCTX) && !session->opts.client.ctx_entry && (session->ti_type == NC_TI_SSH) &&
+                session->ti.libssh.next) {
             for (siter = session->ti.libssh.next; siter != session; siter = siter->ti.libssh.next) {
                 if (siter->status != NC_STATUS_STARTING) {
                     /* move LY ext data to this session */
@@ -1059,7 +1168,10 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         free(session->io_lock);
     }
 
-    if (!(session->flags & NC_SESSION_SHAREDCTX)) {
+    if ((session->side == NC_CLIENT) && session->opts.client.ctx_entry) {
+        /* shared client context */
+        nc_client_ctx_pool_release(session->opts.client.ctx_entry);
+    } else if (!(session->flags & NC_SESSION_SHAREDCTX)) {
         ly_ctx_destroy((struct ly_ctx *)session->ctx);
     }
 
@@ -1069,6 +1181,10 @@ nc_session_free(struct nc_session *session, void (*data_free)(void *))
         pthread_mutex_destroy(&session->opts.server.ch_lock);
     } else {
         pthread_mutex_destroy(&session->opts.client.msgs_lock);
+        if (session->opts.client.ntf_wakeup[0] > -1) {
+            close(session->opts.client.ntf_wakeup[0]);
+            close(session->opts.client.ntf_wakeup[1]);
+        }
     }
 
     free(session);
@@ -1623,6 +1739,14 @@ nc_handshake_io(struct nc_session *session)
 
 #ifdef NC_ENABLED_SSH_TLS
 
+/**
+ * @brief Process-wide CRL cache.
+ */
+static struct nc_crl_cache crl_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+};
+
 /**
  * @brief CURL callback for downloading data.
  *
@@ -1641,26 +1765,81 @@ nc_session_curl_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
 
     data = (struct nc_curl_data *)userdata;
 
-    data->data = nc_realloc(data->data, data->size + size);
+    /* keep the data always NUL-terminated */
+    data->data = nc_realloc(data->data, data->size + size + 1);
     NC_CHECK_ERRMEM_RET(!data->data, 0);
 
     memcpy(&data->data[data->size], ptr, size);
     data->size += size;
+    data->data[data->size] = '\0';
 
     return size;
 }
 
+/**
+ * @brief CURL callback for processing HTTP headers relevant for caching.
+ *
+ * @param[in] buffer Header line, not NUL-terminated.
+ * @param[in] size Size of one element.
+ * @param[in] nitems Number of elements.
+ * @param[in,out] userdata Storage of the parsed header values.
+ * @return Number of bytes processed.
+ */
+static size_t
+nc_session_curl_header_cb(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    struct nc_curl_data *data = userdata;
+    size_t len = size * nitems, i;
+    char *line, *ptr;
+
+    line = strndup(buffer, len);
+    NC_CHECK_ERRMEM_RET(!line, 0);
+
+    /* trim the line end */
+    for (i = strlen(line); i && isspace(line[i - 1]); --i) {
+        line[i - 1] = '\0';
+    }
+
+    if (!strncasecmp(line, "ETag:", 5)) {
+        ptr = line + 5;
+        while (isspace(*ptr)) {
+            ++ptr;
+        }
+        free(data->etag);
+        data->etag = strdup(ptr);
+        NC_CHECK_ERRMEM_GOTO(!data->etag, len = 0, cleanup);
+    } else if (!strncasecmp(line, "Cache-Control:", 14)) {
+        if (strcasestr(line, "no-cache") || strcasestr(line, "no-store")) {
+            data->max_age = 0;
+        } else if ((ptr = strcasestr(line, "max-age="))) {
+            data->max_age = strtol(ptr + 8, NULL, 10);
+        }
+    }
+
+cleanup:
+    free(line);
+    return len;
+}
+
 /**
  * @brief Download data using CURL.
  *
  * @param[in] handle CURL handle.
  * @param[in] url URL to download the data from.
+ * @param[in] etag ETag of the cached data, if any.
+ * @param[in] last_modified Last modification time of the cached data, 0 if unknown.
+ * @param[out] not_modified Set if the cached data are still valid and nothing was downloaded.
  * @return 0 on success, 1 on failure.
  */
 static int
-nc_session_curl_fetch(CURL *handle, const char *url)
+nc_session_curl_fetch(CURL *handle, const char *url, const char *etag, time_t last_modified, int *not_modified)
 {
-    char err_buf[CURL_ERROR_SIZE];
+    int ret = 0;
+    char err_buf[CURL_ERROR_SIZE], *hdr = NULL;
+    struct curl_slist *headers = NULL;
+    long resp_code = 0, unmet = 0;
+
+    *not_modified = 0;
 
     /* set uri */
     if (curl_easy_setopt(handle, CURLOPT_URL, url)) {
@@ -1674,13 +1853,38 @@ nc_session_curl_fetch(CURL *handle, const char *url)
         return 1;
     }
 
+    /* conditional request if we have the data already */
+    if (etag) {
+        if (asprintf(&hdr, "If-None-Match: %s", etag) == -1) {
+            ERRMEM;
+            return 1;
+        }
+        headers = curl_slist_append(NULL, hdr);
+        free(hdr);
+        NC_CHECK_ERRMEM_RET(!headers, 1);
+    }
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(handle, CURLOPT_TIMECONDITION, last_modified ? CURL_TIMECOND_IFMODSINCE : CURL_TIMECOND_NONE);
+    curl_easy_setopt(handle, CURLOPT_TIMEVALUE, (long)last_modified);
+
     /* download */
     if (curl_easy_perform(handle)) {
         ERR(NULL, "Downloading CRL from \"%s\" failed (%s).", url, err_buf);
-        return 1;
+        ret = 1;
+        goto cleanup;
     }
 
-    return 0;
+    /* learn whether the cached data are still valid */
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &resp_code);
+    curl_easy_getinfo(handle, CURLINFO_CONDITION_UNMET, &unmet);
+    if ((resp_code == 304) || unmet) {
+        *not_modified = 1;
+    }
+
+cleanup:
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, NULL);
+    curl_slist_free_all(headers);
+    return ret;
 }
 
 /**
@@ -1713,31 +1917,495 @@ nc_session_curl_init(CURL **handle, struct nc_curl_data *data)
         return 1;
     }
 
+    if (curl_easy_setopt(*handle, CURLOPT_HEADERFUNCTION, nc_session_curl_header_cb)) {
+        ERR(NULL, "Setting curl header callback failed.");
+        return 1;
+    }
+
+    if (curl_easy_setopt(*handle, CURLOPT_HEADERDATA, data)) {
+        ERR(NULL, "Setting curl header callback data failed.");
+        return 1;
+    }
+
+    /* learn the modification time and do not treat HTTP errors as CRLs */
+    curl_easy_setopt(*handle, CURLOPT_FILETIME, 1L);
+    curl_easy_setopt(*handle, CURLOPT_FAILONERROR, 1L);
+
     return 0;
 }
 
+/**
+ * @brief Download a CRL into a CRL cache entry.
+ *
+ * On success, the entry data are replaced unless not modified and the refresh time is always updated.
+ *
+ * @param[in] handle CURL handle initialized with @p data.
+ * @param[in,out] data Download storage, cleared before returning.
+ * @param[in,out] entry CRL cache entry with the URI, not inserted in the cache.
+ * @param[out] modified Whether the entry data changed.
+ * @return 0 on success, 1 on failure.
+ */
+static int
+nc_session_crl_cache_download(CURL *handle, struct nc_curl_data *data, struct nc_crl_cache_entry *entry, int *modified)
+{
+    int ret = 0, not_modified;
+    long filetime = -1;
+    time_t now, next_update, refresh_time;
+
+    *modified = 0;
+    data->max_age = -1;
+
+    VRB(NULL, "Downloading CRL from \"%s\".", entry->uri);
+    ret = nc_session_curl_fetch(handle, entry->uri, entry->etag, entry->last_modified, &not_modified);
+    if (ret) {
+        goto cleanup;
+    }
+
+    if (!not_modified) {
+        /* check that it is a CRL and learn when it is going to be updated */
+        next_update = nc_tls_get_crl_next_update_wrap(data->data, data->size);
+        if (next_update == -1) {
+            ret = 1;
+            goto cleanup;
+        }
+
+        free(entry->data);
+        entry->data = data->data;
+        entry->size = data->size;
+        data->data = NULL;
+        free(entry->etag);
+        entry->etag = data->etag;
+        data->etag = NULL;
+        curl_easy_getinfo(handle, CURLINFO_FILETIME, &filetime);
+        entry->last_modified = (filetime > 0) ? filetime : 0;
+        *modified = 1;
+    } else {
+        VRB(NULL, "CRL from \"%s\" not modified.", entry->uri);
+        next_update = nc_tls_get_crl_next_update_wrap(entry->data, entry->size);
+    }
+
+    /* refresh on nextUpdate or HTTP expiration, whichever comes first */
+    now = time(NULL);
+    refresh_time = now + NC_CRL_CACHE_REFRESH_DEFAULT;
+    if (next_update > 0) {
+        refresh_time = next_update;
+    }
+    if ((data->max_age > -1) && (now + data->max_age < refresh_time)) {
+        refresh_time = now + data->max_age;
+    }
+    if (refresh_time < now + NC_CRL_CACHE_REFRESH_MIN) {
+        refresh_time = now + NC_CRL_CACHE_REFRESH_MIN;
+    }
+    entry->refresh_time = refresh_time;
+
+cleanup:
+    free(data->data);
+    data->data = NULL;
+    data->size = 0;
+    free(data->etag);
+    data->etag = NULL;
+    return ret;
+}
+
+/**
+ * @brief Free a CRL cache entry.
+ *
+ * @param[in] entry Entry to free.
+ */
+static void
+nc_session_crl_cache_entry_free(struct nc_crl_cache_entry *entry)
+{
+    free(entry->uri);
+    free(entry->data);
+    free(entry->etag);
+}
+
+/**
+ * @brief Find a CRL cache entry.
+ *
+ * CRL CACHE LOCK HAS TO BE LOCKED PRIOR TO CALLING THIS
+ *
+ * @param[in] uri URI of the CRL.
+ * @return Found entry, NULL if not cached.
+ */
+static struct nc_crl_cache_entry *
+nc_session_crl_cache_find(const char *uri)
+{
+    uint32_t i;
+
+    for (i = 0; i < crl_cache.entry_count; i++) {
+        if (!strcmp(crl_cache.entries[i].uri, uri)) {
+            return &crl_cache.entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief CRL cache refresh thread, downloads every CRL again when its refresh time comes.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+nc_session_crl_cache_thread(void *UNUSED(arg))
+{
+    int r, modified;
+    uint32_t i;
+    time_t now;
+    struct timespec wakeup_time = {0};
+    struct nc_crl_cache_entry aux, *entry;
+    struct nc_curl_data downloaded = {0};
+    CURL *handle = NULL;
+
+    if (nc_session_curl_init(&handle, &downloaded)) {
+        /* CRL CACHE LOCK */
+        pthread_mutex_lock(&crl_cache.lock);
+        goto cleanup;
+    }
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+
+    while (!crl_cache.thread_stop) {
+        /* find the CRL to be refreshed first */
+        now = time(NULL);
+        wakeup_time.tv_sec = now + NC_CRL_CACHE_REFRESH_DEFAULT;
+        entry = NULL;
+        for (i = 0; i < crl_cache.entry_count; i++) {
+            if (crl_cache.entries[i].refresh_time < wakeup_time.tv_sec) {
+                wakeup_time.tv_sec = crl_cache.entries[i].refresh_time;
+                entry = &crl_cache.entries[i];
+            }
+        }
+
+        if (!entry || (wakeup_time.tv_sec > now)) {
+            /* sleep until the refresh time or until woken up */
+            r = pthread_cond_clockwait(&crl_cache.cond, &crl_cache.lock, CLOCK_REALTIME, &wakeup_time);
+            if (r && (r != ETIMEDOUT)) {
+                ERR(NULL, "Pthread condition timedwait failed (%s).", strerror(r));
+                break;
+            }
+            continue;
+        }
+
+        /* download a copy of the entry without holding the lock */
+        memset(&aux, 0, sizeof aux);
+        aux.uri = strdup(entry->uri);
+        aux.etag = entry->etag ? strdup(entry->etag) : NULL;
+        aux.data = malloc(entry->size + 1);
+        if (!aux.uri || (entry->etag && !aux.etag) || !aux.data) {
+            ERRMEM;
+            nc_session_crl_cache_entry_free(&aux);
+            break;
+        }
+        memcpy(aux.data, entry->data, entry->size + 1);
+        aux.size = entry->size;
+        aux.last_modified = entry->last_modified;
+        aux.generation = entry->generation;
+
+        /* CRL CACHE UNLOCK */
+        pthread_mutex_unlock(&crl_cache.lock);
+
+        r = nc_session_crl_cache_download(handle, &downloaded, &aux, &modified);
+
+        /* CRL CACHE LOCK */
+        pthread_mutex_lock(&crl_cache.lock);
+
+        entry = nc_session_crl_cache_find(aux.uri);
+        if (entry && r) {
+            /* keep the previous CRL and try again later */
+            WRN(NULL, "Failed to refresh CRL from \"%s\", using the previous one.", aux.uri);
+            entry->refresh_time = time(NULL) + NC_CRL_CACHE_REFRESH_MIN;
+        } else if (entry) {
+            /* update the entry */
+            nc_session_crl_cache_entry_free(entry);
+            *entry = aux;
+            memset(&aux, 0, sizeof aux);
+            if (modified) {
+                entry->generation = ++crl_cache.generation;
+            }
+        }
+        nc_session_crl_cache_entry_free(&aux);
+    }
+
+cleanup:
+    /* joined once the cache is destroyed or the thread is needed again */
+    crl_cache.thread_exited = 1;
+
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    VRB(NULL, "CRL cache refresh thread exit.");
+    curl_easy_cleanup(handle);
+    return NULL;
+}
+
 int
-nc_session_tls_crl_from_cert_ext_fetch(void *leaf_cert, void *cert_store, void **crl_store)
+nc_session_tls_crl_cache_get(const char *uri, int cached_only, void *crl_store, uint32_t *generation)
 {
-    int ret = 0, uri_count = 0, i;
+    int ret = 0, r, modified;
     CURL *handle = NULL;
     struct nc_curl_data downloaded = {0};
+    struct nc_crl_cache_entry new_entry = {0}, *entry, *entries;
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+
+    entry = nc_session_crl_cache_find(uri);
+    if (entry) {
+        /* cache hit, add the cached CRL to the store */
+        if (crl_store) {
+            ret = nc_server_tls_add_crl_to_store_wrap(entry->data, entry->size, crl_store);
+        }
+        if (!ret && generation) {
+            *generation = entry->generation;
+        }
+        goto cleanup;
+    } else if (cached_only) {
+        ret = 2;
+        goto cleanup;
+    }
+
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    /* not cached yet, download it now */
+    new_entry.uri = strdup(uri);
+    NC_CHECK_ERRMEM_RET(!new_entry.uri, 1);
+    if (nc_session_curl_init(&handle, &downloaded) ||
+            nc_session_crl_cache_download(handle, &downloaded, &new_entry, &modified)) {
+        curl_easy_cleanup(handle);
+        nc_session_crl_cache_entry_free(&new_entry);
+        return 1;
+    }
+    curl_easy_cleanup(handle);
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+
+    entry = nc_session_crl_cache_find(uri);
+    if (!entry) {
+        /* insert the new entry */
+        entries = nc_realloc(crl_cache.entries, (crl_cache.entry_count + 1) * sizeof *crl_cache.entries);
+        NC_CHECK_ERRMEM_GOTO(!entries, ret = 1, cleanup);
+        crl_cache.entries = entries;
+        entry = &crl_cache.entries[crl_cache.entry_count];
+        ++crl_cache.entry_count;
+
+        *entry = new_entry;
+        memset(&new_entry, 0, sizeof new_entry);
+        entry->generation = ++crl_cache.generation;
+
+        /* make sure it gets refreshed */
+        if (crl_cache.thread_running && crl_cache.thread_exited) {
+            /* exited on an error, it does not use the cache anymore so it can be joined under the lock */
+            pthread_join(crl_cache.tid, NULL);
+            crl_cache.thread_running = 0;
+        }
+        if (!crl_cache.thread_running) {
+            crl_cache.thread_stop = 0;
+            crl_cache.thread_exited = 0;
+            if ((r = pthread_create(&crl_cache.tid, NULL, nc_session_crl_cache_thread, NULL))) {
+                WRN(NULL, "Failed to create the CRL cache refresh thread (%s).", strerror(r));
+            } else {
+                crl_cache.thread_running = 1;
+            }
+        } else {
+            pthread_cond_signal(&crl_cache.cond);
+        }
+    }
+
+    /* add the CRL to the store */
+    if (crl_store) {
+        ret = nc_server_tls_add_crl_to_store_wrap(entry->data, entry->size, crl_store);
+    }
+    if (!ret && generation) {
+        *generation = entry->generation;
+    }
+
+cleanup:
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    nc_session_crl_cache_entry_free(&new_entry);
+    return ret;
+}
+
+uint32_t
+nc_session_tls_crl_cache_generation(void)
+{
+    uint32_t generation;
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+    generation = crl_cache.generation;
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    return generation;
+}
+
+int
+nc_session_tls_crl_cache_changed(const struct nc_crl_cache_ref *crls, uint32_t crl_count)
+{
+    int changed = 0;
+    uint32_t i;
+    struct nc_crl_cache_entry *entry;
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+
+    for (i = 0; i < crl_count; i++) {
+        entry = nc_session_crl_cache_find(crls[i].uri);
+        if ((entry ? entry->generation : 0) != crls[i].generation) {
+            changed = 1;
+            break;
+        }
+    }
+
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    return changed;
+}
+
+time_t
+nc_session_tls_crl_cache_refresh_time(const char *uri)
+{
+    time_t refresh_time = 0;
+    struct nc_crl_cache_entry *entry;
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+    entry = nc_session_crl_cache_find(uri);
+    if (entry) {
+        refresh_time = entry->refresh_time;
+    }
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    return refresh_time;
+}
+
+int
+nc_session_tls_crl_cache_expire(const char *uri)
+{
+    struct nc_crl_cache_entry *entry;
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+    entry = nc_session_crl_cache_find(uri);
+    if (entry) {
+        /* refresh it right away */
+        entry->refresh_time = 0;
+        pthread_cond_signal(&crl_cache.cond);
+    }
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    return entry ? 0 : 1;
+}
+
+void
+nc_session_tls_crl_cache_refs_free(struct nc_crl_cache_ref *crls, uint32_t crl_count)
+{
+    uint32_t i;
+
+    for (i = 0; i < crl_count; i++) {
+        free(crls[i].uri);
+    }
+    free(crls);
+}
+
+void
+nc_session_tls_crl_cache_destroy(void)
+{
+    uint32_t i;
+    int thread_running;
+    pthread_t tid;
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+    thread_running = crl_cache.thread_running;
+    tid = crl_cache.tid;
+    crl_cache.thread_running = 0;
+    crl_cache.thread_stop = 1;
+    pthread_cond_signal(&crl_cache.cond);
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+
+    if (thread_running) {
+        /* also if it has already exited on its own */
+        pthread_join(tid, NULL);
+    }
+
+    /* CRL CACHE LOCK */
+    pthread_mutex_lock(&crl_cache.lock);
+    for (i = 0; i < crl_cache.entry_count; i++) {
+        nc_session_crl_cache_entry_free(&crl_cache.entries[i]);
+    }
+    free(crl_cache.entries);
+    crl_cache.entries = NULL;
+    crl_cache.entry_count = 0;
+    ++crl_cache.generation;
+    /* CRL CACHE UNLOCK */
+    pthread_mutex_unlock(&crl_cache.lock);
+}
+
+/**
+ * @brief Add a URI into a set of URIs.
+ *
+ * @param[in] uri URI to add.
+ * @param[in,out] uris Set of URIs.
+ * @param[in,out] uri_count Count of @p uris.
+ * @return 0 on success, 1 on error.
+ */
+static int
+nc_session_tls_crl_uri_add(const char *uri, char ***uris, uint32_t *uri_count)
+{
+    uint32_t i;
+    void *tmp;
+
+    for (i = 0; i < *uri_count; i++) {
+        if (!strcmp((*uris)[i], uri)) {
+            /* already added */
+            return 0;
+        }
+    }
+
+    tmp = realloc(*uris, (*uri_count + 1) * sizeof **uris);
+    NC_CHECK_ERRMEM_RET(!tmp, 1);
+    *uris = tmp;
+    (*uris)[*uri_count] = strdup(uri);
+    NC_CHECK_ERRMEM_RET(!(*uris)[*uri_count], 1);
+    ++(*uri_count);
+
+    return 0;
+}
+
+int
+nc_session_tls_crl_from_cert_ext_fetch(void *leaf_cert, void *cert_store, char ***uncached, uint32_t *uncached_count,
+        void **crl_store, struct nc_crl_cache_ref **crls, uint32_t *crl_count)
+{
+    int ret = 0, uri_count = 0, i, r;
     char **uris = NULL;
     void *crl_store_aux = NULL;
+    struct nc_crl_cache_ref *refs = NULL;
+    uint32_t generation;
 
     *crl_store = NULL;
+    if (crls) {
+        *crls = NULL;
+        *crl_count = 0;
+    }
 
     crl_store_aux = nc_tls_crl_store_new_wrap();
     if (!crl_store_aux) {
         goto cleanup;
     }
 
-    /* init curl */
-    ret = nc_session_curl_init(&handle, &downloaded);
-    if (ret) {
-        goto cleanup;
-    }
-
     /* get all the uris we can, even though some may point to the same CRL */
     ret = nc_server_tls_get_crl_distpoint_uris_wrap(leaf_cert, cert_store, &uris, &uri_count);
     if (ret) {
@@ -1749,38 +2417,52 @@ nc_session_tls_crl_from_cert_ext_fetch(void *leaf_cert, void *cert_store, void *
         goto cleanup;
     }
 
+    if (crls) {
+        refs = calloc(uri_count, sizeof *refs);
+        NC_CHECK_ERRMEM_GOTO(!refs, ret = 1, cleanup);
+    }
+
     for (i = 0; i < uri_count; i++) {
-        VRB(NULL, "Downloading CRL from \"%s\".", uris[i]);
-        ret = nc_session_curl_fetch(handle, uris[i]);
-        if (ret) {
-            /* failed to download the CRL from this entry, try the next entry */
+        /* add the CRL to the store, it is downloaded only if not cached and allowed */
+        generation = 0;
+        r = nc_session_tls_crl_cache_get(uris[i], uncached ? 1 : 0, crl_store_aux, &generation);
+        if (r == 2) {
+            /* to be downloaded by the caller */
+            if (nc_session_tls_crl_uri_add(uris[i], uncached, uncached_count)) {
+                ret = 1;
+                goto cleanup;
+            }
+        } else if (r) {
+            /* failed to get the CRL from this entry, try the next entry */
             WRN(NULL, "Failed to fetch CRL from \"%s\".", uris[i]);
-            continue;
         }
 
-        /* convert the downloaded data to CRL and add it to the store */
-        ret = nc_server_tls_add_crl_to_store_wrap(downloaded.data, downloaded.size, crl_store_aux);
-
-        /* free the downloaded data */
-        free(downloaded.data);
-        downloaded.data = NULL;
-        downloaded.size = 0;
-
-        if (ret) {
-            goto cleanup;
+        if (refs) {
+            /* remember the CRL even if not cached so that the context is rebuilt once it is */
+            refs[i].uri = uris[i];
+            refs[i].generation = generation;
+            uris[i] = NULL;
         }
     }
 
-    *crl_store = crl_store_aux;
-    crl_store_aux = NULL;
-
 cleanup:
+    if (!ret && uri_count) {
+        *crl_store = crl_store_aux;
+        crl_store_aux = NULL;
+        if (crls) {
+            *crls = refs;
+            *crl_count = uri_count;
+            refs = NULL;
+        }
+    }
     for (i = 0; i < uri_count; i++) {
         free(uris[i]);
     }
     free(uris);
-    curl_easy_cleanup(handle);
     nc_tls_crl_store_destroy_wrap(crl_store_aux);
+    if (refs) {
+        nc_session_tls_crl_cache_refs_free(refs, uri_count);
+    }
     return ret;
 }
 
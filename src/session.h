@@ -201,6 +201,37 @@ uint16_t nc_session_get_port(const struct nc_session *session);
  */
 const char *nc_session_ssh_get_banner(const struct nc_session *session);
 
+/**
+ * @brief Kernel TLS offload flags of a TLS session.
+ */
+#define NC_TLS_KTLS_TX 0x01     /**< Sent records are encrypted by the kernel. */
+#define NC_TLS_KTLS_RX 0x02     /**< Received records are decrypted by the kernel. */
+
+/**
+ * @brief Learn whether a TLS session uses kernel TLS (kTLS) offload.
+ *
+ * The offload is used only if it was enabled by ::nc_server_tls_set_ktls() or ::nc_client_tls_set_ktls(),
+ * and it is supported by the TLS library, the kernel, and the negotiated cipher suite.
+ *
+ * @param[in] session TLS session to get the information from.
+ * @return Bit-field of NC_TLS_KTLS_* flags, 0 if no offload is used or on error.
+ */
+int nc_session_tls_get_ktls(const struct nc_session *session);
+
+/**
+ * @brief Get statistics of the TLS records sent on a session.
+ *
+ * Written data are coalesced into records of up to 16 kB, so the average bytes per record are close to it
+ * for bulk messages. The records are counted as they are written by the TLS library, records encrypted
+ * by the kernel (see ::nc_session_tls_get_ktls()) may not be counted.
+ *
+ * @param[in] session TLS session to get the information from.
+ * @param[out] records Optional count of records sent.
+ * @param[out] bytes Optional count of application data bytes sent in the records.
+ * @return 0 on success, -1 on error.
+ */
+int nc_session_tls_get_record_stats(const struct nc_session *session, uint64_t *records, uint64_t *bytes);
+
 #endif
 
 /**
@@ -22,8 +22,10 @@
 #include <arpa/inet.h>
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -32,11 +34,13 @@
 #include <pwd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef NC_ENABLED_SSH_TLS
@@ -52,6 +56,11 @@
 #include "session_client_ch.h"
 #include "session_p.h"
 
+#ifdef HAVE_EPOLL
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
+
 #include "../modules/ietf_netconf@2013-09-29_yang.h"
 #include "../modules/ietf_netconf_monitoring@2010-10-04_yang.h"
 
@@ -95,12 +104,40 @@ static struct nc_client_context context_main = {
 };
 #endif
 
+/* ACCESS locked, shared contexts of client sessions */
+static struct {
+    pthread_mutex_t lock;
+    struct nc_client_ctx_pool_entry *entries;
+} ctx_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * @brief Free a NULL-terminated list of module names.
+ *
+ * @param[in] modules List to free.
+ */
+static void
+nc_client_free_module_names(char **modules)
+{
+    uint32_t u;
+
+    if (!modules) {
+        return;
+    }
+
+    for (u = 0; modules[u]; ++u) {
+        free(modules[u]);
+    }
+    free(modules);
+}
+
 static void
 nc_client_context_free(void *ptr)
 {
     struct nc_client_context *c = (struct nc_client_context *)ptr;
 
-    if (--(c->refcount)) {
+    if (ATOMIC_DEC_RELAXED(c->refcount) != 1) {
         /* still used */
         return;
     }
@@ -115,6 +152,8 @@ nc_client_context_free(void *ptr)
     {
         /* for the main thread the same is done in nc_client_destroy() */
         free(c->opts.schema_searchpath);
+        free(c->opts.module_cache_dir);
+        nc_client_free_module_names(c->opts.context_lazy_modules);
 
 #ifdef NC_ENABLED_SSH_TLS
         int i;
@@ -165,7 +204,7 @@ nc_client_context_location(void)
         {
             e = calloc(1, sizeof *e);
             /* set default values */
-            e->refcount = 1;
+            ATOMIC_STORE_RELAXED(e->refcount, 1);
             e->opts.ka.enabled = 1;
             e->opts.ka.idle_time = 1;
             e->opts.ka.max_probes = 10;
@@ -230,7 +269,7 @@ nc_client_set_thread_context(void *context)
 
     /* replace old by new, increase reference counter in the newly set context */
     nc_client_context_free(old);
-    new->refcount++;
+    ATOMIC_INC_RELAXED(new->refcount);
     pthread_setspecific(nc_client_context_key, new);
 }
 
@@ -312,6 +351,31 @@ nc_client_get_schema_searchpath(void)
     return client_opts.schema_searchpath;
 }
 
+API int
+nc_client_set_module_cache(const char *path, size_t size_limit)
+{
+    free(client_opts.module_cache_dir);
+    client_opts.module_cache_dir = NULL;
+    client_opts.module_cache_size_max = 0;
+
+    if (path) {
+        client_opts.module_cache_dir = strdup(path);
+        NC_CHECK_ERRMEM_RET(!client_opts.module_cache_dir, 1);
+        client_opts.module_cache_size_max = size_limit;
+    }
+
+    return 0;
+}
+
+API const char *
+nc_client_get_module_cache(size_t *size_limit)
+{
+    if (size_limit) {
+        *size_limit = client_opts.module_cache_size_max;
+    }
+    return client_opts.module_cache_dir;
+}
+
 API int
 nc_client_set_schema_callback(ly_module_imp_clb clb, void *user_data)
 {
@@ -340,6 +404,37 @@ nc_client_set_new_session_context_autofill(int enabled)
     client_opts.auto_context_fill_disabled = !enabled;
 }
 
+API void
+nc_client_set_new_session_context_sharing(int enabled)
+{
+    client_opts.context_sharing_enabled = enabled ? 1 : 0;
+}
+
+API int
+nc_client_set_new_session_context_lazy(int enabled, const char **modules)
+{
+    uint32_t u, count;
+    char **names = NULL;
+
+    if (enabled && modules) {
+        for (count = 0; modules[count]; ++count) {}
+        names = calloc(count + 1, sizeof *names);
+        NC_CHECK_ERRMEM_RET(!names, 1);
+        for (u = 0; u < count; ++u) {
+            names[u] = strdup(modules[u]);
+            NC_CHECK_ERRMEM_GOTO(!names[u], nc_client_free_module_names(names), error);
+        }
+    }
+
+    nc_client_free_module_names(client_opts.context_lazy_modules);
+    client_opts.context_lazy_modules = names;
+    client_opts.context_lazy_enabled = enabled ? 1 : 0;
+    return 0;
+
+error:
+    return 1;
+}
+
 struct module_info {
     char *name;
     char *revision;
@@ -347,9 +442,12 @@ struct module_info {
     struct {
         char *name;
         char *revision;
+        char *data;     /**< prefetched submodule content */
     } *submodules;
     char **features;
     int implemented;
+    char *ns;           /**< module namespace, if known */
+    char *data;         /**< prefetched module content */
 };
 
 struct clb_data_s {
@@ -360,6 +458,438 @@ struct clb_data_s {
     int has_get_schema;
 };
 
+/**
+ * @brief Hash YANG module text for the module cache (64-bit FNV-1a).
+ *
+ * @param[in] data Data to hash.
+ * @param[in] len Length of @p data.
+ * @return Hash of @p data.
+ */
+static uint64_t
+nc_module_cache_hash(const char *data, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Get the module cache key (file name of the link to the cached module text).
+ *
+ * A module with a revision is identified by its name and revision, a module without one only together
+ * with the yang-library content-id of the server.
+ *
+ * @param[in] session NC session the module is retrieved for.
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @return Allocated key, NULL if the module cannot be cached.
+ */
+static char *
+nc_module_cache_key(struct nc_session *session, const char *name, const char *rev)
+{
+    const char *content_id = session->opts.client.content_id;
+    char *key = NULL;
+    int r;
+
+    if (strchr(name, '/') || (name[0] == '.') || (rev && strchr(rev, '/'))) {
+        /* not a valid YANG identifier */
+        return NULL;
+    }
+
+    if (rev && rev[0]) {
+        r = asprintf(&key, "%s@%s.yang", name, rev);
+    } else if (content_id) {
+        r = asprintf(&key, "%s+%016" PRIx64 ".yang", name, nc_module_cache_hash(content_id, strlen(content_id)));
+    } else {
+        /* unknown revision of the module */
+        return NULL;
+    }
+    NC_CHECK_ERRMEM_RET(r == -1, NULL);
+
+    return key;
+}
+
+/**
+ * @brief Check whether a file name in the module cache is a cached module text.
+ *
+ * @param[in] fname File name.
+ * @param[out] hash Optional hash parsed from the name.
+ * @return Whether @p fname is a module text object.
+ */
+static int
+nc_module_cache_is_object(const char *fname, uint64_t *hash)
+{
+    uint64_t h = 0;
+    int i;
+
+    for (i = 0; i < 16; ++i) {
+        if ((fname[i] >= '0') && (fname[i] <= '9')) {
+            h = (h << 4) | (uint64_t)(fname[i] - '0');
+        } else if ((fname[i] >= 'a') && (fname[i] <= 'f')) {
+            h = (h << 4) | (uint64_t)(fname[i] - 'a' + 10);
+        } else {
+            return 0;
+        }
+    }
+    if (strcmp(fname + 16, ".yang")) {
+        return 0;
+    }
+
+    if (hash) {
+        *hash = h;
+    }
+    return 1;
+}
+
+/**
+ * @brief Lock the module cache directory.
+ *
+ * Links are created under a shared lock, while only an exclusive lock allows to remove dangling links
+ * without removing a link that was just re-created by another process.
+ *
+ * @param[in] dir Module cache directory.
+ * @param[in] op Lock operation for flock(2).
+ * @return Lock file descriptor to close for unlocking, -1 if not locked.
+ */
+static int
+nc_module_cache_lock(const char *dir, int op)
+{
+    char *path;
+    int fd;
+
+    if (asprintf(&path, "%s/.lock", dir) == -1) {
+        ERRMEM;
+        return -1;
+    }
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    free(path);
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (flock(fd, op)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Remove a dangling link from the module cache.
+ *
+ * The link is removed only if it still points to @p target and the object does not exist.
+ *
+ * @param[in] dir Module cache directory.
+ * @param[in] key Key of the link.
+ * @param[in] target Expected object the link points to.
+ */
+static void
+nc_module_cache_unlink_dangling(const char *dir, const char *key, const char *target)
+{
+    char *path = NULL, cur_target[32];
+    struct stat st;
+    ssize_t r;
+    int lock_fd;
+
+    /* CACHE LOCK */
+    lock_fd = nc_module_cache_lock(dir, LOCK_EX);
+    if (lock_fd == -1) {
+        return;
+    }
+
+    if (asprintf(&path, "%s/%s", dir, key) == -1) {
+        ERRMEM;
+        path = NULL;
+        goto cleanup;
+    }
+
+    /* the link may have been re-created meanwhile */
+    r = readlink(path, cur_target, sizeof cur_target - 1);
+    if (r < 0) {
+        goto cleanup;
+    }
+    cur_target[r] = '\0';
+    if (strcmp(cur_target, target) || !stat(path, &st) || (errno != ENOENT)) {
+        goto cleanup;
+    }
+
+    unlink(path);
+
+cleanup:
+    /* CACHE UNLOCK */
+    close(lock_fd);
+    free(path);
+}
+
+char *
+nc_module_cache_retrieve(struct nc_session *session, const char *name, const char *rev)
+{
+    const char *dir = client_opts.module_cache_dir;
+    char *key = NULL, *path = NULL, *model_data = NULL, target[32];
+    struct stat st;
+    uint64_t hash;
+    ssize_t r;
+    int fd = -1;
+
+    if (!dir || !(key = nc_module_cache_key(session, name, rev))) {
+        return NULL;
+    }
+
+    /* find the object the key points to */
+    if (asprintf(&path, "%s/%s", dir, key) == -1) {
+        ERRMEM;
+        path = NULL;
+        goto cleanup;
+    }
+    r = readlink(path, target, sizeof target - 1);
+    if (r < 0) {
+        /* not cached */
+        goto cleanup;
+    }
+    target[r] = '\0';
+    if (!nc_module_cache_is_object(target, &hash)) {
+        WRN(session, "Invalid module cache entry \"%s\", removing it.", path);
+        unlink(path);
+        goto cleanup;
+    }
+
+    /* read it */
+    free(path);
+    if (asprintf(&path, "%s/%s", dir, target) == -1) {
+        ERRMEM;
+        path = NULL;
+        goto cleanup;
+    }
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            /* object evicted, remove the dangling link */
+            nc_module_cache_unlink_dangling(dir, key, target);
+        }
+        goto cleanup;
+    }
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        goto cleanup;
+    }
+    model_data = malloc(st.st_size + 1);
+    NC_CHECK_ERRMEM_GOTO(!model_data, , cleanup);
+    r = read(fd, model_data, st.st_size);
+    if ((r != st.st_size) || (nc_module_cache_hash(model_data, r) != hash)) {
+        WRN(session, "Corrupted module cache object \"%s\", removing it.", path);
+        unlink(path);
+        free(model_data);
+        model_data = NULL;
+        goto cleanup;
+    }
+    model_data[r] = '\0';
+
+    /* mark as recently used */
+    futimens(fd, NULL);
+
+    VRB(session, "Reading module \"%s@%s\" from the module cache.", name, rev ? rev : "<latest>");
+
+cleanup:
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+    free(key);
+    return model_data;
+}
+
+struct nc_module_cache_obj {
+    char name[24];
+    off_t size;
+    time_t mtime;
+};
+
+static int
+nc_module_cache_obj_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct nc_module_cache_obj *obj1 = ptr1, *obj2 = ptr2;
+
+    if (obj1->mtime < obj2->mtime) {
+        return -1;
+    } else if (obj1->mtime > obj2->mtime) {
+        return 1;
+    }
+    return 0;
+}
+
+void
+nc_module_cache_evict(const char *dir, size_t size_max)
+{
+    DIR *d = NULL;
+    struct dirent *ent;
+    struct stat st;
+    struct nc_module_cache_obj *objs = NULL, *tmp;
+    uint32_t count = 0, size = 0, u;
+    uint64_t total = 0;
+    int lock_fd, dir_fd;
+
+    /* CACHE LOCK */
+    lock_fd = nc_module_cache_lock(dir, LOCK_EX | LOCK_NB);
+    if (lock_fd == -1) {
+        /* another process is evicting or storing a module, which evicts afterwards */
+        return;
+    }
+
+    d = opendir(dir);
+    if (!d) {
+        goto cleanup;
+    }
+    dir_fd = dirfd(d);
+
+    /* collect all the objects */
+    while ((ent = readdir(d))) {
+        if (!nc_module_cache_is_object(ent->d_name, NULL) || fstatat(dir_fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) ||
+                !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        if (count == size) {
+            size = size ? size * 2 : 32;
+            tmp = nc_realloc(objs, size * sizeof *objs);
+            NC_CHECK_ERRMEM_GOTO(!tmp, , cleanup);
+            objs = tmp;
+        }
+        strcpy(objs[count].name, ent->d_name);
+        objs[count].size = st.st_size;
+        objs[count].mtime = st.st_mtime;
+        total += st.st_size;
+        ++count;
+    }
+    if (total <= size_max) {
+        goto cleanup;
+    }
+
+    /* remove the oldest objects */
+    qsort(objs, count, sizeof *objs, nc_module_cache_obj_cmp);
+    for (u = 0; (u < count) && (total > size_max); ++u) {
+        if (!unlinkat(dir_fd, objs[u].name, 0)) {
+            total -= objs[u].size;
+        }
+    }
+
+    /* remove dangling links */
+    rewinddir(d);
+    while ((ent = readdir(d))) {
+        if ((ent->d_name[0] != '.') && !fstatat(dir_fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) &&
+                S_ISLNK(st.st_mode) && fstatat(dir_fd, ent->d_name, &st, 0) && (errno == ENOENT)) {
+            unlinkat(dir_fd, ent->d_name, 0);
+        }
+    }
+
+cleanup:
+    if (d) {
+        closedir(d);
+    }
+    /* CACHE UNLOCK */
+    close(lock_fd);
+    free(objs);
+}
+
+void
+nc_module_cache_store(struct nc_session *session, const char *name, const char *rev, const char *model_data)
+{
+    const char *dir = client_opts.module_cache_dir;
+    char *key = NULL, *tmp_path = NULL, *path = NULL, target[24];
+    size_t len = strlen(model_data);
+    ssize_t r;
+    int fd = -1, lock_fd = -1;
+
+    if (!dir || !(key = nc_module_cache_key(session, name, rev))) {
+        return;
+    }
+    if (mkdir(dir, 0755) && (errno != EEXIST)) {
+        WRN(session, "Unable to create module cache directory \"%s\" (%s).", dir, strerror(errno));
+        goto cleanup;
+    }
+    sprintf(target, "%016" PRIx64 ".yang", nc_module_cache_hash(model_data, len));
+
+    /* write the object */
+    if (asprintf(&tmp_path, "%s/.tmp.XXXXXX", dir) == -1) {
+        ERRMEM;
+        tmp_path = NULL;
+        goto cleanup;
+    }
+    fd = mkstemp(tmp_path);
+    if (fd == -1) {
+        WRN(session, "Unable to create a module cache file in \"%s\" (%s).", dir, strerror(errno));
+        goto cleanup;
+    }
+    fchmod(fd, 0644);
+    r = write(fd, model_data, len);
+    close(fd);
+    if ((r < 0) || ((size_t)r != len)) {
+        WRN(session, "Unable to write module cache file \"%s\".", tmp_path);
+        unlink(tmp_path);
+        goto cleanup;
+    }
+    if (asprintf(&path, "%s/%s", dir, target) == -1) {
+        ERRMEM;
+        path = NULL;
+        unlink(tmp_path);
+        goto cleanup;
+    }
+
+    /* CACHE LOCK, the object must not be evicted before it is linked */
+    lock_fd = nc_module_cache_lock(dir, LOCK_SH);
+    if (lock_fd == -1) {
+        WRN(session, "Unable to lock the module cache \"%s\".", dir);
+        unlink(tmp_path);
+        goto cleanup;
+    }
+
+    if (rename(tmp_path, path)) {
+        WRN(session, "Unable to store module cache object \"%s\" (%s).", path, strerror(errno));
+        unlink(tmp_path);
+        goto cleanup;
+    }
+
+    /* link the key to it, reuse the unique temporary name */
+    if (symlink(target, tmp_path)) {
+        /* the name was taken in the meantime, give up */
+        goto cleanup;
+    }
+    free(path);
+    if (asprintf(&path, "%s/%s", dir, key) == -1) {
+        ERRMEM;
+        path = NULL;
+        unlink(tmp_path);
+        goto cleanup;
+    }
+    if (rename(tmp_path, path)) {
+        WRN(session, "Unable to store module cache entry \"%s\" (%s).", path, strerror(errno));
+        unlink(tmp_path);
+        goto cleanup;
+    }
+
+    /* CACHE UNLOCK */
+    close(lock_fd);
+    lock_fd = -1;
+
+    /* keep the size limit */
+    if (client_opts.module_cache_size_max) {
+        nc_module_cache_evict(dir, client_opts.module_cache_size_max);
+    }
+
+cleanup:
+    if (lock_fd > -1) {
+        /* CACHE UNLOCK */
+        close(lock_fd);
+    }
+    free(path);
+    free(tmp_path);
+    free(key);
+}
+
 /**
  * @brief Retrieve YANG module content from a local file.
  *
@@ -433,59 +963,34 @@ retrieve_module_data_localfile(const char *name, const char *rev, struct clb_dat
 }
 
 /**
- * @brief Retrieve YANG module content from a reply to get-schema RPC.
+ * @brief Get YANG module content from a received reply to get-schema RPC and store it locally.
  *
  * @param[in] name Module name.
  * @param[in] rev Module revision.
  * @param[in] clb_data get-schema callback data.
- * @param[out] format Module format.
+ * @param[in] envp Received reply envelopes.
+ * @param[in] op Received reply data.
  * @return Module content.
  */
 static char *
-retrieve_module_data_getschema(const char *name, const char *rev, struct clb_data_s *clb_data,
-        LYS_INFORMAT *format)
+getschema_reply_module_data(const char *name, const char *rev, struct clb_data_s *clb_data, const struct lyd_node *envp,
+        const struct lyd_node *op)
 {
-    struct nc_rpc *rpc;
-    struct lyd_node *envp = NULL, *op = NULL;
     struct lyd_node_any *get_schema_data;
-    NC_MSG_TYPE msg;
-    uint64_t msgid;
     char *localfile = NULL, *envp_str = NULL, *model_data = NULL;
     FILE *f;
 
-    VRB(clb_data->session, "Reading module \"%s@%s\" from server via get-schema.", name, rev ? rev : "<latest>");
-    rpc = nc_rpc_getschema(name, rev, "yang", NC_PARAMTYPE_CONST);
-
-    while ((msg = nc_send_rpc(clb_data->session, rpc, 0, &msgid)) == NC_MSG_WOULDBLOCK) {
-        usleep(1000);
-    }
-    if (msg == NC_MSG_ERROR) {
-        ERR(clb_data->session, "Failed to send the <get-schema> RPC.");
-        nc_rpc_free(rpc);
-        return NULL;
-    }
-
-    do {
-        msg = nc_recv_reply(clb_data->session, rpc, msgid, NC_READ_ACT_TIMEOUT * 1000, &envp, &op);
-    } while (msg == NC_MSG_NOTIF || msg == NC_MSG_REPLY_ERR_MSGID);
-    nc_rpc_free(rpc);
-    if (msg == NC_MSG_WOULDBLOCK) {
-        ERR(clb_data->session, "Timeout for receiving reply to a <get-schema> expired.");
-        goto cleanup;
-    } else if (msg == NC_MSG_ERROR) {
-        ERR(clb_data->session, "Failed to receive a reply to <get-schema>.");
-        goto cleanup;
-    } else if (!op) {
+    if (!op) {
         assert(envp);
         lyd_print_mem(&envp_str, envp, LYD_XML, 0);
         WRN(clb_data->session, "Received an unexpected reply to <get-schema>:\n%s", envp_str);
         free(envp_str);
-        goto cleanup;
+        return NULL;
     }
 
     if (!lyd_child(op) || (lyd_child(op)->schema->nodetype != LYS_ANYXML)) {
         ERR(clb_data->session, "Unexpected data in reply to a <get-schema> RPC.");
-        goto cleanup;
+        return NULL;
     }
     get_schema_data = (struct lyd_node_any *)lyd_child(op);
     switch (get_schema_data->value_type) {
@@ -508,11 +1013,11 @@ retrieve_module_data_getschema(const char *name, const char *rev, struct clb_dat
         model_data = NULL;
     }
     if (!model_data) {
-        goto cleanup;
+        return NULL;
     }
 
-    /* set format */
-    *format = LYS_IN_YANG;
+    /* store it into the module cache */
+    nc_module_cache_store(clb_data->session, name, rev, model_data);
 
     /* try to store the model_data into local module repository */
     lys_search_localfile(ly_ctx_get_searchdirs(clb_data->session->ctx), 0, name, rev, &localfile, NULL);
@@ -533,6 +1038,105 @@ retrieve_module_data_getschema(const char *name, const char *rev, struct clb_dat
     }
     free(localfile);
 
+    return model_data;
+}
+
+/**
+ * @brief Take YANG module content prefetched into the server module info.
+ *
+ * @param[in] name Module or submodule name.
+ * @param[in] rev Module or submodule revision.
+ * @param[in] clb_data get-schema callback data.
+ * @return Module content, NULL if not prefetched.
+ */
+static char *
+retrieve_module_data_prefetched(const char *name, const char *rev, struct clb_data_s *clb_data)
+{
+    struct module_info *modules = clb_data->modules;
+    char *model_data = NULL;
+    uint32_t u, v;
+
+    for (u = 0; modules[u].name; ++u) {
+        if (modules[u].data && !strcmp(modules[u].name, name) && (!rev || (modules[u].revision &&
+                !strcmp(modules[u].revision, rev)))) {
+            model_data = modules[u].data;
+            modules[u].data = NULL;
+            break;
+        }
+        for (v = 0; modules[u].submodules && modules[u].submodules[v].name; ++v) {
+            if (modules[u].submodules[v].data && !strcmp(modules[u].submodules[v].name, name) &&
+                    (!rev || (modules[u].submodules[v].revision && !strcmp(modules[u].submodules[v].revision, rev)))) {
+                model_data = modules[u].submodules[v].data;
+                modules[u].submodules[v].data = NULL;
+                break;
+            }
+        }
+        if (model_data) {
+            break;
+        }
+    }
+
+    if (model_data) {
+        VRB(clb_data->session, "Using module \"%s@%s\" prefetched via get-schema.", name, rev ? rev : "<latest>");
+    }
+    return model_data;
+}
+
+/**
+ * @brief Retrieve YANG module content from a reply to get-schema RPC.
+ *
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @param[in] clb_data get-schema callback data.
+ * @param[out] format Module format.
+ * @return Module content.
+ */
+static char *
+retrieve_module_data_getschema(const char *name, const char *rev, struct clb_data_s *clb_data,
+        LYS_INFORMAT *format)
+{
+    struct nc_rpc *rpc;
+    struct lyd_node *envp = NULL, *op = NULL;
+    NC_MSG_TYPE msg;
+    uint64_t msgid;
+    char *model_data = NULL;
+
+    /* the module may have been prefetched */
+    if ((model_data = retrieve_module_data_prefetched(name, rev, clb_data))) {
+        *format = LYS_IN_YANG;
+        return model_data;
+    }
+
+    VRB(clb_data->session, "Reading module \"%s@%s\" from server via get-schema.", name, rev ? rev : "<latest>");
+    rpc = nc_rpc_getschema(name, rev, "yang", NC_PARAMTYPE_CONST);
+
+    while ((msg = nc_send_rpc(clb_data->session, rpc, 0, &msgid)) == NC_MSG_WOULDBLOCK) {
+        usleep(1000);
+    }
+    if (msg == NC_MSG_ERROR) {
+        ERR(clb_data->session, "Failed to send the <get-schema> RPC.");
+        nc_rpc_free(rpc);
+        return NULL;
+    }
+
+    do {
+        msg = nc_recv_reply(clb_data->session, rpc, msgid, NC_READ_ACT_TIMEOUT * 1000, &envp, &op);
+    } while (msg == NC_MSG_NOTIF || msg == NC_MSG_REPLY_ERR_MSGID);
+    nc_rpc_free(rpc);
+    if (msg == NC_MSG_WOULDBLOCK) {
+        ERR(clb_data->session, "Timeout for receiving reply to a <get-schema> expired.");
+        goto cleanup;
+    } else if (msg == NC_MSG_ERROR) {
+        ERR(clb_data->session, "Failed to receive a reply to <get-schema>.");
+        goto cleanup;
+    }
+
+    model_data = getschema_reply_module_data(name, rev, clb_data, envp, op);
+    if (model_data) {
+        /* set format */
+        *format = LYS_IN_YANG;
+    }
+
 cleanup:
     lyd_free_tree(envp);
     lyd_free_tree(op);
@@ -564,8 +1168,15 @@ retrieve_module_data(const char *mod_name, const char *mod_rev, void *user_data,
     struct clb_data_s *clb_data = (struct clb_data_s *)user_data;
     char *model_data = NULL;
 
+    /* 0. try to use the module cache */
+    if ((model_data = nc_module_cache_retrieve(clb_data->session, mod_name, mod_rev))) {
+        *format = LYS_IN_YANG;
+    }
+
     /* 1. try to get data locally */
-    model_data = retrieve_module_data_localfile(mod_name, mod_rev, clb_data, format);
+    if (!model_data) {
+        model_data = retrieve_module_data_localfile(mod_name, mod_rev, clb_data, format);
+    }
 
     /* 2. try to use <get-schema> */
     if (!model_data && clb_data->has_get_schema) {
@@ -653,7 +1264,14 @@ retrieve_module_data_imp(const char *mod_name, const char *mod_rev, const char *
         rev = mod_rev;
     }
 
-    if (match) {
+    /* 0. try to use the module cache */
+    if ((model_data = nc_module_cache_retrieve(clb_data->session, name, rev))) {
+        *format = LYS_IN_YANG;
+    }
+
+    if (model_data) {
+        /* cached */
+    } else if (match) {
         /* we have enough information to avoid communication with server and try to get the module locally */
 
         /* 1. try to get data locally */
@@ -805,6 +1423,8 @@ free_module_info(struct module_info *list)
     for (u = 0; list[u].name; ++u) {
         free(list[u].name);
         free(list[u].revision);
+        free(list[u].ns);
+        free(list[u].data);
         if (list[u].features) {
             for (v = 0; list[u].features[v]; ++v) {
                 free(list[u].features[v]);
@@ -815,6 +1435,7 @@ free_module_info(struct module_info *list)
             for (v = 0; list[u].submodules[v].name; ++v) {
                 free(list[u].submodules[v].name);
                 free(list[u].submodules[v].revision);
+                free(list[u].submodules[v].data);
             }
             free(list[u].submodules);
         }
@@ -942,6 +1563,19 @@ build_module_info_yl(struct nc_session *session, int get_data_sup, int xpath_sup
         goto cleanup;
     }
 
+    /* remember the content-id identifying the module set, used as the module cache key of modules without a revision */
+    if (!lyd_find_xpath(oper_data, "/ietf-yang-library:yang-library/content-id", &modules) && !modules->count) {
+        ly_set_free(modules, NULL);
+        lyd_find_xpath(oper_data, "/ietf-yang-library:modules-state/module-set-id", &modules);
+    }
+    if (modules && modules->count && lyd_get_value(modules->dnodes[0])) {
+        free(session->opts.client.content_id);
+        session->opts.client.content_id = strdup(lyd_get_value(modules->dnodes[0]));
+        NC_CHECK_ERRMEM_GOTO(!session->opts.client.content_id, ret = -1, cleanup);
+    }
+    ly_set_free(modules, NULL);
+    modules = NULL;
+
     if (lyd_find_xpath(oper_data, "/ietf-yang-library:modules-state/module", &modules)) {
         WRN(NULL, "No yang-library module information found.");
         goto cleanup;
@@ -972,6 +1606,8 @@ build_module_info_yl(struct nc_session *session, int get_data_sup, int xpath_sup
                 }
             } else if (!strcmp(iter->schema->name, "revision")) {
                 (*result)[u].revision = strdup(lyd_get_value(iter));
+            } else if (!strcmp(iter->schema->name, "namespace")) {
+                (*result)[u].ns = strdup(lyd_get_value(iter));
             } else if (!strcmp(iter->schema->name, "conformance-type")) {
                 (*result)[u].implemented = !strcmp(lyd_get_value(iter), "implement");
             } else if (!strcmp(iter->schema->name, "feature")) {
@@ -1015,6 +1651,7 @@ build_module_info_yl(struct nc_session *session, int get_data_sup, int xpath_sup
 
         (*result) = nc_realloc(*result, (modules->count + 3) * sizeof **result);
         NC_CHECK_ERRMEM_GOTO(!(*result), ret = -1, cleanup);
+        memset(&(*result)[u], 0, 3 * sizeof **result);
 
         (*result)[u].name = strdup("notifications");
         (*result)[u].revision = strdup("2008-07-14");
@@ -1065,6 +1702,10 @@ build_module_info_cpblts(char **cpblts, struct module_info **result)
         }
         (*result)[v].name = strndup(ptr, ptr2 - ptr);
 
+        /* get module's namespace */
+        ptr2 = strchr(cpblts[u], '?');
+        (*result)[v].ns = strndup(cpblts[u], ptr2 ? (size_t)(ptr2 - cpblts[u]) : strlen(cpblts[u]));
+
         /* get module's revision */
         ptr = strstr(module_cpblt, "revision=");
         if (ptr) {
@@ -1106,6 +1747,156 @@ build_module_info_cpblts(char **cpblts, struct module_info **result)
     return 0;
 }
 
+/**
+ * @brief Check whether a module needs to be retrieved from the server.
+ *
+ * Modules found in the module cache are read into @p data right away.
+ *
+ * @param[in] clb_data get-schema callback data.
+ * @param[in] name Module or submodule name.
+ * @param[in] rev Module or submodule revision.
+ * @param[out] data Module content, if found in the module cache.
+ * @return Whether the module is missing.
+ */
+static int
+nc_ctx_prefetch_is_missing(struct clb_data_s *clb_data, const char *name, const char *rev, char **data)
+{
+    struct ly_ctx *ctx = clb_data->session->ctx;
+    char *localfile = NULL;
+    int missing = 1;
+
+    /* module cache */
+    if ((*data = nc_module_cache_retrieve(clb_data->session, name, rev))) {
+        return 0;
+    }
+
+    /* local file, only checked whether it exists */
+    if (!lys_search_localfile(ly_ctx_get_searchdirs(ctx), !(ly_ctx_get_options(ctx) & LY_CTX_DISABLE_SEARCHDIR_CWD),
+            name, rev, &localfile, NULL) && localfile) {
+        if (!rev || strchr(strrchr(localfile, '/'), '@')) {
+            missing = 0;
+        }
+        free(localfile);
+    }
+
+    return missing;
+}
+
+/**
+ * @brief Retrieve all the server modules missing locally using pipelined get-schema RPCs.
+ *
+ * Up to ::NC_CLIENT_PREFETCH_WINDOW RPCs are kept waiting for their reply so that retrieving many modules
+ * takes only a few round-trips without flooding the server. The retrieved modules are stored in the module
+ * info and used instead of sending get-schema for each of them when loaded.
+ *
+ * @param[in] session NC session.
+ * @param[in] modules Server module info to store the modules in.
+ */
+static void
+nc_ctx_prefetch_modules(struct nc_session *session, struct module_info *modules)
+{
+    struct clb_data_s clb_data = {0};
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct {
+        const char *name;
+        const char *rev;
+        char **data;
+        uint64_t msgid;
+    } *fetch = NULL, *tmp;
+    uint32_t u, v, fetch_count = 0, fetch_size = 0, sent = 0, recvd = 0;
+    const struct lys_module *mod;
+    NC_MSG_TYPE msg;
+
+    clb_data.modules = modules;
+    clb_data.session = session;
+    clb_data.has_get_schema = 1;
+
+    /* learn which modules are missing */
+    for (u = 0; modules[u].name; ++u) {
+        if (modules[u].revision) {
+            mod = ly_ctx_get_module(session->ctx, modules[u].name, modules[u].revision);
+        } else {
+            mod = ly_ctx_get_module_latest(session->ctx, modules[u].name);
+        }
+        if (mod) {
+            /* already in the context, with all its submodules */
+            continue;
+        }
+
+        for (v = 0; !v || (modules[u].submodules && modules[u].submodules[v - 1].name); ++v) {
+            if (fetch_count + 1 > fetch_size) {
+                fetch_size = fetch_size ? fetch_size * 2 : 16;
+                tmp = nc_realloc(fetch, fetch_size * sizeof *fetch);
+                NC_CHECK_ERRMEM_GOTO(!tmp, , cleanup);
+                fetch = tmp;
+            }
+
+            if (!v) {
+                fetch[fetch_count].name = modules[u].name;
+                fetch[fetch_count].rev = modules[u].revision;
+                fetch[fetch_count].data = &modules[u].data;
+            } else {
+                fetch[fetch_count].name = modules[u].submodules[v - 1].name;
+                fetch[fetch_count].rev = modules[u].submodules[v - 1].revision;
+                fetch[fetch_count].data = &modules[u].submodules[v - 1].data;
+            }
+            if (!fetch[fetch_count].name || *fetch[fetch_count].data) {
+                continue;
+            }
+
+            if (nc_ctx_prefetch_is_missing(&clb_data, fetch[fetch_count].name, fetch[fetch_count].rev,
+                    fetch[fetch_count].data)) {
+                ++fetch_count;
+            }
+        }
+    }
+    if (!fetch_count) {
+        goto cleanup;
+    }
+
+    VRB(session, "Reading %" PRIu32 " modules from server via pipelined get-schema.", fetch_count);
+
+    while (recvd < fetch_count) {
+        /* keep the window of RPCs waiting for their reply full */
+        while ((sent < fetch_count) && (sent - recvd < NC_CLIENT_PREFETCH_WINDOW)) {
+            rpc = nc_rpc_getschema(fetch[sent].name, fetch[sent].rev, "yang", NC_PARAMTYPE_CONST);
+            NC_CHECK_ERRMEM_GOTO(!rpc, , discard);
+            msg = nc_send_rpc_async(session, rpc, NC_READ_ACT_TIMEOUT * 1000, NULL, NULL, &fetch[sent].msgid);
+            nc_rpc_free(rpc);
+            if (msg != NC_MSG_RPC) {
+                WRN(session, "Failed to send a pipelined <get-schema> RPC.");
+                goto discard;
+            }
+            ++sent;
+        }
+
+        /* receive the oldest reply */
+        msg = nc_recv_reply_async(session, fetch[recvd].msgid, NC_READ_ACT_TIMEOUT * 1000, &envp, &op);
+        if (msg == NC_MSG_REPLY) {
+            *fetch[recvd].data = getschema_reply_module_data(fetch[recvd].name, fetch[recvd].rev, &clb_data, envp, op);
+            lyd_free_tree(envp);
+            lyd_free_tree(op);
+        } else if (msg == NC_MSG_WOULDBLOCK) {
+            WRN(session, "Timeout for receiving a reply to pipelined <get-schema> expired.");
+            goto discard;
+        } else {
+            ERR(session, "Failed to receive a reply to pipelined <get-schema>.");
+            goto discard;
+        }
+        ++recvd;
+    }
+
+discard:
+    /* the replies still awaited are dropped once received, the rest of the modules is retrieved one by one */
+    for (u = recvd; u < sent; ++u) {
+        nc_client_rpc_pending_discard(session, fetch[u].msgid);
+    }
+
+cleanup:
+    free(fetch);
+}
+
 /**
  * @brief Fill client context based on server modules info.
  *
@@ -1114,16 +1905,22 @@ build_module_info_cpblts(char **cpblts, struct module_info **result)
  * @param[in] user_clb User callback for retrieving specific modules.
  * @param[in] user_data User data for @p user_clb.
  * @param[in] has_get_schema Whether server supports get-schema RPC.
+ * @param[in] only Optional NULL-terminated list of the only modules to load.
  * @return 0 on success.
  * @return -1 on error.
  */
 static int
 nc_ctx_fill(struct nc_session *session, struct module_info *modules, ly_module_imp_clb user_clb, void *user_data,
-        int has_get_schema)
+        int has_get_schema, char **only)
 {
     int ret = -1;
     struct lys_module *mod;
-    uint32_t u;
+    uint32_t u, v;
+
+    if (has_get_schema && !only) {
+        /* retrieve all the missing modules at once, failures are not fatal */
+        nc_ctx_prefetch_modules(session, modules);
+    }
 
     for (u = 0; modules[u].name; ++u) {
         /* skip import-only modules */
@@ -1131,6 +1928,14 @@ nc_ctx_fill(struct nc_session *session, struct module_info *modules, ly_module_i
             continue;
         }
 
+        if (only) {
+            /* skip modules not requested */
+            for (v = 0; only[v] && strcmp(only[v], modules[u].name); ++v) {}
+            if (!only[v]) {
+                continue;
+            }
+        }
+
         /* we can continue even if it fails */
         nc_ctx_load_module(session, modules[u].name, modules[u].revision, (const char **)modules[u].features, modules,
                 user_clb, user_data, has_get_schema, &mod);
@@ -1274,63 +2079,528 @@ cleanup:
     return rc;
 }
 
-int
-nc_ctx_check_and_fill(struct nc_session *session)
+/**
+ * @brief Append a string to a module set fingerprint.
+ *
+ * @param[in,out] fprint Fingerprint to append to.
+ * @param[in,out] len Length of @p fprint.
+ * @param[in] str String to append, NULL is appended as an empty string.
+ * @param[in] sep Separator appended after @p str.
+ * @return 0 on success.
+ * @return -1 on error.
+ */
+static int
+nc_ctx_fingerprint_add(char **fprint, size_t *len, const char *str, char sep)
 {
-    int i, get_schema_support = 0, yanglib_support = 0, xpath_support = 0, nmda_support = 0, ret = -1;
-    ly_module_imp_clb old_clb = NULL;
-    void *old_data = NULL;
-    struct lys_module *mod = NULL;
-    char *revision;
-    struct module_info *server_modules = NULL, *sm = NULL;
+    size_t str_len = str ? strlen(str) : 0;
 
-    assert(session->opts.client.cpblts && session->ctx);
+    *fprint = nc_realloc(*fprint, *len + str_len + 2);
+    NC_CHECK_ERRMEM_RET(!*fprint, -1);
 
-    if (client_opts.auto_context_fill_disabled) {
-        VRB(session, "Context of the new session is left only with the default YANG modules.");
-        return 0;
+    if (str_len) {
+        memcpy(*fprint + *len, str, str_len);
     }
+    (*fprint)[*len + str_len] = sep;
+    (*fprint)[*len + str_len + 1] = '\0';
+    *len += str_len + 1;
 
-    /* store the original user's callback, we will be switching between local search, get-schema and user callback */
-    old_clb = ly_ctx_get_module_imp_clb(session->ctx, &old_data);
+    return 0;
+}
 
-    /* switch off default searchpath to use only our callback integrating modifying searchpath algorithm to limit
-     * modules only to those present on the server side */
-    ly_ctx_set_options(session->ctx, LY_CTX_DISABLE_SEARCHDIRS);
+/**
+ * @brief Create the fingerprint of the context a session would be filled with.
+ *
+ * Besides the server capabilities and module set, it includes the client settings affecting how the modules
+ * are loaded.
+ *
+ * @param[in] session NC session with the received capabilities.
+ * @param[in] modules Server module info.
+ * @param[out] fprint Created fingerprint, NULL if the context cannot be shared.
+ * @return 0 on success.
+ * @return -1 on error.
+ */
+static int
+nc_ctx_fingerprint(struct nc_session *session, const struct module_info *modules, char **fprint)
+{
+    uint32_t u, v;
+    size_t len = 0;
+    char buf[64];
 
-    /* our callback is set later with appropriate data */
-    ly_ctx_set_module_imp_clb(session->ctx, NULL, NULL);
+    *fprint = NULL;
 
-    /* check if get-schema and yang-library is supported */
-    for (i = 0; session->opts.client.cpblts[i]; ++i) {
-        if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?", 52)) {
-            get_schema_support = 1 + i;
-        } else if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:netconf:capability:yang-library:", 48)) {
-            yanglib_support = 1 + i;
-        } else if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:netconf:capability:xpath:1.0", 44)) {
-            xpath_support = 1 + i;
+    for (u = 0; modules[u].name; ++u) {
+        if (!strcmp(modules[u].name, "ietf-yang-schema-mount")) {
+            /* schema-mount data are specific for every session */
+            return 0;
         }
-        /* NMDA is YANG 1.1 module, which is not present in the capabilities */
     }
-    VRB(session, "Capability for <get-schema> support%s found.", get_schema_support ? "" : " not");
-    VRB(session, "Capability for yang-library support%s found.", yanglib_support ? "" : " not");
-    VRB(session, "Capability for XPath filter support%s found.", xpath_support ? "" : " not");
 
-    /* get information about server's modules from capabilities list until we will have yang-library */
-    if (build_module_info_cpblts(session->opts.client.cpblts, &server_modules) || !server_modules) {
-        ERR(session, "Unable to get server module information from the <hello>'s capabilities.");
-        goto cleanup;
+    /* client settings */
+    if (nc_ctx_fingerprint_add(fprint, &len, client_opts.schema_searchpath, '\n')) {
+        goto error;
+    }
+    sprintf(buf, "%p %p", (void *)client_opts.schema_clb, client_opts.schema_clb_data);
+    if (nc_ctx_fingerprint_add(fprint, &len, buf, '\n')) {
+        goto error;
     }
 
-    /* get-schema is supported, load local ietf-netconf-monitoring so we can create <get-schema> RPCs */
-    if (get_schema_support && lys_parse_mem(session->ctx, ietf_netconf_monitoring_2010_10_04_yang, LYS_IN_YANG, NULL)) {
-        WRN(session, "Loading NETCONF monitoring module failed, cannot use <get-schema>.");
-        get_schema_support = 0;
+    /* capabilities */
+    for (u = 0; session->opts.client.cpblts[u]; ++u) {
+        if (nc_ctx_fingerprint_add(fprint, &len, session->opts.client.cpblts[u], '\n')) {
+            goto error;
+        }
     }
 
-    /* load base model disregarding whether it's in capabilities (but NETCONF capabilities are used to enable features) */
-    if (nc_ctx_fill_ietf_netconf(session, server_modules, old_clb, old_data, get_schema_support)) {
-        goto cleanup;
+    /* module set */
+    for (u = 0; modules[u].name; ++u) {
+        if (nc_ctx_fingerprint_add(fprint, &len, modules[u].name, '@') ||
+                nc_ctx_fingerprint_add(fprint, &len, modules[u].revision, modules[u].implemented ? 'i' : ' ')) {
+            goto error;
+        }
+        for (v = 0; modules[u].features && modules[u].features[v]; ++v) {
+            if (nc_ctx_fingerprint_add(fprint, &len, modules[u].features[v], ',')) {
+                goto error;
+            }
+        }
+        for (v = 0; modules[u].submodules && modules[u].submodules[v].name; ++v) {
+            if (nc_ctx_fingerprint_add(fprint, &len, modules[u].submodules[v].name, '@') ||
+                    nc_ctx_fingerprint_add(fprint, &len, modules[u].submodules[v].revision, ',')) {
+                goto error;
+            }
+        }
+        if (nc_ctx_fingerprint_add(fprint, &len, NULL, '\n')) {
+            goto error;
+        }
+    }
+
+    return 0;
+
+error:
+    free(*fprint);
+    *fprint = NULL;
+    return -1;
+}
+
+/**
+ * @brief Replace the context of a session with a shared context of the same fingerprint, if there is any.
+ *
+ * @param[in] session NC session with its own context.
+ * @param[in] fprint Fingerprint of the session context.
+ * @return Whether the context was replaced.
+ */
+static int
+nc_client_ctx_pool_get(struct nc_session *session, const char *fprint)
+{
+    struct nc_client_ctx_pool_entry *entry;
+    uint64_t hash = nc_module_cache_hash(fprint, strlen(fprint));
+
+    /* CTX POOL LOCK */
+    pthread_mutex_lock(&ctx_pool.lock);
+
+    for (entry = ctx_pool.entries; entry; entry = entry->next) {
+        if ((entry->hash == hash) && !strcmp(entry->fprint, fprint)) {
+            break;
+        }
+    }
+    if (entry) {
+        ++entry->refcount;
+    }
+
+    /* CTX POOL UNLOCK */
+    pthread_mutex_unlock(&ctx_pool.lock);
+
+    if (!entry) {
+        return 0;
+    }
+
+    /* use the shared context */
+    VRB(session, "Sharing an already compiled context of the same module set.");
+    ly_ctx_destroy(session->ctx);
+    session->ctx = entry->ctx;
+    session->flags |= NC_SESSION_SHAREDCTX;
+    if (entry->not_strict) {
+        session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
+    }
+    session->opts.client.ctx_entry = entry;
+    return 1;
+}
+
+/**
+ * @brief Add the context of a session into the shared context pool.
+ *
+ * If a context of the same fingerprint has been added in the meantime, the session keeps its own context.
+ *
+ * @param[in] session NC session with its own fully filled context.
+ * @param[in] fprint Fingerprint of the session context.
+ */
+static void
+nc_client_ctx_pool_add(struct nc_session *session, const char *fprint)
+{
+    struct nc_client_ctx_pool_entry *entry;
+    uint64_t hash = nc_module_cache_hash(fprint, strlen(fprint));
+
+    /* CTX POOL LOCK */
+    pthread_mutex_lock(&ctx_pool.lock);
+
+    for (entry = ctx_pool.entries; entry; entry = entry->next) {
+        if ((entry->hash == hash) && !strcmp(entry->fprint, fprint)) {
+            /* keep the private context */
+            goto cleanup;
+        }
+    }
+
+    entry = calloc(1, sizeof *entry);
+    NC_CHECK_ERRMEM_GOTO(!entry, , cleanup);
+    entry->fprint = strdup(fprint);
+    NC_CHECK_ERRMEM_GOTO(!entry->fprint, free(entry), cleanup);
+    entry->hash = hash;
+    entry->ctx = (struct ly_ctx *)session->ctx;
+    entry->refcount = 1;
+    entry->not_strict = (session->flags & NC_SESSION_CLIENT_NOT_STRICT) ? 1 : 0;
+
+    entry->next = ctx_pool.entries;
+    ctx_pool.entries = entry;
+
+    session->flags |= NC_SESSION_SHAREDCTX;
+    session->opts.client.ctx_entry = entry;
+
+cleanup:
+    /* CTX POOL UNLOCK */
+    pthread_mutex_unlock(&ctx_pool.lock);
+}
+
+void
+nc_client_ctx_pool_release(struct nc_client_ctx_pool_entry *entry)
+{
+    struct nc_client_ctx_pool_entry *iter, *prev = NULL;
+
+    /* CTX POOL LOCK */
+    pthread_mutex_lock(&ctx_pool.lock);
+
+    if (--entry->refcount) {
+        /* still used */
+        pthread_mutex_unlock(&ctx_pool.lock);
+        return;
+    }
+
+    /* unlink the entry */
+    for (iter = ctx_pool.entries; iter != entry; iter = iter->next) {
+        prev = iter;
+    }
+    if (prev) {
+        prev->next = entry->next;
+    } else {
+        ctx_pool.entries = entry->next;
+    }
+
+    /* CTX POOL UNLOCK */
+    pthread_mutex_unlock(&ctx_pool.lock);
+
+    ly_ctx_destroy(entry->ctx);
+    free(entry->fprint);
+    free(entry);
+}
+
+void
+nc_client_lazy_ctx_free(struct nc_session *session)
+{
+    struct nc_client_lazy_ctx *lazy = session->opts.client.lazy;
+
+    if (!lazy) {
+        return;
+    }
+
+    free_module_info(lazy->modules);
+    pthread_mutex_destroy(&lazy->load_lock);
+    pthread_rwlock_destroy(&lazy->ctx_lock);
+    free(lazy);
+    session->opts.client.lazy = NULL;
+}
+
+/**
+ * @brief Check whether modules of a session are loaded on demand and the current thread is not loading one.
+ *
+ * Loading a module may require communication with the server (get-schema), which must work without
+ * any on-demand loading.
+ *
+ * @param[in] session Client session.
+ * @return Whether on-demand loading and context locking applies.
+ */
+static int
+nc_client_lazy_ctx_active(struct nc_session *session)
+{
+    struct nc_client_lazy_ctx *lazy = session->opts.client.lazy;
+
+    return lazy && !(lazy->loading && pthread_equal(lazy->loader, pthread_self()));
+}
+
+/**
+ * @brief Lock the context of a session for reading if its modules are loaded on demand.
+ *
+ * @param[in] session Client session.
+ */
+static void
+nc_client_lazy_ctx_rdlock(struct nc_session *session)
+{
+    if (nc_client_lazy_ctx_active(session)) {
+        /* CTX READ LOCK */
+        pthread_rwlock_rdlock(&session->opts.client.lazy->ctx_lock);
+    }
+}
+
+/**
+ * @brief Unlock the context of a session locked by ::nc_client_lazy_ctx_rdlock().
+ *
+ * @param[in] session Client session.
+ */
+static void
+nc_client_lazy_ctx_unlock(struct nc_session *session)
+{
+    if (nc_client_lazy_ctx_active(session)) {
+        /* CTX UNLOCK */
+        pthread_rwlock_unlock(&session->opts.client.lazy->ctx_lock);
+    }
+}
+
+/**
+ * @brief Load a server module into the context on demand.
+ *
+ * Is expected to be called with the load lock held. A module is tried to be loaded only once.
+ *
+ * @param[in] session Client session.
+ * @param[in] idx Index of the module in the server module info.
+ */
+static void
+nc_client_lazy_load_module(struct nc_session *session, uint32_t idx)
+{
+    struct nc_client_lazy_ctx *lazy = session->opts.client.lazy;
+    struct module_info *info = &lazy->modules[idx];
+    struct lys_module *mod;
+
+    /* CTX WRITE LOCK */
+    pthread_rwlock_wrlock(&lazy->ctx_lock);
+    lazy->loader = pthread_self();
+    lazy->loading = 1;
+
+    /* use only our callback, as when filling the context */
+    ly_ctx_set_options(session->ctx, LY_CTX_DISABLE_SEARCHDIRS);
+    ly_ctx_set_module_imp_clb(session->ctx, NULL, NULL);
+
+    VRB(session, "Loading module \"%s\" on demand.", info->name);
+    nc_ctx_load_module(session, info->name, info->revision, (const char **)info->features, lazy->modules,
+            lazy->user_clb, lazy->user_data, lazy->has_get_schema, &mod);
+    if (!mod) {
+        WRN(session, "Failed to load module \"%s@%s\".", info->name, info->revision ? info->revision : "<latest>");
+        session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
+    }
+
+    ly_ctx_set_module_imp_clb(session->ctx, lazy->user_clb, lazy->user_data);
+    ly_ctx_unset_options(session->ctx, LY_CTX_DISABLE_SEARCHDIRS);
+
+    /* CTX UNLOCK */
+    lazy->loading = 0;
+    pthread_rwlock_unlock(&lazy->ctx_lock);
+
+    /* never try again */
+    free(info->ns);
+    info->ns = NULL;
+}
+
+/**
+ * @brief Load all the server modules whose namespaces are used in an XML message, if not loaded yet.
+ *
+ * @param[in] session Client session.
+ * @param[in] xml XML message.
+ */
+static void
+nc_client_lazy_load_ns(struct nc_session *session, const char *xml)
+{
+    struct nc_client_lazy_ctx *lazy = session->opts.client.lazy;
+    const char *ptr, *end;
+    uint32_t u;
+    size_t len;
+
+    if (!nc_client_lazy_ctx_active(session) || !xml) {
+        return;
+    }
+
+    /* LOAD LOCK */
+    pthread_mutex_lock(&lazy->load_lock);
+
+    for (ptr = strstr(xml, "xmlns"); ptr; ptr = strstr(ptr, "xmlns")) {
+        /* get the namespace value */
+        ptr += 5;
+        if (*ptr == ':') {
+            ptr += strcspn(ptr, "= \t\r\n>");
+        }
+        ptr += strspn(ptr, " \t\r\n");
+        if (*ptr != '=') {
+            continue;
+        }
+        ++ptr;
+        ptr += strspn(ptr, " \t\r\n");
+        if ((*ptr != '\"') && (*ptr != '\'')) {
+            continue;
+        }
+        end = strchr(ptr + 1, *ptr);
+        if (!end) {
+            break;
+        }
+        ++ptr;
+        len = end - ptr;
+
+        /* find a server module with the namespace not loaded yet */
+        for (u = 0; lazy->modules[u].name; ++u) {
+            if (lazy->modules[u].implemented && lazy->modules[u].ns && !strncmp(lazy->modules[u].ns, ptr, len) &&
+                    !lazy->modules[u].ns[len]) {
+                nc_client_lazy_load_module(session, u);
+                break;
+            }
+        }
+        ptr = end + 1;
+    }
+
+    /* LOAD UNLOCK */
+    pthread_mutex_unlock(&lazy->load_lock);
+}
+
+/**
+ * @brief Get an implemented module from the context of a session, loading it on demand if needed.
+ *
+ * @param[in] session Client session.
+ * @param[in] name Module name.
+ * @return Implemented module, NULL if not found.
+ */
+static const struct lys_module *
+nc_client_ctx_get_module(struct nc_session *session, const char *name)
+{
+    struct nc_client_lazy_ctx *lazy = session->opts.client.lazy;
+    const struct lys_module *mod;
+    uint32_t u;
+
+    nc_client_lazy_ctx_rdlock(session);
+    mod = ly_ctx_get_module_implemented(session->ctx, name);
+    nc_client_lazy_ctx_unlock(session);
+    if (mod || !nc_client_lazy_ctx_active(session)) {
+        return mod;
+    }
+
+    /* LOAD LOCK */
+    pthread_mutex_lock(&lazy->load_lock);
+
+    for (u = 0; lazy->modules[u].name; ++u) {
+        if (lazy->modules[u].implemented && lazy->modules[u].ns && !strcmp(lazy->modules[u].name, name)) {
+            nc_client_lazy_load_module(session, u);
+            break;
+        }
+    }
+
+    /* LOAD UNLOCK */
+    pthread_mutex_unlock(&lazy->load_lock);
+
+    nc_client_lazy_ctx_rdlock(session);
+    mod = ly_ctx_get_module_implemented(session->ctx, name);
+    nc_client_lazy_ctx_unlock(session);
+    return mod;
+}
+
+/**
+ * @brief Prepare on-demand loading of the server modules not loaded into the context of a session.
+ *
+ * @param[in] session Client session.
+ * @param[in,out] modules Server module info, is spent.
+ * @param[in] user_clb User callback for retrieving specific modules.
+ * @param[in] user_data User data for @p user_clb.
+ * @param[in] has_get_schema Whether server supports get-schema RPC.
+ * @return 0 on success.
+ * @return -1 on error.
+ */
+static int
+nc_client_lazy_ctx_init(struct nc_session *session, struct module_info **modules, ly_module_imp_clb user_clb,
+        void *user_data, int has_get_schema)
+{
+    struct nc_client_lazy_ctx *lazy;
+
+    lazy = calloc(1, sizeof *lazy);
+    NC_CHECK_ERRMEM_RET(!lazy, -1);
+
+    pthread_mutex_init(&lazy->load_lock, NULL);
+    pthread_rwlock_init(&lazy->ctx_lock, NULL);
+    lazy->modules = *modules;
+    *modules = NULL;
+    lazy->user_clb = user_clb;
+    lazy->user_data = user_data;
+    lazy->has_get_schema = has_get_schema;
+
+    session->opts.client.lazy = lazy;
+    return 0;
+}
+
+int
+nc_ctx_check_and_fill(struct nc_session *session)
+{
+    int i, get_schema_support = 0, yanglib_support = 0, xpath_support = 0, nmda_support = 0, ret = -1;
+    ly_module_imp_clb old_clb = NULL;
+    void *old_data = NULL;
+    struct lys_module *mod = NULL;
+    char *revision;
+    struct module_info *server_modules = NULL, *sm = NULL;
+    char *fprint = NULL, *no_modules[] = {NULL}, **only = NULL;
+    int shared = 0, lazy;
+
+    assert(session->opts.client.cpblts && session->ctx);
+
+    if (client_opts.auto_context_fill_disabled) {
+        VRB(session, "Context of the new session is left only with the default YANG modules.");
+        return 0;
+    }
+
+    /* modules can be loaded on demand only into our own context */
+    lazy = client_opts.context_lazy_enabled && !(session->flags & NC_SESSION_SHAREDCTX);
+    if (lazy) {
+        only = client_opts.context_lazy_modules ? client_opts.context_lazy_modules : no_modules;
+    }
+
+    /* store the original user's callback, we will be switching between local search, get-schema and user callback */
+    old_clb = ly_ctx_get_module_imp_clb(session->ctx, &old_data);
+
+    /* switch off default searchpath to use only our callback integrating modifying searchpath algorithm to limit
+     * modules only to those present on the server side */
+    ly_ctx_set_options(session->ctx, LY_CTX_DISABLE_SEARCHDIRS);
+
+    /* our callback is set later with appropriate data */
+    ly_ctx_set_module_imp_clb(session->ctx, NULL, NULL);
+
+    /* check if get-schema and yang-library is supported */
+    for (i = 0; session->opts.client.cpblts[i]; ++i) {
+        if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring?", 52)) {
+            get_schema_support = 1 + i;
+        } else if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:netconf:capability:yang-library:", 48)) {
+            yanglib_support = 1 + i;
+        } else if (!strncmp(session->opts.client.cpblts[i], "urn:ietf:params:netconf:capability:xpath:1.0", 44)) {
+            xpath_support = 1 + i;
+        }
+        /* NMDA is YANG 1.1 module, which is not present in the capabilities */
+    }
+    VRB(session, "Capability for <get-schema> support%s found.", get_schema_support ? "" : " not");
+    VRB(session, "Capability for yang-library support%s found.", yanglib_support ? "" : " not");
+    VRB(session, "Capability for XPath filter support%s found.", xpath_support ? "" : " not");
+
+    /* get information about server's modules from capabilities list until we will have yang-library */
+    if (build_module_info_cpblts(session->opts.client.cpblts, &server_modules) || !server_modules) {
+        ERR(session, "Unable to get server module information from the <hello>'s capabilities.");
+        goto cleanup;
+    }
+
+    /* get-schema is supported, load local ietf-netconf-monitoring so we can create <get-schema> RPCs */
+    if (get_schema_support && lys_parse_mem(session->ctx, ietf_netconf_monitoring_2010_10_04_yang, LYS_IN_YANG, NULL)) {
+        WRN(session, "Loading NETCONF monitoring module failed, cannot use <get-schema>.");
+        get_schema_support = 0;
+    }
+
+    /* load base model disregarding whether it's in capabilities (but NETCONF capabilities are used to enable features) */
+    if (nc_ctx_fill_ietf_netconf(session, server_modules, old_clb, old_data, get_schema_support)) {
+        goto cleanup;
     }
 
     /* get correct version of ietf-yang-library into context */
@@ -1390,11 +2660,22 @@ nc_ctx_check_and_fill(struct nc_session *session)
         }
     }
 
+    /* use a context already compiled for the same module set, if any */
+    if (client_opts.context_sharing_enabled && !lazy && !(session->flags & NC_SESSION_SHAREDCTX)) {
+        if (nc_ctx_fingerprint(session, server_modules, &fprint)) {
+            goto cleanup;
+        }
+        if (fprint && (shared = nc_client_ctx_pool_get(session, fprint))) {
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
     /* compile all modules at once to avoid invalid errors or warnings */
     ly_ctx_set_options(session->ctx, LY_CTX_EXPLICIT_COMPILE);
 
     /* fill the context */
-    if (nc_ctx_fill(session, server_modules, old_clb, old_data, get_schema_support)) {
+    if (nc_ctx_fill(session, server_modules, old_clb, old_data, get_schema_support, only)) {
         goto cleanup;
     }
 
@@ -1408,6 +2689,11 @@ nc_ctx_check_and_fill(struct nc_session *session)
         goto cleanup;
     }
 
+    /* keep the server modules for loading the rest of them on demand */
+    if (lazy && nc_client_lazy_ctx_init(session, &server_modules, old_clb, old_data, get_schema_support)) {
+        goto cleanup;
+    }
+
     /* success */
     ret = 0;
 
@@ -1419,10 +2705,18 @@ nc_ctx_check_and_fill(struct nc_session *session)
 cleanup:
     free_module_info(server_modules);
 
-    /* set user callback back */
-    ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
-    ly_ctx_unset_options(session->ctx, LY_CTX_DISABLE_SEARCHDIRS);
-    ly_ctx_unset_options(session->ctx, LY_CTX_EXPLICIT_COMPILE);
+    if (!shared) {
+        /* set user callback back */
+        ly_ctx_set_module_imp_clb(session->ctx, old_clb, old_data);
+        ly_ctx_unset_options(session->ctx, LY_CTX_DISABLE_SEARCHDIRS);
+        ly_ctx_unset_options(session->ctx, LY_CTX_EXPLICIT_COMPILE);
+
+        if (!ret && fprint) {
+            /* offer the context for sharing */
+            nc_client_ctx_pool_add(session, fprint);
+        }
+    }
+    free(fprint);
 
     return ret;
 }
@@ -1604,128 +2898,286 @@ nc_saddr2str(const struct sockaddr *saddr, char **str_ip, uint16_t *port)
 }
 
 /**
- * @brief Try to connect a socket, optionally a pending one from a previous attempt.
+ * @brief Start connecting a new non-blocking socket.
  *
  * @param[in] src_addr Specific source address to bind to, used only for CH.
  * @param[in] src_port Specific source port to bind to, used only for CH.
- * @param[in] timeout_ms Timeout in ms to wait for the connection to be fully established, -1 to block.
- * @param[in,out] sock_pending Optional previously created socked that was not fully connected yet. If provided and
- * connected, is set to -1.
- * @param[in] res Addrinfo resource to use when creating a new socket.
- * @param[in] ka Keepalives to set.
- * @return Connected socket or -1 on error.
+ * @param[in] res Addrinfo resource to connect to.
+ * @return Socket being connected or -1 on error.
  */
 static int
-sock_connect(const char *src_addr, uint16_t src_port, int timeout_ms, int *sock_pending, struct addrinfo *res,
-        const struct nc_keepalives *ka)
+sock_connect_start(const char *src_addr, uint16_t src_port, const struct addrinfo *res)
 {
-    int flags, ret, error, opt;
+    int flags, opt;
     int sock = -1;
-    struct pollfd fds = {0};
-    socklen_t len = sizeof(int);
     uint16_t port;
     char *str;
 
-    if (sock_pending && (*sock_pending != -1)) {
-        VRB(NULL, "Trying to connect the pending socket %d.", *sock_pending);
-        sock = *sock_pending;
-    } else {
-        assert(res);
-        if (nc_saddr2str(res->ai_addr, &str, &port)) {
-            return -1;
-        }
-        VRB(NULL, "Trying to connect via %s to %s:%u.", (res->ai_family == AF_INET6) ? "IPv6" : "IPv4", str, port);
-        free(str);
+    if (nc_saddr2str(res->ai_addr, &str, &port)) {
+        return -1;
+    }
+    VRB(NULL, "Trying to connect via %s to %s:%u.", (res->ai_family == AF_INET6) ? "IPv6" : "IPv4", str, port);
+    free(str);
 
-        /* connect to a server */
-        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-        if (sock == -1) {
-            ERR(NULL, "Socket could not be created (%s).", strerror(errno));
-            return -1;
-        }
-        /* make the socket non-blocking */
-        if (((flags = fcntl(sock, F_GETFL)) == -1) || (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)) {
-            ERR(NULL, "fcntl() failed (%s).", strerror(errno));
-            goto cleanup;
-        }
-
-        /* bind the socket to a specific address/port to make the connection from (CH only) */
-        if (src_addr || src_port) {
-            /* enable address reuse, so that we're able to bind this address again when the CH conn is dropped and retried */
-            opt = 1;
-            if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt) == -1) {
-                ERR(NULL, "Could not set SO_REUSEADDR socket option (%s).", strerror(errno));
-                goto cleanup;
-            }
+    /* connect to a server */
+    sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock == -1) {
+        ERR(NULL, "Socket could not be created (%s).", strerror(errno));
+        return -1;
+    }
+    /* make the socket non-blocking */
+    if (((flags = fcntl(sock, F_GETFL)) == -1) || (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        ERR(NULL, "fcntl() failed (%s).", strerror(errno));
+        goto error;
+    }
 
-            if (nc_sock_bind_inet(sock, src_addr, src_port, (res->ai_family == AF_INET) ? 1 : 0)) {
-                goto cleanup;
-            }
+    /* bind the socket to a specific address/port to make the connection from (CH only) */
+    if (src_addr || src_port) {
+        /* enable address reuse, so that we're able to bind this address again when the CH conn is dropped and retried */
+        opt = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt) == -1) {
+            ERR(NULL, "Could not set SO_REUSEADDR socket option (%s).", strerror(errno));
+            goto error;
         }
 
-        /* non-blocking connect! */
-        if (connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
-            if (errno != EINPROGRESS) {
-                /* network connection failed, try another resource */
-                ERR(NULL, "connect() failed (%s).", strerror(errno));
-                goto cleanup;
-            }
+        if (nc_sock_bind_inet(sock, src_addr, src_port, (res->ai_family == AF_INET) ? 1 : 0)) {
+            goto error;
         }
     }
 
-    fds.fd = sock;
-    fds.events = POLLOUT;
-
-    /* wait until we can write data to the socket */
-    ret = poll(&fds, 1, timeout_ms);
-    if (ret == -1) {
-        /* error */
-        ERR(NULL, "poll() failed (%s).", strerror(errno));
-        goto cleanup;
-    } else if (ret == 0) {
-        /* there was a timeout */
-        VRB(NULL, "Timed out after %d ms (%s).", timeout_ms, strerror(errno));
-        if (sock_pending) {
-            /* no sock-close, we'll try it again */
-            *sock_pending = sock;
-        } else {
-            close(sock);
+    /* non-blocking connect! */
+    if (connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+        if (errno != EINPROGRESS) {
+            /* network connection failed, try another resource */
+            ERR(NULL, "connect() failed (%s).", strerror(errno));
+            goto error;
         }
-        return -1;
     }
 
+    return sock;
+
+error:
+    close(sock);
+    return -1;
+}
+
+/**
+ * @brief Finish connecting a socket that became writable.
+ *
+ * @param[in] sock Socket being connected.
+ * @param[in] ka Keepalives to set.
+ * @return 0 if connected.
+ * @return -1 on error, the socket is not closed.
+ */
+static int
+sock_connect_finish(int sock, const struct nc_keepalives *ka)
+{
+    int error = 0;
+    socklen_t len = sizeof(int);
+
     /* check the usability of the socket */
-    error = 0;
     if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
         ERR(NULL, "getsockopt() failed (%s).", strerror(errno));
-        goto cleanup;
+        return -1;
     }
     if (error) {
         /* network connection failed, try another resource */
         VRB(NULL, "Connection error (%s).", strerror(error));
         errno = error;
-        goto cleanup;
+        return -1;
     }
 
     /* configure keepalives */
     if (nc_sock_configure_ka(sock, ka)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Try to connect a pending socket from a previous attempt.
+ *
+ * @param[in] timeout_ms Timeout in ms to wait for the connection to be fully established, -1 to block.
+ * @param[in,out] sock_pending Previously created socked that was not fully connected yet. Set to -1 unless
+ * the connection is still in progress.
+ * @param[in] ka Keepalives to set.
+ * @return Connected socket or -1 on error.
+ */
+static int
+sock_connect_pending(int timeout_ms, int *sock_pending, const struct nc_keepalives *ka)
+{
+    int ret;
+    int sock = *sock_pending;
+    struct pollfd fds = {0};
+
+    VRB(NULL, "Trying to connect the pending socket %d.", sock);
+
+    fds.fd = sock;
+    fds.events = POLLOUT;
+
+    /* wait until we can write data to the socket */
+    ret = poll(&fds, 1, timeout_ms);
+    if (ret == -1) {
+        /* error */
+        ERR(NULL, "poll() failed (%s).", strerror(errno));
+        goto cleanup;
+    } else if (ret == 0) {
+        /* there was a timeout, no sock-close, we'll try it again */
+        VRB(NULL, "Timed out after %d ms (%s).", timeout_ms, strerror(errno));
+        return -1;
+    }
+
+    if (sock_connect_finish(sock, ka)) {
         goto cleanup;
     }
 
     /* connected */
-    if (sock_pending) {
-        *sock_pending = -1;
-    }
+    *sock_pending = -1;
     return sock;
 
 cleanup:
-    if (sock_pending) {
-        *sock_pending = -1;
-    }
+    *sock_pending = -1;
     close(sock);
     return -1;
 }
 
+int
+nc_sock_connect_race(const char *src_addr, uint16_t src_port, int timeout_ms, int *sock_pending,
+        struct addrinfo *res_list, const struct nc_keepalives *ka, struct addrinfo **res_conn)
+{
+    int ret, wait_ms, sock = -1;
+    uint32_t i, cand_count = 0, next = 0, fd_count = 0;
+    struct addrinfo *res, *res_other, **cands = NULL, **fd_res = NULL;
+    struct pollfd *fds = NULL;
+    struct timespec ts_timeout, ts_next;
+
+    *res_conn = NULL;
+
+    for (res = res_list; res; res = res->ai_next) {
+        ++cand_count;
+    }
+    if (!cand_count) {
+        return -1;
+    }
+
+    cands = malloc(cand_count * sizeof *cands);
+    fd_res = malloc(cand_count * sizeof *fd_res);
+    fds = calloc(cand_count, sizeof *fds);
+    NC_CHECK_ERRMEM_GOTO(!cands || !fd_res || !fds, , cleanup);
+
+    /* interleave the address families, the family of the first address goes first */
+    res = res_list;
+    for (res_other = res_list; res_other && (res_other->ai_family == res_list->ai_family); res_other = res_other->ai_next) {}
+    i = 0;
+    while (res || res_other) {
+        if (res) {
+            cands[i++] = res;
+            for (res = res->ai_next; res && (res->ai_family != res_list->ai_family); res = res->ai_next) {}
+        }
+        if (res_other) {
+            cands[i++] = res_other;
+            for (res_other = res_other->ai_next; res_other && (res_other->ai_family == res_list->ai_family);
+                    res_other = res_other->ai_next) {}
+        }
+    }
+
+    if (timeout_ms > -1) {
+        nc_timeouttime_get(&ts_timeout, timeout_ms);
+    }
+    nc_timeouttime_get(&ts_next, 0);
+
+    while (1) {
+        /* start the next attempt if the previous ones had enough time or all failed */
+        while ((next < cand_count) && (!fd_count || (nc_timeouttime_cur_diff(&ts_next) < 1))) {
+            fds[fd_count].fd = sock_connect_start(src_addr, src_port, cands[next]);
+            if (fds[fd_count].fd > -1) {
+                fds[fd_count].events = POLLOUT;
+                fds[fd_count].revents = 0;
+                fd_res[fd_count] = cands[next];
+                ++fd_count;
+                nc_timeouttime_get(&ts_next, NC_SOCK_CONNECT_ATTEMPT_DELAY);
+            }
+            ++next;
+        }
+        if (!fd_count) {
+            /* all the attempts failed */
+            break;
+        }
+
+        /* wait for the first event, the next attempt, or the timeout */
+        wait_ms = -1;
+        if (next < cand_count) {
+            wait_ms = nc_timeouttime_cur_diff(&ts_next);
+            if (wait_ms < 0) {
+                wait_ms = 0;
+            }
+        }
+        if (timeout_ms > -1) {
+            ret = nc_timeouttime_cur_diff(&ts_timeout);
+            if (ret < 1) {
+                VRB(NULL, "Timed out after %d ms.", timeout_ms);
+                break;
+            }
+            if ((wait_ms == -1) || (ret < wait_ms)) {
+                wait_ms = ret;
+            }
+        }
+
+        ret = poll(fds, fd_count, wait_ms);
+        if (ret == -1) {
+            ERR(NULL, "poll() failed (%s).", strerror(errno));
+            break;
+        } else if (ret == 0) {
+            /* start another attempt or time out */
+            continue;
+        }
+
+        for (i = 0; i < fd_count; ) {
+            if (!fds[i].revents) {
+                ++i;
+                continue;
+            }
+
+            if (!sock_connect_finish(fds[i].fd, ka)) {
+                /* connected */
+                sock = fds[i].fd;
+                *res_conn = fd_res[i];
+                break;
+            }
+
+            /* failed, start another attempt right away */
+            close(fds[i].fd);
+            --fd_count;
+            memmove(&fds[i], &fds[i + 1], (fd_count - i) * sizeof *fds);
+            memmove(&fd_res[i], &fd_res[i + 1], (fd_count - i) * sizeof *fd_res);
+            nc_timeouttime_get(&ts_next, 0);
+        }
+        if (sock > -1) {
+            break;
+        }
+    }
+
+    /* cancel the other attempts */
+    for (i = 0; i < fd_count; ++i) {
+        if (fds[i].fd == sock) {
+            continue;
+        }
+        if ((sock == -1) && sock_pending && (*sock_pending == -1)) {
+            /* keep the first attempt still in progress */
+            *sock_pending = fds[i].fd;
+            continue;
+        }
+        close(fds[i].fd);
+    }
+
+cleanup:
+    free(cands);
+    free(fd_res);
+    free(fds);
+    return sock;
+}
+
 int
 nc_sock_connect(const char *src_addr, uint16_t src_port, const char *dst_addr, uint16_t dst_port, int timeout_ms,
         struct nc_keepalives *ka, int *sock_pending, char **ip_host)
@@ -1753,18 +3205,8 @@ nc_sock_connect(const char *src_addr, uint16_t src_port, const char *dst_addr, u
             goto error;
         }
 
-        for (res = res_list; res != NULL; res = res->ai_next) {
-            sock = sock_connect(src_addr, src_port, timeout_ms, sock_pending, res, ka);
-            if (sock == -1) {
-                if (!sock_pending || (*sock_pending == -1)) {
-                    /* try the next resource */
-                    continue;
-                } else {
-                    /* timeout, keep pending socket */
-                    break;
-                }
-            }
-
+        sock = nc_sock_connect_race(src_addr, src_port, timeout_ms, sock_pending, res_list, ka, &res);
+        if (sock > -1) {
             if (res->ai_family == AF_INET) {
                 VRB(NULL, "Successfully connected to %s:%s over IPv4.", dst_addr, dst_port_str);
             } else {
@@ -1780,14 +3222,13 @@ nc_sock_connect(const char *src_addr, uint16_t src_port, const char *dst_addr, u
             if (nc_saddr2str(res->ai_addr, ip_host, NULL)) {
                 goto error;
             }
-            break;
         }
         freeaddrinfo(res_list);
 
     } else {
         /* try to get a connection with the pending socket */
         assert(sock_pending);
-        sock = sock_connect(src_addr, src_port, timeout_ms, sock_pending, NULL, ka);
+        sock = sock_connect_pending(timeout_ms, sock_pending, ka);
 
         if (sock > 0) {
             if (getpeername(sock, (struct sockaddr *)&saddr, &addr_len)) {
@@ -2024,10 +3465,13 @@ nc_client_destroy(void)
 {
     pthread_mutex_destroy(&client_opts.ch_bind_lock);
     nc_client_set_schema_searchpath(NULL);
+    nc_client_set_module_cache(NULL, 0);
+    nc_client_set_new_session_context_lazy(0, NULL);
 #ifdef NC_ENABLED_SSH_TLS
     nc_client_ch_del_bind(NULL, 0, 0);
     nc_client_ssh_destroy_opts();
     nc_client_tls_destroy_opts();
+    nc_session_tls_crl_cache_destroy();
     nc_tls_backend_destroy_wrap();
     ssh_finalize();
 #endif /* NC_ENABLED_SSH_TLS */
@@ -2123,1497 +3567,5239 @@ get_msg_type(struct nc_session *session, struct ly_in *msg)
 }
 
 /**
- * @brief Function to receive either replies or notifications.
+ * @brief Get the message-id of an rpc-reply without parsing it.
  *
- * @param[in] session NETCONF session from which this function receives messages.
- * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite.
- * @param[in] expected Type of the message the caller desired.
- * @param[out] message If receiving a message succeeded this is the message, NULL otherwise.
- * @return NC_MSG_REPLY If a rpc-reply was received;
- * @return NC_MSG_NOTIF If a notification was received;
- * @return NC_MSG_ERROR If any error occurred;
- * @return NC_MSG_WOULDBLOCK If the timeout was reached.
+ * @param[in] msg Message roughly matching an rpc-reply.
+ * @param[out] msgid Message ID of the reply.
+ * @return 0 on success;
+ * @return 1 if the reply has no valid message-id.
  */
-static NC_MSG_TYPE
-recv_msg(struct nc_session *session, int timeout, NC_MSG_TYPE expected, struct ly_in **message)
+static int
+get_msg_msgid(const char *msg, uint64_t *msgid)
 {
-    struct nc_msg_cont **cont_ptr;
-    struct ly_in *msg = NULL;
-    struct nc_msg_cont *cont, *prev;
-    NC_MSG_TYPE ret = NC_MSG_ERROR;
-    int r;
-
-    *message = NULL;
+    const char *str, *end;
+    char *ptr, quot;
 
-    /* MSGS LOCK */
-    r = nc_session_client_msgs_lock(session, &timeout, __func__);
-    if (!r) {
-        ret = NC_MSG_WOULDBLOCK;
-        goto cleanup;
-    } else if (r == -1) {
-        ret = NC_MSG_ERROR;
-        goto cleanup;
+    /* rpc-reply start tag */
+    str = strstr(msg, "<rpc-reply");
+    if (!str || !(end = strchr(str, '>'))) {
+        return 1;
     }
 
-    /* Find the expected message in the buffer */
-    prev = NULL;
-    for (cont = session->opts.client.msgs; cont && (cont->type != expected); cont = cont->next) {
-        prev = cont;
-    }
+    for (str += 10; str < end; str++) {
+        if (!isspace(str[0]) || strncmp(str + 1, "message-id", 10)) {
+            /* not an unprefixed message-id attribute */
+            continue;
+        }
 
-    if (cont) {
-        /* Remove found message from buffer */
-        if (prev) {
-            prev->next = cont->next;
-        } else {
-            session->opts.client.msgs = cont->next;
+        /* skip to the value */
+        str += 11;
+        while (isspace(*str)) {
+            str++;
+        }
+        if (*str != '=') {
+            continue;
+        }
+        str++;
+        while (isspace(*str)) {
+            str++;
         }
+        if ((*str != '\"') && (*str != '\'')) {
+            return 1;
+        }
+        quot = *str;
+        str++;
 
-        /* Use the buffer message */
-        ret = cont->type;
-        msg = cont->msg;
-        free(cont);
-        goto cleanup_unlock;
+        if (!isdigit(*str)) {
+            return 1;
+        }
+        *msgid = strtoull(str, &ptr, 10);
+        return (*ptr == quot) ? 0 : 1;
     }
 
-    /* Read a message from the wire */
-    r = nc_read_msg_poll_io(session, timeout, &msg);
-    if (!r) {
-        ret = NC_MSG_WOULDBLOCK;
-        goto cleanup_unlock;
-    } else if (r == -1) {
-        ret = NC_MSG_ERROR;
-        goto cleanup_unlock;
-    }
+    return 1;
+}
 
-    /* Basic check to determine message type */
-    ret = get_msg_type(session, msg);
-    if (ret == NC_MSG_ERROR) {
-        goto cleanup_unlock;
-    }
+/**
+ * @brief Get the hash of a message ID of a pending RPC.
+ *
+ * @param[in] msgid Message ID.
+ * @return Hash of @p msgid.
+ */
+static uint32_t
+nc_rpc_pending_hash(uint64_t msgid)
+{
+    uint32_t hash;
 
-    /* If received a message of different type store it in the buffer */
-    if (ret != expected) {
-        cont_ptr = &session->opts.client.msgs;
-        while (*cont_ptr) {
-            cont_ptr = &((*cont_ptr)->next);
-        }
-        *cont_ptr = malloc(sizeof **cont_ptr);
-        NC_CHECK_ERRMEM_GOTO(!*cont_ptr, ret = NC_MSG_ERROR, cleanup_unlock);
-        (*cont_ptr)->msg = msg;
-        msg = NULL;
-        (*cont_ptr)->type = ret;
-        (*cont_ptr)->next = NULL;
-    }
+    hash = lyht_hash_multi(0, (const char *)&msgid, sizeof msgid);
+    return lyht_hash_multi(hash, NULL, 0);
+}
 
-cleanup_unlock:
-    /* MSGS UNLOCK */
-    nc_session_client_msgs_unlock(session, __func__);
+/**
+ * @brief Pending RPC hash table value equal callback.
+ */
+static ly_bool
+nc_rpc_pending_equal(void *val1_p, void *val2_p, ly_bool UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct nc_rpc_pending *pending1 = *(struct nc_rpc_pending **)val1_p, *pending2 = *(struct nc_rpc_pending **)val2_p;
 
-cleanup:
-    if (ret == expected) {
-        *message = msg;
-    } else {
-        ly_in_free(msg, 1);
+    return pending1->msgid == pending2->msgid;
+}
+
+static void
+nc_rpc_pending_free(struct nc_rpc_pending *pending)
+{
+    if (!pending) {
+        return;
     }
-    return ret;
+
+    free(pending->rpc_xml);
+    ly_in_free(pending->msg, 1);
+    free(pending);
 }
 
-static NC_MSG_TYPE
-recv_reply(struct nc_session *session, int timeout, struct lyd_node *op, uint64_t msgid, struct lyd_node **envp)
+/**
+ * @brief Pending RPC hash table value free callback.
+ */
+static void
+nc_rpc_pending_ht_free(void *val_p)
 {
-    LY_ERR lyrc;
-    struct ly_in *msg = NULL;
-    NC_MSG_TYPE ret = NC_MSG_ERROR;
-    uint32_t temp_lo = LY_LOSTORE, *prev_lo;
+    nc_rpc_pending_free(*(struct nc_rpc_pending **)val_p);
+}
 
-    assert(op && (op->schema->nodetype & (LYS_RPC | LYS_ACTION)));
+void
+nc_client_rpc_pending_free_all(struct nc_session *session)
+{
+    lyht_free(session->opts.client.pending, nc_rpc_pending_ht_free);
+    session->opts.client.pending = NULL;
+    session->opts.client.ready = NULL;
+    session->opts.client.ready_last = NULL;
+}
 
-    *envp = NULL;
+/**
+ * @brief Find a pending RPC, MSGS lock is expected to be held.
+ *
+ * @param[in] session Client session.
+ * @param[in] msgid Message ID of the RPC.
+ * @return Found pending RPC, NULL if there is none.
+ */
+static struct nc_rpc_pending *
+nc_rpc_pending_find(struct nc_session *session, uint64_t msgid)
+{
+    struct nc_rpc_pending key = {.msgid = msgid}, *key_p = &key, **match;
 
-    /* Receive messages until a rpc-reply is found or a timeout or error reached */
-    ret = recv_msg(session, timeout, NC_MSG_REPLY, &msg);
-    if (ret != NC_MSG_REPLY) {
-        goto cleanup;
+    if (!session->opts.client.pending ||
+            lyht_find(session->opts.client.pending, &key_p, nc_rpc_pending_hash(msgid), (void **)&match)) {
+        return NULL;
     }
 
-    /* parse */
-    prev_lo = ly_temp_log_options(&temp_lo);
-    lyrc = lyd_parse_op(NULL, op, msg, LYD_XML, LYD_TYPE_REPLY_NETCONF, envp, NULL);
-    ly_temp_log_options(prev_lo);
+    return *match;
+}
 
-    if (*envp) {
-        /* if the envelopes were parsed, check the message-id, even on error */
-        ret = recv_reply_check_msgid(session, *envp, msgid);
-        goto cleanup;
+/**
+ * @brief Route an rpc-reply to its asynchronously sent RPC, MSGS lock is expected to be held.
+ *
+ * @param[in] session Client session.
+ * @param[in] msg Received rpc-reply, is spent if routed.
+ * @return 1 if the reply was routed;
+ * @return 0 if there is no pending RPC for the reply.
+ */
+static int
+recv_msg_route_reply(struct nc_session *session, struct ly_in *msg)
+{
+    struct nc_rpc_pending *pending;
+    uint64_t msgid;
+
+    if (!session->opts.client.pending || get_msg_msgid(ly_in_memory(msg, NULL), &msgid)) {
+        return 0;
     }
 
-    if (lyrc) {
-        /* parsing error */
-        ERR(session, "Received an invalid message (%s).", ly_err_last(LYD_CTX(op))->msg);
-        lyd_free_tree(*envp);
-        *envp = NULL;
-        ret = NC_MSG_ERROR;
-        goto cleanup;
+    pending = nc_rpc_pending_find(session, msgid);
+    if (!pending || pending->msg) {
+        /* unknown or duplicate reply */
+        return 0;
     }
 
-cleanup:
-    ly_in_free(msg, 1);
-    return ret;
+    if (pending->discard) {
+        /* no longer awaited */
+        lyht_remove(session->opts.client.pending, &pending, nc_rpc_pending_hash(msgid));
+        nc_rpc_pending_free(pending);
+        ly_in_free(msg, 1);
+        return 1;
+    }
+
+    pending->msg = msg;
+    if (pending->reply_clb) {
+        /* append into the ready FIFO */
+        if (session->opts.client.ready_last) {
+            session->opts.client.ready_last->next = pending;
+        } else {
+            session->opts.client.ready = pending;
+        }
+        session->opts.client.ready_last = pending;
+    }
+
+    return 1;
 }
 
-static int
-recv_reply_dup_rpc(struct nc_session *session, struct nc_rpc *rpc, struct lyd_node **op)
+void
+nc_client_rpc_pending_discard(struct nc_session *session, uint64_t msgid)
 {
-    LY_ERR lyrc = LY_SUCCESS;
-    struct nc_rpc_act_generic *rpc_gen;
-    struct ly_in *in;
-    struct lyd_node *tree, *op2;
-    const struct lys_module *mod;
-    const char *module_name = NULL, *rpc_name = NULL, *module_check = NULL;
+    struct nc_rpc_pending *pending;
+    int timeout = NC_SESSION_LOCK_TIMEOUT;
 
-    switch (rpc->type) {
-    case NC_RPC_ACT_GENERIC:
-        rpc_gen = (struct nc_rpc_act_generic *)rpc;
-        if (rpc_gen->has_data) {
-            tree = rpc_gen->content.data;
+    /* MSGS LOCK */
+    if (nc_session_client_msgs_lock(session, &timeout, __func__) != 1) {
+        return;
+    }
 
-            /* find the operation node */
-            lyrc = LY_EINVAL;
-            LYD_TREE_DFS_BEGIN(tree, op2) {
-                if (op2->schema->nodetype & (LYS_RPC | LYS_ACTION)) {
-                    lyrc = lyd_dup_single(op2, NULL, 0, op);
-                    break;
-                }
-                LYD_TREE_DFS_END(tree, op2);
-            }
+    pending = nc_rpc_pending_find(session, msgid);
+    if (pending && !pending->reply_clb) {
+        if (pending->msg) {
+            /* already received */
+            lyht_remove(session->opts.client.pending, &pending, nc_rpc_pending_hash(msgid));
+            nc_rpc_pending_free(pending);
         } else {
-            ly_in_new_memory(rpc_gen->content.xml_str, &in);
-            lyrc = lyd_parse_op(session->ctx, NULL, in, LYD_XML, LYD_TYPE_RPC_YANG, &tree, &op2);
-            ly_in_free(in, 0);
-            if (lyrc) {
-                lyd_free_tree(tree);
-                return -1;
-            }
-
-            /* we want just the operation node */
-            lyrc = lyd_dup_single(op2, NULL, 0, op);
-
-            lyd_free_tree(tree);
+            pending->discard = 1;
         }
-        break;
-    case NC_RPC_GETCONFIG:
-        module_name = "ietf-netconf";
-        rpc_name = "get-config";
-        break;
-    case NC_RPC_EDIT:
-        module_name = "ietf-netconf";
-        rpc_name = "edit-config";
-        break;
-    case NC_RPC_COPY:
-        module_name = "ietf-netconf";
-        rpc_name = "copy-config";
-        break;
-    case NC_RPC_DELETE:
-        module_name = "ietf-netconf";
-        rpc_name = "delete-config";
-        break;
-    case NC_RPC_LOCK:
-        module_name = "ietf-netconf";
-        rpc_name = "lock";
-        break;
-    case NC_RPC_UNLOCK:
-        module_name = "ietf-netconf";
-        rpc_name = "unlock";
-        break;
-    case NC_RPC_GET:
-        module_name = "ietf-netconf";
-        rpc_name = "get";
-        break;
-    case NC_RPC_KILL:
-        module_name = "ietf-netconf";
-        rpc_name = "kill-session";
-        break;
-    case NC_RPC_COMMIT:
-        module_name = "ietf-netconf";
-        rpc_name = "commit";
-        break;
-    case NC_RPC_DISCARD:
-        module_name = "ietf-netconf";
-        rpc_name = "discard-changes";
-        break;
-    case NC_RPC_CANCEL:
-        module_name = "ietf-netconf";
-        rpc_name = "cancel-commit";
-        break;
-    case NC_RPC_VALIDATE:
-        module_name = "ietf-netconf";
-        rpc_name = "validate";
-        break;
-    case NC_RPC_GETSCHEMA:
-        module_name = "ietf-netconf-monitoring";
-        rpc_name = "get-schema";
-        break;
-    case NC_RPC_SUBSCRIBE:
-        module_name = "notifications";
-        rpc_name = "create-subscription";
-        break;
-    case NC_RPC_GETDATA:
-        module_name = "ietf-netconf-nmda";
-        rpc_name = "get-data";
-        break;
-    case NC_RPC_EDITDATA:
-        module_name = "ietf-netconf-nmda";
-        rpc_name = "edit-data";
-        break;
-    case NC_RPC_ESTABLISHSUB:
-        module_name = "ietf-subscribed-notifications";
-        rpc_name = "establish-subscription";
-        break;
-    case NC_RPC_MODIFYSUB:
-        module_name = "ietf-subscribed-notifications";
-        rpc_name = "modify-subscription";
-        break;
-    case NC_RPC_DELETESUB:
-        module_name = "ietf-subscribed-notifications";
-        rpc_name = "delete-subscription";
-        break;
-    case NC_RPC_KILLSUB:
-        module_name = "ietf-subscribed-notifications";
-        rpc_name = "kill-subscription";
-        break;
-    case NC_RPC_ESTABLISHPUSH:
-        module_name = "ietf-subscribed-notifications";
-        rpc_name = "establish-subscription";
-        module_check = "ietf-yang-push";
-        break;
-    case NC_RPC_MODIFYPUSH:
-        module_name = "ietf-subscribed-notifications";
-        rpc_name = "modify-subscription";
-        module_check = "ietf-yang-push";
-        break;
-    case NC_RPC_RESYNCSUB:
-        module_name = "ietf-yang-push";
-        rpc_name = "resync-subscription";
-        break;
-    case NC_RPC_UNKNOWN:
-        lyrc = LY_EINT;
-        break;
     }
 
-    if (module_name && rpc_name) {
-        mod = ly_ctx_get_module_implemented(session->ctx, module_name);
-        if (!mod) {
-            ERR(session, "Missing \"%s\" module in the context.", module_name);
-            return -1;
-        }
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+}
 
-        /* create the operation node */
-        lyrc = lyd_new_inner(NULL, mod, rpc_name, 0, op);
+/**
+ * @brief Learn whether a client session has data buffered in its transport that were already read from the socket.
+ *
+ * Such data are not signalled by the socket becoming readable.
+ *
+ * @param[in] session Client session.
+ * @return 1 if there are buffered data or the session should be read to learn its state;
+ * @return 0 otherwise.
+ */
+static int
+nc_client_session_has_buffered(struct nc_session *session)
+{
+#ifdef NC_ENABLED_SSH_TLS
+    int r;
+
+    if ((session->ti_type != NC_TI_SSH) && (session->ti_type != NC_TI_TLS)) {
+        /* no transport buffers */
+        return 0;
     }
-    if (module_check) {
-        if (!ly_ctx_get_module_implemented(session->ctx, module_check)) {
-            ERR(session, "Missing \"%s\" module in the context.", module_check);
-            return -1;
-        }
+
+    /* SESSION IO LOCK */
+    if (nc_session_io_lock(session, 0, __func__) != 1) {
+        /* being read by another thread */
+        return 0;
     }
 
-    if (lyrc) {
-        return -1;
+    if (session->ti_type == NC_TI_SSH) {
+        /* also learns about EOF or an error, the session is then read to handle it */
+        r = ssh_channel_poll(session->ti.libssh.channel, 0) ? 1 : 0;
+    } else {
+        r = nc_tls_get_num_pending_bytes_wrap(session->ti.tls.session) ? 1 : 0;
     }
+
+    /* SESSION IO UNLOCK */
+    nc_session_io_unlock(session, __func__);
+
+    return r;
+#else
+    (void)session;
     return 0;
+#endif /* NC_ENABLED_SSH_TLS */
 }
 
-API NC_MSG_TYPE
-nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout, struct lyd_node **envp,
-        struct lyd_node **op)
+void
+nc_client_notif_wakeup(struct nc_session *session)
 {
-    NC_MSG_TYPE ret;
+    char c = 0;
 
-    NC_CHECK_ARG_RET(session, session, rpc, envp, op, NC_MSG_ERROR);
+    if (session->opts.client.ntf_wakeup[1] == -1) {
+        /* no notification threads */
+        return;
+    }
 
-    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
-        ERR(session, "Invalid session to receive RPC replies.");
-        return NC_MSG_ERROR;
+    if ((write(session->opts.client.ntf_wakeup[1], &c, 1) == -1) && (errno != EAGAIN)) {
+        ERR(session, "Failed to wake up the notification threads (%s).", strerror(errno));
     }
+}
 
-    /* get a duplicate of the RPC node to append reply to */
-    if (recv_reply_dup_rpc(session, rpc, op)) {
-        return NC_MSG_ERROR;
+/**
+ * @brief Consume all the pending wakeups of the notification threads of a client session.
+ *
+ * @param[in] session Client session.
+ */
+static void
+nc_client_notif_wakeup_clear(struct nc_session *session)
+{
+    char buf[64];
+
+    while (read(session->opts.client.ntf_wakeup[0], buf, sizeof buf) > 0) {}
+}
+
+/**
+ * @brief Wake up the notification threads of a client session if its transport buffered data
+ * after reading a message.
+ *
+ * These data are not signalled by the socket becoming readable so the threads would not notice them.
+ *
+ * @param[in] session Client session.
+ */
+static void
+nc_client_notif_wakeup_buffered(struct nc_session *session)
+{
+    if ((session->opts.client.ntf_wakeup[1] > -1) && nc_client_session_has_buffered(session)) {
+        nc_client_notif_wakeup(session);
     }
+}
+
+/**
+ * @brief Read a single message from the wire and route it if it is a reply to an asynchronously sent RPC.
+ * MSGS lock is expected to be held.
+ *
+ * @param[in] session Client session.
+ * @param[in] timeout Timeout for reading in milliseconds.
+ * @param[out] msg Read message, NULL if it was routed.
+ * @param[out] type Type of the read message.
+ * @return 1 if a message was read;
+ * @return 0 on timeout;
+ * @return -1 on error.
+ */
+static int
+recv_msg_read(struct nc_session *session, int timeout, struct ly_in **msg, NC_MSG_TYPE *type)
+{
+    int r;
 
-    /* receive a reply */
-    ret = recv_reply(session, timeout, *op, msgid, envp);
+    *msg = NULL;
 
-    /* do not return the RPC copy on error or if the reply includes no data */
-    if (((ret != NC_MSG_REPLY) && (ret != NC_MSG_REPLY_ERR_MSGID)) || !lyd_child(*op)) {
-        lyd_free_tree(*op);
-        *op = NULL;
+    r = nc_read_msg_poll_io(session, timeout, msg);
+    if (r < 1) {
+        return r;
     }
-    return ret;
+
+    /* the transport may have read the beginning of another message */
+    nc_client_notif_wakeup_buffered(session);
+
+    /* Basic check to determine message type */
+    *type = get_msg_type(session, *msg);
+    if (*type == NC_MSG_ERROR) {
+        ly_in_free(*msg, 1);
+        *msg = NULL;
+        return -1;
+    }
+
+    if ((*type == NC_MSG_REPLY) && recv_msg_route_reply(session, *msg)) {
+        *msg = NULL;
+    }
+    return 1;
 }
 
-static NC_MSG_TYPE
-recv_notif(struct nc_session *session, int timeout, struct lyd_node **envp, struct lyd_node **op)
+/**
+ * @brief Store a message in its queue, MSGS lock is expected to be held.
+ *
+ * If the buffered messages limit would be exceeded by a notification, it is dropped. Replies are always
+ * buffered because they are expected by a pending RPC.
+ *
+ * @param[in] session Client session.
+ * @param[in] msg Message to store, is spent.
+ * @param[in] type Type of @p msg.
+ * @return 0 on success, -1 on error.
+ */
+static int
+recv_msg_buffer(struct nc_session *session, struct ly_in *msg, NC_MSG_TYPE type)
 {
-    LY_ERR lyrc;
-    struct ly_in *msg = NULL;
-    NC_MSG_TYPE ret = NC_MSG_ERROR;
+    struct nc_msg_queue *queue;
+    struct nc_msg_cont *cont;
+    size_t size;
 
-    *op = NULL;
-    *envp = NULL;
+    queue = (type == NC_MSG_REPLY) ? &session->opts.client.replies : &session->opts.client.notifs;
+    size = strlen(ly_in_memory(msg, NULL));
 
-    /* Receive messages until a notification is found or a timeout or error reached */
-    ret = recv_msg(session, timeout, NC_MSG_NOTIF, &msg);
-    if (ret != NC_MSG_NOTIF) {
-        goto cleanup;
+    if ((type == NC_MSG_NOTIF) && session->opts.client.msgs_size_max &&
+            (session->opts.client.msgs_size + size > session->opts.client.msgs_size_max)) {
+        WRN(session, "Buffered messages limit (%zu B) reached, dropping a received notification.",
+                session->opts.client.msgs_size_max);
+        ly_in_free(msg, 1);
+        return 0;
     }
 
-    /* Parse */
-    lyrc = lyd_parse_op(session->ctx, NULL, msg, LYD_XML, LYD_TYPE_NOTIF_NETCONF, envp, op);
-    if (!lyrc) {
-        goto cleanup;
+    cont = malloc(sizeof *cont);
+    if (!cont) {
+        ERRMEM;
+        ly_in_free(msg, 1);
+        return -1;
+    }
+    cont->msg = msg;
+    cont->size = size;
+    cont->next = NULL;
+
+    /* append */
+    if (queue->tail) {
+        queue->tail->next = cont;
     } else {
-        ERR(session, "Received an invalid message (%s).", ly_err_last(session->ctx)->msg);
-        lyd_free_tree(*envp);
-        *envp = NULL;
-        ret = NC_MSG_ERROR;
-        goto cleanup;
+        queue->head = cont;
     }
+    queue->tail = cont;
+    session->opts.client.msgs_size += size;
 
-cleanup:
-    ly_in_free(msg, 1);
-    return ret;
+    if (type == NC_MSG_NOTIF) {
+        /* the notification is not signalled by the socket */
+        nc_client_notif_wakeup(session);
+    }
+
+    return 0;
 }
 
-API NC_MSG_TYPE
-nc_recv_notif(struct nc_session *session, int timeout, struct lyd_node **envp, struct lyd_node **op)
+/**
+ * @brief Remove the oldest message from a queue, MSGS lock is expected to be held.
+ *
+ * @param[in] session Client session.
+ * @param[in] queue Queue to use.
+ * @return Removed message, NULL if the queue is empty.
+ */
+static struct ly_in *
+recv_msg_queue_pop(struct nc_session *session, struct nc_msg_queue *queue)
 {
-    NC_CHECK_ARG_RET(session, session, envp, op, NC_MSG_ERROR);
+    struct nc_msg_cont *cont;
+    struct ly_in *msg;
 
-    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
-        ERR(session, "Invalid session to receive Notifications.");
-        return NC_MSG_ERROR;
+    cont = queue->head;
+    if (!cont) {
+        return NULL;
     }
 
-    /* receive a notification */
-    return recv_notif(session, timeout, envp, op);
+    queue->head = cont->next;
+    if (!queue->head) {
+        queue->tail = NULL;
+    }
+    session->opts.client.msgs_size -= cont->size;
+
+    msg = cont->msg;
+    free(cont);
+    return msg;
 }
 
-static void *
-nc_recv_notif_thread(void *arg)
+void
+nc_client_msg_queue_free(struct nc_session *session, struct nc_msg_queue *queue)
 {
-    struct nc_ntf_thread_arg *ntarg;
-    struct nc_session *session;
-    nc_notif_dispatch_clb notif_clb;
-    void *user_data;
+    struct ly_in *msg;
 
-    void (*free_data)(void *);
-    struct lyd_node *envp, *op;
-    NC_MSG_TYPE msgtype;
+    while ((msg = recv_msg_queue_pop(session, queue))) {
+        ly_in_free(msg, 1);
+    }
+}
 
-    /* detach ourselves */
-    pthread_detach(pthread_self());
+/**
+ * @brief Function to receive either replies or notifications.
+ *
+ * @param[in] session NETCONF session from which this function receives messages.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite.
+ * @param[in] expected Type of the message the caller desired.
+ * @param[out] message If receiving a message succeeded this is the message, NULL otherwise.
+ * @return NC_MSG_REPLY If a rpc-reply was received;
+ * @return NC_MSG_NOTIF If a notification was received;
+ * @return NC_MSG_ERROR If any error occurred;
+ * @return NC_MSG_WOULDBLOCK If the timeout was reached.
+ */
+static NC_MSG_TYPE
+recv_msg(struct nc_session *session, int timeout, NC_MSG_TYPE expected, struct ly_in **message)
+{
+    struct ly_in *msg = NULL;
+    struct timespec ts_timeout = {0};
+    NC_MSG_TYPE ret = NC_MSG_ERROR;
+    int r;
 
-    ntarg = (struct nc_ntf_thread_arg *)arg;
-    session = ntarg->session;
-    notif_clb = ntarg->notif_clb;
-    user_data = ntarg->user_data;
-    free_data = ntarg->free_data;
-    free(ntarg);
+    *message = NULL;
 
-    while (ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running)) {
-        msgtype = nc_recv_notif(session, NC_CLIENT_NOTIF_THREAD_SLEEP / 1000, &envp, &op);
-        if (msgtype == NC_MSG_NOTIF) {
-            notif_clb(session, envp, op, user_data);
-            if (!strcmp(op->schema->name, "notificationComplete") && !strcmp(op->schema->module->name, "nc-notifications")) {
-                lyd_free_all(envp);
-                lyd_free_all(op);
-                break;
-            }
-            lyd_free_all(envp);
-            lyd_free_all(op);
-        } else if ((msgtype == NC_MSG_ERROR) && (session->status != NC_STATUS_RUNNING)) {
-            /* quit this thread once the session is broken */
-            break;
-        }
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (!r) {
+        ret = NC_MSG_WOULDBLOCK;
+        goto cleanup;
+    } else if (r == -1) {
+        ret = NC_MSG_ERROR;
+        goto cleanup;
+    }
 
-        usleep(NC_CLIENT_NOTIF_THREAD_SLEEP);
+    /* Use the oldest buffered message of the expected type, if any */
+    msg = recv_msg_queue_pop(session, (expected == NC_MSG_REPLY) ? &session->opts.client.replies :
+            &session->opts.client.notifs);
+    if (msg) {
+        ret = expected;
+        goto cleanup_unlock;
     }
 
-    VRB(session, "Notification thread exit.");
-    ATOMIC_DEC_RELAXED(session->opts.client.ntf_thread_count);
-    if (free_data) {
-        free_data(user_data);
+    if (timeout > 0) {
+        nc_timeouttime_get(&ts_timeout, timeout);
     }
 
-    return NULL;
-}
+    do {
+        /* Read a message from the wire */
+        r = recv_msg_read(session, timeout, &msg, &ret);
+        if (!r) {
+            ret = NC_MSG_WOULDBLOCK;
+            goto cleanup_unlock;
+        } else if (r == -1) {
+            ret = NC_MSG_ERROR;
+            goto cleanup_unlock;
+        }
 
-API int
-nc_recv_notif_dispatch(struct nc_session *session, nc_notif_dispatch_clb notif_clb)
-{
-    return nc_recv_notif_dispatch_data(session, notif_clb, NULL, NULL);
-}
+        if (!msg && (timeout > 0)) {
+            /* reply to an asynchronously sent RPC was routed, keep reading for the rest of the timeout */
+            timeout = nc_timeouttime_cur_diff(&ts_timeout);
+            if (timeout < 1) {
+                ret = NC_MSG_WOULDBLOCK;
+                goto cleanup_unlock;
+            }
+        }
+    } while (!msg);
 
-API int
-nc_recv_notif_dispatch_data(struct nc_session *session, nc_notif_dispatch_clb notif_clb, void *user_data,
-        void (*free_data)(void *))
-{
-    struct nc_ntf_thread_arg *ntarg;
-    pthread_t tid;
-    int ret;
+    /* If received a message of different type store it in the buffer */
+    if (ret != expected) {
+        if (recv_msg_buffer(session, msg, ret)) {
+            ret = NC_MSG_ERROR;
+        }
+        msg = NULL;
+    }
 
-    NC_CHECK_ARG_RET(session, session, notif_clb, -1);
+cleanup_unlock:
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
 
-    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
-        ERR(session, "Invalid session to receive Notifications.");
-        return -1;
+cleanup:
+    if (ret == expected) {
+        *message = msg;
+    } else {
+        ly_in_free(msg, 1);
     }
+    return ret;
+}
 
-    ntarg = malloc(sizeof *ntarg);
-    NC_CHECK_ERRMEM_RET(!ntarg, -1);
-
-    ntarg->session = session;
-    ntarg->notif_clb = notif_clb;
-    ntarg->user_data = user_data;
-    ntarg->free_data = free_data;
-    ATOMIC_INC_RELAXED(session->opts.client.ntf_thread_count);
+/**
+ * @brief Add a parsed message into the parse statistics of a session.
+ *
+ * @param[in] session Client session.
+ * @param[in] mode Parse mode used.
+ * @param[in] bytes Size of the parsed message.
+ * @param[in] ts_start Time the parsing started.
+ */
+static void
+nc_client_parse_stats_add(struct nc_session *session, NC_CLIENT_PARSE_MODE mode, uint64_t bytes,
+        const struct timespec *ts_start)
+{
+    struct timespec ts_end;
 
-    /* just so that nc_recv_notif_thread() does not immediately exit */
-    ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 1);
+    clock_gettime(COMPAT_CLOCK_ID, &ts_end);
+    ATOMIC_INC_RELAXED(session->opts.client.parse_stats[mode].count);
+    ATOMIC_ADD_RELAXED(session->opts.client.parse_stats[mode].bytes, bytes);
+    ATOMIC_ADD_RELAXED(session->opts.client.parse_stats[mode].usec,
+            (ts_end.tv_sec - ts_start->tv_sec) * 1000000 + (ts_end.tv_nsec - ts_start->tv_nsec) / 1000);
+}
 
-    ret = pthread_create(&tid, NULL, nc_recv_notif_thread, ntarg);
-    if (ret) {
-        ERR(session, "Failed to create a new thread (%s).", strerror(errno));
-        free(ntarg);
-        if (ATOMIC_DEC_RELAXED(session->opts.client.ntf_thread_count) == 1) {
-            ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 0);
+/**
+ * @brief Parse a received RPC reply or notification according to the session parse mode.
+ *
+ * In the schema parse mode, the modules used by the message are expected to be loaded and the context read-locked.
+ *
+ * @param[in] session Client session.
+ * @param[in] msg Received message.
+ * @param[in] op RPC to parse the reply into, NULL for a notification.
+ * @param[out] envp Parsed envelopes.
+ * @param[out] notif Parsed notification, only for notifications.
+ * @return LY_ERR value.
+ */
+static LY_ERR
+nc_client_parse_msg(struct nc_session *session, struct ly_in *msg, struct lyd_node *op, struct lyd_node **envp,
+        struct lyd_node **notif)
+{
+    LY_ERR lyrc;
+    NC_CLIENT_PARSE_MODE mode = session->opts.client.parse_mode;
+    struct timespec ts_start;
+    uint32_t temp_lo = LY_LOSTORE, *prev_lo = NULL;
+    struct lyd_node *node;
+    uint64_t bytes;
+
+    bytes = strlen(ly_in_memory(msg, NULL));
+    clock_gettime(COMPAT_CLOCK_ID, &ts_start);
+
+    if (op) {
+        /* reply errors are handled by the caller */
+        prev_lo = ly_temp_log_options(&temp_lo);
+    }
+
+    if (mode == NC_CLIENT_PARSE_OPAQ) {
+        /* there are no modules in the context so all the nodes are opaque */
+        lyrc = lyd_parse_data(session->opts.client.opaq_ctx, NULL, msg, LYD_XML, LYD_PARSE_ONLY | LYD_PARSE_OPAQ, 0,
+                envp);
+        if (!lyrc && notif) {
+            /* the notification is the only envelope child except for eventTime */
+            LY_LIST_FOR(lyd_child(*envp), node) {
+                if (strcmp(LYD_NAME(node), "eventTime")) {
+                    lyd_unlink_tree(node);
+                    *notif = node;
+                    break;
+                }
+            }
         }
-        return -1;
+    } else if (op) {
+        lyrc = lyd_parse_op(NULL, op, msg, LYD_XML, LYD_TYPE_REPLY_NETCONF, envp, NULL);
+    } else {
+        lyrc = lyd_parse_op(session->ctx, NULL, msg, LYD_XML, LYD_TYPE_NOTIF_NETCONF, envp, notif);
     }
 
-    return 0;
+    if (op) {
+        ly_temp_log_options(prev_lo);
+    }
+
+    nc_client_parse_stats_add(session, mode, bytes, &ts_start);
+    return lyrc;
 }
 
-static const char *
-nc_wd2str(NC_WD_MODE wd)
+/**
+ * @brief Get the context with errors of parsing a received message.
+ *
+ * @param[in] session Client session.
+ * @return Context used for parsing.
+ */
+static const struct ly_ctx *
+nc_client_parse_err_ctx(const struct nc_session *session)
 {
-    switch (wd) {
-    case NC_WD_ALL:
-        return "report-all";
-    case NC_WD_ALL_TAG:
-        return "report-all-tagged";
-    case NC_WD_TRIM:
-        return "trim";
-    case NC_WD_EXPLICIT:
-        return "explicit";
-    default:
-        break;
+    if (session->opts.client.parse_mode == NC_CLIENT_PARSE_OPAQ) {
+        return session->opts.client.opaq_ctx;
     }
-
-    return NULL;
+    return session->ctx;
 }
 
-API NC_MSG_TYPE
-nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid)
+/**
+ * @brief Parse a received RPC reply.
+ *
+ * @param[in] session Client session.
+ * @param[in] msg Received reply.
+ * @param[in] op RPC to parse the reply into.
+ * @param[in] msgid Expected message ID.
+ * @param[out] envp Parsed envelopes.
+ * @return NC_MSG_REPLY on success, NC_MSG_REPLY_ERR_MSGID on a message-id mismatch, NC_MSG_ERROR on error.
+ */
+static NC_MSG_TYPE
+recv_reply_parse(struct nc_session *session, struct ly_in *msg, struct lyd_node *op, uint64_t msgid,
+        struct lyd_node **envp)
 {
-    NC_MSG_TYPE r;
-    int dofree = 1;
-    struct ly_in *in;
-    struct nc_rpc_act_generic *rpc_gen;
-    struct nc_rpc_getconfig *rpc_gc;
-    struct nc_rpc_edit *rpc_e;
-    struct nc_rpc_copy *rpc_cp;
-    struct nc_rpc_delete *rpc_del;
-    struct nc_rpc_lock *rpc_lock;
-    struct nc_rpc_get *rpc_g;
-    struct nc_rpc_kill *rpc_k;
-    struct nc_rpc_commit *rpc_com;
-    struct nc_rpc_cancel *rpc_can;
-    struct nc_rpc_validate *rpc_val;
-    struct nc_rpc_getschema *rpc_gs;
-    struct nc_rpc_subscribe *rpc_sub;
-    struct nc_rpc_getdata *rpc_getd;
-    struct nc_rpc_editdata *rpc_editd;
-    struct nc_rpc_establishsub *rpc_estsub;
-    struct nc_rpc_modifysub *rpc_modsub;
-    struct nc_rpc_deletesub *rpc_delsub;
-    struct nc_rpc_killsub *rpc_killsub;
-    struct nc_rpc_establishpush *rpc_estpush;
-    struct nc_rpc_modifypush *rpc_modpush;
-    struct nc_rpc_resyncsub *rpc_resyncsub;
-    struct lyd_node *data = NULL, *node, *cont;
-    const struct lys_module *mod = NULL, *mod2 = NULL, *ietfncwd;
-    LY_ERR lyrc = 0;
-    int i;
-    char str[11];
-    uint64_t cur_msgid;
+    LY_ERR lyrc;
 
-    NC_CHECK_ARG_RET(session, session, rpc, msgid, NC_MSG_ERROR);
+    lyrc = nc_client_parse_msg(session, msg, op, envp, NULL);
 
-    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
-        ERR(session, "Invalid session to send RPCs.");
+    if (*envp) {
+        /* if the envelopes were parsed, check the message-id, even on error */
+        return recv_reply_check_msgid(session, *envp, msgid);
+    }
+
+    if (lyrc) {
+        /* parsing error */
+        ERR(session, "Received an invalid message (%s).", ly_err_last(nc_client_parse_err_ctx(session))->msg);
         return NC_MSG_ERROR;
     }
 
-    switch (rpc->type) {
+    return NC_MSG_REPLY;
+}
+
+/**
+ * @brief Get the module and name of the operation of a standard RPC.
+ *
+ * @param[in] type RPC type.
+ * @param[out] module_name Module of the operation, NULL for a generic RPC.
+ * @param[out] rpc_name Name of the operation, NULL for a generic RPC.
+ * @param[out] module_check Another module required for the operation, if any.
+ * @return 0 on success, -1 on error.
+ */
+static int
+recv_reply_rpc_names(NC_RPC_TYPE type, const char **module_name, const char **rpc_name, const char **module_check)
+{
+    *module_name = NULL;
+    *rpc_name = NULL;
+    *module_check = NULL;
+
+    switch (type) {
     case NC_RPC_ACT_GENERIC:
-        /* checked when parsing */
         break;
     case NC_RPC_GETCONFIG:
+        *module_name = "ietf-netconf";
+        *rpc_name = "get-config";
+        break;
     case NC_RPC_EDIT:
+        *module_name = "ietf-netconf";
+        *rpc_name = "edit-config";
+        break;
     case NC_RPC_COPY:
+        *module_name = "ietf-netconf";
+        *rpc_name = "copy-config";
+        break;
     case NC_RPC_DELETE:
+        *module_name = "ietf-netconf";
+        *rpc_name = "delete-config";
+        break;
     case NC_RPC_LOCK:
+        *module_name = "ietf-netconf";
+        *rpc_name = "lock";
+        break;
     case NC_RPC_UNLOCK:
+        *module_name = "ietf-netconf";
+        *rpc_name = "unlock";
+        break;
     case NC_RPC_GET:
+        *module_name = "ietf-netconf";
+        *rpc_name = "get";
+        break;
     case NC_RPC_KILL:
+        *module_name = "ietf-netconf";
+        *rpc_name = "kill-session";
+        break;
     case NC_RPC_COMMIT:
+        *module_name = "ietf-netconf";
+        *rpc_name = "commit";
+        break;
     case NC_RPC_DISCARD:
+        *module_name = "ietf-netconf";
+        *rpc_name = "discard-changes";
+        break;
     case NC_RPC_CANCEL:
+        *module_name = "ietf-netconf";
+        *rpc_name = "cancel-commit";
+        break;
     case NC_RPC_VALIDATE:
-        mod = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf");
-        if (!mod) {
-            ERR(session, "Missing \"ietf-netconf\" module in the context.");
-            return NC_MSG_ERROR;
-        }
+        *module_name = "ietf-netconf";
+        *rpc_name = "validate";
         break;
     case NC_RPC_GETSCHEMA:
-        mod = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-monitoring");
-        if (!mod) {
-            ERR(session, "Missing \"ietf-netconf-monitoring\" module in the context.");
-            return NC_MSG_ERROR;
-        }
+        *module_name = "ietf-netconf-monitoring";
+        *rpc_name = "get-schema";
         break;
     case NC_RPC_SUBSCRIBE:
-        mod = ly_ctx_get_module_implemented(session->ctx, "notifications");
-        if (!mod) {
-            ERR(session, "Missing \"notifications\" module in the context.");
-            return NC_MSG_ERROR;
-        }
+        *module_name = "notifications";
+        *rpc_name = "create-subscription";
         break;
     case NC_RPC_GETDATA:
+        *module_name = "ietf-netconf-nmda";
+        *rpc_name = "get-data";
+        break;
     case NC_RPC_EDITDATA:
-        mod = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-nmda");
-        if (!mod) {
-            ERR(session, "Missing \"ietf-netconf-nmda\" module in the context.");
-            return NC_MSG_ERROR;
-        }
+        *module_name = "ietf-netconf-nmda";
+        *rpc_name = "edit-data";
         break;
     case NC_RPC_ESTABLISHSUB:
+        *module_name = "ietf-subscribed-notifications";
+        *rpc_name = "establish-subscription";
+        break;
     case NC_RPC_MODIFYSUB:
+        *module_name = "ietf-subscribed-notifications";
+        *rpc_name = "modify-subscription";
+        break;
     case NC_RPC_DELETESUB:
+        *module_name = "ietf-subscribed-notifications";
+        *rpc_name = "delete-subscription";
+        break;
     case NC_RPC_KILLSUB:
-        mod = ly_ctx_get_module_implemented(session->ctx, "ietf-subscribed-notifications");
-        if (!mod) {
-            ERR(session, "Missing \"ietf-subscribed-notifications\" module in the context.");
-            return NC_MSG_ERROR;
-        }
+        *module_name = "ietf-subscribed-notifications";
+        *rpc_name = "kill-subscription";
         break;
     case NC_RPC_ESTABLISHPUSH:
+        *module_name = "ietf-subscribed-notifications";
+        *rpc_name = "establish-subscription";
+        *module_check = "ietf-yang-push";
+        break;
     case NC_RPC_MODIFYPUSH:
-        mod = ly_ctx_get_module_implemented(session->ctx, "ietf-subscribed-notifications");
-        if (!mod) {
-            ERR(session, "Missing \"ietf-subscribed-notifications\" module in the context.");
-            return NC_MSG_ERROR;
-        }
-        mod2 = ly_ctx_get_module_implemented(session->ctx, "ietf-yang-push");
-        if (!mod2) {
-            ERR(session, "Missing \"ietf-yang-push\" module in the context.");
-            return NC_MSG_ERROR;
-        }
+        *module_name = "ietf-subscribed-notifications";
+        *rpc_name = "modify-subscription";
+        *module_check = "ietf-yang-push";
         break;
     case NC_RPC_RESYNCSUB:
-        mod = ly_ctx_get_module_implemented(session->ctx, "ietf-yang-push");
-        if (!mod) {
-            ERR(session, "Missing \"ietf-yang-push\" module in the context.");
-            return NC_MSG_ERROR;
-        }
+        *module_name = "ietf-yang-push";
+        *rpc_name = "resync-subscription";
         break;
     case NC_RPC_UNKNOWN:
-        ERRINT;
-        return NC_MSG_ERROR;
+        return -1;
     }
 
-#define CHECK_LYRC_BREAK(func_call) if ((lyrc = func_call)) break;
+    return 0;
+}
 
-    switch (rpc->type) {
-    case NC_RPC_ACT_GENERIC:
+/**
+ * @brief Load the modules of the operation of an RPC into the context, if loaded on demand.
+ *
+ * @param[in] session Client session.
+ * @param[in] rpc Sent RPC.
+ * @return 0 on success, -1 on error.
+ */
+static int
+recv_reply_load_rpc(struct nc_session *session, struct nc_rpc *rpc)
+{
+    struct nc_rpc_act_generic *rpc_gen;
+    const char *module_name, *rpc_name, *module_check;
+
+    if (recv_reply_rpc_names(rpc->type, &module_name, &rpc_name, &module_check)) {
+        return -1;
+    }
+
+    if (rpc->type == NC_RPC_ACT_GENERIC) {
         rpc_gen = (struct nc_rpc_act_generic *)rpc;
+        if (!rpc_gen->has_data) {
+            nc_client_lazy_load_ns(session, rpc_gen->content.xml_str);
+        }
+        return 0;
+    }
+
+    if (!nc_client_ctx_get_module(session, module_name)) {
+        ERR(session, "Missing \"%s\" module in the context.", module_name);
+        return -1;
+    }
+    if (module_check && !nc_client_ctx_get_module(session, module_check)) {
+        ERR(session, "Missing \"%s\" module in the context.", module_check);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Duplicate the operation node of an RPC to parse its reply into.
+ *
+ * The modules of the operation are expected to be loaded by ::recv_reply_load_rpc() and the context read-locked.
+ *
+ * @param[in] session Client session.
+ * @param[in] rpc Sent RPC.
+ * @param[out] op Duplicated operation node.
+ * @return 0 on success, -1 on error.
+ */
+static int
+recv_reply_dup_rpc(struct nc_session *session, struct nc_rpc *rpc, struct lyd_node **op)
+{
+    LY_ERR lyrc = LY_SUCCESS;
+    struct nc_rpc_act_generic *rpc_gen;
+    struct ly_in *in;
+    struct lyd_node *tree, *op2;
+    const struct lys_module *mod;
+    const char *module_name, *rpc_name, *module_check;
 
+    if (recv_reply_rpc_names(rpc->type, &module_name, &rpc_name, &module_check)) {
+        return -1;
+    }
+
+    if (rpc->type == NC_RPC_ACT_GENERIC) {
+        rpc_gen = (struct nc_rpc_act_generic *)rpc;
         if (rpc_gen->has_data) {
-            data = rpc_gen->content.data;
-            dofree = 0;
+            tree = rpc_gen->content.data;
+
+            /* find the operation node */
+            lyrc = LY_EINVAL;
+            LYD_TREE_DFS_BEGIN(tree, op2) {
+                if (op2->schema->nodetype & (LYS_RPC | LYS_ACTION)) {
+                    lyrc = lyd_dup_single(op2, NULL, 0, op);
+                    break;
+                }
+                LYD_TREE_DFS_END(tree, op2);
+            }
         } else {
             ly_in_new_memory(rpc_gen->content.xml_str, &in);
-            lyrc = lyd_parse_op(session->ctx, NULL, in, LYD_XML, LYD_TYPE_RPC_YANG, &data, NULL);
+            lyrc = lyd_parse_op(session->ctx, NULL, in, LYD_XML, LYD_TYPE_RPC_YANG, &tree, &op2);
             ly_in_free(in, 0);
             if (lyrc) {
-                break;
+                lyd_free_tree(tree);
+                return -1;
             }
-        }
-        break;
 
-    case NC_RPC_GETCONFIG:
-        rpc_gc = (struct nc_rpc_getconfig *)rpc;
-
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get-config", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "source", 0, &cont));
-        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_gc->source], NULL, 0, NULL));
-        if (rpc_gc->filter) {
-            if (!rpc_gc->filter[0] || (rpc_gc->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", rpc_gc->filter, LYD_ANYDATA_XML, 0, &node));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "subtree", 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", NULL, LYD_ANYDATA_STRING, 0, &node));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "xpath", 0, NULL));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:select", rpc_gc->filter, 0, NULL));
-            }
+            /* we want just the operation node */
+            lyrc = lyd_dup_single(op2, NULL, 0, op);
+            lyd_free_tree(tree);
         }
-
-        if (rpc_gc->wd_mode) {
-            ietfncwd = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-with-defaults");
-            if (!ietfncwd) {
-                ERR(session, "Missing \"ietf-netconf-with-defaults\" module in the context.");
-                lyrc = LY_ENOTFOUND;
-                break;
-            }
-            CHECK_LYRC_BREAK(lyd_new_term(data, ietfncwd, "with-defaults", nc_wd2str(rpc_gc->wd_mode), 0, NULL));
+    } else {
+        mod = ly_ctx_get_module_implemented(session->ctx, module_name);
+        if (!mod) {
+            ERR(session, "Missing \"%s\" module in the context.", module_name);
+            return -1;
         }
-        break;
-
-    case NC_RPC_EDIT:
-        rpc_e = (struct nc_rpc_edit *)rpc;
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "edit-config", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
-        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_e->target], NULL, 0, NULL));
+        /* create the operation node */
+        lyrc = lyd_new_inner(NULL, mod, rpc_name, 0, op);
+    }
 
-        if (rpc_e->default_op) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "default-operation", rpcedit_dfltop2str[rpc_e->default_op], 0, NULL));
-        }
-        if (rpc_e->test_opt) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "test-option", rpcedit_testopt2str[rpc_e->test_opt], 0, NULL));
-        }
-        if (rpc_e->error_opt) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "error-option", rpcedit_erropt2str[rpc_e->error_opt], 0, NULL));
-        }
-        if (!rpc_e->edit_cont[0] || (rpc_e->edit_cont[0] == '<')) {
-            CHECK_LYRC_BREAK(lyd_new_any(data, mod, "config", rpc_e->edit_cont, LYD_ANYDATA_XML, 0, NULL));
-        } else {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "url", rpc_e->edit_cont, 0, NULL));
-        }
-        break;
+    if (lyrc) {
+        return -1;
+    }
+    return 0;
+}
 
-    case NC_RPC_COPY:
-        rpc_cp = (struct nc_rpc_copy *)rpc;
+/**
+ * @brief Prepare parsing a received reply by duplicating the operation node of its RPC.
+ *
+ * Loading a module may recompile the context so all the modules used by the reply are loaded before
+ * the operation node is duplicated. On success, the context is read-locked and the caller unlocks it
+ * once it is done with the operation node.
+ *
+ * @param[in] session Client session.
+ * @param[in] rpc Sent RPC, its modules are expected to be loaded by ::recv_reply_load_rpc().
+ * @param[in] msg Received reply.
+ * @param[out] op Duplicated operation node.
+ * @return 0 on success, -1 on error.
+ */
+static int
+recv_reply_prepare(struct nc_session *session, struct nc_rpc *rpc, const char *msg, struct lyd_node **op)
+{
+    if (session->opts.client.parse_mode == NC_CLIENT_PARSE_SCHEMA) {
+        /* load any missing modules used by the reply */
+        nc_client_lazy_load_ns(session, msg);
+    }
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "copy-config", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
-        if (rpc_cp->url_trg) {
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_cp->url_trg, 0, NULL));
-        } else {
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_cp->target], NULL, 0, NULL));
-        }
+    /* CTX READ LOCK */
+    nc_client_lazy_ctx_rdlock(session);
 
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "source", 0, &cont));
-        if (rpc_cp->url_config_src) {
-            if (!rpc_cp->url_config_src[0] || (rpc_cp->url_config_src[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(cont, mod, "config", rpc_cp->url_config_src, LYD_ANYDATA_XML, 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_cp->url_config_src, 0, NULL));
-            }
-        } else {
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_cp->source], NULL, 0, NULL));
-        }
+    if (recv_reply_dup_rpc(session, rpc, op)) {
+        /* CTX UNLOCK */
+        nc_client_lazy_ctx_unlock(session);
+        return -1;
+    }
 
-        if (rpc_cp->wd_mode) {
-            ietfncwd = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-with-defaults");
-            if (!ietfncwd) {
-                ERR(session, "Missing \"ietf-netconf-with-defaults\" module in the context.");
-                lyrc = LY_ENOTFOUND;
-                break;
-            }
-            CHECK_LYRC_BREAK(lyd_new_term(data, ietfncwd, "with-defaults", nc_wd2str(rpc_cp->wd_mode), 0, NULL));
-        }
-        break;
+    return 0;
+}
 
-    case NC_RPC_DELETE:
-        rpc_del = (struct nc_rpc_delete *)rpc;
+API NC_MSG_TYPE
+nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout, struct lyd_node **envp,
+        struct lyd_node **op)
+{
+    NC_MSG_TYPE ret;
+    struct ly_in *msg = NULL;
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "delete-config", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
-        if (rpc_del->url) {
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_del->url, 0, NULL));
-        } else {
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_del->target], NULL, 0, NULL));
-        }
-        break;
+    NC_CHECK_ARG_RET(session, session, rpc, envp, op, NC_MSG_ERROR);
 
-    case NC_RPC_LOCK:
-        rpc_lock = (struct nc_rpc_lock *)rpc;
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive RPC replies.");
+        return NC_MSG_ERROR;
+    }
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "lock", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
-        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_lock->target], NULL, 0, NULL));
-        break;
+    *envp = NULL;
+    *op = NULL;
 
-    case NC_RPC_UNLOCK:
-        rpc_lock = (struct nc_rpc_lock *)rpc;
+    /* make sure the RPC modules are in the context */
+    if (recv_reply_load_rpc(session, rpc)) {
+        return NC_MSG_ERROR;
+    }
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "unlock", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
-        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_lock->target], NULL, 0, NULL));
-        break;
+    /* Receive messages until a rpc-reply is found or a timeout or error reached */
+    ret = recv_msg(session, timeout, NC_MSG_REPLY, &msg);
+    if (ret != NC_MSG_REPLY) {
+        goto cleanup;
+    }
 
-    case NC_RPC_GET:
-        rpc_g = (struct nc_rpc_get *)rpc;
+    /* get a duplicate of the RPC node to append reply to, CTX READ LOCK */
+    if (recv_reply_prepare(session, rpc, ly_in_memory(msg, NULL), op)) {
+        ret = NC_MSG_ERROR;
+        goto cleanup;
+    }
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get", 0, &data));
-        if (rpc_g->filter) {
-            if (!rpc_g->filter[0] || (rpc_g->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", rpc_g->filter, LYD_ANYDATA_XML, 0, &node));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "subtree", 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", NULL, LYD_ANYDATA_STRING, 0, &node));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "xpath", 0, NULL));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:select", rpc_g->filter, 0, NULL));
-            }
-        }
+    /* parse */
+    ret = recv_reply_parse(session, msg, *op, msgid, envp);
 
-        if (rpc_g->wd_mode) {
-            ietfncwd = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-with-defaults");
-            if (!ietfncwd) {
-                ERR(session, "Missing \"ietf-netconf-with-defaults\" module in the context.");
-                lyrc = LY_ENOTFOUND;
-                break;
-            }
-            CHECK_LYRC_BREAK(lyd_new_term(data, ietfncwd, "with-defaults", nc_wd2str(rpc_g->wd_mode), 0, NULL));
-        }
-        break;
+    /* do not return the RPC copy on error or if the reply includes no data */
+    if (((ret != NC_MSG_REPLY) && (ret != NC_MSG_REPLY_ERR_MSGID)) || !lyd_child(*op)) {
+        lyd_free_tree(*op);
+        *op = NULL;
+    }
 
-    case NC_RPC_KILL:
-        rpc_k = (struct nc_rpc_kill *)rpc;
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "kill-session", 0, &data));
-        sprintf(str, "%" PRIu32, rpc_k->sid);
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "session-id", str, 0, NULL));
-        break;
+cleanup:
+    ly_in_free(msg, 1);
+    return ret;
+}
 
-    case NC_RPC_COMMIT:
-        rpc_com = (struct nc_rpc_commit *)rpc;
+/**
+ * @brief Namespace declaration attribute of an XML element.
+ */
+struct nc_xml_nsdecl {
+    const char *attr;       /**< whole attribute, xmlns[:prefix]="namespace" */
+    uint32_t attr_len;      /**< length of the attribute */
+    uint32_t name_len;      /**< length of the attribute name */
+};
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "commit", 0, &data));
-        if (rpc_com->confirmed) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "confirmed", NULL, 0, NULL));
-        }
+/**
+ * @brief Skip an XML comment, CDATA section, processing instruction, or document type declaration.
+ *
+ * @param[in] str String starting with '<'.
+ * @return Pointer after the skipped markup, @p str if it is none of these, NULL on error.
+ */
+static const char *
+nc_xml_skip_misc(const char *str)
+{
+    const char *end;
+
+    if (!strncmp(str, "<!--", 4)) {
+        end = strstr(str + 4, "-->");
+        return end ? end + 3 : NULL;
+    } else if (!strncmp(str, "<![CDATA[", 9)) {
+        end = strstr(str + 9, "]]>");
+        return end ? end + 3 : NULL;
+    } else if (!strncmp(str, "<?", 2)) {
+        end = strstr(str + 2, "?>");
+        return end ? end + 2 : NULL;
+    } else if (!strncmp(str, "<!", 2)) {
+        end = strchr(str + 2, '>');
+        return end ? end + 1 : NULL;
+    }
+
+    return str;
+}
 
-        if (rpc_com->confirm_timeout) {
-            sprintf(str, "%" PRIu32, rpc_com->confirm_timeout);
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "confirm-timeout", str, 0, NULL));
-        }
-        if (rpc_com->persist) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "persist", rpc_com->persist, 0, NULL));
+/**
+ * @brief Find the next start or end tag.
+ *
+ * @param[in] str Position in an XML document.
+ * @return Start of the next tag, NULL on error.
+ */
+static const char *
+nc_xml_next_tag(const char *str)
+{
+    const char *next;
+
+    while ((str = strchr(str, '<'))) {
+        next = nc_xml_skip_misc(str);
+        if (next == str) {
+            /* start or end tag */
+            return str;
         }
-        if (rpc_com->persist_id) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "persist-id", rpc_com->persist_id, 0, NULL));
+        str = next;
+        if (!str) {
+            break;
         }
-        break;
+    }
 
-    case NC_RPC_DISCARD:
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "discard-changes", 0, &data));
-        break;
+    return NULL;
+}
 
-    case NC_RPC_CANCEL:
-        rpc_can = (struct nc_rpc_cancel *)rpc;
+/**
+ * @brief Find the end of an XML tag.
+ *
+ * @param[in] str Start of the tag.
+ * @param[out] empty Optional, whether it is an empty-element tag.
+ * @return Pointer after the tag, NULL on error.
+ */
+static const char *
+nc_xml_tag_end(const char *str, int *empty)
+{
+    char quote = 0;
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "cancel-commit", 0, &data));
-        if (rpc_can->persist_id) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "persist-id", rpc_can->persist_id, 0, NULL));
+    for (++str; *str; ++str) {
+        if (quote) {
+            if (*str == quote) {
+                quote = 0;
+            }
+        } else if ((*str == '\"') || (*str == '\'')) {
+            quote = *str;
+        } else if (*str == '>') {
+            if (empty) {
+                *empty = (str[-1] == '/') ? 1 : 0;
+            }
+            return str + 1;
         }
-        break;
+    }
 
-    case NC_RPC_VALIDATE:
-        rpc_val = (struct nc_rpc_validate *)rpc;
+    return NULL;
+}
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "validate", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "source", 0, &cont));
-        if (rpc_val->url_config_src) {
-            if (!rpc_val->url_config_src[0] || (rpc_val->url_config_src[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(cont, mod, "config", rpc_val->url_config_src, LYD_ANYDATA_XML, 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_val->url_config_src, 0, NULL));
+/**
+ * @brief Find the end of an XML element.
+ *
+ * @param[in] str Start tag of the element.
+ * @return Pointer after the end tag of the element, NULL on error.
+ */
+static const char *
+nc_xml_elem_end(const char *str)
+{
+    uint32_t depth = 0;
+    int empty;
+
+    do {
+        str = nc_xml_next_tag(str);
+        if (!str) {
+            return NULL;
+        }
+
+        if (str[1] == '/') {
+            if (!depth) {
+                /* end tag without a start tag */
+                return NULL;
             }
+            --depth;
+            str = nc_xml_tag_end(str, NULL);
         } else {
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_val->source], NULL, 0, NULL));
+            str = nc_xml_tag_end(str, &empty);
+            if (!empty) {
+                ++depth;
+            }
         }
-        break;
+        if (!str) {
+            return NULL;
+        }
+    } while (depth);
 
-    case NC_RPC_GETSCHEMA:
-        rpc_gs = (struct nc_rpc_getschema *)rpc;
+    return str;
+}
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get-schema", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "identifier", rpc_gs->identifier, 0, NULL));
-        if (rpc_gs->version) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "version", rpc_gs->version, 0, NULL));
-        }
-        if (rpc_gs->format) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "format", rpc_gs->format, 0, NULL));
-        }
-        break;
+/**
+ * @brief Get the length of the qualified name of an XML element.
+ *
+ * @param[in] str Start tag of the element.
+ * @return Name length.
+ */
+static uint32_t
+nc_xml_name_len(const char *str)
+{
+    return strcspn(str + 1, " \t\r\n/>");
+}
 
-    case NC_RPC_SUBSCRIBE:
-        rpc_sub = (struct nc_rpc_subscribe *)rpc;
+/**
+ * @brief Check the local name of an XML element.
+ *
+ * @param[in] str Start tag of the element.
+ * @param[in] name Expected local name.
+ * @return Whether the local name matches.
+ */
+static int
+nc_xml_name_is(const char *str, const char *name)
+{
+    uint32_t len = nc_xml_name_len(str);
+    const char *local = str + 1, *colon;
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "create-subscription", 0, &data));
-        if (rpc_sub->stream) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream", rpc_sub->stream, 0, NULL));
+    colon = memchr(local, ':', len);
+    if (colon) {
+        len -= colon + 1 - local;
+        local = colon + 1;
+    }
+
+    return (len == strlen(name)) && !strncmp(local, name, len);
+}
+
+/**
+ * @brief Collect the namespace declarations of an XML element.
+ *
+ * A declaration replaces any previous one of the same prefix.
+ *
+ * @param[in] str Start tag of the element.
+ * @param[in,out] decls Namespace declarations.
+ * @param[in,out] count Count of @p decls.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_xml_nsdecls_add(const char *str, struct nc_xml_nsdecl **decls, uint32_t *count)
+{
+    const char *name, *end;
+    uint32_t name_len, i;
+    void *tmp;
+
+    str += 1 + nc_xml_name_len(str);
+    while (1) {
+        str += strspn(str, " \t\r\n");
+        if (!*str || (*str == '/') || (*str == '>')) {
+            break;
         }
 
-        if (rpc_sub->filter) {
-            if (!rpc_sub->filter[0] || (rpc_sub->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", rpc_sub->filter, LYD_ANYDATA_XML, 0, &node));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "subtree", 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", NULL, LYD_ANYDATA_STRING, 0, &node));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "xpath", 0, NULL));
-                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:select", rpc_sub->filter, 0, NULL));
-            }
+        /* attribute name */
+        name = str;
+        name_len = strcspn(str, " \t\r\n=");
+        str += name_len;
+        str += strspn(str, " \t\r\n");
+        if (*str != '=') {
+            return -1;
         }
-        if (rpc_sub->start) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "startTime", rpc_sub->start, 0, NULL));
+        ++str;
+        str += strspn(str, " \t\r\n");
+
+        /* attribute value */
+        if ((*str != '\"') && (*str != '\'')) {
+            return -1;
         }
-        if (rpc_sub->stop) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stopTime", rpc_sub->stop, 0, NULL));
+        end = strchr(str + 1, *str);
+        if (!end) {
+            return -1;
         }
-        break;
-
-    case NC_RPC_GETDATA:
-        rpc_getd = (struct nc_rpc_getdata *)rpc;
+        str = end + 1;
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get-data", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "datastore", rpc_getd->datastore, 0, NULL));
+        if (strncmp(name, "xmlns", 5) || ((name_len > 5) && (name[5] != ':'))) {
+            /* not a namespace declaration */
+            continue;
+        }
 
-        if (rpc_getd->filter) {
-            if (!rpc_getd->filter[0] || (rpc_getd->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "subtree-filter", rpc_getd->filter, LYD_ANYDATA_XML, 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "xpath-filter", rpc_getd->filter, 0, NULL));
+        for (i = 0; i < *count; ++i) {
+            if (((*decls)[i].name_len == name_len) && !strncmp((*decls)[i].attr, name, name_len)) {
+                break;
             }
         }
-        if (rpc_getd->config_filter) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "config-filter", rpc_getd->config_filter, 0, NULL));
-        }
-        for (i = 0; i < rpc_getd->origin_filter_count; ++i) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, rpc_getd->negated_origin_filter ? "negated-origin-filter" :
-                    "origin-filter", rpc_getd->origin_filter[i], 0, NULL));
-        }
-        if (rpc_getd->max_depth) {
-            sprintf(str, "%u", rpc_getd->max_depth);
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "max-depth", str, 0, NULL));
-        }
-        if (rpc_getd->with_origin) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "with-origin", NULL, 0, NULL));
+        if (i == *count) {
+            tmp = realloc(*decls, (*count + 1) * sizeof **decls);
+            NC_CHECK_ERRMEM_RET(!tmp, -1);
+            *decls = tmp;
+            ++(*count);
         }
+        (*decls)[i].attr = name;
+        (*decls)[i].attr_len = str - name;
+        (*decls)[i].name_len = name_len;
+    }
 
-        if (rpc_getd->wd_mode) {
-            /* "with-defaults" are used from a grouping so it belongs to the ietf-netconf-nmda module */
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "with-defaults", nc_wd2str(rpc_getd->wd_mode), 0, NULL));
+    return 0;
+}
+
+/**
+ * @brief Find the namespace declared for a prefix.
+ *
+ * @param[in] decls Namespace declarations.
+ * @param[in] decl_count Count of @p decls.
+ * @param[in] prefix Prefix, NULL for the default namespace.
+ * @param[in] prefix_len Length of @p prefix.
+ * @return Declared namespace, NULL if not declared or on error.
+ */
+static char *
+nc_xml_nsdecl_find(const struct nc_xml_nsdecl *decls, uint32_t decl_count, const char *prefix, uint32_t prefix_len)
+{
+    const char *value;
+    uint32_t i;
+
+    for (i = 0; i < decl_count; ++i) {
+        if (prefix && (decls[i].name_len == 6 + prefix_len) && !strncmp(decls[i].attr + 6, prefix, prefix_len)) {
+            break;
+        } else if (!prefix && (decls[i].name_len == 5)) {
+            break;
         }
-        break;
+    }
+    if (i == decl_count) {
+        return NULL;
+    }
 
-    case NC_RPC_EDITDATA:
-        rpc_editd = (struct nc_rpc_editdata *)rpc;
+    /* skip "=" and the quote */
+    value = decls[i].attr + decls[i].name_len;
+    value += strspn(value, " \t\r\n=");
+    ++value;
+    return strndup(value, decls[i].attr + decls[i].attr_len - 1 - value);
+}
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "edit-data", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "datastore", rpc_editd->datastore, 0, NULL));
+/**
+ * @brief Learn whether a top-level data element is a container in the session context.
+ *
+ * @param[in] session Client session.
+ * @param[in] elem Start tag of the element.
+ * @param[in] decls Inherited namespace declarations.
+ * @param[in] decl_count Count of @p decls.
+ * @return Whether the element is a container.
+ */
+static int
+nc_recv_reply_stream_is_cont(struct nc_session *session, const char *elem, const struct nc_xml_nsdecl *decls,
+        uint32_t decl_count)
+{
+    const char *name = elem + 1, *prefix = NULL, *colon;
+    uint32_t name_len = nc_xml_name_len(elem), prefix_len = 0, own_decl_count = 0;
+    struct nc_xml_nsdecl *own_decls = NULL;
+    const struct lys_module *mod;
+    const struct lysc_node *snode = NULL;
+    char *ns = NULL;
 
-        if (rpc_editd->default_op) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "default-operation", rpcedit_dfltop2str[rpc_editd->default_op], 0,
-                    NULL));
-        }
-        if (!rpc_editd->edit_cont[0] || (rpc_editd->edit_cont[0] == '<')) {
-            CHECK_LYRC_BREAK(lyd_new_any(data, mod, "config", rpc_editd->edit_cont, LYD_ANYDATA_XML, 0, NULL));
-        } else {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "url", rpc_editd->edit_cont, 0, NULL));
-        }
-        break;
+    colon = memchr(name, ':', name_len);
+    if (colon) {
+        prefix = name;
+        prefix_len = colon - name;
+        name_len -= prefix_len + 1;
+        name = colon + 1;
+    }
 
-    case NC_RPC_ESTABLISHSUB:
-        rpc_estsub = (struct nc_rpc_establishsub *)rpc;
+    /* find the namespace of the element, its own declarations first */
+    if (!nc_xml_nsdecls_add(elem, &own_decls, &own_decl_count)) {
+        ns = nc_xml_nsdecl_find(own_decls, own_decl_count, prefix, prefix_len);
+    }
+    if (!ns) {
+        ns = nc_xml_nsdecl_find(decls, decl_count, prefix, prefix_len);
+    }
+    free(own_decls);
+    if (!ns) {
+        return 0;
+    }
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "establish-subscription", 0, &data));
+    /* CTX READ LOCK */
+    nc_client_lazy_ctx_rdlock(session);
+    mod = ly_ctx_get_module_implemented_ns(session->ctx, ns);
+    if (mod) {
+        snode = lys_find_child(NULL, mod, name, name_len, 0, 0);
+    }
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
 
-        if (rpc_estsub->filter) {
-            if (!rpc_estsub->filter[0] || (rpc_estsub->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "stream-subtree-filter", rpc_estsub->filter, LYD_ANYDATA_XML,
-                        0, NULL));
-            } else if (rpc_estsub->filter[0] == '/') {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-xpath-filter", rpc_estsub->filter, 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-filter-name", rpc_estsub->filter, 0, NULL));
+    free(ns);
+    return (snode && (snode->nodetype == LYS_CONTAINER)) ? 1 : 0;
+}
+
+/**
+ * @brief Parse a part of the reply data and pass it to the callback.
+ *
+ * @param[in] session Client session.
+ * @param[in] elem Start tag of the top-level element.
+ * @param[in] elem_tag_end End of the start tag of the top-level element.
+ * @param[in] decls Inherited namespace declarations.
+ * @param[in] decl_count Count of @p decls.
+ * @param[in] content Content to parse, either the rest of the top-level element or some of its child elements.
+ * @param[in] content_len Length of @p content.
+ * @param[in] wrap Whether to close the top-level element after @p content.
+ * @param[in] clb Callback to call.
+ * @param[in] user_data Arbitrary user data for @p clb.
+ * @return 0 on success.
+ * @return 1 if the callback asked to stop.
+ * @return -1 on error.
+ */
+static int
+nc_recv_reply_stream_part(struct nc_session *session, const char *elem, const char *elem_tag_end,
+        const struct nc_xml_nsdecl *decls, uint32_t decl_count, const char *content, size_t content_len, int wrap,
+        nc_reply_subtree_clb clb, void *user_data)
+{
+    int ret = -1;
+    NC_CLIENT_PARSE_MODE mode = session->opts.client.parse_mode;
+    struct nc_xml_nsdecl *own_decls = NULL;
+    uint32_t own_decl_count = 0, name_len, i, j;
+    char *part = NULL, *ptr;
+    size_t len;
+    struct ly_in *in = NULL;
+    struct lyd_node *tree = NULL;
+    uint32_t parse_opts;
+    struct timespec ts_start;
+
+    /* learn the declarations of the element itself, they must not be repeated */
+    if (nc_xml_nsdecls_add(elem, &own_decls, &own_decl_count)) {
+        ERR(session, "Failed to parse the start tag of a reply data element.");
+        goto cleanup;
+    }
+
+    /* element start tag with all the inherited namespace declarations */
+    name_len = nc_xml_name_len(elem);
+    len = 1 + name_len + (elem_tag_end - (elem + 1 + name_len)) + content_len + (wrap ? name_len + 3 : 0) + 1;
+    for (i = 0; i < decl_count; ++i) {
+        len += 1 + decls[i].attr_len;
+    }
+    part = malloc(len);
+    NC_CHECK_ERRMEM_GOTO(!part, , cleanup);
+
+    ptr = part;
+    memcpy(ptr, elem, 1 + name_len);
+    ptr += 1 + name_len;
+    for (i = 0; i < decl_count; ++i) {
+        for (j = 0; j < own_decl_count; ++j) {
+            if ((own_decls[j].name_len == decls[i].name_len) && !strncmp(own_decls[j].attr, decls[i].attr,
+                    decls[i].name_len)) {
+                break;
             }
         }
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream", rpc_estsub->stream, 0, NULL));
-
-        if (rpc_estsub->start) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "replay-start-time", rpc_estsub->start, 0, NULL));
+        if (j < own_decl_count) {
+            /* redeclared */
+            continue;
         }
-        if (rpc_estsub->stop) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_estsub->stop, 0, NULL));
+        *ptr++ = ' ';
+        memcpy(ptr, decls[i].attr, decls[i].attr_len);
+        ptr += decls[i].attr_len;
+    }
+    memcpy(ptr, elem + 1 + name_len, elem_tag_end - (elem + 1 + name_len));
+    ptr += elem_tag_end - (elem + 1 + name_len);
+
+    /* content and the end tag */
+    memcpy(ptr, content, content_len);
+    ptr += content_len;
+    if (wrap) {
+        ptr += sprintf(ptr, "</%.*s>", (int)name_len, elem + 1);
+    }
+    *ptr = '\0';
+
+    /* parse it */
+    clock_gettime(COMPAT_CLOCK_ID, &ts_start);
+    ly_in_new_memory(part, &in);
+    if (mode == NC_CLIENT_PARSE_OPAQ) {
+        parse_opts = LYD_PARSE_ONLY | LYD_PARSE_OPAQ;
+        if (lyd_parse_data(session->opts.client.opaq_ctx, NULL, in, LYD_XML, parse_opts, 0, &tree)) {
+            ERR(session, "Received invalid reply data (%s).", ly_err_last(session->opts.client.opaq_ctx)->msg);
+            goto cleanup;
         }
-        if (rpc_estsub->encoding) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "encoding", rpc_estsub->encoding, 0, NULL));
+    } else {
+        parse_opts = LYD_PARSE_ONLY;
+        if (!(session->flags & NC_SESSION_CLIENT_NOT_STRICT)) {
+            parse_opts |= LYD_PARSE_STRICT;
         }
-        break;
 
-    case NC_RPC_MODIFYSUB:
-        rpc_modsub = (struct nc_rpc_modifysub *)rpc;
+        /* CTX READ LOCK */
+        nc_client_lazy_ctx_rdlock(session);
+        if (lyd_parse_data(session->ctx, NULL, in, LYD_XML, parse_opts, 0, &tree)) {
+            ERR(session, "Received invalid reply data (%s).", ly_err_last(session->ctx)->msg);
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "modify-subscription", 0, &data));
+            /* CTX UNLOCK */
+            nc_client_lazy_ctx_unlock(session);
+            goto cleanup;
+        }
 
-        sprintf(str, "%" PRIu32, rpc_modsub->id);
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
+        /* CTX UNLOCK */
+        nc_client_lazy_ctx_unlock(session);
+    }
+    nc_client_parse_stats_add(session, mode, ptr - part, &ts_start);
 
-        if (rpc_modsub->filter) {
-            if (!rpc_modsub->filter[0] || (rpc_modsub->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "stream-subtree-filter", rpc_modsub->filter, LYD_ANYDATA_XML,
-                        0, NULL));
-            } else if (rpc_modsub->filter[0] == '/') {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-xpath-filter", rpc_modsub->filter, 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-filter-name", rpc_modsub->filter, 0, NULL));
-            }
-        }
-        if (rpc_modsub->stop) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_modsub->stop, 0, NULL));
+    /* the callback may take long, do not block loading modules on demand meanwhile */
+    ret = clb(session, tree, user_data) ? 1 : 0;
+
+cleanup:
+    lyd_free_siblings(tree);
+    ly_in_free(in, 0);
+    free(part);
+    free(own_decls);
+    return ret;
+}
+
+/**
+ * @brief Parse the envelopes of a streamed reply.
+ *
+ * @param[in] session Client session.
+ * @param[in] op RPC to parse the reply into.
+ * @param[in] reply Start tag of rpc-reply.
+ * @param[in] reply_tag_end End of the start tag of rpc-reply.
+ * @param[in] data Start tag of data.
+ * @param[in] data_tag_end End of the start tag of data.
+ * @param[in] data_empty Whether data is an empty-element tag.
+ * @param[in] msgid Expected message ID.
+ * @param[out] envp Parsed envelopes.
+ * @return NC_MSG_REPLY on success, NC_MSG_REPLY_ERR_MSGID on a message-id mismatch, NC_MSG_ERROR on error.
+ */
+static NC_MSG_TYPE
+nc_recv_reply_stream_envp(struct nc_session *session, struct lyd_node *op, const char *reply, const char *reply_tag_end,
+        const char *data, const char *data_tag_end, int data_empty, uint64_t msgid, struct lyd_node **envp)
+{
+    int r;
+    char *str;
+    struct ly_in *in;
+    LY_ERR lyrc;
+
+    /* reply without any data */
+    if (data_empty) {
+        r = asprintf(&str, "%.*s%.*s</%.*s>", (int)(reply_tag_end - reply), reply, (int)(data_tag_end - data), data,
+                (int)nc_xml_name_len(reply), reply + 1);
+    } else {
+        r = asprintf(&str, "%.*s%.*s</%.*s></%.*s>", (int)(reply_tag_end - reply), reply, (int)(data_tag_end - data),
+                data, (int)nc_xml_name_len(data), data + 1, (int)nc_xml_name_len(reply), reply + 1);
+    }
+    NC_CHECK_ERRMEM_RET(r == -1, NC_MSG_ERROR);
+
+    ly_in_new_memory(str, &in);
+    lyrc = nc_client_parse_msg(session, in, op, envp, NULL);
+    ly_in_free(in, 0);
+    free(str);
+
+    if (*envp) {
+        /* check the message-id, even on error */
+        return recv_reply_check_msgid(session, *envp, msgid);
+    }
+
+    ERR(session, "Received an invalid message (%s).", lyrc ? ly_err_last(nc_client_parse_err_ctx(session))->msg :
+            "no envelopes");
+    return NC_MSG_ERROR;
+}
+
+/**
+ * @brief Pass the parsed output of an RPC to the callback, one node at a time.
+ *
+ * @param[in] session Client session.
+ * @param[in] op RPC with the output, it is freed.
+ * @param[in] clb Callback to call.
+ * @param[in] user_data Arbitrary user data for @p clb.
+ */
+static void
+nc_recv_reply_stream_output(struct nc_session *session, struct lyd_node *op, nc_reply_subtree_clb clb, void *user_data)
+{
+    struct lyd_node *node;
+    int r = 0;
+
+    while (!r && (node = lyd_child(op))) {
+        lyd_unlink_tree(node);
+        r = clb(session, node, user_data);
+        lyd_free_tree(node);
+    }
+    lyd_free_tree(op);
+}
+
+/**
+ * @brief Reply being received and its data passed to a callback in parts.
+ */
+struct nc_reply_stream {
+    struct nc_session *session;     /**< client session */
+    struct nc_rpc *rpc;             /**< sent RPC */
+    uint64_t msgid;                 /**< expected message ID */
+    uint32_t batch;                 /**< maximum number of container children in a part */
+    nc_reply_subtree_clb clb;       /**< callback for the parts */
+    void *user_data;                /**< arbitrary user data for clb */
+    int reading;                    /**< the message is being read from the wire, MSGS lock is held */
+
+    enum {
+        NC_REPLY_STREAM_START = 0,  /**< the start tags of the message are being waited for */
+        NC_REPLY_STREAM_DATA,       /**< top-level data elements are being passed */
+        NC_REPLY_STREAM_CONT,       /**< children of a top-level container are being passed in batches */
+        NC_REPLY_STREAM_SKIP,       /**< the rest of the message is skipped */
+        NC_REPLY_STREAM_OTHER       /**< the message is not a reply to stream, it is kept whole */
+    } state;                        /**< processing state */
+    NC_MSG_TYPE ret;                /**< result of processing the reply */
+    struct lyd_node *envp;          /**< parsed envelopes */
+    char *tags;                     /**< copy of the rpc-reply and data start tags */
+    struct nc_xml_nsdecl *decls;    /**< namespace declarations inherited by all the data, point into tags */
+    uint32_t decl_count;            /**< count of decls */
+    char *cont;                     /**< copy of the start tag of the container whose children are being passed */
+    char *msg;                      /**< whole message kept in the ::NC_REPLY_STREAM_OTHER state */
+};
+
+/**
+ * @brief Learn whether a reply is awaited by an asynchronously sent RPC, MSGS lock is expected to be held.
+ *
+ * @param[in] session Client session.
+ * @param[in] msg Start of the reply.
+ * @return Whether the reply is to be routed to its RPC.
+ */
+static int
+nc_recv_reply_stream_is_pending(struct nc_session *session, const char *msg)
+{
+    struct nc_rpc_pending *pending;
+    uint64_t msgid;
+
+    if (!session->opts.client.pending || get_msg_msgid(msg, &msgid)) {
+        return 0;
+    }
+
+    pending = nc_rpc_pending_find(session, msgid);
+    return (pending && !pending->msg) ? 1 : 0;
+}
+
+/**
+ * @brief Handle missing data of a streamed reply.
+ *
+ * @param[in] st Reply being received.
+ * @param[in] last Whether all the data of the message were read.
+ * @return 0 to wait for more data, -1 if there are none.
+ */
+static int
+nc_recv_reply_stream_more(struct nc_reply_stream *st, int last)
+{
+    if (!last) {
+        return 0;
+    }
+
+    ERR(st->session, "Received an invalid <rpc-reply>.");
+    return -1;
+}
+
+/**
+ * @brief Handle the result of passing a part of the data to the callback.
+ *
+ * @param[in] st Reply being received.
+ * @param[in] r Result of ::nc_recv_reply_stream_part().
+ * @return 1 to continue, -1 on error.
+ */
+static int
+nc_recv_reply_stream_passed(struct nc_reply_stream *st, int r)
+{
+    if (r == -1) {
+        return -1;
+    } else if (r) {
+        /* the callback asked to stop */
+        st->state = NC_REPLY_STREAM_SKIP;
+    }
+    return 1;
+}
+
+/**
+ * @brief Parse a reply without any data to stream at once and pass its output nodes to the callback.
+ *
+ * @param[in] st Reply being received.
+ * @param[in] data Whole reply.
+ * @return 1 on success, -1 on error.
+ */
+static int
+nc_recv_reply_stream_whole(struct nc_reply_stream *st, const char *data)
+{
+    struct nc_session *session = st->session;
+    struct ly_in *in;
+    struct lyd_node *op;
+
+    st->state = NC_REPLY_STREAM_SKIP;
+
+    /* get a duplicate of the RPC node to parse the reply into, CTX READ LOCK */
+    if (recv_reply_prepare(session, st->rpc, data, &op)) {
+        return -1;
+    }
+
+    ly_in_new_memory(data, &in);
+    st->ret = recv_reply_parse(session, in, op, st->msgid, &st->envp);
+    ly_in_free(in, 0);
+    if ((st->ret != NC_MSG_REPLY) && (st->ret != NC_MSG_REPLY_ERR_MSGID)) {
+        lyd_free_tree(op);
+        op = NULL;
+    }
+
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
+
+    if (op) {
+        nc_recv_reply_stream_output(session, op, st->clb, st->user_data);
+    }
+    return (st->ret == NC_MSG_ERROR) ? -1 : 1;
+}
+
+/**
+ * @brief Process the start tags of a reply and parse its envelopes.
+ *
+ * @param[in] st Reply being received.
+ * @param[in] data Received data of the message.
+ * @param[in] last Whether all the data of the message were read.
+ * @param[out] pos Position after the processed data.
+ * @return 1 if processed, 0 to wait for more data, -1 on error.
+ */
+static int
+nc_recv_reply_stream_start(struct nc_reply_stream *st, const char *data, int last, const char **pos)
+{
+    struct nc_session *session = st->session;
+    const char *reply, *reply_tag_end, *elem = NULL, *elem_tag_end = NULL;
+    struct lyd_node *op;
+    uint32_t reply_len;
+    int empty, data_empty = 0;
+
+    /* find rpc-reply and its first child */
+    reply = nc_xml_next_tag(data);
+    reply_tag_end = reply ? nc_xml_tag_end(reply, &empty) : NULL;
+    if (reply_tag_end && !empty) {
+        elem = nc_xml_next_tag(reply_tag_end);
+        elem_tag_end = elem ? nc_xml_tag_end(elem, &data_empty) : NULL;
+    }
+    if (!last && (!reply_tag_end || (!empty && !elem_tag_end))) {
+        /* wait for the start tags */
+        return 0;
+    }
+
+    if (st->reading && (!reply_tag_end || !nc_xml_name_is(reply, "rpc-reply") ||
+            nc_recv_reply_stream_is_pending(session, data))) {
+        /* a notification or a reply to an asynchronously sent RPC */
+        st->state = NC_REPLY_STREAM_OTHER;
+        return 1;
+    }
+
+    if (!elem_tag_end || (elem[1] == '/') || !nc_xml_name_is(elem, "data")) {
+        /* no data to stream, parse the reply at once */
+        if (!last) {
+            return 0;
+        }
+        *pos = data + strlen(data);
+        return nc_recv_reply_stream_whole(st, data);
+    }
+
+    /* keep the start tags, the namespace declarations inherited by all the data point into them */
+    reply_len = reply_tag_end - reply;
+    if (asprintf(&st->tags, "%.*s%.*s", (int)reply_len, reply, (int)(elem_tag_end - elem), elem) == -1) {
+        ERRMEM;
+        st->tags = NULL;
+        return -1;
+    }
+
+    /* get a duplicate of the RPC node to parse the envelopes into, CTX READ LOCK */
+    if (recv_reply_prepare(session, st->rpc, data, &op)) {
+        return -1;
+    }
+
+    /* parse the envelopes and check the message-id, the RPC node is not needed for the data */
+    st->ret = nc_recv_reply_stream_envp(session, op, reply, reply_tag_end, elem, elem_tag_end, data_empty, st->msgid,
+            &st->envp);
+    lyd_free_tree(op);
+
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
+
+    if ((st->ret != NC_MSG_REPLY) && (st->ret != NC_MSG_REPLY_ERR_MSGID)) {
+        return -1;
+    } else if (data_empty) {
+        st->state = NC_REPLY_STREAM_SKIP;
+        return 1;
+    }
+
+    /* namespaces declared for all the data */
+    if (nc_xml_nsdecls_add(st->tags, &st->decls, &st->decl_count) ||
+            nc_xml_nsdecls_add(st->tags + reply_len, &st->decls, &st->decl_count)) {
+        ERR(session, "Received an invalid <rpc-reply>.");
+        return -1;
+    }
+
+    *pos = elem_tag_end;
+    st->state = NC_REPLY_STREAM_DATA;
+    return 1;
+}
+
+/**
+ * @brief Pass the next top-level data element, or start passing the children of a container.
+ *
+ * @param[in] st Reply being received.
+ * @param[in] last Whether all the data of the message were read.
+ * @param[in,out] pos Position in the received data, moved after the processed data.
+ * @return 1 if processed, 0 to wait for more data, -1 on error.
+ */
+static int
+nc_recv_reply_stream_elem(struct nc_reply_stream *st, int last, const char **pos)
+{
+    struct nc_session *session = st->session;
+    const char *elem, *elem_tag_end, *elem_end;
+    int empty, r;
+
+    elem = nc_xml_next_tag(*pos);
+    if (!elem) {
+        return nc_recv_reply_stream_more(st, last);
+    } else if (elem[1] == '/') {
+        /* end of data */
+        st->state = NC_REPLY_STREAM_SKIP;
+        return 1;
+    }
+
+    elem_tag_end = nc_xml_tag_end(elem, &empty);
+    if (!elem_tag_end) {
+        return nc_recv_reply_stream_more(st, last);
+    }
+
+    if (st->batch && !empty && ((session->opts.client.parse_mode == NC_CLIENT_PARSE_OPAQ) ||
+            nc_recv_reply_stream_is_cont(session, elem, st->decls, st->decl_count))) {
+        /* the child elements in batches, each wrapped in the top-level element */
+        st->cont = strndup(elem, elem_tag_end - elem);
+        NC_CHECK_ERRMEM_RET(!st->cont, -1);
+        *pos = elem_tag_end;
+        st->state = NC_REPLY_STREAM_CONT;
+        return 1;
+    }
+
+    /* the whole subtree */
+    elem_end = nc_xml_elem_end(elem);
+    if (!elem_end) {
+        return nc_recv_reply_stream_more(st, last);
+    }
+    r = nc_recv_reply_stream_part(session, elem, elem_tag_end, st->decls, st->decl_count, elem_tag_end,
+            elem_end - elem_tag_end, 0, st->clb, st->user_data);
+    *pos = elem_end;
+    return nc_recv_reply_stream_passed(st, r);
+}
+
+/**
+ * @brief Pass the next batch of the children of a top-level container.
+ *
+ * @param[in] st Reply being received.
+ * @param[in] last Whether all the data of the message were read.
+ * @param[in,out] pos Position in the received data, moved after the processed data.
+ * @return 1 if processed, 0 to wait for more data, -1 on error.
+ */
+static int
+nc_recv_reply_stream_batch(struct nc_reply_stream *st, int last, const char **pos)
+{
+    const char *first, *next, *end = NULL, *next_end;
+    uint32_t count = 0;
+    int complete = 0, r;
+
+    first = nc_xml_next_tag(*pos);
+    if (!first) {
+        return nc_recv_reply_stream_more(st, last);
+    } else if (first[1] == '/') {
+        /* end of the container */
+        end = nc_xml_tag_end(first, NULL);
+        if (!end) {
+            return nc_recv_reply_stream_more(st, last);
+        }
+        free(st->cont);
+        st->cont = NULL;
+        *pos = end;
+        st->state = NC_REPLY_STREAM_DATA;
+        return 1;
+    }
+
+    /* a batch is complete once it is full or followed by the end of the container */
+    next = first;
+    while ((next_end = nc_xml_elem_end(next))) {
+        end = next_end;
+        if (++count == st->batch) {
+            complete = 1;
+            break;
+        }
+
+        next = nc_xml_next_tag(end);
+        if (!next) {
+            break;
+        } else if (next[1] == '/') {
+            complete = 1;
+            break;
+        }
+    }
+    if (!complete) {
+        return nc_recv_reply_stream_more(st, last);
+    }
+
+    r = nc_recv_reply_stream_part(st->session, st->cont, st->cont + strlen(st->cont), st->decls, st->decl_count, first,
+            end - first, 1, st->clb, st->user_data);
+    *pos = end;
+    return nc_recv_reply_stream_passed(st, r);
+}
+
+/**
+ * @brief Process the received data of a reply, callback for ::nc_read_msg_poll_stream_io().
+ *
+ * Every complete top-level data subtree (or batch of container children) is parsed and passed on,
+ * the incomplete rest is left for the next call.
+ *
+ * @param[in] data Received data of the message not processed yet.
+ * @param[in] len Length of @p data.
+ * @param[in] last Whether all the data of the message were read.
+ * @param[in] clb_data Reply being received.
+ * @return Number of processed bytes, -1 on error.
+ */
+static ssize_t
+nc_recv_reply_stream_clb(const char *data, size_t len, int last, void *clb_data)
+{
+    struct nc_reply_stream *st = clb_data;
+    const char *pos = data;
+    int r = 0;
+
+    do {
+        switch (st->state) {
+        case NC_REPLY_STREAM_START:
+            r = nc_recv_reply_stream_start(st, data, last, &pos);
+            break;
+        case NC_REPLY_STREAM_DATA:
+            r = nc_recv_reply_stream_elem(st, last, &pos);
+            break;
+        case NC_REPLY_STREAM_CONT:
+            r = nc_recv_reply_stream_batch(st, last, &pos);
+            break;
+        case NC_REPLY_STREAM_SKIP:
+            pos = data + len;
+            r = 0;
+            break;
+        case NC_REPLY_STREAM_OTHER:
+            if (last) {
+                /* keep the whole message */
+                st->msg = strndup(data, len);
+                NC_CHECK_ERRMEM_GOTO(!st->msg, r = -1, cleanup);
+                pos = data + len;
+            }
+            r = 0;
+            break;
+        }
+    } while (r == 1);
+
+cleanup:
+    if (r == -1) {
+        st->ret = NC_MSG_ERROR;
+        st->state = NC_REPLY_STREAM_SKIP;
+        return -1;
+    }
+    return pos - data;
+}
+
+/**
+ * @brief Receive a reply and process its data while it is being read, works as ::recv_msg().
+ *
+ * A reply that was already buffered is processed whole. Any other read messages are buffered, or routed
+ * if they are replies to asynchronously sent RPCs.
+ *
+ * @param[in] session Client session.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite.
+ * @param[in] st Reply being received.
+ * @return NC_MSG_REPLY If a rpc-reply was processed, the result is in @p st;
+ * @return NC_MSG_NOTIF If a notification was received;
+ * @return NC_MSG_ERROR If any error occurred;
+ * @return NC_MSG_WOULDBLOCK If the timeout was reached.
+ */
+static NC_MSG_TYPE
+recv_reply_stream(struct nc_session *session, int timeout, struct nc_reply_stream *st)
+{
+    struct ly_in *msg = NULL;
+    struct timespec ts_timeout = {0};
+    NC_MSG_TYPE ret = NC_MSG_ERROR;
+    int r;
+
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (!r) {
+        return NC_MSG_WOULDBLOCK;
+    } else if (r == -1) {
+        return NC_MSG_ERROR;
+    }
+
+    /* use the oldest buffered reply, if any */
+    msg = recv_msg_queue_pop(session, &session->opts.client.replies);
+    if (msg) {
+        ret = NC_MSG_REPLY;
+        goto cleanup_unlock;
+    }
+
+    if (timeout > 0) {
+        nc_timeouttime_get(&ts_timeout, timeout);
+    }
+
+    st->reading = 1;
+    while (1) {
+        /* read a message from the wire, a reply is processed while being read */
+        r = nc_read_msg_poll_stream_io(session, timeout, nc_recv_reply_stream_clb, st);
+        if (!r) {
+            ret = NC_MSG_WOULDBLOCK;
+            goto cleanup_unlock;
+        } else if (r < 0) {
+            ret = NC_MSG_ERROR;
+            goto cleanup_unlock;
         }
+
+        /* the transport may have read the beginning of another message */
+        nc_client_notif_wakeup_buffered(session);
+
+        if (!st->msg) {
+            /* reply processed */
+            ret = NC_MSG_REPLY;
+            break;
+        }
+
+        /* the message was read whole */
+        if (ly_in_new_memory(st->msg, &msg)) {
+            goto cleanup_unlock;
+        }
+        st->msg = NULL;
+        st->state = NC_REPLY_STREAM_START;
+
+        ret = get_msg_type(session, msg);
+        if (ret == NC_MSG_ERROR) {
+            ly_in_free(msg, 1);
+            msg = NULL;
+            goto cleanup_unlock;
+        } else if (ret == NC_MSG_REPLY) {
+            if (!recv_msg_route_reply(session, msg)) {
+                /* process it whole */
+                break;
+            }
+            msg = NULL;
+
+            /* reply to an asynchronously sent RPC was routed, keep reading for the rest of the timeout */
+            if (timeout > 0) {
+                timeout = nc_timeouttime_cur_diff(&ts_timeout);
+                if (timeout < 1) {
+                    ret = NC_MSG_WOULDBLOCK;
+                    goto cleanup_unlock;
+                }
+            }
+            continue;
+        }
+
+        /* store the notification in the buffer */
+        if (recv_msg_buffer(session, msg, ret)) {
+            ret = NC_MSG_ERROR;
+        }
+        msg = NULL;
         break;
+    }
+
+cleanup_unlock:
+    st->reading = 0;
+
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+
+    if (msg) {
+        /* a whole reply */
+        nc_recv_reply_stream_clb(ly_in_memory(msg, NULL), strlen(ly_in_memory(msg, NULL)), 1, st);
+        ly_in_free(msg, 1);
+    }
+    return ret;
+}
+
+API NC_MSG_TYPE
+nc_recv_reply_stream(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout, uint32_t batch,
+        nc_reply_subtree_clb clb, void *user_data, struct lyd_node **envp)
+{
+    NC_MSG_TYPE ret;
+    struct ly_in *msg = NULL;
+    struct nc_reply_stream st = {0};
+
+    NC_CHECK_ARG_RET(session, session, rpc, clb, envp, NC_MSG_ERROR);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive RPC replies.");
+        return NC_MSG_ERROR;
+    }
+
+    *envp = NULL;
+
+    /* make sure the RPC modules are in the context */
+    if (recv_reply_load_rpc(session, rpc)) {
+        return NC_MSG_ERROR;
+    }
+
+    st.session = session;
+    st.rpc = rpc;
+    st.msgid = msgid;
+    st.batch = batch;
+    st.clb = clb;
+    st.user_data = user_data;
+    st.ret = NC_MSG_REPLY;
+
+    if (nc_client_lazy_ctx_active(session)) {
+        /* modules may need to be loaded on demand using the session, receive the whole reply first */
+        ret = recv_msg(session, timeout, NC_MSG_REPLY, &msg);
+        if (ret == NC_MSG_REPLY) {
+            nc_recv_reply_stream_clb(ly_in_memory(msg, NULL), strlen(ly_in_memory(msg, NULL)), 1, &st);
+        }
+        ly_in_free(msg, 1);
+    } else {
+        ret = recv_reply_stream(session, timeout, &st);
+    }
+    if (ret == NC_MSG_REPLY) {
+        ret = st.ret;
+    }
+
+    if (ret == NC_MSG_ERROR) {
+        lyd_free_tree(st.envp);
+    } else {
+        *envp = st.envp;
+    }
+    free(st.tags);
+    free(st.decls);
+    free(st.cont);
+    free(st.msg);
+    return ret;
+}
+
+/**
+ * @brief Remember the operation of an RPC sent asynchronously.
+ *
+ * The operation node itself cannot be stored because loading modules on demand may recompile the context
+ * before the reply arrives.
+ *
+ * @param[in] session Client session.
+ * @param[in] rpc Sent RPC.
+ * @param[in] pending Pending RPC to store the operation in.
+ * @return 0 on success, -1 on error.
+ */
+static int
+recv_reply_pending_store_rpc(struct nc_session *session, struct nc_rpc *rpc, struct nc_rpc_pending *pending)
+{
+    struct nc_rpc_act_generic *rpc_gen;
+    LY_ERR lyrc;
+
+    /* make sure the RPC modules are in the context */
+    if (recv_reply_load_rpc(session, rpc)) {
+        return -1;
+    }
+
+    pending->rpc_type = rpc->type;
+    if (rpc->type != NC_RPC_ACT_GENERIC) {
+        return 0;
+    }
+
+    rpc_gen = (struct nc_rpc_act_generic *)rpc;
+    if (rpc_gen->has_data) {
+        /* CTX READ LOCK */
+        nc_client_lazy_ctx_rdlock(session);
+        lyrc = lyd_print_mem(&pending->rpc_xml, rpc_gen->content.data, LYD_XML,
+                LYD_PRINT_SHRINK | LYD_PRINT_WITHSIBLINGS);
+        /* CTX UNLOCK */
+        nc_client_lazy_ctx_unlock(session);
+        if (lyrc) {
+            ERR(session, "Failed to print the RPC.");
+            return -1;
+        }
+    } else {
+        pending->rpc_xml = strdup(rpc_gen->content.xml_str);
+        NC_CHECK_ERRMEM_RET(!pending->rpc_xml, -1);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Parse the reply of a pending RPC.
+ *
+ * @param[in] session Client session.
+ * @param[in] pending Pending RPC with a received reply.
+ * @param[out] envp NETCONF rpc-reply XML envelopes.
+ * @param[out] op Parsed NETCONF reply data, if any.
+ * @return NC_MSG_REPLY on success, NC_MSG_ERROR on error.
+ */
+static NC_MSG_TYPE
+recv_reply_pending_parse(struct nc_session *session, struct nc_rpc_pending *pending, struct lyd_node **envp,
+        struct lyd_node **op)
+{
+    LY_ERR lyrc;
+    NC_MSG_TYPE ret = NC_MSG_REPLY;
+    struct nc_rpc_act_generic rpc = {0};
+
+    *envp = NULL;
+    *op = NULL;
+
+    /* only the type is used for a standard RPC */
+    rpc.type = pending->rpc_type;
+    rpc.content.xml_str = pending->rpc_xml;
+
+    /* get a duplicate of the RPC node to append the reply to, CTX READ LOCK */
+    if (recv_reply_load_rpc(session, (struct nc_rpc *)&rpc) ||
+            recv_reply_prepare(session, (struct nc_rpc *)&rpc, ly_in_memory(pending->msg, NULL), op)) {
+        return NC_MSG_ERROR;
+    }
+
+    /* parse */
+    lyrc = nc_client_parse_msg(session, pending->msg, *op, envp, NULL);
+
+    if (lyrc && !*envp) {
+        /* parsing error, the message-id was already matched if the envelopes were parsed */
+        ERR(session, "Received an invalid message (%s).", ly_err_last(nc_client_parse_err_ctx(session))->msg);
+        ret = NC_MSG_ERROR;
+    }
+
+    /* do not return the RPC copy on error or if the reply includes no data */
+    if ((ret != NC_MSG_REPLY) || !lyd_child(*op)) {
+        lyd_free_tree(*op);
+        *op = NULL;
+    }
+
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
+
+    return ret;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc_async(struct nc_session *session, struct nc_rpc *rpc, int timeout, nc_rpc_reply_clb reply_clb,
+        void *user_data, uint64_t *msgid)
+{
+    NC_MSG_TYPE ret;
+    struct nc_rpc_pending *pending;
+    int r;
+
+    NC_CHECK_ARG_RET(session, session, rpc, msgid, NC_MSG_ERROR);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to send RPCs.");
+        return NC_MSG_ERROR;
+    }
+
+    pending = calloc(1, sizeof *pending);
+    NC_CHECK_ERRMEM_RET(!pending, NC_MSG_ERROR);
+    pending->reply_clb = reply_clb;
+    pending->user_data = user_data;
+
+    /* remember the RPC operation to parse the reply into */
+    if (recv_reply_pending_store_rpc(session, rpc, pending)) {
+        nc_rpc_pending_free(pending);
+        return NC_MSG_ERROR;
+    }
+
+    /* MSGS LOCK, the reply must not be read before the RPC is stored */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (!r) {
+        ret = NC_MSG_WOULDBLOCK;
+        goto cleanup;
+    } else if (r == -1) {
+        ret = NC_MSG_ERROR;
+        goto cleanup;
+    }
+
+    if (!session->opts.client.pending) {
+        session->opts.client.pending = lyht_new(8, sizeof pending, nc_rpc_pending_equal, NULL, 1);
+        NC_CHECK_ERRMEM_GOTO(!session->opts.client.pending, ret = NC_MSG_ERROR, cleanup_unlock);
+    }
+
+    /* send the RPC */
+    ret = nc_send_rpc(session, rpc, timeout, &pending->msgid);
+    if (ret != NC_MSG_RPC) {
+        goto cleanup_unlock;
+    }
+
+    /* store it */
+    if (lyht_insert(session->opts.client.pending, &pending, nc_rpc_pending_hash(pending->msgid), NULL)) {
+        ERR(session, "Failed to store RPC with message-id %" PRIu64 ".", pending->msgid);
+        ret = NC_MSG_ERROR;
+        goto cleanup_unlock;
+    }
+    *msgid = pending->msgid;
+    pending = NULL;
+
+cleanup_unlock:
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+
+cleanup:
+    nc_rpc_pending_free(pending);
+    return ret;
+}
+
+API int
+nc_recv_reply_dispatch(struct nc_session *session, int timeout)
+{
+    struct nc_rpc_pending *ready, *pending;
+    struct lyd_node *envp, *op;
+    struct ly_in *msg;
+    NC_MSG_TYPE type;
+    int r, count = 0;
+
+    NC_CHECK_ARG_RET(session, session, -1);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive RPC replies.");
+        return -1;
+    }
+
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (r < 1) {
+        return r;
+    }
+
+    if (!session->opts.client.ready) {
+        /* read a message, store it if it is not a routed reply */
+        r = recv_msg_read(session, timeout, &msg, &type);
+        if ((r == 1) && msg && recv_msg_buffer(session, msg, type)) {
+            r = -1;
+        }
+        if (r == -1) {
+            /* MSGS UNLOCK */
+            nc_session_client_msgs_unlock(session, __func__);
+            return -1;
+        }
+    }
+
+    /* take all the received replies */
+    ready = session->opts.client.ready;
+    session->opts.client.ready = NULL;
+    session->opts.client.ready_last = NULL;
+    for (pending = ready; pending; pending = pending->next) {
+        lyht_remove(session->opts.client.pending, &pending, nc_rpc_pending_hash(pending->msgid));
+    }
+
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+
+    /* call the callbacks without any lock */
+    while (ready) {
+        pending = ready;
+        ready = ready->next;
+
+        type = recv_reply_pending_parse(session, pending, &envp, &op);
+        pending->reply_clb(session, pending->msgid, type, envp, op, pending->user_data);
+
+        lyd_free_tree(envp);
+        lyd_free_tree(op);
+        nc_rpc_pending_free(pending);
+        ++count;
+    }
+
+    return count;
+}
+
+API NC_MSG_TYPE
+nc_recv_reply_async(struct nc_session *session, uint64_t msgid, int timeout, struct lyd_node **envp,
+        struct lyd_node **op)
+{
+    struct nc_rpc_pending *pending;
+    struct ly_in *msg;
+    struct timespec ts_timeout = {0};
+    NC_MSG_TYPE ret = NC_MSG_ERROR, type;
+    int r;
+
+    NC_CHECK_ARG_RET(session, session, envp, op, NC_MSG_ERROR);
+
+    *envp = NULL;
+    *op = NULL;
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive RPC replies.");
+        return NC_MSG_ERROR;
+    }
+
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (!r) {
+        return NC_MSG_WOULDBLOCK;
+    } else if (r == -1) {
+        return NC_MSG_ERROR;
+    }
+
+    pending = nc_rpc_pending_find(session, msgid);
+    if (!pending || pending->reply_clb) {
+        ERR(session, "No RPC with message-id %" PRIu64 " is waiting for its reply.", msgid);
+        goto cleanup_unlock;
+    }
+
+    if (timeout > 0) {
+        nc_timeouttime_get(&ts_timeout, timeout);
+    }
+
+    /* read messages until the reply is routed */
+    while (!pending->msg) {
+        r = recv_msg_read(session, timeout, &msg, &type);
+        if (!r) {
+            ret = NC_MSG_WOULDBLOCK;
+            goto cleanup_unlock;
+        } else if (r == -1) {
+            goto cleanup_unlock;
+        }
+
+        if (msg && recv_msg_buffer(session, msg, type)) {
+            goto cleanup_unlock;
+        }
+
+        if (!pending->msg && (timeout > 0)) {
+            timeout = nc_timeouttime_cur_diff(&ts_timeout);
+            if (timeout < 1) {
+                ret = NC_MSG_WOULDBLOCK;
+                goto cleanup_unlock;
+            }
+        }
+    }
+
+    /* the reply was received */
+    lyht_remove(session->opts.client.pending, &pending, nc_rpc_pending_hash(msgid));
+    ret = NC_MSG_REPLY;
+
+cleanup_unlock:
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+
+    if (ret == NC_MSG_REPLY) {
+        ret = recv_reply_pending_parse(session, pending, envp, op);
+        nc_rpc_pending_free(pending);
+    }
+    return ret;
+}
+
+static NC_MSG_TYPE
+recv_notif(struct nc_session *session, int timeout, struct lyd_node **envp, struct lyd_node **op)
+{
+    LY_ERR lyrc;
+    struct ly_in *msg = NULL;
+    NC_MSG_TYPE ret = NC_MSG_ERROR;
+
+    *op = NULL;
+    *envp = NULL;
+
+    /* Receive messages until a notification is found or a timeout or error reached */
+    ret = recv_msg(session, timeout, NC_MSG_NOTIF, &msg);
+    if (ret != NC_MSG_NOTIF) {
+        goto cleanup;
+    }
+
+    if (session->opts.client.parse_mode == NC_CLIENT_PARSE_SCHEMA) {
+        /* load any missing modules used by the notification */
+        nc_client_lazy_load_ns(session, ly_in_memory(msg, NULL));
+    }
+
+    /* Parse, CTX READ LOCK */
+    nc_client_lazy_ctx_rdlock(session);
+    lyrc = nc_client_parse_msg(session, msg, NULL, envp, op);
+
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
+    if (!lyrc && *op) {
+        goto cleanup;
+    } else {
+        if (lyrc) {
+            ERR(session, "Received an invalid message (%s).", ly_err_last(nc_client_parse_err_ctx(session))->msg);
+        } else {
+            ERR(session, "Received a notification without any content.");
+        }
+        lyd_free_tree(*envp);
+        *envp = NULL;
+        ret = NC_MSG_ERROR;
+        goto cleanup;
+    }
+
+cleanup:
+    ly_in_free(msg, 1);
+    return ret;
+}
+
+API NC_MSG_TYPE
+nc_recv_notif(struct nc_session *session, int timeout, struct lyd_node **envp, struct lyd_node **op)
+{
+    NC_CHECK_ARG_RET(session, session, envp, op, NC_MSG_ERROR);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive Notifications.");
+        return NC_MSG_ERROR;
+    }
+
+    /* receive a notification */
+    return recv_notif(session, timeout, envp, op);
+}
+
+/**
+ * @brief Get the file descriptor of a session.
+ *
+ * @param[in] session Session.
+ *
+ * @return File descriptor of the session or -1 in case of an error.
+ */
+static int
+nc_client_session_get_fd(struct nc_session *session)
+{
+    int fd = -1;
+
+    switch (session->ti_type) {
+    case NC_TI_FD:
+        fd = session->ti.fd.in;
+        break;
+    case NC_TI_UNIX:
+        fd = session->ti.unixsock.sock;
+        break;
+#ifdef NC_ENABLED_SSH_TLS
+    case NC_TI_SSH:
+        fd = ssh_get_fd(session->ti.libssh.session);
+        break;
+    case NC_TI_TLS:
+        fd = nc_tls_get_fd_wrap(session);
+        break;
+#endif /* NC_ENABLED_SSH_TLS */
+    case NC_TI_NONE:
+        /* invalid */
+        break;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Check whether a notification is \<notificationComplete\>.
+ *
+ * @param[in] op Notification body, may be opaque.
+ * @return Whether it is the last notification.
+ */
+static int
+nc_notif_is_complete(const struct lyd_node *op)
+{
+    const struct lyd_node_opaq *opaq;
+
+    if (strcmp(LYD_NAME(op), "notificationComplete")) {
+        return 0;
+    }
+
+    if (op->schema) {
+        return !strcmp(op->schema->module->name, "nc-notifications");
+    }
+
+    /* parsed into an opaque node */
+    opaq = (const struct lyd_node_opaq *)op;
+    return opaq->name.module_ns && !strcmp(opaq->name.module_ns, "urn:ietf:params:xml:ns:netmod:notification");
+}
+
+/**
+ * @brief Learn whether a client session has a notification to receive without waiting for its socket.
+ *
+ * @param[in] session Client session.
+ * @return 1 if a notification is buffered or there are data buffered in the transport;
+ * @return 0 otherwise.
+ */
+static int
+nc_client_session_notif_pending(struct nc_session *session)
+{
+    int r, timeout = 0;
+
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (r != 1) {
+        /* being read by another thread, it wakes the notification threads up if anything is left to receive */
+        return 0;
+    }
+
+    r = session->opts.client.notifs.head ? 1 : nc_client_session_has_buffered(session);
+
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+
+    return r;
+}
+
+/**
+ * @brief Learn whether a client session is being read by another thread after receiving its notifications failed.
+ *
+ * Unread data left in the socket mean that the session was locked by another thread, which reads them.
+ *
+ * @param[in] fd Session socket.
+ * @return Whether the session is busy.
+ */
+static int
+nc_client_session_notif_busy(int fd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return (poll(&pfd, 1, 0) == 1) && (pfd.revents & POLLIN);
+}
+
+/**
+ * @brief Create the pipe waking the notification threads of a client session up, if not created yet.
+ *
+ * @param[in] session Client session.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_client_notif_wakeup_init(struct nc_session *session)
+{
+    int r, ret = 0, timeout = NC_SESSION_LOCK_TIMEOUT;
+
+    if (session->opts.client.ntf_wakeup[0] > -1) {
+        /* already created, it is closed only when the session is freed */
+        return 0;
+    }
+
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (!r) {
+        ERR(session, "Failed to start receiving notifications, the session is busy.");
+        return -1;
+    } else if (r == -1) {
+        return -1;
+    }
+
+    if (session->opts.client.ntf_wakeup[0] > -1) {
+        /* created meanwhile */
+        goto cleanup;
+    }
+
+    /* non-blocking wakeup pipe */
+    if (pipe(session->opts.client.ntf_wakeup)) {
+        ERR(session, "Failed to create the notification wakeup pipe (%s).", strerror(errno));
+        session->opts.client.ntf_wakeup[0] = -1;
+        session->opts.client.ntf_wakeup[1] = -1;
+        ret = -1;
+        goto cleanup;
+    }
+    if ((fcntl(session->opts.client.ntf_wakeup[0], F_SETFL, O_NONBLOCK) == -1) ||
+            (fcntl(session->opts.client.ntf_wakeup[1], F_SETFL, O_NONBLOCK) == -1)) {
+        ERR(session, "Failed to set the notification wakeup pipe non-blocking (%s).", strerror(errno));
+        close(session->opts.client.ntf_wakeup[0]);
+        close(session->opts.client.ntf_wakeup[1]);
+        session->opts.client.ntf_wakeup[0] = -1;
+        session->opts.client.ntf_wakeup[1] = -1;
+        ret = -1;
+        goto cleanup;
+    }
+
+cleanup:
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+    return ret;
+}
+
+static void *
+nc_recv_notif_thread(void *arg)
+{
+    struct nc_ntf_thread_arg *ntarg;
+    struct nc_session *session;
+    nc_notif_dispatch_clb notif_clb;
+    void *user_data;
+
+    void (*free_data)(void *);
+    struct lyd_node *envp, *op;
+    struct pollfd pfds[2];
+    NC_MSG_TYPE msgtype;
+    int fd, done = 0, busy = 0;
+
+    /* detach ourselves */
+    pthread_detach(pthread_self());
+
+    ntarg = (struct nc_ntf_thread_arg *)arg;
+    session = ntarg->session;
+    notif_clb = ntarg->notif_clb;
+    user_data = ntarg->user_data;
+    free_data = ntarg->free_data;
+    free(ntarg);
+
+    fd = nc_client_session_get_fd(session);
+    if (fd == -1) {
+        ERR(session, "Notification thread has no socket to wait on.");
+        done = 1;
+    }
+    pfds[0].events = POLLIN;
+    pfds[1].fd = session->opts.client.ntf_wakeup[0];
+    pfds[1].events = POLLIN;
+
+    while (!done && ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running)) {
+        if (!nc_client_session_notif_pending(session)) {
+            /* wait for data on the session or a wakeup, notifications may also be buffered by other threads,
+             * a busy session is only retried after a while */
+            pfds[0].fd = busy ? -1 : fd;
+            pfds[0].revents = 0;
+            pfds[1].revents = 0;
+            if (nc_poll(pfds, 2, busy ? NC_CLIENT_NOTIF_BUSY_TIMEOUT : -1) == -1) {
+                ERR(session, "Notification thread poll failed (%s).", strerror(errno));
+                break;
+            }
+
+            if (!ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running)) {
+                /* the session is being freed, keep the wakeup for the other threads */
+                break;
+            }
+            if (pfds[1].revents & POLLIN) {
+                nc_client_notif_wakeup_clear(session);
+            }
+        }
+
+        /* receive all the available notifications */
+        do {
+            msgtype = nc_recv_notif(session, 0, &envp, &op);
+            if (msgtype == NC_MSG_NOTIF) {
+                notif_clb(session, envp, op, user_data);
+                done = nc_notif_is_complete(op);
+                lyd_free_all(envp);
+                lyd_free_all(op);
+            } else if ((msgtype == NC_MSG_ERROR) && (session->status != NC_STATUS_RUNNING)) {
+                /* quit this thread once the session is broken */
+                done = 1;
+            }
+        } while (!done && ((msgtype == NC_MSG_NOTIF) || (msgtype == NC_MSG_REPLY)));
+
+        busy = !done && (msgtype == NC_MSG_WOULDBLOCK) && nc_client_session_notif_busy(fd);
+    }
+
+    VRB(session, "Notification thread exit.");
+    if (free_data) {
+        free_data(user_data);
+    }
+
+    /* the session may be freed once no threads are using it */
+    ATOMIC_DEC_RELAXED(session->opts.client.ntf_thread_count);
+
+    return NULL;
+}
+
+API int
+nc_recv_notif_dispatch(struct nc_session *session, nc_notif_dispatch_clb notif_clb)
+{
+    return nc_recv_notif_dispatch_data(session, notif_clb, NULL, NULL);
+}
+
+API int
+nc_recv_notif_dispatch_data(struct nc_session *session, nc_notif_dispatch_clb notif_clb, void *user_data,
+        void (*free_data)(void *))
+{
+    struct nc_ntf_thread_arg *ntarg;
+    pthread_t tid;
+    int ret;
+
+    NC_CHECK_ARG_RET(session, session, notif_clb, -1);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive Notifications.");
+        return -1;
+    }
+
+    if (nc_client_notif_wakeup_init(session)) {
+        return -1;
+    }
+
+    ntarg = malloc(sizeof *ntarg);
+    NC_CHECK_ERRMEM_RET(!ntarg, -1);
+
+    ntarg->session = session;
+    ntarg->notif_clb = notif_clb;
+    ntarg->user_data = user_data;
+    ntarg->free_data = free_data;
+    ATOMIC_INC_RELAXED(session->opts.client.ntf_thread_count);
+
+    /* just so that nc_recv_notif_thread() does not immediately exit */
+    ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 1);
+
+    ret = pthread_create(&tid, NULL, nc_recv_notif_thread, ntarg);
+    if (ret) {
+        ERR(session, "Failed to create a new thread (%s).", strerror(errno));
+        free(ntarg);
+        if (ATOMIC_DEC_RELAXED(session->opts.client.ntf_thread_count) == 1) {
+            ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 0);
+        }
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wake the notification dispatcher thread up.
+ *
+ * @param[in] disp Notification dispatcher.
+ */
+static void
+nc_notif_dispatcher_wakeup(struct nc_notif_dispatcher *disp)
+{
+    char c = 0;
+
+    if ((write(disp->wakeup[1], &c, 1) == -1) && (errno != EAGAIN)) {
+        ERR(NULL, "Failed to wake up the notification dispatcher (%s).", strerror(errno));
+    }
+}
+
+/**
+ * @brief Finish dispatching a session once it was removed and has no jobs left.
+ *
+ * @param[in] dsession Dispatched session to free.
+ */
+static void
+nc_notif_disp_session_finish(struct nc_notif_disp_session *dsession)
+{
+    struct nc_session *session = dsession->session;
+
+    VRB(session, "Notification dispatching finished.");
+    if (dsession->free_data) {
+        dsession->free_data(dsession->user_data);
+    }
+    free(dsession);
+
+    /* the session may be freed once no threads are using it */
+    ATOMIC_DEC_RELAXED(session->opts.client.ntf_thread_count);
+}
+
+/**
+ * @brief Stop dispatching a session.
+ *
+ * @param[in] dsession Dispatched session, may be freed.
+ */
+static void
+nc_notif_disp_session_remove(struct nc_notif_disp_session *dsession)
+{
+    int finish = 1;
+
+    if (dsession->worker) {
+        /* WORKER LOCK */
+        pthread_mutex_lock(&dsession->worker->lock);
+
+        /* the worker finishes it after the last job */
+        dsession->removed = 1;
+        finish = !dsession->jobs;
+
+        /* WORKER UNLOCK */
+        pthread_mutex_unlock(&dsession->worker->lock);
+    }
+
+    if (finish) {
+        nc_notif_disp_session_finish(dsession);
+    }
+}
+
+/**
+ * @brief Pass a received notification to its callback, directly or in a worker.
+ *
+ * @param[in] dsession Dispatched session.
+ * @param[in] envp Notification envelope, is spent.
+ * @param[in] op Notification body, is spent.
+ */
+static void
+nc_notif_disp_session_deliver(struct nc_notif_disp_session *dsession, struct lyd_node *envp, struct lyd_node *op)
+{
+    struct nc_notif_disp_worker *worker = dsession->worker;
+    struct nc_notif_disp_job *job;
+
+    if (worker) {
+        job = malloc(sizeof *job);
+        if (job) {
+            job->dsession = dsession;
+            job->envp = envp;
+            job->op = op;
+            job->next = NULL;
+
+            /* WORKER LOCK */
+            pthread_mutex_lock(&worker->lock);
+
+            if (worker->jobs_last) {
+                worker->jobs_last->next = job;
+            } else {
+                worker->jobs = job;
+            }
+            worker->jobs_last = job;
+            ++dsession->jobs;
+            pthread_cond_signal(&worker->cond);
+
+            /* WORKER UNLOCK */
+            pthread_mutex_unlock(&worker->lock);
+            return;
+        }
+
+        /* call the callback directly rather than losing the notification */
+        ERRMEM;
+    }
+
+    dsession->notif_clb(dsession->session, envp, op, dsession->user_data);
+    lyd_free_all(envp);
+    lyd_free_all(op);
+}
+
+/**
+ * @brief Receive all the available notifications of a dispatched session.
+ *
+ * @param[in] dsession Dispatched session.
+ * @param[in] revents Poll events of the session socket and its notification wakeup pipe.
+ * @return 0 if the session is still to be dispatched;
+ * @return 1 if the session should no longer be dispatched.
+ */
+static int
+nc_notif_disp_session_recv(struct nc_notif_disp_session *dsession, short revents)
+{
+    struct nc_session *session = dsession->session;
+    struct lyd_node *envp, *op;
+    NC_MSG_TYPE msgtype;
+    int done;
+
+    if (!ATOMIC_LOAD_RELAXED(session->opts.client.ntf_thread_running)) {
+        /* session is being freed */
+        return 1;
+    }
+
+    if (!revents && !nc_client_session_notif_pending(session)) {
+        /* nothing to receive */
+        dsession->busy = 0;
+        return 0;
+    }
+
+    do {
+        /* do not wait for the session, there are other sessions to dispatch */
+        msgtype = nc_recv_notif(session, 0, &envp, &op);
+        if (msgtype == NC_MSG_NOTIF) {
+            done = nc_notif_is_complete(op);
+            nc_notif_disp_session_deliver(dsession, envp, op);
+            if (done) {
+                return 1;
+            }
+        } else if ((msgtype == NC_MSG_ERROR) && (session->status != NC_STATUS_RUNNING)) {
+            /* session is broken */
+            return 1;
+        }
+    } while ((msgtype == NC_MSG_NOTIF) || (msgtype == NC_MSG_REPLY));
+
+    dsession->busy = (msgtype == NC_MSG_WOULDBLOCK) && nc_client_session_notif_busy(nc_client_session_get_fd(session));
+    return 0;
+}
+
+/**
+ * @brief Notification dispatcher worker thread.
+ *
+ * @param[in] arg Worker.
+ * @return NULL.
+ */
+static void *
+nc_notif_disp_worker_thread(void *arg)
+{
+    struct nc_notif_disp_worker *worker = arg;
+    struct nc_notif_disp_job *job;
+    struct nc_notif_disp_session *dsession;
+    int finish;
+
+    /* WORKER LOCK */
+    pthread_mutex_lock(&worker->lock);
+
+    while (1) {
+        while (!worker->jobs && worker->running) {
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        }
+        if (!worker->jobs) {
+            /* stopped and all the jobs done */
+            break;
+        }
+
+        /* take the first job */
+        job = worker->jobs;
+        worker->jobs = job->next;
+        if (!worker->jobs) {
+            worker->jobs_last = NULL;
+        }
+        dsession = job->dsession;
+
+        /* WORKER UNLOCK */
+        pthread_mutex_unlock(&worker->lock);
+
+        dsession->notif_clb(dsession->session, job->envp, job->op, dsession->user_data);
+        lyd_free_all(job->envp);
+        lyd_free_all(job->op);
+        free(job);
+
+        /* WORKER LOCK */
+        pthread_mutex_lock(&worker->lock);
+
+        --dsession->jobs;
+        finish = dsession->removed && !dsession->jobs;
+        if (finish) {
+            /* WORKER UNLOCK */
+            pthread_mutex_unlock(&worker->lock);
+
+            nc_notif_disp_session_finish(dsession);
+
+            /* WORKER LOCK */
+            pthread_mutex_lock(&worker->lock);
+        }
+    }
+
+    /* WORKER UNLOCK */
+    pthread_mutex_unlock(&worker->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Notification dispatcher thread.
+ *
+ * @param[in] arg Notification dispatcher.
+ * @return NULL.
+ */
+static void *
+nc_notif_dispatcher_thread(void *arg)
+{
+    struct nc_notif_dispatcher *disp = arg;
+    struct nc_notif_disp_session **dsessions = NULL, *dsession;
+    struct pollfd *pfds = NULL;
+    uint16_t count = 0, size = 0, i, j;
+    short revents;
+    char buf[64];
+    void *tmp;
+    int timeout;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&disp->lock);
+
+        if (!disp->running) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&disp->lock);
+            break;
+        }
+
+        /* get the current sessions, they are removed only by this thread */
+        if (disp->session_count > size) {
+            tmp = realloc(dsessions, disp->session_count * sizeof *dsessions);
+            if (tmp) {
+                dsessions = tmp;
+                tmp = realloc(pfds, (2 * disp->session_count + 1) * sizeof *pfds);
+            }
+            if (!tmp) {
+                /* UNLOCK */
+                pthread_mutex_unlock(&disp->lock);
+                ERRMEM;
+                break;
+            }
+            pfds = tmp;
+            size = disp->session_count;
+        }
+        count = disp->session_count;
+        if (count) {
+            memcpy(dsessions, disp->sessions, count * sizeof *dsessions);
+        }
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&disp->lock);
+
+        if (!pfds) {
+            pfds = malloc(sizeof *pfds);
+            if (!pfds) {
+                ERRMEM;
+                break;
+            }
+        }
+
+        /* the dispatcher wakeup pipe and the socket and notification wakeup pipe of every session */
+        pfds[0].fd = disp->wakeup[0];
+        pfds[0].events = POLLIN;
+        pfds[0].revents = 0;
+        timeout = -1;
+        for (i = 0; i < count; ++i) {
+            dsession = dsessions[i];
+            pfds[2 * i + 1].fd = dsession->busy ? -1 : nc_client_session_get_fd(dsession->session);
+            pfds[2 * i + 1].events = POLLIN;
+            pfds[2 * i + 1].revents = 0;
+            pfds[2 * i + 2].fd = dsession->session->opts.client.ntf_wakeup[0];
+            pfds[2 * i + 2].events = POLLIN;
+            pfds[2 * i + 2].revents = 0;
+
+            if (dsession->busy) {
+                /* being read by another thread, retry it after a while */
+                timeout = NC_CLIENT_NOTIF_BUSY_TIMEOUT;
+            }
+        }
+
+        /* wait for data or a wakeup of any session, notifications may also be buffered by other threads */
+        if (nc_poll(pfds, 2 * count + 1, timeout) == -1) {
+            ERR(NULL, "Notification dispatcher poll failed (%s).", strerror(errno));
+            break;
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            /* consume the wakeups, the sessions and running flag are checked anyway */
+            while (read(disp->wakeup[0], buf, sizeof buf) > 0) {}
+        }
+
+        for (i = 0; i < count; ++i) {
+            dsession = dsessions[i];
+            revents = pfds[2 * i + 1].revents | pfds[2 * i + 2].revents;
+            if (dsession->busy) {
+                /* retry it now */
+                revents |= POLLIN;
+            }
+            if ((pfds[2 * i + 2].revents & POLLIN) &&
+                    ATOMIC_LOAD_RELAXED(dsession->session->opts.client.ntf_thread_running)) {
+                /* a wakeup of a session being freed is kept for its other notification threads */
+                nc_client_notif_wakeup_clear(dsession->session);
+            }
+            if (!nc_notif_disp_session_recv(dsession, revents)) {
+                continue;
+            }
+
+            /* LOCK */
+            pthread_mutex_lock(&disp->lock);
+
+            for (j = 0; disp->sessions[j] != dsession; ++j) {}
+            --disp->session_count;
+            disp->sessions[j] = disp->sessions[disp->session_count];
+
+            /* UNLOCK */
+            pthread_mutex_unlock(&disp->lock);
+
+            nc_notif_disp_session_remove(dsession);
+        }
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&disp->lock);
+
+    /* stop dispatching all the remaining sessions */
+    disp->running = 0;
+    for (i = 0; i < disp->session_count; ++i) {
+        nc_notif_disp_session_remove(disp->sessions[i]);
+    }
+    free(disp->sessions);
+    disp->sessions = NULL;
+    disp->session_count = 0;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+
+    free(dsessions);
+    free(pfds);
+    VRB(NULL, "Notification dispatcher thread exit.");
+    return NULL;
+}
+
+API struct nc_notif_dispatcher *
+nc_notif_dispatcher_new(uint16_t worker_count)
+{
+    struct nc_notif_dispatcher *disp;
+    struct nc_notif_disp_worker *worker;
+    int r;
+
+    disp = calloc(1, sizeof *disp);
+    NC_CHECK_ERRMEM_RET(!disp, NULL);
+    disp->wakeup[0] = -1;
+    disp->wakeup[1] = -1;
+    pthread_mutex_init(&disp->lock, NULL);
+
+    /* non-blocking wakeup pipe */
+    if (pipe(disp->wakeup) || (fcntl(disp->wakeup[0], F_SETFL, O_NONBLOCK) == -1) ||
+            (fcntl(disp->wakeup[1], F_SETFL, O_NONBLOCK) == -1)) {
+        ERR(NULL, "Failed to create the notification dispatcher wakeup pipe (%s).", strerror(errno));
+        goto error;
+    }
+
+    /* workers */
+    if (worker_count) {
+        disp->workers = calloc(worker_count, sizeof *disp->workers);
+        NC_CHECK_ERRMEM_GOTO(!disp->workers, , error);
+    }
+    for (disp->worker_count = 0; disp->worker_count < worker_count; ++disp->worker_count) {
+        worker = &disp->workers[disp->worker_count];
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->cond, NULL);
+        worker->running = 1;
+
+        r = pthread_create(&worker->tid, NULL, nc_notif_disp_worker_thread, worker);
+        if (r) {
+            ERR(NULL, "Failed to create a notification dispatcher worker thread (%s).", strerror(r));
+            pthread_mutex_destroy(&worker->lock);
+            pthread_cond_destroy(&worker->cond);
+            goto error;
+        }
+    }
+
+    /* dispatcher thread */
+    disp->running = 1;
+    r = pthread_create(&disp->tid, NULL, nc_notif_dispatcher_thread, disp);
+    if (r) {
+        ERR(NULL, "Failed to create the notification dispatcher thread (%s).", strerror(r));
+        disp->running = 0;
+        goto error;
+    }
+    disp->tid_valid = 1;
+
+    return disp;
+
+error:
+    nc_notif_dispatcher_free(disp);
+    return NULL;
+}
+
+API int
+nc_notif_dispatcher_add_session(struct nc_notif_dispatcher *disp, struct nc_session *session,
+        nc_notif_dispatch_clb notif_clb, void *user_data, void (*free_data)(void *))
+{
+    struct nc_notif_disp_session *dsession;
+    void *tmp;
+    int ret = 0;
+
+    NC_CHECK_ARG_RET(session, disp, session, notif_clb, -1);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to receive Notifications.");
+        return -1;
+    }
+
+    if (nc_client_notif_wakeup_init(session)) {
+        return -1;
+    }
+
+    dsession = calloc(1, sizeof *dsession);
+    NC_CHECK_ERRMEM_RET(!dsession, -1);
+    dsession->session = session;
+    dsession->notif_clb = notif_clb;
+    dsession->user_data = user_data;
+    dsession->free_data = free_data;
+
+    /* LOCK */
+    pthread_mutex_lock(&disp->lock);
+
+    if (!disp->running) {
+        ERR(session, "Notification dispatcher is not running.");
+        ret = -1;
+        goto cleanup;
+    }
+
+    tmp = realloc(disp->sessions, (disp->session_count + 1) * sizeof *disp->sessions);
+    NC_CHECK_ERRMEM_GOTO(!tmp, ret = -1, cleanup);
+    disp->sessions = tmp;
+
+    /* assign a worker, all the notifications of the session are handled by it to keep their order */
+    if (disp->worker_count) {
+        dsession->worker = &disp->workers[disp->next_worker];
+        disp->next_worker = (disp->next_worker + 1) % disp->worker_count;
+    }
+
+    /* the session counts as a notification thread */
+    ATOMIC_INC_RELAXED(session->opts.client.ntf_thread_count);
+    ATOMIC_STORE_RELAXED(session->opts.client.ntf_thread_running, 1);
+
+    disp->sessions[disp->session_count] = dsession;
+    ++disp->session_count;
+    dsession = NULL;
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+
+    free(dsession);
+    if (!ret) {
+        nc_notif_dispatcher_wakeup(disp);
+    }
+    return ret;
+}
+
+API void
+nc_notif_dispatcher_free(struct nc_notif_dispatcher *disp)
+{
+    uint16_t i;
+
+    if (!disp) {
+        return;
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&disp->lock);
+    disp->running = 0;
+    /* UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+
+    if (disp->tid_valid) {
+        /* stop the dispatcher thread, it removes all the sessions */
+        nc_notif_dispatcher_wakeup(disp);
+        pthread_join(disp->tid, NULL);
+    }
+
+    /* stop the workers once they are done with all the jobs */
+    for (i = 0; i < disp->worker_count; ++i) {
+        pthread_mutex_lock(&disp->workers[i].lock);
+        disp->workers[i].running = 0;
+        pthread_cond_signal(&disp->workers[i].cond);
+        pthread_mutex_unlock(&disp->workers[i].lock);
+
+        pthread_join(disp->workers[i].tid, NULL);
+        pthread_mutex_destroy(&disp->workers[i].lock);
+        pthread_cond_destroy(&disp->workers[i].cond);
+    }
+    free(disp->workers);
+
+    if (disp->wakeup[0] > -1) {
+        close(disp->wakeup[0]);
+    }
+    if (disp->wakeup[1] > -1) {
+        close(disp->wakeup[1]);
+    }
+    pthread_mutex_destroy(&disp->lock);
+    free(disp);
+}
+
+static const char *
+nc_wd2str(NC_WD_MODE wd)
+{
+    switch (wd) {
+    case NC_WD_ALL:
+        return "report-all";
+    case NC_WD_ALL_TAG:
+        return "report-all-tagged";
+    case NC_WD_TRIM:
+        return "trim";
+    case NC_WD_EXPLICIT:
+        return "explicit";
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Create the operation data tree of an RPC.
+ *
+ * @param[in] session Session to create the RPC for.
+ * @param[in] rpc RPC to create.
+ * @param[out] rpc_data Created operation data tree.
+ * @param[out] rpc_free Whether @p rpc_data should be freed.
+ * @return 0 on success, the session context is read-locked and needs to be unlocked by
+ * ::nc_client_lazy_ctx_unlock() after @p rpc_data is no longer used.
+ * @return -1 on error.
+ */
+static int
+nc_rpc_build(struct nc_session *session, struct nc_rpc *rpc, struct lyd_node **rpc_data, int *rpc_free)
+{
+    int dofree = 1;
+    struct ly_in *in;
+    struct nc_rpc_act_generic *rpc_gen;
+    struct nc_rpc_getconfig *rpc_gc;
+    struct nc_rpc_edit *rpc_e;
+    struct nc_rpc_copy *rpc_cp;
+    struct nc_rpc_delete *rpc_del;
+    struct nc_rpc_lock *rpc_lock;
+    struct nc_rpc_get *rpc_g;
+    struct nc_rpc_kill *rpc_k;
+    struct nc_rpc_commit *rpc_com;
+    struct nc_rpc_cancel *rpc_can;
+    struct nc_rpc_validate *rpc_val;
+    struct nc_rpc_getschema *rpc_gs;
+    struct nc_rpc_subscribe *rpc_sub;
+    struct nc_rpc_getdata *rpc_getd;
+    struct nc_rpc_editdata *rpc_editd;
+    struct nc_rpc_establishsub *rpc_estsub;
+    struct nc_rpc_modifysub *rpc_modsub;
+    struct nc_rpc_deletesub *rpc_delsub;
+    struct nc_rpc_killsub *rpc_killsub;
+    struct nc_rpc_establishpush *rpc_estpush;
+    struct nc_rpc_modifypush *rpc_modpush;
+    struct nc_rpc_resyncsub *rpc_resyncsub;
+    struct lyd_node *data = NULL, *node, *cont;
+    const struct lys_module *mod = NULL, *mod2 = NULL, *ietfncwd;
+    LY_ERR lyrc = 0;
+    int i;
+    char str[11];
+
+    switch (rpc->type) {
+    case NC_RPC_ACT_GENERIC:
+        /* checked when parsing */
+        break;
+    case NC_RPC_GETCONFIG:
+    case NC_RPC_EDIT:
+    case NC_RPC_COPY:
+    case NC_RPC_DELETE:
+    case NC_RPC_LOCK:
+    case NC_RPC_UNLOCK:
+    case NC_RPC_GET:
+    case NC_RPC_KILL:
+    case NC_RPC_COMMIT:
+    case NC_RPC_DISCARD:
+    case NC_RPC_CANCEL:
+    case NC_RPC_VALIDATE:
+        mod = nc_client_ctx_get_module(session, "ietf-netconf");
+        if (!mod) {
+            ERR(session, "Missing \"ietf-netconf\" module in the context.");
+            return -1;
+        }
+        break;
+    case NC_RPC_GETSCHEMA:
+        mod = nc_client_ctx_get_module(session, "ietf-netconf-monitoring");
+        if (!mod) {
+            ERR(session, "Missing \"ietf-netconf-monitoring\" module in the context.");
+            return -1;
+        }
+        break;
+    case NC_RPC_SUBSCRIBE:
+        mod = nc_client_ctx_get_module(session, "notifications");
+        if (!mod) {
+            ERR(session, "Missing \"notifications\" module in the context.");
+            return -1;
+        }
+        break;
+    case NC_RPC_GETDATA:
+    case NC_RPC_EDITDATA:
+        mod = nc_client_ctx_get_module(session, "ietf-netconf-nmda");
+        if (!mod) {
+            ERR(session, "Missing \"ietf-netconf-nmda\" module in the context.");
+            return -1;
+        }
+        break;
+    case NC_RPC_ESTABLISHSUB:
+    case NC_RPC_MODIFYSUB:
+    case NC_RPC_DELETESUB:
+    case NC_RPC_KILLSUB:
+        mod = nc_client_ctx_get_module(session, "ietf-subscribed-notifications");
+        if (!mod) {
+            ERR(session, "Missing \"ietf-subscribed-notifications\" module in the context.");
+            return -1;
+        }
+        break;
+    case NC_RPC_ESTABLISHPUSH:
+    case NC_RPC_MODIFYPUSH:
+        mod = nc_client_ctx_get_module(session, "ietf-subscribed-notifications");
+        if (!mod) {
+            ERR(session, "Missing \"ietf-subscribed-notifications\" module in the context.");
+            return -1;
+        }
+        mod2 = nc_client_ctx_get_module(session, "ietf-yang-push");
+        if (!mod2) {
+            ERR(session, "Missing \"ietf-yang-push\" module in the context.");
+            return -1;
+        }
+        break;
+    case NC_RPC_RESYNCSUB:
+        mod = nc_client_ctx_get_module(session, "ietf-yang-push");
+        if (!mod) {
+            ERR(session, "Missing \"ietf-yang-push\" module in the context.");
+            return -1;
+        }
+        break;
+    case NC_RPC_UNKNOWN:
+        ERRINT;
+        return -1;
+    }
+
+    /* with-defaults module may be needed, as well */
+    if (((rpc->type == NC_RPC_GETCONFIG) && ((struct nc_rpc_getconfig *)rpc)->wd_mode) ||
+            ((rpc->type == NC_RPC_GET) && ((struct nc_rpc_get *)rpc)->wd_mode) ||
+            ((rpc->type == NC_RPC_GETDATA) && ((struct nc_rpc_getdata *)rpc)->wd_mode)) {
+        nc_client_ctx_get_module(session, "ietf-netconf-with-defaults");
+    }
+
+    /* load any missing modules used by the RPC */
+    if ((rpc->type == NC_RPC_ACT_GENERIC) && !((struct nc_rpc_act_generic *)rpc)->has_data) {
+        nc_client_lazy_load_ns(session, ((struct nc_rpc_act_generic *)rpc)->content.xml_str);
+    }
+
+    /* CTX READ LOCK */
+    nc_client_lazy_ctx_rdlock(session);
+
+#define CHECK_LYRC_BREAK(func_call) if ((lyrc = func_call)) break;
+
+    switch (rpc->type) {
+    case NC_RPC_ACT_GENERIC:
+        rpc_gen = (struct nc_rpc_act_generic *)rpc;
+
+        if (rpc_gen->has_data) {
+            data = rpc_gen->content.data;
+            dofree = 0;
+        } else {
+            ly_in_new_memory(rpc_gen->content.xml_str, &in);
+            lyrc = lyd_parse_op(session->ctx, NULL, in, LYD_XML, LYD_TYPE_RPC_YANG, &data, NULL);
+            ly_in_free(in, 0);
+            if (lyrc) {
+                break;
+            }
+        }
+        break;
+
+    case NC_RPC_GETCONFIG:
+        rpc_gc = (struct nc_rpc_getconfig *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get-config", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "source", 0, &cont));
+        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_gc->source], NULL, 0, NULL));
+        if (rpc_gc->filter) {
+            if (!rpc_gc->filter[0] || (rpc_gc->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", rpc_gc->filter, LYD_ANYDATA_XML, 0, &node));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "subtree", 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", NULL, LYD_ANYDATA_STRING, 0, &node));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "xpath", 0, NULL));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:select", rpc_gc->filter, 0, NULL));
+            }
+        }
+
+        if (rpc_gc->wd_mode) {
+            ietfncwd = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-with-defaults");
+            if (!ietfncwd) {
+                ERR(session, "Missing \"ietf-netconf-with-defaults\" module in the context.");
+                lyrc = LY_ENOTFOUND;
+                break;
+            }
+            CHECK_LYRC_BREAK(lyd_new_term(data, ietfncwd, "with-defaults", nc_wd2str(rpc_gc->wd_mode), 0, NULL));
+        }
+        break;
+
+    case NC_RPC_EDIT:
+        rpc_e = (struct nc_rpc_edit *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "edit-config", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
+        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_e->target], NULL, 0, NULL));
+
+        if (rpc_e->default_op) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "default-operation", rpcedit_dfltop2str[rpc_e->default_op], 0, NULL));
+        }
+        if (rpc_e->test_opt) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "test-option", rpcedit_testopt2str[rpc_e->test_opt], 0, NULL));
+        }
+        if (rpc_e->error_opt) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "error-option", rpcedit_erropt2str[rpc_e->error_opt], 0, NULL));
+        }
+        if (!rpc_e->edit_cont[0] || (rpc_e->edit_cont[0] == '<')) {
+            CHECK_LYRC_BREAK(lyd_new_any(data, mod, "config", rpc_e->edit_cont, LYD_ANYDATA_XML, 0, NULL));
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "url", rpc_e->edit_cont, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_COPY:
+        rpc_cp = (struct nc_rpc_copy *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "copy-config", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
+        if (rpc_cp->url_trg) {
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_cp->url_trg, 0, NULL));
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_cp->target], NULL, 0, NULL));
+        }
+
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "source", 0, &cont));
+        if (rpc_cp->url_config_src) {
+            if (!rpc_cp->url_config_src[0] || (rpc_cp->url_config_src[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(cont, mod, "config", rpc_cp->url_config_src, LYD_ANYDATA_XML, 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_cp->url_config_src, 0, NULL));
+            }
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_cp->source], NULL, 0, NULL));
+        }
+
+        if (rpc_cp->wd_mode) {
+            ietfncwd = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-with-defaults");
+            if (!ietfncwd) {
+                ERR(session, "Missing \"ietf-netconf-with-defaults\" module in the context.");
+                lyrc = LY_ENOTFOUND;
+                break;
+            }
+            CHECK_LYRC_BREAK(lyd_new_term(data, ietfncwd, "with-defaults", nc_wd2str(rpc_cp->wd_mode), 0, NULL));
+        }
+        break;
+
+    case NC_RPC_DELETE:
+        rpc_del = (struct nc_rpc_delete *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "delete-config", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
+        if (rpc_del->url) {
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_del->url, 0, NULL));
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_del->target], NULL, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_LOCK:
+        rpc_lock = (struct nc_rpc_lock *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "lock", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
+        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_lock->target], NULL, 0, NULL));
+        break;
+
+    case NC_RPC_UNLOCK:
+        rpc_lock = (struct nc_rpc_lock *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "unlock", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "target", 0, &cont));
+        CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_lock->target], NULL, 0, NULL));
+        break;
+
+    case NC_RPC_GET:
+        rpc_g = (struct nc_rpc_get *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get", 0, &data));
+        if (rpc_g->filter) {
+            if (!rpc_g->filter[0] || (rpc_g->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", rpc_g->filter, LYD_ANYDATA_XML, 0, &node));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "subtree", 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", NULL, LYD_ANYDATA_STRING, 0, &node));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "xpath", 0, NULL));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:select", rpc_g->filter, 0, NULL));
+            }
+        }
+
+        if (rpc_g->wd_mode) {
+            ietfncwd = ly_ctx_get_module_implemented(session->ctx, "ietf-netconf-with-defaults");
+            if (!ietfncwd) {
+                ERR(session, "Missing \"ietf-netconf-with-defaults\" module in the context.");
+                lyrc = LY_ENOTFOUND;
+                break;
+            }
+            CHECK_LYRC_BREAK(lyd_new_term(data, ietfncwd, "with-defaults", nc_wd2str(rpc_g->wd_mode), 0, NULL));
+        }
+        break;
+
+    case NC_RPC_KILL:
+        rpc_k = (struct nc_rpc_kill *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "kill-session", 0, &data));
+        sprintf(str, "%" PRIu32, rpc_k->sid);
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "session-id", str, 0, NULL));
+        break;
+
+    case NC_RPC_COMMIT:
+        rpc_com = (struct nc_rpc_commit *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "commit", 0, &data));
+        if (rpc_com->confirmed) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "confirmed", NULL, 0, NULL));
+        }
+
+        if (rpc_com->confirm_timeout) {
+            sprintf(str, "%" PRIu32, rpc_com->confirm_timeout);
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "confirm-timeout", str, 0, NULL));
+        }
+        if (rpc_com->persist) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "persist", rpc_com->persist, 0, NULL));
+        }
+        if (rpc_com->persist_id) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "persist-id", rpc_com->persist_id, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_DISCARD:
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "discard-changes", 0, &data));
+        break;
+
+    case NC_RPC_CANCEL:
+        rpc_can = (struct nc_rpc_cancel *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "cancel-commit", 0, &data));
+        if (rpc_can->persist_id) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "persist-id", rpc_can->persist_id, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_VALIDATE:
+        rpc_val = (struct nc_rpc_validate *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "validate", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_inner(data, mod, "source", 0, &cont));
+        if (rpc_val->url_config_src) {
+            if (!rpc_val->url_config_src[0] || (rpc_val->url_config_src[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(cont, mod, "config", rpc_val->url_config_src, LYD_ANYDATA_XML, 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_term(cont, mod, "url", rpc_val->url_config_src, 0, NULL));
+            }
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod, ncds2str[rpc_val->source], NULL, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_GETSCHEMA:
+        rpc_gs = (struct nc_rpc_getschema *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get-schema", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "identifier", rpc_gs->identifier, 0, NULL));
+        if (rpc_gs->version) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "version", rpc_gs->version, 0, NULL));
+        }
+        if (rpc_gs->format) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "format", rpc_gs->format, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_SUBSCRIBE:
+        rpc_sub = (struct nc_rpc_subscribe *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "create-subscription", 0, &data));
+        if (rpc_sub->stream) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream", rpc_sub->stream, 0, NULL));
+        }
+
+        if (rpc_sub->filter) {
+            if (!rpc_sub->filter[0] || (rpc_sub->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", rpc_sub->filter, LYD_ANYDATA_XML, 0, &node));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "subtree", 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "filter", NULL, LYD_ANYDATA_STRING, 0, &node));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:type", "xpath", 0, NULL));
+                CHECK_LYRC_BREAK(lyd_new_meta(NULL, node, NULL, "ietf-netconf:select", rpc_sub->filter, 0, NULL));
+            }
+        }
+        if (rpc_sub->start) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "startTime", rpc_sub->start, 0, NULL));
+        }
+        if (rpc_sub->stop) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stopTime", rpc_sub->stop, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_GETDATA:
+        rpc_getd = (struct nc_rpc_getdata *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "get-data", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "datastore", rpc_getd->datastore, 0, NULL));
+
+        if (rpc_getd->filter) {
+            if (!rpc_getd->filter[0] || (rpc_getd->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "subtree-filter", rpc_getd->filter, LYD_ANYDATA_XML, 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "xpath-filter", rpc_getd->filter, 0, NULL));
+            }
+        }
+        if (rpc_getd->config_filter) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "config-filter", rpc_getd->config_filter, 0, NULL));
+        }
+        for (i = 0; i < rpc_getd->origin_filter_count; ++i) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, rpc_getd->negated_origin_filter ? "negated-origin-filter" :
+                    "origin-filter", rpc_getd->origin_filter[i], 0, NULL));
+        }
+        if (rpc_getd->max_depth) {
+            sprintf(str, "%u", rpc_getd->max_depth);
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "max-depth", str, 0, NULL));
+        }
+        if (rpc_getd->with_origin) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "with-origin", NULL, 0, NULL));
+        }
+
+        if (rpc_getd->wd_mode) {
+            /* "with-defaults" are used from a grouping so it belongs to the ietf-netconf-nmda module */
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "with-defaults", nc_wd2str(rpc_getd->wd_mode), 0, NULL));
+        }
+        break;
+
+    case NC_RPC_EDITDATA:
+        rpc_editd = (struct nc_rpc_editdata *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "edit-data", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "datastore", rpc_editd->datastore, 0, NULL));
+
+        if (rpc_editd->default_op) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "default-operation", rpcedit_dfltop2str[rpc_editd->default_op], 0,
+                    NULL));
+        }
+        if (!rpc_editd->edit_cont[0] || (rpc_editd->edit_cont[0] == '<')) {
+            CHECK_LYRC_BREAK(lyd_new_any(data, mod, "config", rpc_editd->edit_cont, LYD_ANYDATA_XML, 0, NULL));
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "url", rpc_editd->edit_cont, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_ESTABLISHSUB:
+        rpc_estsub = (struct nc_rpc_establishsub *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "establish-subscription", 0, &data));
+
+        if (rpc_estsub->filter) {
+            if (!rpc_estsub->filter[0] || (rpc_estsub->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "stream-subtree-filter", rpc_estsub->filter, LYD_ANYDATA_XML,
+                        0, NULL));
+            } else if (rpc_estsub->filter[0] == '/') {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-xpath-filter", rpc_estsub->filter, 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-filter-name", rpc_estsub->filter, 0, NULL));
+            }
+        }
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream", rpc_estsub->stream, 0, NULL));
+
+        if (rpc_estsub->start) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "replay-start-time", rpc_estsub->start, 0, NULL));
+        }
+        if (rpc_estsub->stop) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_estsub->stop, 0, NULL));
+        }
+        if (rpc_estsub->encoding) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "encoding", rpc_estsub->encoding, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_MODIFYSUB:
+        rpc_modsub = (struct nc_rpc_modifysub *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "modify-subscription", 0, &data));
+
+        sprintf(str, "%" PRIu32, rpc_modsub->id);
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
+
+        if (rpc_modsub->filter) {
+            if (!rpc_modsub->filter[0] || (rpc_modsub->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod, "stream-subtree-filter", rpc_modsub->filter, LYD_ANYDATA_XML,
+                        0, NULL));
+            } else if (rpc_modsub->filter[0] == '/') {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-xpath-filter", rpc_modsub->filter, 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stream-filter-name", rpc_modsub->filter, 0, NULL));
+            }
+        }
+        if (rpc_modsub->stop) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_modsub->stop, 0, NULL));
+        }
+        break;
+
+    case NC_RPC_DELETESUB:
+        rpc_delsub = (struct nc_rpc_deletesub *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "delete-subscription", 0, &data));
+
+        sprintf(str, "%" PRIu32, rpc_delsub->id);
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
+        break;
+
+    case NC_RPC_KILLSUB:
+        rpc_killsub = (struct nc_rpc_killsub *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "kill-subscription", 0, &data));
+
+        sprintf(str, "%" PRIu32, rpc_killsub->id);
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
+        break;
+
+    case NC_RPC_ESTABLISHPUSH:
+        rpc_estpush = (struct nc_rpc_establishpush *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "establish-subscription", 0, &data));
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore", rpc_estpush->datastore, 0, NULL));
+
+        if (rpc_estpush->filter) {
+            if (!rpc_estpush->filter[0] || (rpc_estpush->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod2, "datastore-subtree-filter", rpc_estpush->filter,
+                        LYD_ANYDATA_XML, 0, NULL));
+            } else if (rpc_estpush->filter[0] == '/') {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore-xpath-filter", rpc_estpush->filter, 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "selection-filter-ref", rpc_estpush->filter, 0, NULL));
+            }
+        }
+
+        if (rpc_estpush->stop) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_estpush->stop, 0, NULL));
+        }
+        if (rpc_estpush->encoding) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "encoding", rpc_estpush->encoding, 0, NULL));
+        }
+
+        if (rpc_estpush->periodic) {
+            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "periodic", 0, &cont));
+            sprintf(str, "%" PRIu32, rpc_estpush->period);
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "period", str, 0, NULL));
+            if (rpc_estpush->anchor_time) {
+                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "anchor-time", rpc_estpush->anchor_time, 0, NULL));
+            }
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "on-change", 0, &cont));
+            if (rpc_estpush->dampening_period) {
+                sprintf(str, "%" PRIu32, rpc_estpush->dampening_period);
+                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "dampening-period", str, 0, NULL));
+            }
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "sync-on-start", rpc_estpush->sync_on_start ? "true" : "false", 0,
+                    NULL));
+            if (rpc_estpush->excluded_change) {
+                for (i = 0; rpc_estpush->excluded_change[i]; ++i) {
+                    CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "excluded-change", rpc_estpush->excluded_change[i], 0,
+                            NULL));
+                }
+            }
+        }
+        break;
+
+    case NC_RPC_MODIFYPUSH:
+        rpc_modpush = (struct nc_rpc_modifypush *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "modify-subscription", 0, &data));
+
+        sprintf(str, "%" PRIu32, rpc_modpush->id);
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore", rpc_modpush->datastore, 0, NULL));
+
+        if (rpc_modpush->filter) {
+            if (!rpc_modpush->filter[0] || (rpc_modpush->filter[0] == '<')) {
+                CHECK_LYRC_BREAK(lyd_new_any(data, mod2, "datastore-subtree-filter", rpc_modpush->filter,
+                        LYD_ANYDATA_XML, 0, NULL));
+            } else if (rpc_modpush->filter[0] == '/') {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore-xpath-filter", rpc_modpush->filter, 0, NULL));
+            } else {
+                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "selection-filter-ref", rpc_modpush->filter, 0, NULL));
+            }
+        }
+        if (rpc_modpush->stop) {
+            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_modpush->stop, 0, NULL));
+        }
+
+        if (rpc_modpush->periodic) {
+            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "periodic", 0, &cont));
+            sprintf(str, "%" PRIu32, rpc_modpush->period);
+            CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "period", str, 0, NULL));
+            if (rpc_modpush->anchor_time) {
+                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "anchor-time", rpc_modpush->anchor_time, 0, NULL));
+            }
+        } else {
+            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "on-change", 0, &cont));
+            if (rpc_modpush->dampening_period) {
+                sprintf(str, "%" PRIu32, rpc_modpush->dampening_period);
+                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "dampening-period", str, 0, NULL));
+            }
+        }
+        break;
+
+    case NC_RPC_RESYNCSUB:
+        rpc_resyncsub = (struct nc_rpc_resyncsub *)rpc;
+
+        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "resync-subscription", 0, &data));
+        sprintf(str, "%" PRIu32, rpc_resyncsub->id);
+        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
+        break;
+
+    case NC_RPC_UNKNOWN:
+        lyrc = LY_EINT;
+        break;
+    }
+
+#undef CHECK_LYRC_BREAK
+
+    if (lyrc) {
+        ERR(session, "Failed to create RPC, perhaps a required feature is disabled.");
+        lyd_free_tree(data);
+        nc_client_lazy_ctx_unlock(session);
+        return -1;
+    }
+
+    *rpc_data = data;
+    *rpc_free = dofree;
+    return 0;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid)
+{
+    NC_MSG_TYPE r;
+    int dofree;
+    struct lyd_node *data;
+    uint64_t cur_msgid;
+
+    NC_CHECK_ARG_RET(session, session, rpc, msgid, NC_MSG_ERROR);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to send RPCs.");
+        return NC_MSG_ERROR;
+    }
+
+    /* create the RPC, CTX READ LOCK */
+    if (nc_rpc_build(session, rpc, &data, &dofree)) {
+        return NC_MSG_ERROR;
+    }
+
+    /* send RPC, store its message ID */
+    r = nc_send_msg_io(session, timeout, data);
+    cur_msgid = session->opts.client.msgid;
+
+    if (dofree) {
+        lyd_free_tree(data);
+    }
+
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
+
+    if (r == NC_MSG_RPC) {
+        *msgid = cur_msgid;
+    }
+    return r;
+}
+
+API struct nc_rpc_prepared *
+nc_rpc_prepare(struct nc_session *session, struct nc_rpc *rpc)
+{
+    struct nc_rpc_prepared *prep = NULL;
+    struct lyd_node *data;
+    char *str = NULL;
+    int dofree, action, count;
+
+    NC_CHECK_ARG_RET(session, session, rpc, NULL);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to prepare RPCs.");
+        return NULL;
+    }
+
+    /* create the RPC, CTX READ LOCK */
+    if (nc_rpc_build(session, rpc, &data, &dofree)) {
+        return NULL;
+    }
+
+    if (session->ctx != LYD_CTX(data)) {
+        ERR(session, "RPC \"%s\" was created in different context than that of the session.", LYD_NAME(data));
+        goto cleanup;
+    }
+
+    /* print it exactly as when sending it */
+    if (lyd_print_mem(&str, data, LYD_XML, LYD_PRINT_SHRINK | LYD_PRINT_KEEPEMPTYCONT)) {
+        ERR(session, "Failed to print RPC \"%s\".", LYD_NAME(data));
+        goto cleanup;
+    }
+    action = data->schema && (data->schema->nodetype & (LYS_CONTAINER | LYS_LIST));
+
+    prep = calloc(1, sizeof *prep);
+    NC_CHECK_ERRMEM_GOTO(!prep, , cleanup);
+
+    count = asprintf(&prep->rpc_tail, "\">%s%s%s</rpc>", action ? "<action xmlns=\"urn:ietf:params:xml:ns:yang:1\">" : "",
+            str, action ? "</action>" : "");
+    NC_CHECK_ERRMEM_GOTO(count == -1, free(prep); prep = NULL, cleanup);
+    prep->rpc_tail_len = count;
+
+cleanup:
+    free(str);
+    if (dofree) {
+        lyd_free_tree(data);
+    }
+
+    /* CTX UNLOCK */
+    nc_client_lazy_ctx_unlock(session);
+    return prep;
+}
+
+API NC_MSG_TYPE
+nc_send_rpc_prepared(struct nc_session *session, const struct nc_rpc_prepared *rpc, int timeout, uint64_t *msgid)
+{
+    NC_CHECK_ARG_RET(session, session, rpc, msgid, NC_MSG_ERROR);
+
+    if ((session->status != NC_STATUS_RUNNING) || (session->side != NC_CLIENT)) {
+        ERR(session, "Invalid session to send RPCs.");
+        return NC_MSG_ERROR;
+    }
+
+    return nc_write_rpc_prepared_io(session, timeout, rpc->rpc_tail, rpc->rpc_tail_len, msgid);
+}
+
+API void
+nc_rpc_prepared_free(struct nc_rpc_prepared *rpc)
+{
+    if (!rpc) {
+        return;
+    }
+
+    free(rpc->rpc_tail);
+    free(rpc);
+}
+
+API void
+nc_client_session_set_not_strict(struct nc_session *session)
+{
+    if (session->side != NC_CLIENT) {
+        ERRARG(NULL, "session");
+        return;
+    }
+
+    session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
+}
+
+API void
+nc_client_session_set_msg_buffer_limit(struct nc_session *session, size_t limit)
+{
+    int r, timeout = NC_SESSION_LOCK_TIMEOUT;
+
+    if (!session || (session->side != NC_CLIENT)) {
+        ERRARG(NULL, "session");
+        return;
+    }
+
+    /* MSGS LOCK */
+    r = nc_session_client_msgs_lock(session, &timeout, __func__);
+    if (!r) {
+        ERR(session, "Failed to set the buffered messages limit, the session is busy.");
+        return;
+    } else if (r == -1) {
+        return;
+    }
+
+    session->opts.client.msgs_size_max = limit;
+
+    /* MSGS UNLOCK */
+    nc_session_client_msgs_unlock(session, __func__);
+}
+
+API int
+nc_client_session_set_parse_mode(struct nc_session *session, NC_CLIENT_PARSE_MODE mode)
+{
+    if (!session || (session->side != NC_CLIENT)) {
+        ERRARG(NULL, "session");
+        return -1;
+    } else if ((mode != NC_CLIENT_PARSE_SCHEMA) && (mode != NC_CLIENT_PARSE_OPAQ)) {
+        ERRARG(session, "mode");
+        return -1;
+    }
+
+    if ((mode == NC_CLIENT_PARSE_OPAQ) && !session->opts.client.opaq_ctx) {
+        /* context without any modules */
+        if (ly_ctx_new(NULL, LY_CTX_NO_YANGLIBRARY, &session->opts.client.opaq_ctx)) {
+            ERR(session, "Failed to create a context for parsing opaque messages.");
+            return -1;
+        }
+    }
+
+    session->opts.client.parse_mode = mode;
+    return 0;
+}
+
+API int
+nc_client_session_get_parse_stats(const struct nc_session *session, struct nc_client_parse_stats *stats)
+{
+    double schema_rate;
+
+    if (!session || (session->side != NC_CLIENT)) {
+        ERRARG(NULL, "session");
+        return -1;
+    } else if (!stats) {
+        ERRARG(session, "stats");
+        return -1;
+    }
+
+    stats->schema_count = ATOMIC_LOAD_RELAXED(session->opts.client.parse_stats[NC_CLIENT_PARSE_SCHEMA].count);
+    stats->schema_bytes = ATOMIC_LOAD_RELAXED(session->opts.client.parse_stats[NC_CLIENT_PARSE_SCHEMA].bytes);
+    stats->schema_usec = ATOMIC_LOAD_RELAXED(session->opts.client.parse_stats[NC_CLIENT_PARSE_SCHEMA].usec);
+    stats->opaq_count = ATOMIC_LOAD_RELAXED(session->opts.client.parse_stats[NC_CLIENT_PARSE_OPAQ].count);
+    stats->opaq_bytes = ATOMIC_LOAD_RELAXED(session->opts.client.parse_stats[NC_CLIENT_PARSE_OPAQ].bytes);
+    stats->opaq_usec = ATOMIC_LOAD_RELAXED(session->opts.client.parse_stats[NC_CLIENT_PARSE_OPAQ].usec);
+
+    /* only a rough estimate of how long parsing the opaque messages using the session context would have taken,
+     * the messages may differ a lot, impossible without any messages parsed using the session context */
+    stats->saved_usec = 0;
+    if (stats->schema_bytes) {
+        schema_rate = (double)stats->schema_usec / stats->schema_bytes;
+        if (schema_rate * stats->opaq_bytes > stats->opaq_usec) {
+            stats->saved_usec = schema_rate * stats->opaq_bytes - stats->opaq_usec;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Lock the client monitoring data.
+ *
+ * @param[in] timeout Timeout in msec to use.
+ *
+ * @return 1 on success;
+ * @return 0 on timeout;
+ * @return -1 on error.
+ */
+static int
+nc_client_monitoring_lock(int timeout)
+{
+    int r;
+    struct timespec ts;
+
+    if (timeout > 0) {
+        nc_timeouttime_get(&ts, timeout);
+        r = pthread_mutex_clocklock(&client_opts.monitoring_thread_data.lock, COMPAT_CLOCK_ID, &ts);
+    } else if (!timeout) {
+        r = pthread_mutex_trylock(&client_opts.monitoring_thread_data.lock);
+    } else {
+        r = pthread_mutex_lock(&client_opts.monitoring_thread_data.lock);
+    }
+
+    if (r) {
+        ERR(NULL, "Failed to lock the client monitoring data lock (%s).", strerror(r));
+
+        if ((r == EBUSY) || (r == ETIMEDOUT)) {
+            /* timeout */
+            return 0;
+        }
+
+        /* error */
+        return -1;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Wake the client monitoring thread up.
+ *
+ * @param[in] mtarg Monitoring thread data.
+ */
+static void
+nc_client_monitoring_wakeup(struct nc_client_monitoring_thread_arg *mtarg)
+{
+#ifdef HAVE_EPOLL
+    uint64_t val = 1;
+    ssize_t r = write(mtarg->evfd, &val, sizeof val);
+#else
+    char c = 0;
+    ssize_t r = write(mtarg->wakeup[1], &c, 1);
+#endif
+
+    if ((r == -1) && (errno != EAGAIN)) {
+        ERR(NULL, "Failed to wake up the client monitoring thread (%s).", strerror(errno));
+    }
+}
+
+/**
+ * @brief Consume all the pending wakeups of the client monitoring thread.
+ *
+ * @param[in] mtarg Monitoring thread data.
+ */
+static void
+nc_client_monitoring_wakeup_clear(struct nc_client_monitoring_thread_arg *mtarg)
+{
+#ifdef HAVE_EPOLL
+    uint64_t val;
+
+    while (read(mtarg->evfd, &val, sizeof val) > 0) {}
+#else
+    char buf[64];
+
+    while (read(mtarg->wakeup[0], buf, sizeof buf) > 0) {}
+#endif
+}
+
+/**
+ * @brief Free the event file descriptors of the client monitoring thread.
+ *
+ * @param[in] mtarg Monitoring thread data.
+ */
+static void
+nc_client_monitoring_fds_destroy(struct nc_client_monitoring_thread_arg *mtarg)
+{
+#ifdef HAVE_EPOLL
+    if (mtarg->epfd > -1) {
+        close(mtarg->epfd);
+        mtarg->epfd = -1;
+    }
+    if (mtarg->evfd > -1) {
+        close(mtarg->evfd);
+        mtarg->evfd = -1;
+    }
+#else
+    free(mtarg->pfds);
+    mtarg->pfds = NULL;
+    if (mtarg->wakeup[0] > -1) {
+        close(mtarg->wakeup[0]);
+        mtarg->wakeup[0] = -1;
+    }
+    if (mtarg->wakeup[1] > -1) {
+        close(mtarg->wakeup[1]);
+        mtarg->wakeup[1] = -1;
+    }
+#endif
+}
+
+/**
+ * @brief Create the event file descriptors of the client monitoring thread.
+ *
+ * @param[in] mtarg Monitoring thread data.
+ * @return 0 on success, 1 on error.
+ */
+static int
+nc_client_monitoring_fds_init(struct nc_client_monitoring_thread_arg *mtarg)
+{
+#ifdef HAVE_EPOLL
+    struct epoll_event ev = {0};
+
+    mtarg->epfd = epoll_create1(EPOLL_CLOEXEC);
+    mtarg->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((mtarg->epfd == -1) || (mtarg->evfd == -1)) {
+        goto error;
+    }
+
+    /* wakeup event has no session */
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(mtarg->epfd, EPOLL_CTL_ADD, mtarg->evfd, &ev)) {
+        goto error;
+    }
+#else
+    mtarg->wakeup[0] = -1;
+    mtarg->wakeup[1] = -1;
+    mtarg->pfds = malloc(sizeof *mtarg->pfds);
+    NC_CHECK_ERRMEM_RET(!mtarg->pfds, 1);
+
+    if (pipe(mtarg->wakeup) || (fcntl(mtarg->wakeup[0], F_SETFL, O_NONBLOCK) == -1) ||
+            (fcntl(mtarg->wakeup[1], F_SETFL, O_NONBLOCK) == -1)) {
+        goto error;
+    }
+
+    /* wakeup pipe is always first */
+    mtarg->pfds[0].fd = mtarg->wakeup[0];
+    mtarg->pfds[0].events = POLLIN;
+    mtarg->pfds[0].revents = 0;
+#endif
+
+    return 0;
+
+error:
+    ERR(NULL, "Failed to create the client monitoring thread events (%s).", strerror(errno));
+    nc_client_monitoring_fds_destroy(mtarg);
+    return 1;
+}
+
+int
+nc_client_monitoring_session_start(struct nc_session *session)
+{
+    int ret = 0, fd, r;
+    uint16_t size;
+    struct nc_client_monitoring_thread_arg *mtarg;
+    void *tmp;
+
+#ifdef HAVE_EPOLL
+    struct epoll_event ev = {0};
+#endif
+
+    /* LOCK */
+    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+    if (r < 1) {
+        return 1;
+    }
+
+    /* check if the monitoring thread is running */
+    if (!client_opts.monitoring_thread_data.thread_running) {
+        goto cleanup;
+    }
+
+    mtarg = &client_opts.monitoring_thread_data;
+    if (mtarg->session_count == UINT16_MAX) {
+        ERR(session, "Too many monitored sessions.");
+        ret = 1;
+        goto cleanup;
+    }
+
+    /* enlarge the sessions, if realloc fails, keep the original sessions without adding the new one */
+    if (mtarg->session_count == mtarg->session_size) {
+        size = (mtarg->session_size > UINT16_MAX / 2) ? UINT16_MAX : (mtarg->session_size ? mtarg->session_size * 2 : 8);
+
+        tmp = realloc(mtarg->sessions, size * sizeof *mtarg->sessions);
+        NC_CHECK_ERRMEM_GOTO(!tmp, ret = 1, cleanup);
+        mtarg->sessions = tmp;
+#ifndef HAVE_EPOLL
+        tmp = realloc(mtarg->pfds, (size + 1) * sizeof *mtarg->pfds);
+        NC_CHECK_ERRMEM_GOTO(!tmp, ret = 1, cleanup);
+        mtarg->pfds = tmp;
+#endif
+        mtarg->session_size = size;
+    }
+
+    /* watch a duplicate of the session's file descriptor, it may be shared by more sessions (SSH channels) */
+    fd = nc_client_session_get_fd(session);
+    assert(fd != -1);
+    fd = dup(fd);
+    if (fd == -1) {
+        ERR(session, "Failed to duplicate the session file descriptor (%s).", strerror(errno));
+        ret = 1;
+        goto cleanup;
+    }
+
+#ifdef HAVE_EPOLL
+    /* we are only interested in the connection being closed */
+    ev.events = EPOLLRDHUP;
+    ev.data.ptr = session;
+    if (epoll_ctl(mtarg->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+        ERR(session, "Failed to add the session to the monitored sessions (%s).", strerror(errno));
+        close(fd);
+        ret = 1;
+        goto cleanup;
+    }
+#else
+    /* we are only interested in POLLHUP or POLLNVAL */
+    mtarg->pfds[mtarg->session_count + 1].fd = fd;
+    mtarg->pfds[mtarg->session_count + 1].events = 0;
+    mtarg->pfds[mtarg->session_count + 1].revents = 0;
+#endif
+
+    session->opts.client.mon_fd = fd;
+    session->opts.client.mon_idx = mtarg->session_count;
+    mtarg->sessions[mtarg->session_count] = session;
+    mtarg->session_count++;
+
+    session->flags |= NC_SESSION_CLIENT_MONITORED;
+
+#ifndef HAVE_EPOLL
+    /* let the thread poll the new session */
+    nc_client_monitoring_wakeup(mtarg);
+#endif
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&client_opts.monitoring_thread_data.lock);
+    return ret;
+}
+
+void
+nc_client_monitoring_session_stop(struct nc_session *session, int lock)
+{
+    int r;
+    uint16_t i;
+    struct nc_client_monitoring_thread_arg *mtarg;
+
+    if (lock) {
+        /* LOCK */
+        r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+        if (r < 1) {
+            return;
+        }
+    }
+
+    mtarg = &client_opts.monitoring_thread_data;
+
+    /* session is no longer monitored (is being freed) */
+    if (!(session->flags & NC_SESSION_CLIENT_MONITORED)) {
+        goto cleanup;
+    }
+
+    /* the session knows its index */
+    i = session->opts.client.mon_idx;
+    if ((i >= mtarg->session_count) || (mtarg->sessions[i] != session)) {
+        ERRINT;
+        goto cleanup;
+    }
+
+#ifdef HAVE_EPOLL
+    epoll_ctl(mtarg->epfd, EPOLL_CTL_DEL, session->opts.client.mon_fd, NULL);
+#endif
+    close(session->opts.client.mon_fd);
+    session->opts.client.mon_fd = -1;
+
+    /* move the last session in its place */
+    mtarg->session_count--;
+    if (i < mtarg->session_count) {
+        mtarg->sessions[i] = mtarg->sessions[mtarg->session_count];
+        mtarg->sessions[i]->opts.client.mon_idx = i;
+#ifndef HAVE_EPOLL
+        mtarg->pfds[i + 1] = mtarg->pfds[mtarg->session_count + 1];
+#endif
+    }
+
+    /* any event of the session the thread is just processing is stale now */
+    mtarg->removals++;
+
+    session->flags &= ~NC_SESSION_CLIENT_MONITORED;
+
+#ifndef HAVE_EPOLL
+    /* the thread may be polling the closed file descriptor */
+    nc_client_monitoring_wakeup(mtarg);
+#endif
+
+cleanup:
+    if (lock) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&mtarg->lock);
+    }
+}
+
+/**
+ * @brief Monitoring thread for client sessions.
+ *
+ * Sleeps until a monitored session is closed by the server or the thread is woken up.
+ *
+ * @param[in] arg Thread context of the creating thread.
+ * @return NULL.
+ */
+static void *
+nc_client_monitoring_thread(void *arg)
+{
+    int r, n, locked = 0;
+    uint32_t removals;
+    struct nc_client_monitoring_thread_arg *mtarg;
+    struct nc_session *session = NULL;
+
+#ifdef HAVE_EPOLL
+    struct epoll_event events[NC_CLIENT_MONITORING_EVENTS];
+    int i;
+#else
+    struct pollfd *pfds = NULL;
+    nfds_t i, pfd_count, pfd_size = 0;
+    void *tmp;
+#endif
+
+    /* set this thread's context to the one from the thread that started the monitoring thread */
+    nc_client_set_thread_context(arg);
+
+    /* LOCK */
+    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+    if (r < 1) {
+        goto cleanup;
+    }
+    locked = 1;
+
+    mtarg = &client_opts.monitoring_thread_data;
+
+    while (mtarg->thread_running) {
+        removals = mtarg->removals;
+
+#ifndef HAVE_EPOLL
+        /* poll a copy of the file descriptors, they may change meanwhile */
+        pfd_count = mtarg->session_count + 1;
+        if (pfd_count > pfd_size) {
+            tmp = realloc(pfds, pfd_count * sizeof *pfds);
+            NC_CHECK_ERRMEM_GOTO(!tmp, , cleanup);
+            pfds = tmp;
+            pfd_size = pfd_count;
+        }
+        memcpy(pfds, mtarg->pfds, pfd_count * sizeof *pfds);
+#endif
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&mtarg->lock);
+        locked = 0;
+
+        /* wait for a closed session or a wakeup */
+#ifdef HAVE_EPOLL
+        n = epoll_wait(mtarg->epfd, events, NC_CLIENT_MONITORING_EVENTS, -1);
+#else
+        n = poll(pfds, pfd_count, -1);
+#endif
+        if ((n == -1) && (errno != EINTR)) {
+            ERR(NULL, "Client monitoring thread: waiting for events failed (%s).", strerror(errno));
+            goto cleanup;
+        }
+
+        /* LOCK */
+        r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+        if (r < 1) {
+            goto cleanup;
+        }
+        locked = 1;
+
+        if ((n < 1) || (removals != mtarg->removals)) {
+            /* interrupted or the events may belong to a removed session, pending events are reported again */
+            continue;
+        }
+
+#ifdef HAVE_EPOLL
+        for (i = 0; i < n; i++) {
+            if (!events[i].data.ptr) {
+                nc_client_monitoring_wakeup_clear(mtarg);
+            } else if (!session && (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                session = events[i].data.ptr;
+            }
+        }
+#else
+        if (pfds[0].revents & POLLIN) {
+            nc_client_monitoring_wakeup_clear(mtarg);
+        }
+        for (i = 1; i < pfd_count; i++) {
+            if (pfds[i].revents & (POLLHUP | POLLNVAL)) {
+                /* no session was removed so the indices are still valid */
+                session = mtarg->sessions[i - 1];
+                break;
+            }
+        }
+#endif
+        if (!session) {
+            continue;
+        }
+
+        /* save the session and stop monitoring it, callback will be called outside of the lock */
+        session->status = NC_STATUS_INVALID;
+        session->term_reason = NC_SESSION_TERM_DROPPED;
+        nc_client_monitoring_session_stop(session, 0);
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&mtarg->lock);
+        locked = 0;
+
+        /* call the callback right away */
+        mtarg->clb(session, mtarg->clb_data);
+        session = NULL;
+
+        /* LOCK */
+        r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+        if (r < 1) {
+            goto cleanup;
+        }
+        locked = 1;
+    }
+
+cleanup:
+    if (locked) {
+        /* UNLOCK */
+        pthread_mutex_unlock(&mtarg->lock);
+    }
+#ifndef HAVE_EPOLL
+    free(pfds);
+#endif
+    VRB(NULL, "Client monitoring thread exit.");
+    return NULL;
+}
+
+API int
+nc_client_monitoring_thread_start(nc_client_monitoring_clb monitoring_clb, void *user_data, void (*free_data)(void *))
+{
+    int ret = 0, r;
+    void *ctx;
+
+    NC_CHECK_ARG_RET(NULL, monitoring_clb, 1);
+
+    /* LOCK */
+    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+    if (r < 1) {
+        return 1;
+    }
+
+    if (client_opts.monitoring_thread_data.thread_running) {
+        ERR(NULL, "Client monitoring thread is already running.");
+        ret = 1;
+        goto cleanup;
+    }
+
+    /* get the current thread context, so that the monitoring thread can use it */
+    ctx = nc_client_get_thread_context();
+    if (!ctx) {
+        ERR(NULL, "Failed to get the client thread context.");
+        ret = 1;
+        goto cleanup;
+    }
+
+    /* create the events the thread waits for */
+    if (nc_client_monitoring_fds_init(&client_opts.monitoring_thread_data)) {
+        ret = 1;
+        goto cleanup;
+    }
+
+    client_opts.monitoring_thread_data.clb = monitoring_clb;
+    client_opts.monitoring_thread_data.clb_data = user_data;
+    client_opts.monitoring_thread_data.clb_free_data = free_data;
+
+    client_opts.monitoring_thread_data.thread_running = 1;
+
+    r = pthread_create(&client_opts.monitoring_thread_data.tid, NULL,
+            nc_client_monitoring_thread, ctx);
+    if (r) {
+        ERR(NULL, "Failed to create the client monitoring thread (%s).", strerror(r));
+        client_opts.monitoring_thread_data.thread_running = 0;
+        client_opts.monitoring_thread_data.clb = NULL;
+        client_opts.monitoring_thread_data.clb_data = NULL;
+        client_opts.monitoring_thread_data.clb_free_data = NULL;
+        nc_client_monitoring_fds_destroy(&client_opts.monitoring_thread_data);
+        ret = 1;
+        goto cleanup;
+    }
+
+cleanup:
+    /* UNLOCK */
+    pthread_mutex_unlock(&client_opts.monitoring_thread_data.lock);
+    return ret;
+}
+
+API void
+nc_client_monitoring_thread_stop(void)
+{
+    int r;
+    pthread_t tid;
+    struct nc_client_monitoring_thread_arg *mtarg;
+
+    /* LOCK */
+    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+    if (r < 1) {
+        return;
+    }
+
+    if (!client_opts.monitoring_thread_data.thread_running) {
+        ERR(NULL, "Client monitoring thread is not running.");
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&client_opts.monitoring_thread_data.lock);
+        return;
+    }
+
+    mtarg = &client_opts.monitoring_thread_data;
+
+    mtarg->thread_running = 0;
+    tid = mtarg->tid;
+
+    /* stop monitoring all the sessions while the lock is held */
+    while (mtarg->session_count) {
+        nc_client_monitoring_session_stop(mtarg->sessions[0], 0);
+    }
+
+    /* wake the thread so that it notices it should stop */
+    nc_client_monitoring_wakeup(mtarg);
 
-    case NC_RPC_DELETESUB:
-        rpc_delsub = (struct nc_rpc_deletesub *)rpc;
+    /* UNLOCK */
+    pthread_mutex_unlock(&mtarg->lock);
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "delete-subscription", 0, &data));
+    r = pthread_join(tid, NULL);
+    if (r) {
+        ERR(NULL, "Failed to join the client monitoring thread (%s).", strerror(r));
+    }
 
-        sprintf(str, "%" PRIu32, rpc_delsub->id);
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
-        break;
+    /* LOCK */
+    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
+    if (r < 1) {
+        return;
+    }
 
-    case NC_RPC_KILLSUB:
-        rpc_killsub = (struct nc_rpc_killsub *)rpc;
+    if (mtarg->clb_free_data) {
+        mtarg->clb_free_data(mtarg->clb_data);
+    }
+    mtarg->clb = NULL;
+    mtarg->clb_data = NULL;
+    mtarg->clb_free_data = NULL;
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "kill-subscription", 0, &data));
+    free(mtarg->sessions);
+    mtarg->sessions = NULL;
+    mtarg->session_size = 0;
 
-        sprintf(str, "%" PRIu32, rpc_killsub->id);
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
-        break;
+    nc_client_monitoring_fds_destroy(mtarg);
 
-    case NC_RPC_ESTABLISHPUSH:
-        rpc_estpush = (struct nc_rpc_establishpush *)rpc;
+    /* UNLOCK */
+    pthread_mutex_unlock(&mtarg->lock);
+}
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "establish-subscription", 0, &data));
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore", rpc_estpush->datastore, 0, NULL));
+API struct nc_client_pool *
+nc_client_pool_new(uint16_t max_idle, uint32_t idle_timeout, uint16_t max_channels)
+{
+    struct nc_client_pool *pool;
 
-        if (rpc_estpush->filter) {
-            if (!rpc_estpush->filter[0] || (rpc_estpush->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod2, "datastore-subtree-filter", rpc_estpush->filter,
-                        LYD_ANYDATA_XML, 0, NULL));
-            } else if (rpc_estpush->filter[0] == '/') {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore-xpath-filter", rpc_estpush->filter, 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "selection-filter-ref", rpc_estpush->filter, 0, NULL));
-            }
-        }
+    pool = calloc(1, sizeof *pool);
+    NC_CHECK_ERRMEM_RET(!pool, NULL);
 
-        if (rpc_estpush->stop) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_estpush->stop, 0, NULL));
-        }
-        if (rpc_estpush->encoding) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "encoding", rpc_estpush->encoding, 0, NULL));
-        }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->max_idle = max_idle;
+    pool->idle_timeout = idle_timeout;
+    pool->max_channels = max_channels ? max_channels : 1;
 
-        if (rpc_estpush->periodic) {
-            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "periodic", 0, &cont));
-            sprintf(str, "%" PRIu32, rpc_estpush->period);
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "period", str, 0, NULL));
-            if (rpc_estpush->anchor_time) {
-                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "anchor-time", rpc_estpush->anchor_time, 0, NULL));
-            }
-        } else {
-            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "on-change", 0, &cont));
-            if (rpc_estpush->dampening_period) {
-                sprintf(str, "%" PRIu32, rpc_estpush->dampening_period);
-                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "dampening-period", str, 0, NULL));
-            }
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "sync-on-start", rpc_estpush->sync_on_start ? "true" : "false", 0,
-                    NULL));
-            if (rpc_estpush->excluded_change) {
-                for (i = 0; rpc_estpush->excluded_change[i]; ++i) {
-                    CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "excluded-change", rpc_estpush->excluded_change[i], 0,
-                            NULL));
-                }
-            }
-        }
-        break;
+    return pool;
+}
 
-    case NC_RPC_MODIFYPUSH:
-        rpc_modpush = (struct nc_rpc_modifypush *)rpc;
+/**
+ * @brief Check whether a pooled session is of the given key.
+ *
+ * @param[in] item Pooled session.
+ * @param[in] ti Transport.
+ * @param[in] host Server host.
+ * @param[in] port Server port.
+ * @param[in] username Optional username.
+ * @param[in] ctx Optional context requested for the session.
+ * @return Whether the key matches.
+ */
+static int
+nc_client_pool_item_match(const struct nc_client_pool_item *item, NC_TRANSPORT_IMPL ti, const char *host, uint16_t port,
+        const char *username, const struct ly_ctx *ctx)
+{
+    if ((item->ti != ti) || (item->port != port) || (item->ctx != ctx) || strcmp(item->host, host)) {
+        return 0;
+    }
+    if (!item->username != !username) {
+        return 0;
+    }
+    if (username && strcmp(item->username, username)) {
+        return 0;
+    }
+    return 1;
+}
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "modify-subscription", 0, &data));
+/**
+ * @brief Check whether a pooled session can still be used.
+ *
+ * Sessions dropped by the server are invalidated by the client monitoring thread, if running.
+ *
+ * @param[in] item Pooled session.
+ * @return Whether the session is usable.
+ */
+static int
+nc_client_pool_item_alive(const struct nc_client_pool_item *item)
+{
+    return (item->session->status == NC_STATUS_RUNNING) && nc_session_is_connected(item->session);
+}
 
-        sprintf(str, "%" PRIu32, rpc_modpush->id);
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore", rpc_modpush->datastore, 0, NULL));
+/**
+ * @brief Actively check that an idle pooled session was not dropped by the server.
+ *
+ * A server closing an idle TCP connection is not noticed by ::nc_client_pool_item_alive() until the client
+ * reads from it. The session is expected to be lent to the caller, the pool lock must not be held.
+ *
+ * @param[in] session Pooled session.
+ * @return Whether the session is usable.
+ */
+static int
+nc_client_pool_session_check(struct nc_session *session)
+{
+    struct pollfd pfd = {.fd = -1, .events = POLLIN};
+    char c;
+    int r;
 
-        if (rpc_modpush->filter) {
-            if (!rpc_modpush->filter[0] || (rpc_modpush->filter[0] == '<')) {
-                CHECK_LYRC_BREAK(lyd_new_any(data, mod2, "datastore-subtree-filter", rpc_modpush->filter,
-                        LYD_ANYDATA_XML, 0, NULL));
-            } else if (rpc_modpush->filter[0] == '/') {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "datastore-xpath-filter", rpc_modpush->filter, 0, NULL));
-            } else {
-                CHECK_LYRC_BREAK(lyd_new_term(data, mod2, "selection-filter-ref", rpc_modpush->filter, 0, NULL));
-            }
-        }
-        if (rpc_modpush->stop) {
-            CHECK_LYRC_BREAK(lyd_new_term(data, mod, "stop-time", rpc_modpush->stop, 0, NULL));
-        }
+    if ((session->status != NC_STATUS_RUNNING) || !nc_session_is_connected(session)) {
+        return 0;
+    }
 
-        if (rpc_modpush->periodic) {
-            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "periodic", 0, &cont));
-            sprintf(str, "%" PRIu32, rpc_modpush->period);
-            CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "period", str, 0, NULL));
-            if (rpc_modpush->anchor_time) {
-                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "anchor-time", rpc_modpush->anchor_time, 0, NULL));
-            }
-        } else {
-            CHECK_LYRC_BREAK(lyd_new_inner(data, mod2, "on-change", 0, &cont));
-            if (rpc_modpush->dampening_period) {
-                sprintf(str, "%" PRIu32, rpc_modpush->dampening_period);
-                CHECK_LYRC_BREAK(lyd_new_term(cont, mod2, "dampening-period", str, 0, NULL));
-            }
-        }
+    switch (session->ti_type) {
+    case NC_TI_UNIX:
+        pfd.fd = session->ti.unixsock.sock;
         break;
+#ifdef NC_ENABLED_SSH_TLS
+    case NC_TI_SSH:
+        /* SESSION IO LOCK, the SSH connection may be shared with other sessions */
+        r = nc_session_io_lock(session, NC_SESSION_LOCK_TIMEOUT, __func__);
+        if (r != 1) {
+            /* the connection is being used */
+            return !r;
+        }
 
-    case NC_RPC_RESYNCSUB:
-        rpc_resyncsub = (struct nc_rpc_resyncsub *)rpc;
+        /* process any received SSH packets, a closed channel or connection is detected */
+        r = ssh_channel_poll(session->ti.libssh.channel, 0);
 
-        CHECK_LYRC_BREAK(lyd_new_inner(NULL, mod, "resync-subscription", 0, &data));
-        sprintf(str, "%" PRIu32, rpc_resyncsub->id);
-        CHECK_LYRC_BREAK(lyd_new_term(data, mod, "id", str, 0, NULL));
+        /* SESSION IO UNLOCK */
+        nc_session_io_unlock(session, __func__);
+        return (r != SSH_ERROR) && (r != SSH_EOF);
+    case NC_TI_TLS:
+        pfd.fd = nc_tls_get_fd_wrap(session);
         break;
-
-    case NC_RPC_UNKNOWN:
-        ERRINT;
-        return NC_MSG_ERROR;
+#endif /* NC_ENABLED_SSH_TLS */
+    default:
+        return 1;
     }
 
-#undef CHECK_LYRC_BREAK
-
-    if (lyrc) {
-        ERR(session, "Failed to create RPC, perhaps a required feature is disabled.");
-        lyd_free_tree(data);
-        return NC_MSG_ERROR;
+    if (nc_poll(&pfd, 1, 0) < 1) {
+        /* nothing received */
+        return 1;
     }
 
-    /* send RPC, store its message ID */
-    r = nc_send_msg_io(session, timeout, data);
-    cur_msgid = session->opts.client.msgid;
+    /* an idle session receives nothing unless the server closed the connection */
+    r = recv(pfd.fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return (r == 1) || ((r == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)));
+}
 
-    if (dofree) {
-        lyd_free_tree(data);
+/**
+ * @brief Free a pooled session.
+ *
+ * @param[in] item Pooled session to free.
+ */
+static void
+nc_client_pool_item_free(struct nc_client_pool_item *item)
+{
+    if (!item) {
+        return;
     }
 
-    if (r == NC_MSG_RPC) {
-        *msgid = cur_msgid;
-    }
-    return r;
+    nc_session_free(item->session, NULL);
+    free(item->host);
+    free(item->username);
+    free(item);
 }
 
-API void
-nc_client_session_set_not_strict(struct nc_session *session)
+/**
+ * @brief Unlink a pooled session to be freed.
+ *
+ * The sessions are moved to @p to_free and freed outside the lock. Sessions sharing an SSH connection are
+ * modified under their IO lock and a session with a channel being opened on its connection is never removed.
+ *
+ * @param[in] pool Pool with the session, lock is expected to be held.
+ * @param[in] item Pooled session.
+ * @param[in] prev Previous item of @p item in the pool.
+ * @param[in,out] to_free List of sessions to free.
+ */
+static void
+nc_client_pool_item_remove(struct nc_client_pool *pool, struct nc_client_pool_item *item, struct nc_client_pool_item *prev,
+        struct nc_client_pool_item **to_free)
 {
-    if (session->side != NC_CLIENT) {
-        ERRARG(NULL, "session");
-        return;
+    if (prev) {
+        prev->next = item->next;
+    } else {
+        pool->items = item->next;
     }
 
-    session->flags |= NC_SESSION_CLIENT_NOT_STRICT;
+    item->next = *to_free;
+    *to_free = item;
 }
 
+#ifdef NC_ENABLED_SSH_TLS
+
 /**
- * @brief Get the file descriptor of a session.
+ * @brief Check whether another NETCONF channel can be opened on the SSH connection of a pooled session.
  *
- * @param[in] session Session.
+ * The pool lock is expected to be held. Connections being used or with a channel being opened are skipped.
  *
- * @return File descriptor of the session or -1 in case of an error.
+ * @param[in] pool Connection pool.
+ * @param[in] session Pooled SSH session.
+ * @return Whether the connection has spare capacity and is not busy.
  */
 static int
-nc_client_monitoring_get_session_fd(struct nc_session *session)
+nc_client_pool_ssh_spare(const struct nc_client_pool *pool, struct nc_session *session)
 {
-    int fd = -1;
+    struct nc_session *siter;
+    uint16_t count = 0;
+    int spare = 1;
 
-    switch (session->ti_type) {
-    case NC_TI_FD:
-        fd = session->ti.fd.in;
-        break;
+    /* SESSION IO LOCK, the sessions on the connection are modified under it */
+    if (nc_session_io_lock(session, 0, __func__) != 1) {
+        return 0;
+    }
+
+    siter = session;
+    do {
+        if (!siter->opts.client.pool_item || siter->opts.client.pool_item->opening) {
+            /* a channel is being opened on the connection */
+            spare = 0;
+            break;
+        }
+        ++count;
+        siter = siter->ti.libssh.next;
+    } while (siter && (siter != session));
+
+    /* SESSION IO UNLOCK */
+    nc_session_io_unlock(session, __func__);
+
+    return spare && (count < pool->max_channels);
+}
+
+#endif /* NC_ENABLED_SSH_TLS */
+
+/**
+ * @brief Connect to a server using the given transport.
+ *
+ * @param[in] ti Transport.
+ * @param[in] host Server host.
+ * @param[in] port Server port.
+ * @param[in] username Optional username.
+ * @param[in] ctx Optional context for the session.
+ * @return Created session, NULL on error.
+ */
+static struct nc_session *
+nc_connect_ti(NC_TRANSPORT_IMPL ti, const char *host, uint16_t port, const char *username, struct ly_ctx *ctx)
+{
+    struct nc_session *session = NULL;
+
+    switch (ti) {
     case NC_TI_UNIX:
-        fd = session->ti.unixsock.sock;
+        session = nc_connect_unix(host, ctx);
         break;
 #ifdef NC_ENABLED_SSH_TLS
     case NC_TI_SSH:
-        fd = ssh_get_fd(session->ti.libssh.session);
+        session = nc_connect_ssh_user(host, port, username, ctx);
         break;
     case NC_TI_TLS:
-        fd = nc_tls_get_fd_wrap(session);
+        session = nc_connect_tls(host, port, ctx);
         break;
 #endif /* NC_ENABLED_SSH_TLS */
-    case NC_TI_NONE:
-        /* invalid */
+    default:
+        ERR(NULL, "Transport not supported by the client connection pool.");
         break;
     }
 
-    return fd;
+    return session;
 }
 
-/**
- * @brief Lock the client monitoring data.
- *
- * @param[in] timeout Timeout in msec to use.
- *
- * @return 1 on success;
- * @return 0 on timeout;
- * @return -1 on error.
- */
-static int
-nc_client_monitoring_lock(int timeout)
+API struct nc_session *
+nc_client_pool_get(struct nc_client_pool *pool, NC_TRANSPORT_IMPL ti, const char *host, uint16_t port,
+        const char *username, struct ly_ctx *ctx)
 {
-    int r;
-    struct timespec ts;
+    struct nc_client_pool_item *item, *prev, *next, *to_free, *parent, *new_item = NULL;
+    struct nc_session *session;
+
+    NC_CHECK_ARG_RET(NULL, pool, host, NULL);
+
+lend:
+    session = NULL;
+    parent = NULL;
+    to_free = NULL;
+
+    /* LOCK */
+    pthread_mutex_lock(&pool->lock);
+
+    /* remove all the dead and expired idle sessions, find an idle session to lend */
+    prev = NULL;
+    for (item = pool->items; item; item = next) {
+        next = item->next;
+        if (item->lent || item->opening) {
+            prev = item;
+            continue;
+        }
+
+        if (!nc_client_pool_item_alive(item) || (pool->idle_timeout && (nc_timeouttime_cur_diff(&item->idle_expire) < 1))) {
+            nc_client_pool_item_remove(pool, item, prev, &to_free);
+            continue;
+        }
 
-    if (timeout > 0) {
-        nc_timeouttime_get(&ts, timeout);
-        r = pthread_mutex_clocklock(&client_opts.monitoring_thread_data.lock, COMPAT_CLOCK_ID, &ts);
-    } else if (!timeout) {
-        r = pthread_mutex_trylock(&client_opts.monitoring_thread_data.lock);
-    } else {
-        r = pthread_mutex_lock(&client_opts.monitoring_thread_data.lock);
+        if (!session && nc_client_pool_item_match(item, ti, host, port, username, ctx)) {
+            item->lent = 1;
+            session = item->session;
+        }
+        prev = item;
     }
 
-    if (r) {
-        ERR(NULL, "Failed to lock the client monitoring data lock (%s).", strerror(r));
-
-        if ((r == EBUSY) || (r == ETIMEDOUT)) {
-            /* timeout */
-            return 0;
+#ifdef NC_ENABLED_SSH_TLS
+    if (!session && (ti == NC_TI_SSH) && (pool->max_channels > 1)) {
+        /* find an existing SSH connection with the spare capacity, it is not freed while the channel is opened */
+        for (item = pool->items; item; item = item->next) {
+            if (nc_client_pool_item_match(item, ti, host, port, username, ctx) && (item->session->status == NC_STATUS_RUNNING) &&
+                    nc_client_pool_ssh_spare(pool, item->session)) {
+                item->opening = 1;
+                parent = item;
+                break;
+            }
         }
+    }
+#endif /* NC_ENABLED_SSH_TLS */
 
-        /* error */
-        return -1;
+    /* UNLOCK */
+    pthread_mutex_unlock(&pool->lock);
+
+    /* free the removed sessions */
+    while (to_free) {
+        item = to_free;
+        to_free = to_free->next;
+        nc_client_pool_item_free(item);
     }
 
-    return 1;
-}
+    if (session && !nc_client_pool_session_check(session)) {
+        /* dropped while idle, remove it and try again */
+        VRB(session, "Pooled session was dropped by the server.");
 
-int
-nc_client_monitoring_session_start(struct nc_session *session)
-{
-    int ret = 0, fd, r;
-    struct nc_client_monitoring_thread_arg *mtarg;
-    void *tmp, *tmp2;
+        /* LOCK */
+        pthread_mutex_lock(&pool->lock);
 
-    /* LOCK */
-    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
-    if (r < 1) {
-        return 1;
+        prev = NULL;
+        for (item = pool->items; item->session != session; item = item->next) {
+            prev = item;
+        }
+        nc_client_pool_item_remove(pool, item, prev, &to_free);
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&pool->lock);
+
+        nc_client_pool_item_free(to_free);
+        goto lend;
     }
 
-    /* check if the monitoring thread is running */
-    if (!client_opts.monitoring_thread_data.thread_running) {
-        goto cleanup;
+#ifdef NC_ENABLED_SSH_TLS
+    if (parent) {
+        /* open another channel on the connection, outside the lock */
+        session = nc_connect_ssh_channel(parent->session, ctx);
+        if (!session) {
+            WRN(parent->session, "Failed to open a new channel on an existing SSH connection, connecting again.");
+        }
+
+        /* LOCK */
+        pthread_mutex_lock(&pool->lock);
+        parent->opening = 0;
+        /* UNLOCK */
+        pthread_mutex_unlock(&pool->lock);
     }
+#endif /* NC_ENABLED_SSH_TLS */
 
-    mtarg = &client_opts.monitoring_thread_data;
+    if (session && session->opts.client.pool_item) {
+        /* idle session lent */
+        return session;
+    }
 
-    /* get the session's file descriptor */
-    fd = nc_client_monitoring_get_session_fd(session);
-    assert(fd != -1);
+    if (!session) {
+        /* create a new session */
+        session = nc_connect_ti(ti, host, port, username, ctx);
+        if (!session) {
+            return NULL;
+        }
+    }
 
-    /* if realloc fails, keep the original sessions without adding the new one */
-    tmp = realloc(mtarg->sessions, (mtarg->session_count + 1) * sizeof *mtarg->sessions);
-    NC_CHECK_ERRMEM_GOTO(!tmp, ret = 1, cleanup);
-    tmp2 = realloc(mtarg->pfds, (mtarg->pfd_count + 1) * sizeof *mtarg->pfds);
-    NC_CHECK_ERRMEM_GOTO(!tmp2, free(tmp); ret = 1, cleanup);
+    /* store the new session */
+    new_item = calloc(1, sizeof *new_item);
+    NC_CHECK_ERRMEM_GOTO(!new_item, nc_session_free(session, NULL); session = NULL, cleanup);
+    new_item->session = session;
+    new_item->ti = ti;
+    new_item->host = strdup(host);
+    new_item->port = port;
+    new_item->username = username ? strdup(username) : NULL;
+    new_item->ctx = ctx;
+    new_item->lent = 1;
+    if (!new_item->host || (username && !new_item->username)) {
+        ERRMEM;
+        session = NULL;
+        goto cleanup;
+    }
+    session->opts.client.pool_item = new_item;
 
-    mtarg->sessions = tmp;
-    mtarg->sessions[mtarg->session_count] = session;
-    mtarg->session_count++;
+    /* LOCK */
+    pthread_mutex_lock(&pool->lock);
 
-    /* we are only interested in POLLHUP or POLLNVAL */
-    mtarg->pfds = tmp2;
-    mtarg->pfds[mtarg->pfd_count].fd = fd;
-    mtarg->pfds[mtarg->pfd_count].events = 0;
-    mtarg->pfds[mtarg->pfd_count].revents = 0;
-    mtarg->pfd_count++;
+    new_item->next = pool->items;
+    pool->items = new_item;
 
-    session->flags |= NC_SESSION_CLIENT_MONITORED;
+    /* UNLOCK */
+    pthread_mutex_unlock(&pool->lock);
+    new_item = NULL;
 
 cleanup:
-    /* UNLOCK */
-    pthread_mutex_unlock(&client_opts.monitoring_thread_data.lock);
-    return ret;
+    nc_client_pool_item_free(new_item);
+    return session;
 }
 
-void
-nc_client_monitoring_session_stop(struct nc_session *session, int lock)
+API void
+nc_client_pool_put(struct nc_client_pool *pool, struct nc_session *session)
 {
-    int i, r;
-    struct nc_client_monitoring_thread_arg *mtarg;
+    struct nc_client_pool_item *key, *item, *prev = NULL, *found = NULL, *found_prev = NULL, *to_free = NULL;
+    uint16_t idle_count = 0;
 
-    if (lock) {
-        /* LOCK */
-        r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
-        if (r < 1) {
-            return;
-        }
+    if (!pool || !session) {
+        return;
     }
 
-    mtarg = &client_opts.monitoring_thread_data;
+    key = (session->side == NC_CLIENT) ? session->opts.client.pool_item : NULL;
+    if (!key) {
+        ERR(session, "Session was not lent by a client connection pool.");
+        return;
+    }
 
-    /* session is no longer monitored (is being freed) */
-    if (!(session->flags & NC_SESSION_CLIENT_MONITORED)) {
-        goto cleanup;
+    /* LOCK */
+    pthread_mutex_lock(&pool->lock);
+
+    /* find the session and count the idle sessions of the same key */
+    for (item = pool->items; item; item = item->next) {
+        if (item == key) {
+            found = item;
+            found_prev = prev;
+        } else if (!item->lent && nc_client_pool_item_match(item, key->ti, key->host, key->port, key->username, key->ctx)) {
+            ++idle_count;
+        }
+        prev = item;
+    }
+    if (!found || !found->lent) {
+        ERR(session, "Session was not lent by the client connection pool.");
+        goto unlock;
     }
 
-    /* find the session */
-    for (i = 0; i < mtarg->session_count; i++) {
-        if (mtarg->sessions[i] == session) {
-            break;
+    if (!found->opening && (!nc_client_pool_item_alive(found) || (pool->max_idle && (idle_count >= pool->max_idle)))) {
+        /* not worth keeping, unless a channel is being opened on its SSH connection */
+        nc_client_pool_item_remove(pool, found, found_prev, &to_free);
+    } else {
+        /* keep it warm */
+        found->lent = 0;
+        if (pool->idle_timeout) {
+            nc_timeouttime_get(&found->idle_expire, pool->idle_timeout * 1000);
         }
     }
-    if (i == mtarg->session_count) {
-        /* not found */
-        ERRINT;
-        goto cleanup;
+
+unlock:
+    /* UNLOCK */
+    pthread_mutex_unlock(&pool->lock);
+
+    nc_client_pool_item_free(to_free);
+}
+
+API void
+nc_client_pool_free(struct nc_client_pool *pool)
+{
+    struct nc_client_pool_item *item, *to_free = NULL;
+
+    if (!pool) {
+        return;
     }
 
-    /* remove the session */
-    mtarg->session_count--;
-    mtarg->pfd_count--;
-    if (!mtarg->session_count) {
-        free(mtarg->sessions);
-        mtarg->sessions = NULL;
-        free(mtarg->pfds);
-        mtarg->pfds = NULL;
-    } else if (mtarg->sessions[i] != mtarg->sessions[mtarg->session_count]) {
-        mtarg->sessions[i] = mtarg->sessions[mtarg->session_count];
-        mtarg->pfds[i] = mtarg->pfds[mtarg->session_count];
+    /* LOCK */
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->items) {
+        item = pool->items;
+        if (item->lent) {
+            WRN(item->session, "Freeing a session still lent by the client connection pool.");
+        }
+        nc_client_pool_item_remove(pool, item, NULL, &to_free);
     }
 
-    session->flags &= ~NC_SESSION_CLIENT_MONITORED;
+    /* UNLOCK */
+    pthread_mutex_unlock(&pool->lock);
 
-cleanup:
-    if (lock) {
-        /* UNLOCK */
-        pthread_mutex_unlock(&mtarg->lock);
+    while (to_free) {
+        item = to_free;
+        to_free = to_free->next;
+        nc_client_pool_item_free(item);
     }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
 }
 
 /**
- * @brief Monitoring thread for client sessions.
+ * @brief Free a connection batch.
  *
- * @param[in] arg Thread context of the creating thread.
- * @return NULL.
+ * @param[in] batch Batch to free, all its threads are expected to be joined.
  */
-static void *
-nc_client_monitoring_thread(void *arg)
+static void
+nc_connect_batch_free(struct nc_connect_batch *batch)
 {
-    int r, locked = 0;
-    struct nc_client_monitoring_thread_arg *mtarg;
-    nfds_t i;
-    struct nc_session *session = NULL;
+    uint32_t i;
 
-    /* set this thread's context to the one from the thread that started the monitoring thread */
-    nc_client_set_thread_context(arg);
+    if (!batch) {
+        return;
+    }
 
-    /* LOCK */
-    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
-    if (r < 1) {
-        goto cleanup;
+    for (i = 0; i < batch->target_count; ++i) {
+        free((char *)batch->targets[i].host);
     }
-    locked = 1;
+    free(batch->targets);
+    free(batch->tids);
+    pthread_mutex_destroy(&batch->lock);
+    free(batch);
+}
 
-    mtarg = &client_opts.monitoring_thread_data;
+/**
+ * @brief Connection batch worker thread.
+ *
+ * @param[in] arg Connection batch.
+ * @return NULL.
+ */
+static void *
+nc_connect_batch_thread(void *arg)
+{
+    struct nc_connect_batch *batch = arg;
+    struct nc_connect_target *target;
+    struct nc_session *session;
 
-    while (mtarg->thread_running) {
-        if (!mtarg->session_count) {
-            goto next_iter;
-        }
+    /* use the client settings of the thread that started the batch */
+    nc_client_set_thread_context(batch->client_ctx);
 
-        /* poll for either POLLIN or POLLHUP events */
-        r = poll(mtarg->pfds, mtarg->pfd_count, 0);
-        if (r == -1) {
-            if (errno == EINTR) {
-                continue;
-            }
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&batch->lock);
 
-            ERR(NULL, "Client monitoring thread: poll failed (%s).", strerror(errno));
-            goto cleanup;
-        } else if (!r) {
-            /* no events */
-            goto next_iter;
-        }
-
-        for (i = 0; i < mtarg->pfd_count; i++) {
-            if (mtarg->pfds[i].revents & (POLLHUP | POLLNVAL)) {
-                /* save the session and stop monitoring it, callback will be called outside of the lock */
-                session = mtarg->sessions[i];
-                session->status = NC_STATUS_INVALID;
-                session->term_reason = NC_SESSION_TERM_DROPPED;
-                nc_client_monitoring_session_stop(session, 0);
-                break;
-            }
+        if (batch->canceled || (batch->next == batch->target_count)) {
+            target = NULL;
+        } else {
+            target = &batch->targets[batch->next++];
         }
 
-next_iter:
         /* UNLOCK */
-        pthread_mutex_unlock(&mtarg->lock);
-        locked = 0;
+        pthread_mutex_unlock(&batch->lock);
 
-        /* if an event occurred, call the callback */
-        if (session) {
-            mtarg->clb(session, mtarg->clb_data);
+        if (!target) {
+            break;
         }
-        session = NULL;
-
-        usleep(NC_CLIENT_MONITORING_BACKOFF * 1000);
 
-        /* LOCK */
-        r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
-        if (r < 1) {
-            goto cleanup;
+        session = nc_connect_ti(target->ti, target->host, target->port, NULL, target->ctx);
+        if (!session) {
+            /* LOCK */
+            pthread_mutex_lock(&batch->lock);
+            ++batch->failed;
+            /* UNLOCK */
+            pthread_mutex_unlock(&batch->lock);
         }
-        locked = 1;
-    }
 
-cleanup:
-    if (locked) {
-        /* UNLOCK */
-        pthread_mutex_unlock(&mtarg->lock);
+        batch->clb(target, session, batch->clb_data);
     }
-    VRB(NULL, "Client monitoring thread exit.");
+
     return NULL;
 }
 
-API int
-nc_client_monitoring_thread_start(nc_client_monitoring_clb monitoring_clb, void *user_data, void (*free_data)(void *))
+API struct nc_connect_batch *
+nc_connect_batch_start(const struct nc_connect_target *targets, uint32_t target_count, uint16_t max_concurrent,
+        nc_connect_clb clb, void *user_data)
 {
-    int ret = 0, r;
-    void *ctx;
+    struct nc_connect_batch *batch;
+    uint32_t i;
+    int r;
 
-    NC_CHECK_ARG_RET(NULL, monitoring_clb, 1);
+    NC_CHECK_ARG_RET(NULL, targets, target_count, clb, NULL);
 
-    /* LOCK */
-    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
-    if (r < 1) {
-        return 1;
+    for (i = 0; i < target_count; ++i) {
+        if (!targets[i].host) {
+            ERRARG(NULL, "targets");
+            return NULL;
+        }
     }
 
-    if (client_opts.monitoring_thread_data.thread_running) {
-        ERR(NULL, "Client monitoring thread is already running.");
-        ret = 1;
-        goto cleanup;
+    batch = calloc(1, sizeof *batch);
+    NC_CHECK_ERRMEM_RET(!batch, NULL);
+    pthread_mutex_init(&batch->lock, NULL);
+    batch->clb = clb;
+    batch->clb_data = user_data;
+
+    /* copy the targets */
+    batch->targets = calloc(target_count, sizeof *batch->targets);
+    NC_CHECK_ERRMEM_GOTO(!batch->targets, , error);
+    for (i = 0; i < target_count; ++i) {
+        batch->targets[i] = targets[i];
+        batch->targets[i].host = strdup(targets[i].host);
+        NC_CHECK_ERRMEM_GOTO(!batch->targets[i].host, batch->target_count = i, error);
     }
+    batch->target_count = target_count;
 
-    client_opts.monitoring_thread_data.clb = monitoring_clb;
-    client_opts.monitoring_thread_data.clb_data = user_data;
-    client_opts.monitoring_thread_data.clb_free_data = free_data;
+    /* the worker threads share the client settings of this thread */
+    batch->client_ctx = nc_client_get_thread_context();
 
-    /* get the current thread context, so that the monitoring thread can use it */
-    ctx = nc_client_get_thread_context();
-    if (!ctx) {
-        ERR(NULL, "Failed to get the client thread context.");
-        ret = 1;
-        goto cleanup;
+    if (!max_concurrent) {
+        /* every worker thread blocks in a connection, keep their number small */
+        max_concurrent = NC_CONNECT_BATCH_THREADS;
     }
+    if (max_concurrent > target_count) {
+        max_concurrent = target_count;
+    }
+    batch->tids = malloc(max_concurrent * sizeof *batch->tids);
+    NC_CHECK_ERRMEM_GOTO(!batch->tids, , error);
 
-    client_opts.monitoring_thread_data.thread_running = 1;
-
-    r = pthread_create(&client_opts.monitoring_thread_data.tid, NULL,
-            nc_client_monitoring_thread, ctx);
-    if (r) {
-        ERR(NULL, "Failed to create the client monitoring thread (%s).", strerror(r));
-        ret = 1;
-        goto cleanup;
+    for (i = 0; i < max_concurrent; ++i) {
+        r = pthread_create(&batch->tids[i], NULL, nc_connect_batch_thread, batch);
+        if (r) {
+            /* use the threads created so far */
+            WRN(NULL, "Failed to create a connection batch thread (%s).", strerror(r));
+            break;
+        }
+        ++batch->thread_count;
+    }
+    if (!batch->thread_count) {
+        ERR(NULL, "Failed to create any connection batch threads.");
+        goto error;
     }
 
-cleanup:
-    /* UNLOCK */
-    pthread_mutex_unlock(&client_opts.monitoring_thread_data.lock);
-    return ret;
+    return batch;
+
+error:
+    nc_connect_batch_free(batch);
+    return NULL;
 }
 
 API void
-nc_client_monitoring_thread_stop(void)
+nc_connect_batch_cancel(struct nc_connect_batch *batch)
 {
-    int r, i;
-    pthread_t tid;
-    struct nc_client_monitoring_thread_arg *mtarg;
-
-    /* LOCK */
-    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
-    if (r < 1) {
-        return;
-    }
-
-    if (!client_opts.monitoring_thread_data.thread_running) {
-        ERR(NULL, "Client monitoring thread is not running.");
-
-        /* UNLOCK */
-        pthread_mutex_unlock(&client_opts.monitoring_thread_data.lock);
+    if (!batch) {
         return;
     }
 
-    mtarg = &client_opts.monitoring_thread_data;
-
-    mtarg->thread_running = 0;
-    tid = mtarg->tid;
+    /* LOCK */
+    pthread_mutex_lock(&batch->lock);
 
-    /* remove the flag from the session while the lock is held */
-    for (i = 0; i < mtarg->session_count; i++) {
-        mtarg->sessions[i]->flags &= ~NC_SESSION_CLIENT_MONITORED;
-    }
+    batch->canceled = 1;
 
     /* UNLOCK */
-    pthread_mutex_unlock(&mtarg->lock);
+    pthread_mutex_unlock(&batch->lock);
+}
 
-    r = pthread_join(tid, NULL);
-    if (r) {
-        ERR(NULL, "Failed to join the client monitoring thread (%s).", strerror(r));
-    }
+API uint32_t
+nc_connect_batch_wait(struct nc_connect_batch *batch)
+{
+    uint32_t failed;
+    uint16_t i;
 
-    /* LOCK */
-    r = nc_client_monitoring_lock(NC_CLIENT_MONITORING_LOCK_TIMEOUT);
-    if (r < 1) {
-        return;
+    if (!batch) {
+        return 0;
     }
 
-    if (mtarg->clb_free_data) {
-        mtarg->clb_free_data(mtarg->clb_data);
+    for (i = 0; i < batch->thread_count; ++i) {
+        pthread_join(batch->tids[i], NULL);
     }
-    mtarg->clb = NULL;
-    mtarg->clb_data = NULL;
-    mtarg->clb_free_data = NULL;
-
-    free(mtarg->sessions);
-    mtarg->sessions = NULL;
 
-    free(mtarg->pfds);
-    mtarg->pfds = NULL;
+    /* failed and skipped targets */
+    failed = batch->failed + (batch->target_count - batch->next);
 
-    /* UNLOCK */
-    pthread_mutex_unlock(&mtarg->lock);
+    nc_connect_batch_free(batch);
+    return failed;
 }
 
 API void
@@ -59,6 +59,32 @@ int nc_client_set_schema_searchpath(const char *path);
  */
 const char *nc_client_get_schema_searchpath(void);
 
+/**
+ * @brief Set the location of a persistent cache of YANG modules retrieved from servers.
+ *
+ * Every module retrieved via \<get-schema\> is stored in the cache and any module needed
+ * for a new session context is looked for in the cache first. Modules are stored content-addressed
+ * (by a hash of their text) and found by their name and revision or, if a module has no revision,
+ * by its name and the yang-library content-id of the server. A module without a revision is not
+ * cached if the server does not provide a content-id.
+ *
+ * The cache can be safely shared by several processes. When its size exceeds @p size_limit,
+ * the least recently used modules are removed.
+ *
+ * @param[in] path Cache directory, created if it does not exist. NULL to disable the cache.
+ * @param[in] size_limit Maximum size of all the cached modules in bytes, 0 for no limit.
+ * @return 0 on success, 1 on (memory allocation) failure.
+ */
+int nc_client_set_module_cache(const char *path, size_t size_limit);
+
+/**
+ * @brief Get the module cache location set by nc_client_set_module_cache().
+ *
+ * @param[out] size_limit Optional maximum size of the cache.
+ * @return Cache directory, NULL if not set.
+ */
+const char *nc_client_get_module_cache(size_t *size_limit);
+
 /**
  * @brief Set callback function to get missing schemas.
  *
@@ -89,6 +115,53 @@ ly_module_imp_clb nc_client_get_schema_callback(void **user_data);
  */
 void nc_client_set_new_session_context_autofill(int enabled);
 
+/**
+ * @brief Enable/disable sharing of contexts among new sessions with the same
+ * set of YANG modules.
+ *
+ * When enabled, the module set learned from the server (its capabilities and
+ * yang-library data) is fingerprinted after connecting and if another session
+ * already has a context filled for the identical module set (and with the same
+ * schema searchpath and callback), the context is reused instead of compiling
+ * a new one. The shared context is freed when the last session using it is freed.
+ * Shared contexts must not be modified, so do not enable this if the contexts
+ * of the sessions are updated by the application. Contexts of servers supporting
+ * schema-mount are never shared.
+ *
+ * Disabled by default, has no effect if the context is provided by the caller
+ * or context autofill is disabled.
+ *
+ * @param[in] enabled Whether context sharing is enabled or disabled.
+ */
+void nc_client_set_new_session_context_sharing(int enabled);
+
+/**
+ * @brief Enable/disable loading of the YANG modules supported by the server
+ * into the context of a new session on demand.
+ *
+ * When enabled, only ietf-netconf (and ietf-netconf-monitoring and ietf-yang-library,
+ * if supported by the server) and the explicitly listed @p modules are loaded
+ * when a new session is created. Any other module implemented by the server is
+ * loaded once an RPC sent or a reply or a notification received on the session
+ * first uses its namespace, or when an RPC defined in the module is created by
+ * the library.
+ *
+ * Note that loading a module may require recompiling the context, in which case
+ * any data trees received on the session before become invalid. So free the data
+ * received on the session before sending or receiving further messages. Also,
+ * data trees created by the application using the session context need the
+ * modules loaded beforehand, list them in @p modules.
+ *
+ * Disabled by default, has no effect if the context is provided by the caller
+ * or context autofill is disabled. Contexts of such sessions are never shared
+ * (see ::nc_client_set_new_session_context_sharing()).
+ *
+ * @param[in] enabled Whether on-demand loading is enabled or disabled.
+ * @param[in] modules Optional NULL-terminated list of names of the modules to load right away.
+ * @return 0 on success, 1 on (memory allocation) failure.
+ */
+int nc_client_set_new_session_context_lazy(int enabled, const char **modules);
+
 /**
  * @brief Set client session context to support schema-mount, if possible.
  *
@@ -449,6 +522,29 @@ int nc_client_tls_set_trusted_ca_paths(const char *ca_file, const char *ca_dir);
  */
 void nc_client_tls_get_trusted_ca_paths(const char **ca_file, const char **ca_dir);
 
+/**
+ * @brief Enable or disable kernel TLS (kTLS) offload of new TLS sessions, disabled by default.
+ *
+ * Once the handshake finishes, record encryption and decryption is handed over to the kernel if supported
+ * by the TLS library (only OpenSSL built with kTLS), the kernel (Linux tls module), and the negotiated
+ * cipher suite. Otherwise, the session silently falls back to user-space encryption. Messages on sessions
+ * with offloaded encryption are written directly to the socket. See ::nc_session_tls_get_ktls().
+ *
+ * @param[in] enabled Non-zero to enable the offload, 0 to disable it.
+ */
+void nc_client_tls_set_ktls(int enabled);
+
+/**
+ * @brief Enable or disable dynamic TLS record sizing of new TLS sessions, disabled by default.
+ *
+ * Messages are always sent in records as large as possible (16 kB). With dynamic record sizing, sessions
+ * that were idle for a while send small records fitting a single TCP segment first, so that the peer can
+ * start processing a message before the whole record arrives, and switch to large records for bulk data.
+ *
+ * @param[in] enabled Non-zero to enable dynamic record sizing, 0 to disable it.
+ */
+void nc_client_tls_set_dynamic_record_sizing(int enabled);
+
 /**
  * @brief Deprecated.
  */
@@ -537,6 +633,52 @@ int nc_session_ntf_thread_running(const struct nc_session *session);
 NC_MSG_TYPE nc_recv_reply(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout,
         struct lyd_node **envp, struct lyd_node **op);
 
+/**
+ * @brief Callback for a parsed part of reply data.
+ *
+ * @param[in] session NETCONF session the reply was received on.
+ * @param[in] subtree Parsed data subtree, it is freed once the callback returns.
+ * @param[in] user_data Arbitrary user data.
+ * @return 0 to continue with the next part, non-zero to skip the rest of the data.
+ */
+typedef int (*nc_reply_subtree_clb)(struct nc_session *session, struct lyd_node *subtree, void *user_data);
+
+/**
+ * @brief Receive NETCONF RPC reply and pass its data to a callback part by part.
+ *
+ * Instead of parsing a large \<data\> reply (\<get\>, \<get-config\>, \<get-data\>) into a single tree, every
+ * top-level data subtree is parsed and passed to @p clb separately and freed right after, so the memory used
+ * by the parsed data stays bounded by the largest part. With @p batch set, the children of every top-level
+ * container (or every top-level node for ::NC_CLIENT_PARSE_OPAQ) are further split into groups of at most
+ * @p batch nodes, each passed in a copy of the container, which suits containers with long lists. Replies
+ * without \<data\> are parsed as a whole and any output nodes passed to @p clb one by one.
+ *
+ * The data are parsed while the message is being read so only the part being parsed is kept in memory, not
+ * the whole message. Meanwhile, the session is locked and @p clb must not use it. If the session context loads
+ * modules on demand (::nc_client_set_new_session_context_lazy()), which may require communication on the session,
+ * the whole message is received first.
+ *
+ * @note This function can be called in a single thread only.
+ *
+ * @param[in] session NETCONF session from which the function gets data. It must be the
+ * client side session object.
+ * @param[in] rpc Original RPC this should be the reply to.
+ * @param[in] msgid Expected message ID of the reply.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite
+ * waiting and 0 for immediate return if data are not available on the wire.
+ * @param[in] batch Maximum number of container children in a single part, 0 to pass whole top-level subtrees.
+ * @param[in] clb Callback called for every parsed part of the data.
+ * @param[in] user_data Arbitrary user data passed to @p clb.
+ * @param[out] envp NETCONF rpc-reply XML envelopes.
+ * @return #NC_MSG_REPLY for success (even if @p clb skipped some data),
+ *         #NC_MSG_WOULDBLOCK if @p timeout has elapsed,
+ *         #NC_MSG_ERROR if reading or parsing has failed,
+ *         #NC_MSG_NOTIF if a notification was read instead (call this function again to get the reply), and
+ *         #NC_MSG_REPLY_ERR_MSGID if a reply with missing or wrong message-id was received.
+ */
+NC_MSG_TYPE nc_recv_reply_stream(struct nc_session *session, struct nc_rpc *rpc, uint64_t msgid, int timeout,
+        uint32_t batch, nc_reply_subtree_clb clb, void *user_data, struct lyd_node **envp);
+
 /**
  * @brief Receive NETCONF Notification.
  *
@@ -592,6 +734,48 @@ int nc_recv_notif_dispatch(struct nc_session *session, nc_notif_dispatch_clb not
 int nc_recv_notif_dispatch_data(struct nc_session *session, nc_notif_dispatch_clb notif_clb, void *user_data,
         void (*free_data)(void *));
 
+/**
+ * @brief Opaque notification dispatcher, receives notifications of any number of sessions in a single thread.
+ */
+struct nc_notif_dispatcher;
+
+/**
+ * @brief Create a notification dispatcher and start its thread.
+ *
+ * The dispatcher waits for data on all its sessions at once and receives every available notification
+ * of a session before waiting again.
+ *
+ * @param[in] worker_count Number of worker threads to call the notification callbacks in. Notifications
+ * of a single session are always passed to the callback in a single worker so their order is kept.
+ * If 0, the callbacks are called directly in the dispatcher thread.
+ * @return Created dispatcher, NULL on error.
+ */
+struct nc_notif_dispatcher *nc_notif_dispatcher_new(uint16_t worker_count);
+
+/**
+ * @brief Receive NETCONF Notifications of a session in a notification dispatcher until the session is terminated
+ * or \<notificationComplete\> is received. Replaces ::nc_recv_notif_dispatch_data() thread for this session.
+ *
+ * @param[in] disp Notification dispatcher.
+ * @param[in] session Netconf session to read notifications from.
+ * @param[in] notif_clb Callback that is called for every received notification (including \<notificationComplete\>).
+ * @param[in] user_data Arbitrary user data.
+ * @param[in] free_data Callback for freeing the user data once the session is no longer dispatched.
+ * @return 0 on success, -1 on error.
+ */
+int nc_notif_dispatcher_add_session(struct nc_notif_dispatcher *disp, struct nc_session *session,
+        nc_notif_dispatch_clb notif_clb, void *user_data, void (*free_data)(void *));
+
+/**
+ * @brief Stop and free a notification dispatcher.
+ *
+ * All the sessions stop being dispatched, notifications already received are still passed to their callbacks.
+ * The sessions themselves are not freed.
+ *
+ * @param[in] disp Notification dispatcher to free.
+ */
+void nc_notif_dispatcher_free(struct nc_notif_dispatcher *disp);
+
 /**
  * @brief Send NETCONF RPC message via the session.
  *
@@ -606,6 +790,117 @@ int nc_recv_notif_dispatch_data(struct nc_session *session, nc_notif_dispatch_cl
  */
 NC_MSG_TYPE nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int timeout, uint64_t *msgid);
 
+/**
+ * @brief NETCONF RPC printed once to be sent many times, see ::nc_rpc_prepare().
+ */
+struct nc_rpc_prepared;
+
+/**
+ * @brief Create and print an RPC once so that it can be repeatedly sent with minimal overhead.
+ *
+ * Useful for RPCs sent periodically without any change, such as \<get\> with the same filter.
+ *
+ * @param[in] session NETCONF session whose context is used to create the RPC.
+ * @param[in] rpc NETCONF RPC object to prepare, is not needed by the prepared RPC afterwards.
+ * @return Prepared RPC, NULL on error.
+ */
+struct nc_rpc_prepared *nc_rpc_prepare(struct nc_session *session, struct nc_rpc *rpc);
+
+/**
+ * @brief Send a prepared NETCONF RPC message via the session.
+ *
+ * Only the message-id is generated, the rest of the message is written as printed by ::nc_rpc_prepare().
+ * Receive its reply using ::nc_recv_reply() with the RPC object the prepared RPC was created from.
+ *
+ * @param[in] session NETCONF session where the RPC will be written, should have the same context
+ * as the one used for preparing the RPC.
+ * @param[in] rpc Prepared RPC to send.
+ * @param[in] timeout Timeout for writing in milliseconds. Use negative value for infinite
+ * waiting and 0 for return if data cannot be sent immediately.
+ * @param[out] msgid If RPC was successfully sent, this is it's message ID.
+ * @return #NC_MSG_RPC on success,
+ *         #NC_MSG_WOULDBLOCK in case of a busy session, and
+ *         #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_send_rpc_prepared(struct nc_session *session, const struct nc_rpc_prepared *rpc, int timeout,
+        uint64_t *msgid);
+
+/**
+ * @brief Free a prepared NETCONF RPC.
+ *
+ * @param[in] rpc Prepared RPC to free.
+ */
+void nc_rpc_prepared_free(struct nc_rpc_prepared *rpc);
+
+/**
+ * @brief Callback for receiving replies to RPCs sent by ::nc_send_rpc_async().
+ *
+ * @param[in] session NETCONF session the reply was received on.
+ * @param[in] msgid Message ID of the RPC the reply belongs to.
+ * @param[in] type #NC_MSG_REPLY if the reply was parsed, #NC_MSG_ERROR if parsing failed.
+ * @param[in] envp NETCONF rpc-reply XML envelopes, NULL on error.
+ * @param[in] op Parsed NETCONF reply data, if any (none for \<ok\> or error replies).
+ * @param[in] user_data Arbitrary user data passed to ::nc_send_rpc_async().
+ */
+typedef void (*nc_rpc_reply_clb)(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE type,
+        const struct lyd_node *envp, const struct lyd_node *op, void *user_data);
+
+/**
+ * @brief Send NETCONF RPC message via the session without waiting for its reply.
+ *
+ * Any number of RPCs can be sent this way before their replies arrive. Every reply is routed
+ * to its RPC by its message-id and then either passed to @p reply_clb by ::nc_recv_reply_dispatch()
+ * or returned by ::nc_recv_reply_async(), if no callback was set. Replies are also routed while
+ * reading messages by ::nc_recv_reply() and ::nc_recv_notif() so they are never lost.
+ *
+ * Pending RPCs whose replies were not received are discarded when the session is freed,
+ * their callbacks are not called.
+ *
+ * @param[in] session NETCONF session where the RPC will be written.
+ * @param[in] rpc NETCONF RPC object to send via the specified session.
+ * @param[in] timeout Timeout for writing in milliseconds. Use negative value for infinite
+ * waiting and 0 for return if data cannot be sent immediately.
+ * @param[in] reply_clb Optional callback to be called with the reply.
+ * @param[in] user_data Arbitrary user data passed to @p reply_clb.
+ * @param[out] msgid If RPC was successfully sent, this is it's message ID.
+ * @return #NC_MSG_RPC on success,
+ *         #NC_MSG_WOULDBLOCK in case of a busy session, and
+ *         #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_send_rpc_async(struct nc_session *session, struct nc_rpc *rpc, int timeout, nc_rpc_reply_clb reply_clb,
+        void *user_data, uint64_t *msgid);
+
+/**
+ * @brief Receive replies to RPCs sent by ::nc_send_rpc_async() and pass them to their callbacks.
+ *
+ * If no received reply is waiting, a single message is read. Callbacks are called from this function
+ * without any session lock held so they may send further RPCs.
+ *
+ * @param[in] session NETCONF session from which the function gets data.
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite
+ * waiting and 0 for immediate return if data are not available on the wire.
+ * @return Number of replies passed to their callbacks (may be 0), -1 on error.
+ */
+int nc_recv_reply_dispatch(struct nc_session *session, int timeout);
+
+/**
+ * @brief Receive a reply to an RPC sent by ::nc_send_rpc_async() without a callback.
+ *
+ * Replies to other RPCs read meanwhile are routed to their RPCs and can be received in any order.
+ *
+ * @param[in] session NETCONF session from which the function gets data.
+ * @param[in] msgid Message ID of the RPC returned by ::nc_send_rpc_async().
+ * @param[in] timeout Timeout for reading in milliseconds. Use negative value for infinite
+ * waiting and 0 for immediate return if data are not available on the wire.
+ * @param[out] envp NETCONF rpc-reply XML envelopes.
+ * @param[out] op Parsed NETCONF reply data, if any (none for \<ok\> or error replies).
+ * @return #NC_MSG_REPLY for success,
+ *         #NC_MSG_WOULDBLOCK if @p timeout has elapsed (the reply can still be received later), and
+ *         #NC_MSG_ERROR on error or if there is no such pending RPC.
+ */
+NC_MSG_TYPE nc_recv_reply_async(struct nc_session *session, uint64_t msgid, int timeout, struct lyd_node **envp,
+        struct lyd_node **op);
+
 /**
  * @brief Make a session not strict when sending RPCs and receiving RPC replies. In other words,
  * it will silently skip unknown nodes without an error.
@@ -617,6 +912,68 @@ NC_MSG_TYPE nc_send_rpc(struct nc_session *session, struct nc_rpc *rpc, int time
  */
 void nc_client_session_set_not_strict(struct nc_session *session);
 
+/**
+ * @brief Limit the size of messages buffered on a session.
+ *
+ * Messages are buffered when an rpc-reply is received while waiting for a notification or vice versa,
+ * for example, when notifications are received while no one is reading them. Once the limit is reached,
+ * any further received notifications that would have been buffered are dropped and a warning is printed.
+ * Replies are always buffered, but count towards the limit.
+ *
+ * @param[in] session NETCONF client session.
+ * @param[in] limit Maximum size of all the buffered messages in bytes, 0 for no limit (default).
+ */
+void nc_client_session_set_msg_buffer_limit(struct nc_session *session, size_t limit);
+
+/**
+ * @brief How received RPC replies and notifications are parsed.
+ */
+typedef enum {
+    NC_CLIENT_PARSE_SCHEMA = 0, /**< parse the messages using the session context (default) */
+    NC_CLIENT_PARSE_OPAQ        /**< parse the messages into opaque nodes without using any schema */
+} NC_CLIENT_PARSE_MODE;
+
+/**
+ * @brief Statistics of parsing received RPC replies and notifications on a session.
+ */
+struct nc_client_parse_stats {
+    uint64_t schema_count;      /**< number of messages parsed using the session context */
+    uint64_t schema_bytes;      /**< size of messages parsed using the session context */
+    uint64_t schema_usec;       /**< time spent parsing messages using the session context */
+    uint64_t opaq_count;        /**< number of messages parsed into opaque nodes */
+    uint64_t opaq_bytes;        /**< size of messages parsed into opaque nodes */
+    uint64_t opaq_usec;         /**< time spent parsing messages into opaque nodes */
+    uint64_t saved_usec;        /**< rough estimate of the time saved by parsing into opaque nodes, assumes
+                                     the opaque messages would take as long per byte as the messages parsed
+                                     using the session context, 0 until there is at least one such message */
+};
+
+/**
+ * @brief Set how RPC replies and notifications received on a session are parsed.
+ *
+ * Messages from a trusted server that are only passed on or inspected by the application can be parsed
+ * into opaque nodes (::NC_CLIENT_PARSE_OPAQ), which skips any schema lookups and value resolution. The whole
+ * RPC reply is then returned in the envelopes by ::nc_recv_reply() and ::nc_recv_reply_async() (the operation
+ * is always NULL) and the notification operation returned by ::nc_recv_notif() is an opaque node. Such nodes
+ * are not from the session context and must be freed before the session.
+ *
+ * Set it before receiving any messages on the session.
+ *
+ * @param[in] session NETCONF client session.
+ * @param[in] mode Parse mode to use.
+ * @return 0 on success, -1 on error.
+ */
+int nc_client_session_set_parse_mode(struct nc_session *session, NC_CLIENT_PARSE_MODE mode);
+
+/**
+ * @brief Get the statistics of parsing RPC replies and notifications received on a session.
+ *
+ * @param[in] session NETCONF client session.
+ * @param[out] stats Parse statistics.
+ * @return 0 on success, -1 on error.
+ */
+int nc_client_session_get_parse_stats(const struct nc_session *session, struct nc_client_parse_stats *stats);
+
 /**
  * @brief Callback for monitoring client sessions.
  *
@@ -648,6 +1005,131 @@ int nc_client_monitoring_thread_start(nc_client_monitoring_clb monitoring_clb, v
  */
 void nc_client_monitoring_thread_stop(void);
 
+/**
+ * @brief Opaque client connection pool, keeps established sessions to be reused.
+ */
+struct nc_client_pool;
+
+/**
+ * @brief Create a client connection pool.
+ *
+ * Sessions in the pool are identified by their transport, host, port, and username and lent out
+ * exclusively. Dropped sessions are detected when lent or returned and, if the client monitoring
+ * thread is running (see ::nc_client_monitoring_thread_start()), right when they are dropped
+ * (with the help of TCP keepalives, see ::nc_client_enable_tcp_keepalives()).
+ *
+ * @param[in] max_idle Maximum number of idle sessions kept for a single server, 0 for no limit.
+ * @param[in] idle_timeout Time in seconds an idle session is kept, 0 for no limit.
+ * @param[in] max_channels Maximum number of SSH sessions sharing a single SSH connection. If greater than 1,
+ * a new session to a server with all its sessions lent out is created as another NETCONF channel on an existing
+ * SSH connection (see ::nc_connect_ssh_channel()) instead of a new connection, if the connection is not being
+ * used at the moment. 0 is the same as 1.
+ * @return Created pool, NULL on error.
+ */
+struct nc_client_pool *nc_client_pool_new(uint16_t max_idle, uint32_t idle_timeout, uint16_t max_channels);
+
+/**
+ * @brief Borrow a session from a client connection pool, connect a new one if there is no idle session.
+ *
+ * An idle session is checked not to have been closed by the server before it is lent. New sessions are created
+ * with ::nc_connect_unix() (@p host is the socket path), ::nc_connect_ssh(), or ::nc_connect_tls(), respectively,
+ * using the client settings of the calling thread. No other pool operation waits for the connecting.
+ *
+ * @param[in] pool Connection pool.
+ * @param[in] ti Transport of the session, ::NC_TI_UNIX, ::NC_TI_SSH, or ::NC_TI_TLS.
+ * @param[in] host Server host.
+ * @param[in] port Server port.
+ * @param[in] username Optional username, used for SSH instead of the one set by ::nc_client_ssh_set_username().
+ * @param[in] ctx Optional context for a new session, see ::nc_connect_ssh(). Only sessions requested with the same
+ * context are lent.
+ * @return Lent session, NULL on error. Return it using ::nc_client_pool_put(), never free it.
+ */
+struct nc_session *nc_client_pool_get(struct nc_client_pool *pool, NC_TRANSPORT_IMPL ti, const char *host,
+        uint16_t port, const char *username, struct ly_ctx *ctx);
+
+/**
+ * @brief Return a session lent by a client connection pool.
+ *
+ * Invalid sessions and those exceeding the pool limits are freed.
+ *
+ * @param[in] pool Connection pool.
+ * @param[in] session Session returned by ::nc_client_pool_get().
+ */
+void nc_client_pool_put(struct nc_client_pool *pool, struct nc_session *session);
+
+/**
+ * @brief Free a client connection pool with all its sessions.
+ *
+ * All the lent sessions are expected to be returned.
+ *
+ * @param[in] pool Connection pool to free.
+ */
+void nc_client_pool_free(struct nc_client_pool *pool);
+
+/**
+ * @brief Server to connect to by ::nc_connect_batch_start().
+ */
+struct nc_connect_target {
+    NC_TRANSPORT_IMPL ti;   /**< Transport of the session, ::NC_TI_UNIX, ::NC_TI_SSH, or ::NC_TI_TLS. */
+    const char *host;       /**< Server host, socket path for UNIX sockets. */
+    uint16_t port;          /**< Server port. */
+    struct ly_ctx *ctx;     /**< Optional context for the session, see ::nc_connect_ssh(). */
+    void *user_data;        /**< Arbitrary user data of the target. */
+};
+
+/**
+ * @brief Callback for a target connected to by ::nc_connect_batch_start().
+ *
+ * May be called concurrently from several worker threads.
+ *
+ * @param[in] target Target connected to.
+ * @param[in] session Established session, the callback becomes its owner. NULL if the connection failed.
+ * @param[in] user_data Arbitrary user data passed to ::nc_connect_batch_start().
+ */
+typedef void (*nc_connect_clb)(const struct nc_connect_target *target, struct nc_session *session, void *user_data);
+
+/**
+ * @brief Opaque client connections being established in parallel.
+ */
+struct nc_connect_batch;
+
+/**
+ * @brief Start connecting to many servers in parallel.
+ *
+ * Worker threads connect to the targets in the order they are given, each performing the whole connection
+ * including the SSH/TLS handshake, hello exchange, and the context creation, using the client settings
+ * of the calling thread (which must not be modified until the batch is finished). Only SSH usernames set
+ * by ::nc_client_ssh_set_username() are used. TLS sessions for resumption stored in the shared settings are
+ * accessed under a lock.
+ *
+ * @param[in] targets Array of targets to connect to, is copied.
+ * @param[in] target_count Number of @p targets.
+ * @param[in] max_concurrent Maximum number of connections being established at once, each by its own thread.
+ * 0 for a small default (8).
+ * @param[in] clb Callback called for every target as soon as it is connected to or the connection fails.
+ * @param[in] user_data Arbitrary user data passed to @p clb.
+ * @return Started batch, finish it using ::nc_connect_batch_wait(). NULL on error.
+ */
+struct nc_connect_batch *nc_connect_batch_start(const struct nc_connect_target *targets, uint32_t target_count,
+        uint16_t max_concurrent, nc_connect_clb clb, void *user_data);
+
+/**
+ * @brief Stop connecting to any more targets of a batch, the connections being established are finished.
+ *
+ * The callback is not called for the skipped targets.
+ *
+ * @param[in] batch Batch to cancel.
+ */
+void nc_connect_batch_cancel(struct nc_connect_batch *batch);
+
+/**
+ * @brief Wait for a batch to finish and free it.
+ *
+ * @param[in] batch Batch to wait for.
+ * @return Number of targets without a session, either failed or skipped because of ::nc_connect_batch_cancel().
+ */
+uint32_t nc_connect_batch_wait(struct nc_connect_batch *batch);
+
 /**
  * @brief Enable or disable TCP keepalives. Only affects new sessions.
  *
@@ -323,6 +323,24 @@ int nc_client_tls_ch_set_trusted_ca_paths(const char *ca_file, const char *ca_di
  */
 void nc_client_tls_ch_get_trusted_ca_paths(const char **ca_file, const char **ca_dir);
 
+/**
+ * @brief Enable or disable kernel TLS (kTLS) offload of new Call Home TLS sessions, disabled by default.
+ *
+ * For details, see ::nc_client_tls_set_ktls().
+ *
+ * @param[in] enabled Non-zero to enable the offload, 0 to disable it.
+ */
+void nc_client_tls_ch_set_ktls(int enabled);
+
+/**
+ * @brief Enable or disable dynamic TLS record sizing of new Call Home TLS sessions, disabled by default.
+ *
+ * For details, see ::nc_client_tls_set_dynamic_record_sizing().
+ *
+ * @param[in] enabled Non-zero to enable dynamic record sizing, 0 to disable it.
+ */
+void nc_client_tls_ch_set_dynamic_record_sizing(int enabled);
+
 /**
  * @brief Deprecated.
  */
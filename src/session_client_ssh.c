@@ -1759,13 +1759,13 @@ fail:
     return NULL;
 }
 
-API struct nc_session *
-nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
+struct nc_session *
+nc_connect_ssh_user(const char *host, uint16_t port, const char *username, struct ly_ctx *ctx)
 {
     const long timeout = NC_SSH_TIMEOUT;
     int sock;
     uint32_t port_uint;
-    char *username, *ip_host = NULL;
+    char *ip_host = NULL;
     struct passwd *pw, pw_buf;
     struct nc_session *session = NULL;
     char *buf = NULL;
@@ -1781,7 +1781,10 @@ nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
     }
     port_uint = port;
 
-    if (!ssh_opts.username) {
+    if (!username) {
+        username = ssh_opts.username;
+    }
+    if (!username) {
         pw = nc_getpw(getuid(), NULL, &pw_buf, &buf, &buf_len);
         if (!pw) {
             ERR(session, "Unknown username for the SSH connection (%s).", strerror(errno));
@@ -1790,8 +1793,6 @@ nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
             username = pw->pw_name;
         }
     } else {
-        username = ssh_opts.username;
-
         pw = nc_getpw(0, username, &pw_buf, &buf, &buf_len);
     }
 
@@ -1873,6 +1874,12 @@ fail:
     return NULL;
 }
 
+API struct nc_session *
+nc_connect_ssh(const char *host, uint16_t port, struct ly_ctx *ctx)
+{
+    return nc_connect_ssh_user(host, port, NULL, ctx);
+}
+
 API struct nc_session *
 nc_connect_libssh(ssh_session ssh_session, struct ly_ctx *ctx)
 {
@@ -1896,6 +1903,14 @@ nc_connect_ssh_channel(struct nc_session *session, struct ly_ctx *ctx)
     new_session->ti.libssh.session = session->ti.libssh.session;
     new_session->io_lock = session->io_lock;
 
+    /* SESSION IO LOCK, the session ring list is modified and the channel created safely */
+    if (nc_session_io_lock(new_session, -1, __func__) != 1) {
+        /* not a part of the connection yet */
+        new_session->ti_type = NC_TI_NONE;
+        new_session->io_lock = NULL;
+        goto fail;
+    }
+
     /* append to the session ring list */
     if (!session->ti.libssh.next) {
         session->ti.libssh.next = new_session;
@@ -1906,13 +1921,13 @@ nc_connect_ssh_channel(struct nc_session *session, struct ly_ctx *ctx)
         new_session->ti.libssh.next = ptr;
     }
 
-    /* create the channel safely */
-    if (nc_session_io_lock(new_session, -1, __func__) != 1) {
-        goto fail;
-    }
     if (open_netconf_channel(new_session, NC_TRANSPORT_TIMEOUT) != 1) {
+        /* SESSION IO UNLOCK */
+        nc_session_io_unlock(new_session, __func__);
         goto fail;
     }
+
+    /* SESSION IO UNLOCK */
     nc_session_io_unlock(new_session, __func__);
 
     if (nc_client_session_new_ctx(new_session, ctx) != EXIT_SUCCESS) {
@@ -1931,7 +1946,7 @@ nc_connect_ssh_channel(struct nc_session *session, struct ly_ctx *ctx)
     }
 
     /* start monitoring the session if the monitoring thread is running */
-    if (nc_client_monitoring_session_start(session)) {
+    if (nc_client_monitoring_session_start(new_session)) {
         goto fail;
     }
 
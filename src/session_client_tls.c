@@ -20,6 +20,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
@@ -40,6 +41,151 @@ struct nc_client_context *nc_client_context_location(void);
 #define tls_opts nc_client_context_location()->tls_opts
 #define tls_ch_opts nc_client_context_location()->tls_ch_opts
 
+/* lock for the resumable sessions, client thread contexts may be shared by several connecting threads */
+static pthread_mutex_t resumable_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Remove all the resumable sessions.
+ *
+ * @param[in] opts TLS options with the resumable sessions.
+ */
+static void
+nc_client_tls_resumable_clear(struct nc_client_tls_opts *opts)
+{
+    uint16_t i;
+
+    /* RESUMABLE LOCK */
+    pthread_mutex_lock(&resumable_lock);
+
+    for (i = 0; i < opts->resumable_count; ++i) {
+        free(opts->resumables[i].host);
+        nc_client_tls_resumable_destroy_wrap(opts->resumables[i].session);
+    }
+    free(opts->resumables);
+    opts->resumables = NULL;
+    opts->resumable_count = 0;
+
+    /* RESUMABLE UNLOCK */
+    pthread_mutex_unlock(&resumable_lock);
+}
+
+/**
+ * @brief Find the resumable session of a server.
+ *
+ * Is expected to be called with the resumable lock held.
+ *
+ * @param[in] opts TLS options with the resumable sessions.
+ * @param[in] host Expected hostname of the server.
+ * @param[in] port Port of the server, 0 for Call Home.
+ * @return Found resumable session, NULL if there is none.
+ */
+static struct nc_client_tls_resumable *
+nc_client_tls_resumable_find(struct nc_client_tls_opts *opts, const char *host, uint16_t port)
+{
+    uint16_t i;
+
+    for (i = 0; i < opts->resumable_count; ++i) {
+        if ((opts->resumables[i].port == port) && !strcmp(opts->resumables[i].host, host)) {
+            return &opts->resumables[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Remove the resumable session of a server, if any.
+ *
+ * Is expected to be called with the resumable lock held.
+ *
+ * @param[in] opts TLS options with the resumable sessions.
+ * @param[in] host Expected hostname of the server.
+ * @param[in] port Port of the server, 0 for Call Home.
+ */
+static void
+nc_client_tls_resumable_del(struct nc_client_tls_opts *opts, const char *host, uint16_t port)
+{
+    struct nc_client_tls_resumable *res;
+
+    res = nc_client_tls_resumable_find(opts, host, port);
+    if (!res) {
+        return;
+    }
+
+    free(res->host);
+    nc_client_tls_resumable_destroy_wrap(res->session);
+
+    /* replace it with the last one */
+    --opts->resumable_count;
+    if (res != &opts->resumables[opts->resumable_count]) {
+        *res = opts->resumables[opts->resumable_count];
+    }
+    if (!opts->resumable_count) {
+        free(opts->resumables);
+        opts->resumables = NULL;
+    }
+}
+
+/**
+ * @brief Store an established session of a server to be resumed by the next connection to it.
+ *
+ * Failing to store it is not an error, the next connection just performs the full handshake.
+ *
+ * @param[in] opts TLS options with the resumable sessions.
+ * @param[in] host Expected hostname of the server.
+ * @param[in] port Port of the server, 0 for Call Home.
+ * @param[in] tls_session Established TLS session.
+ */
+static void
+nc_client_tls_resumable_store(struct nc_client_tls_opts *opts, const char *host, uint16_t port, void *tls_session)
+{
+    struct nc_client_tls_resumable *res;
+    void *resumable, *ptr;
+
+    char *host_dup = NULL;
+
+    resumable = nc_client_tls_get_resumable_wrap(tls_session);
+
+    /* RESUMABLE LOCK */
+    pthread_mutex_lock(&resumable_lock);
+
+    if (!resumable) {
+        /* the server does not support resumption */
+        nc_client_tls_resumable_del(opts, host, port);
+        goto unlock;
+    }
+
+    res = nc_client_tls_resumable_find(opts, host, port);
+    if (res) {
+        /* replace the previous session */
+        nc_client_tls_resumable_destroy_wrap(res->session);
+        res->session = resumable;
+        goto unlock;
+    }
+
+    host_dup = strdup(host);
+    NC_CHECK_ERRMEM_GOTO(!host_dup, , fail);
+
+    ptr = realloc(opts->resumables, (opts->resumable_count + 1) * sizeof *opts->resumables);
+    NC_CHECK_ERRMEM_GOTO(!ptr, , fail);
+    opts->resumables = ptr;
+
+    res = &opts->resumables[opts->resumable_count];
+    res->host = host_dup;
+    res->port = port;
+    res->session = resumable;
+    ++opts->resumable_count;
+    goto unlock;
+
+fail:
+    free(host_dup);
+    nc_client_tls_resumable_destroy_wrap(resumable);
+
+unlock:
+    /* RESUMABLE UNLOCK */
+    pthread_mutex_unlock(&resumable_lock);
+}
+
 void
 _nc_client_tls_destroy_opts(struct nc_client_tls_opts *opts)
 {
@@ -47,6 +193,7 @@ _nc_client_tls_destroy_opts(struct nc_client_tls_opts *opts)
     free(opts->key_path);
     free(opts->ca_file);
     free(opts->ca_dir);
+    nc_client_tls_resumable_clear(opts);
     memset(opts, 0, sizeof *opts);
 }
 
@@ -62,6 +209,9 @@ _nc_client_tls_set_cert_key_paths(const char *client_cert, const char *client_ke
 {
     NC_CHECK_ARG_RET(NULL, client_cert, -1);
 
+    /* sessions established with the previous certificate must not be resumed */
+    nc_client_tls_resumable_clear(opts);
+
     free(opts->cert_path);
     free(opts->key_path);
 
@@ -126,6 +276,9 @@ _nc_client_tls_set_trusted_ca_paths(const char *ca_file, const char *ca_dir, str
         return -1;
     }
 
+    /* sessions with servers verified by the previous CAs must not be resumed */
+    nc_client_tls_resumable_clear(opts);
+
     free(opts->ca_file);
     free(opts->ca_dir);
 
@@ -186,6 +339,30 @@ nc_client_tls_ch_get_trusted_ca_paths(const char **ca_file, const char **ca_dir)
     _nc_client_tls_get_trusted_ca_paths(ca_file, ca_dir, &tls_ch_opts);
 }
 
+API void
+nc_client_tls_set_ktls(int enabled)
+{
+    tls_opts.ktls = enabled ? 1 : 0;
+}
+
+API void
+nc_client_tls_ch_set_ktls(int enabled)
+{
+    tls_ch_opts.ktls = enabled ? 1 : 0;
+}
+
+API void
+nc_client_tls_set_dynamic_record_sizing(int enabled)
+{
+    tls_opts.drs = enabled ? 1 : 0;
+}
+
+API void
+nc_client_tls_ch_set_dynamic_record_sizing(int enabled)
+{
+    tls_ch_opts.drs = enabled ? 1 : 0;
+}
+
 API int
 nc_client_tls_set_crl_paths(const char *UNUSED(crl_file), const char *UNUSED(crl_dir))
 {
@@ -256,11 +433,26 @@ nc_client_tls_connect_check(int connect_ret, void *tls_session, const char *peer
     return connect_ret;
 }
 
+/**
+ * @brief Create a new client TLS session and perform the TLS handshake.
+ *
+ * @param[in] sock Connected socket, it is always consumed.
+ * @param[in] host Expected hostname of the server.
+ * @param[in] port Port of the server used to find a session to resume, 0 for Call Home.
+ * @param[in] timeout Handshake timeout in ms, -1 for infinite.
+ * @param[in] opts TLS options to use.
+ * @param[out] out_tls_cfg Created TLS configuration.
+ * @param[in,out] tls_ctx TLS context to fill.
+ * @return Established TLS session, NULL on error.
+ */
 static void *
-nc_client_tls_session_new(int sock, const char *host, int timeout, struct nc_client_tls_opts *opts, void **out_tls_cfg, struct nc_tls_ctx *tls_ctx)
+nc_client_tls_session_new(int sock, const char *host, uint16_t port, int timeout, struct nc_client_tls_opts *opts,
+        void **out_tls_cfg, struct nc_tls_ctx *tls_ctx)
 {
-    int ret = 0, sock_tmp = sock;
+    int ret = 0, r, sock_tmp = sock;
+    short events;
     struct timespec ts_timeout;
+    struct nc_client_tls_resumable *res;
     void *tls_session, *tls_cfg, *cli_cert, *cli_pkey, *cert_store, *crl_store;
 
     tls_session = tls_cfg = cli_cert = cli_pkey = cert_store = crl_store = NULL;
@@ -288,7 +480,7 @@ nc_client_tls_session_new(int sock, const char *host, int timeout, struct nc_cli
     }
 
     /* load CRLs from set certificates' extensions */
-    if (nc_session_tls_crl_from_cert_ext_fetch(cli_cert, cert_store, &crl_store)) {
+    if (nc_session_tls_crl_from_cert_ext_fetch(cli_cert, cert_store, NULL, NULL, &crl_store, NULL, NULL)) {
         goto fail;
     }
 
@@ -313,6 +505,9 @@ nc_client_tls_session_new(int sock, const char *host, int timeout, struct nc_cli
     if (!tls_session) {
         goto fail;
     }
+    if (opts->ktls) {
+        nc_tls_enable_ktls_wrap(tls_session);
+    }
 
     /* set session fd */
     nc_tls_set_fd_wrap(tls_session, sock, tls_ctx);
@@ -324,20 +519,38 @@ nc_client_tls_session_new(int sock, const char *host, int timeout, struct nc_cli
         goto fail;
     }
 
+    /* try to resume the previous session with the server, RESUMABLE LOCK */
+    pthread_mutex_lock(&resumable_lock);
+    res = nc_client_tls_resumable_find(opts, host, port);
+    if (res && nc_client_tls_set_resumable_wrap(tls_session, res->session)) {
+        nc_client_tls_resumable_del(opts, host, port);
+    }
+    /* RESUMABLE UNLOCK */
+    pthread_mutex_unlock(&resumable_lock);
+
     /* handshake */
     if (timeout > -1) {
         nc_timeouttime_get(&ts_timeout, timeout);
     }
-    while ((ret = nc_client_tls_handshake_step_wrap(tls_session, sock_tmp)) == 0) {
-        usleep(NC_TIMEOUT_STEP);
-        if ((timeout > -1) && (nc_timeouttime_cur_diff(&ts_timeout) < 1)) {
+    while ((ret = nc_client_tls_handshake_step_wrap(tls_session, &events)) == 0) {
+        /* wait for the socket to become ready for whatever the TLS backend needs */
+        r = nc_sock_wait(sock_tmp, events, (timeout > -1) ? &ts_timeout : NULL);
+        if (!r) {
             ERR(NULL, "SSL connect timeout.");
             goto fail;
+        } else if (r < 0) {
+            ERR(NULL, "Communication socket unexpectedly closed.");
+            goto fail;
         }
     }
 
     /* check if handshake was ok */
     if (nc_client_tls_connect_check(ret, tls_session, host) != 1) {
+        /* do not try to resume the session again, RESUMABLE LOCK */
+        pthread_mutex_lock(&resumable_lock);
+        nc_client_tls_resumable_del(opts, host, port);
+        /* RESUMABLE UNLOCK */
+        pthread_mutex_unlock(&resumable_lock);
         goto fail;
     }
 
@@ -398,7 +611,8 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
 
     /* fill the session */
     session->ti_type = NC_TI_TLS;
-    if (!(session->ti.tls.session = nc_client_tls_session_new(sock, host, NC_TRANSPORT_TIMEOUT, &tls_opts, &tls_cfg, &tls_ctx))) {
+    if (!(session->ti.tls.session = nc_client_tls_session_new(sock, host, port, NC_TRANSPORT_TIMEOUT, &tls_opts, &tls_cfg,
+            &tls_ctx))) {
         goto fail;
     }
     session->ti.tls.config = tls_cfg;
@@ -406,6 +620,8 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
     /* memory belongs to session */
     memcpy(&session->ti.tls.ctx, &tls_ctx, sizeof tls_ctx);
     memset(&tls_ctx, 0, sizeof tls_ctx);
+    nc_session_tls_established(session);
+    session->ti.tls.drs = tls_opts.drs;
 
     if (nc_client_session_new_ctx(session, ctx) != EXIT_SUCCESS) {
         goto fail;
@@ -417,6 +633,9 @@ nc_connect_tls(const char *host, unsigned short port, struct ly_ctx *ctx)
     }
     session->status = NC_STATUS_RUNNING;
 
+    /* TLS 1.3 session tickets are sent after the handshake so they have been received with the hello by now */
+    nc_client_tls_resumable_store(&tls_opts, host, port, session->ti.tls.session);
+
     if (nc_ctx_check_and_fill(session) == -1) {
         goto fail;
     }
@@ -461,7 +680,7 @@ nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly
 
     /* fill the session */
     session->ti_type = NC_TI_TLS;
-    if (!(session->ti.tls.session = nc_client_tls_session_new(sock, peername, timeout, &tls_ch_opts, &tls_cfg, &tls_ctx))) {
+    if (!(session->ti.tls.session = nc_client_tls_session_new(sock, peername, 0, timeout, &tls_ch_opts, &tls_cfg, &tls_ctx))) {
         goto fail;
     }
     session->ti.tls.config = tls_cfg;
@@ -469,6 +688,8 @@ nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly
     /* memory belongs to session */
     memcpy(&session->ti.tls.ctx, &tls_ctx, sizeof tls_ctx);
     memset(&tls_ctx, 0, sizeof tls_ctx);
+    nc_session_tls_established(session);
+    session->ti.tls.drs = tls_ch_opts.drs;
 
     if (nc_client_session_new_ctx(session, ctx) != EXIT_SUCCESS) {
         goto fail;
@@ -480,6 +701,9 @@ nc_accept_callhome_tls_sock(int sock, const char *host, uint16_t port, struct ly
     }
     session->status = NC_STATUS_RUNNING;
 
+    /* the server port differs for every Call Home connection, the sessions are resumed by the hostname only */
+    nc_client_tls_resumable_store(&tls_ch_opts, peername, 0, session->ti.tls.session);
+
     if (nc_ctx_check_and_fill(session) == -1) {
         goto fail;
     }
@@ -160,61 +160,74 @@ nc_server_tls_dn2str(const mbedtls_x509_name *dn)
 /**
  * @brief Create a new random number generator context.
  *
- * @param[out] ctr_drbg Random bit generator context.
- * @param[out] entropy Entropy context.
+ * @param[out] rng Random number generator context.
  * @return 0 on success, 1 on failure.
  */
 static int
-nc_tls_rng_new(mbedtls_ctr_drbg_context **ctr_drbg, mbedtls_entropy_context **entropy)
+nc_tls_rng_new(struct nc_tls_rng **rng)
 {
     int rc;
 
-    *ctr_drbg = NULL;
-    *entropy = NULL;
+    *rng = calloc(1, sizeof **rng);
+    NC_CHECK_ERRMEM_RET(!*rng, 1);
 
-    *entropy = malloc(sizeof **entropy);
-    NC_CHECK_ERRMEM_GOTO(!*entropy, , fail);
-    *ctr_drbg = malloc(sizeof **ctr_drbg);
-    NC_CHECK_ERRMEM_GOTO(!*ctr_drbg, , fail);
+    mbedtls_entropy_init(&(*rng)->entropy);
+    mbedtls_ctr_drbg_init(&(*rng)->ctr_drbg);
+    pthread_mutex_init(&(*rng)->lock, NULL);
 
-    mbedtls_entropy_init(*entropy);
-    mbedtls_ctr_drbg_init(*ctr_drbg);
-
-    rc = mbedtls_ctr_drbg_seed(*ctr_drbg, mbedtls_entropy_func, *entropy, NULL, 0);
+    rc = mbedtls_ctr_drbg_seed(&(*rng)->ctr_drbg, mbedtls_entropy_func, &(*rng)->entropy, NULL, 0);
     if (rc) {
         nc_mbedtls_strerr(NULL, rc, "Seeding ctr_drbg failed");
-        goto fail;
+        mbedtls_ctr_drbg_free(&(*rng)->ctr_drbg);
+        mbedtls_entropy_free(&(*rng)->entropy);
+        pthread_mutex_destroy(&(*rng)->lock);
+        free(*rng);
+        *rng = NULL;
+        return 1;
     }
 
     return 0;
-
-fail:
-    mbedtls_ctr_drbg_free(*ctr_drbg);
-    free(*ctr_drbg);
-    if (*entropy) {
-        mbedtls_entropy_free(*entropy);
-        free(*entropy);
-    }
-    *ctr_drbg = NULL;
-    *entropy = NULL;
-    return 1;
 }
 
 /**
  * @brief Destroy the random number generator context.
  *
- * @param[in] ctr_drbg Random bit generator context.
- * @param[in] entropy Entropy context.
+ * @param[in] rng Random number generator context.
  */
 static void
-nc_tls_rng_destroy(mbedtls_ctr_drbg_context *ctr_drbg, mbedtls_entropy_context *entropy)
+nc_tls_rng_destroy(struct nc_tls_rng *rng)
 {
-    mbedtls_ctr_drbg_free(ctr_drbg);
-    free(ctr_drbg);
-    if (entropy) {
-        mbedtls_entropy_free(entropy);
-        free(entropy);
+    if (!rng) {
+        return;
     }
+
+    mbedtls_ctr_drbg_free(&rng->ctr_drbg);
+    mbedtls_entropy_free(&rng->entropy);
+    pthread_mutex_destroy(&rng->lock);
+    free(rng);
+}
+
+/**
+ * @brief Generate random data, the generator may be shared by several sessions handshaking in parallel.
+ *
+ * @param[in] p_rng Random number generator context.
+ * @param[out] output Buffer for the random data.
+ * @param[in] output_len Length of @p output.
+ * @return 0 on success, MbedTLS error code on failure.
+ */
+static int
+nc_tls_rng_random(void *p_rng, unsigned char *output, size_t output_len)
+{
+    struct nc_tls_rng *rng = p_rng;
+    int rc;
+
+    /* RNG LOCK */
+    pthread_mutex_lock(&rng->lock);
+    rc = mbedtls_ctr_drbg_random(&rng->ctr_drbg, output, output_len);
+    /* RNG UNLOCK */
+    pthread_mutex_unlock(&rng->lock);
+
+    return rc;
 }
 
 /**
@@ -434,10 +447,9 @@ nc_tls_pem_to_privkey_wrap(const char *privkey_data)
 {
     int rc = 0;
     mbedtls_pk_context *pkey = NULL;
-    mbedtls_ctr_drbg_context *ctr_drbg = NULL;
-    mbedtls_entropy_context *entropy = NULL;
+    struct nc_tls_rng *rng = NULL;
 
-    rc = nc_tls_rng_new(&ctr_drbg, &entropy);
+    rc = nc_tls_rng_new(&rng);
     if (rc) {
         goto cleanup;
     }
@@ -448,7 +460,7 @@ nc_tls_pem_to_privkey_wrap(const char *privkey_data)
         goto cleanup;
     }
 
-    rc = mbedtls_pk_parse_key(pkey, (const unsigned char *)privkey_data, strlen(privkey_data) + 1, NULL, 0, mbedtls_ctr_drbg_random, ctr_drbg);
+    rc = mbedtls_pk_parse_key(pkey, (const unsigned char *)privkey_data, strlen(privkey_data) + 1, NULL, 0, nc_tls_rng_random, rng);
     if (rc) {
         nc_mbedtls_strerr(NULL, rc, "Parsing private key data failed");
         goto cleanup;
@@ -459,7 +471,7 @@ cleanup:
         nc_tls_privkey_destroy_wrap(pkey);
         pkey = NULL;
     }
-    nc_tls_rng_destroy(ctr_drbg, entropy);
+    nc_tls_rng_destroy(rng);
     return pkey;
 }
 
@@ -653,10 +665,188 @@ nc_server_tls_verify_cb(void *cb_data, mbedtls_x509_crt *cert, int depth, uint32
 }
 
 void
-nc_server_tls_set_verify_wrap(void *tls_cfg, struct nc_tls_verify_cb_data *cb_data)
+nc_server_tls_set_verify_wrap(void *tls_cfg)
 {
     mbedtls_ssl_conf_authmode(tls_cfg, MBEDTLS_SSL_VERIFY_REQUIRED);
-    mbedtls_ssl_conf_verify(tls_cfg, nc_server_tls_verify_cb, cb_data);
+}
+
+void
+nc_server_tls_set_verify_data_wrap(void *tls_session, struct nc_tls_verify_cb_data *cb_data)
+{
+    /* the callback is set per session since its data are session-specific */
+    mbedtls_ssl_set_verify(tls_session, nc_server_tls_verify_cb, cb_data);
+}
+
+#if defined (MBEDTLS_SSL_KEEP_PEER_CERTIFICATE) && !defined (MBEDTLS_THREADING_C)
+
+/**
+ * @brief Lock for the session ticket keys and session caches, MbedTLS guards them only if built with threading support.
+ */
+static pthread_mutex_t nc_tls_resumption_lock = PTHREAD_MUTEX_INITIALIZER;
+
+# ifdef MBEDTLS_SSL_SESSION_TICKETS
+
+/**
+ * @brief Locked ::mbedtls_ssl_ticket_write().
+ */
+static int
+nc_tls_ticket_write(void *p_ticket, const mbedtls_ssl_session *session, unsigned char *start, const unsigned char *end,
+        size_t *tlen, uint32_t *lifetime)
+{
+    int rc;
+
+    /* RESUMPTION LOCK */
+    pthread_mutex_lock(&nc_tls_resumption_lock);
+    rc = mbedtls_ssl_ticket_write(p_ticket, session, start, end, tlen, lifetime);
+    /* RESUMPTION UNLOCK */
+    pthread_mutex_unlock(&nc_tls_resumption_lock);
+
+    return rc;
+}
+
+/**
+ * @brief Locked ::mbedtls_ssl_ticket_parse().
+ */
+static int
+nc_tls_ticket_parse(void *p_ticket, mbedtls_ssl_session *session, unsigned char *buf, size_t len)
+{
+    int rc;
+
+    /* RESUMPTION LOCK */
+    pthread_mutex_lock(&nc_tls_resumption_lock);
+    rc = mbedtls_ssl_ticket_parse(p_ticket, session, buf, len);
+    /* RESUMPTION UNLOCK */
+    pthread_mutex_unlock(&nc_tls_resumption_lock);
+
+    return rc;
+}
+
+#  define NC_TLS_TICKET_WRITE nc_tls_ticket_write
+#  define NC_TLS_TICKET_PARSE nc_tls_ticket_parse
+# endif
+
+# ifdef MBEDTLS_SSL_CACHE_C
+
+/**
+ * @brief Locked ::mbedtls_ssl_cache_get().
+ */
+static int
+nc_tls_cache_get(void *data, const unsigned char *session_id, size_t session_id_len, mbedtls_ssl_session *session)
+{
+    int rc;
+
+    /* RESUMPTION LOCK */
+    pthread_mutex_lock(&nc_tls_resumption_lock);
+    rc = mbedtls_ssl_cache_get(data, session_id, session_id_len, session);
+    /* RESUMPTION UNLOCK */
+    pthread_mutex_unlock(&nc_tls_resumption_lock);
+
+    return rc;
+}
+
+/**
+ * @brief Locked ::mbedtls_ssl_cache_set().
+ */
+static int
+nc_tls_cache_set(void *data, const unsigned char *session_id, size_t session_id_len, const mbedtls_ssl_session *session)
+{
+    int rc;
+
+    /* RESUMPTION LOCK */
+    pthread_mutex_lock(&nc_tls_resumption_lock);
+    rc = mbedtls_ssl_cache_set(data, session_id, session_id_len, session);
+    /* RESUMPTION UNLOCK */
+    pthread_mutex_unlock(&nc_tls_resumption_lock);
+
+    return rc;
+}
+
+#  define NC_TLS_CACHE_GET nc_tls_cache_get
+#  define NC_TLS_CACHE_SET nc_tls_cache_set
+# endif
+
+#else
+
+# define NC_TLS_TICKET_WRITE mbedtls_ssl_ticket_write
+# define NC_TLS_TICKET_PARSE mbedtls_ssl_ticket_parse
+# define NC_TLS_CACHE_GET mbedtls_ssl_cache_get
+# define NC_TLS_CACHE_SET mbedtls_ssl_cache_set
+
+#endif
+
+int
+nc_server_tls_set_resumption_wrap(void *tls_cfg, uint32_t lifetime, struct nc_tls_ctx *tls_ctx)
+{
+#if defined (MBEDTLS_SSL_KEEP_PEER_CERTIFICATE) && defined (MBEDTLS_SSL_SESSION_TICKETS)
+    int rc;
+#endif
+
+    if (!lifetime) {
+        /* neither session cache nor ticket callbacks are set by default */
+        return 0;
+    }
+
+#ifndef MBEDTLS_SSL_KEEP_PEER_CERTIFICATE
+    (void)tls_cfg;
+    (void)tls_ctx;
+    WRN(NULL, "TLS session resumption requires MbedTLS to keep peer certificates, it is disabled.");
+    return 0;
+#else
+# ifdef MBEDTLS_SSL_SESSION_TICKETS
+    /* TLS 1.2 and 1.3 stateless tickets, the keys are generated for every config */
+    tls_ctx->ticket = malloc(sizeof *tls_ctx->ticket);
+    NC_CHECK_ERRMEM_RET(!tls_ctx->ticket, 1);
+    mbedtls_ssl_ticket_init(tls_ctx->ticket);
+
+    rc = mbedtls_ssl_ticket_setup(tls_ctx->ticket, nc_tls_rng_random, tls_ctx->rng, MBEDTLS_CIPHER_AES_256_GCM, lifetime);
+    if (rc) {
+        nc_mbedtls_strerr(NULL, rc, "Setting up TLS session tickets failed");
+        return 1;
+    }
+    mbedtls_ssl_conf_session_tickets_cb(tls_cfg, NC_TLS_TICKET_WRITE, NC_TLS_TICKET_PARSE, tls_ctx->ticket);
+# endif
+
+# ifdef MBEDTLS_SSL_CACHE_C
+    /* TLS 1.2 session cache */
+    tls_ctx->cache = malloc(sizeof *tls_ctx->cache);
+    NC_CHECK_ERRMEM_RET(!tls_ctx->cache, 1);
+    mbedtls_ssl_cache_init(tls_ctx->cache);
+    mbedtls_ssl_cache_set_timeout(tls_ctx->cache, lifetime);
+    mbedtls_ssl_conf_session_cache(tls_cfg, tls_ctx->cache, NC_TLS_CACHE_GET, NC_TLS_CACHE_SET);
+# endif
+
+    return 0;
+#endif
+}
+
+int
+nc_server_tls_verify_resumed_wrap(void *tls_session, struct nc_tls_ctx *tls_ctx, struct nc_tls_verify_cb_data *cb_data)
+{
+#ifdef MBEDTLS_SSL_KEEP_PEER_CERTIFICATE
+    int rc;
+    uint32_t flags = 0;
+    const mbedtls_x509_crt *peer_cert;
+
+    peer_cert = mbedtls_ssl_get_peer_cert(tls_session);
+    if (!peer_cert) {
+        ERR(cb_data->session, "Resumed TLS session has no client certificate.");
+        return 1;
+    }
+
+    /* verify it the same way as during the handshake */
+    rc = mbedtls_x509_crt_verify((mbedtls_x509_crt *)peer_cert, tls_ctx->cert_store, tls_ctx->crl_store, NULL, &flags,
+            nc_server_tls_verify_cb, cb_data);
+    if (rc || flags || !cb_data->session->username) {
+        return 1;
+    }
+
+    return 0;
+#else
+    (void)tls_session;
+    (void)tls_ctx;
+    ERR(cb_data->session, "Resumed TLS session has no client certificate.");
+    return 1;
+#endif
 }
 
 void
@@ -665,6 +855,50 @@ nc_client_tls_set_verify_wrap(void *tls_cfg)
     mbedtls_ssl_conf_authmode(tls_cfg, MBEDTLS_SSL_VERIFY_REQUIRED);
 }
 
+void *
+nc_client_tls_get_resumable_wrap(void *tls_session)
+{
+    mbedtls_ssl_session *resumable;
+
+    resumable = malloc(sizeof *resumable);
+    NC_CHECK_ERRMEM_RET(!resumable, NULL);
+    mbedtls_ssl_session_init(resumable);
+
+    /* fails if the server did not provide any means of resumption */
+    if (mbedtls_ssl_get_session(tls_session, resumable)) {
+        mbedtls_ssl_session_free(resumable);
+        free(resumable);
+        return NULL;
+    }
+
+    return resumable;
+}
+
+int
+nc_client_tls_set_resumable_wrap(void *tls_session, void *resumable)
+{
+    int rc;
+
+    rc = mbedtls_ssl_set_session(tls_session, resumable);
+    if (rc) {
+        nc_mbedtls_strerr(NULL, rc, "Setting TLS session to resume failed");
+        return 1;
+    }
+
+    return 0;
+}
+
+void
+nc_client_tls_resumable_destroy_wrap(void *resumable)
+{
+    if (!resumable) {
+        return;
+    }
+
+    mbedtls_ssl_session_free(resumable);
+    free(resumable);
+}
+
 char *
 nc_server_tls_get_subject_wrap(void *cert)
 {
@@ -799,25 +1033,6 @@ nc_tls_get_cert_wrap(void *chain, int idx, void **cert)
     *cert = iter;
 }
 
-int
-nc_server_tls_certs_match_wrap(void *cert1, void *cert2)
-{
-    mbedtls_x509_crt *c1 = cert1;
-    mbedtls_x509_crt *c2 = cert2;
-
-    if (!c1 || !c2) {
-        return 0;
-    }
-
-    /* compare raw DER encoded data */
-    if (!c1->raw.p || !c2->raw.p || (c1->raw.len != c2->raw.len) ||
-            memcmp(c1->raw.p, c2->raw.p, c1->raw.len)) {
-        return 0;
-    }
-
-    return 1;
-}
-
 int
 nc_server_tls_md5_wrap(void *cert, unsigned char *buf)
 {
@@ -927,7 +1142,7 @@ nc_server_tls_send(void *ctx, const unsigned char *buf, size_t len)
 
     ret = send(sock, buf, len, MSG_NOSIGNAL);
     if (ret < 0) {
-        if ((errno == EWOULDBLOCK) || (errno = EAGAIN) || (errno == EINTR)) {
+        if ((errno == EWOULDBLOCK) || (errno == EAGAIN) || (errno == EINTR)) {
             return MBEDTLS_ERR_SSL_WANT_WRITE;
         } else if ((errno == EPIPE) || (errno == ECONNRESET)) {
             return MBEDTLS_ERR_NET_CONN_RESET;
@@ -958,7 +1173,7 @@ nc_server_tls_recv(void *ctx, unsigned char *buf, size_t len)
 
     ret = recv(sock, buf, len, 0);
     if (ret < 0) {
-        if ((errno == EWOULDBLOCK) || (errno = EAGAIN) || (errno == EINTR)) {
+        if ((errno == EWOULDBLOCK) || (errno == EAGAIN) || (errno == EINTR)) {
             return MBEDTLS_ERR_SSL_WANT_READ;
         } else if ((errno == EPIPE) || (errno == ECONNRESET)) {
             return MBEDTLS_ERR_NET_CONN_RESET;
@@ -978,15 +1193,23 @@ nc_tls_set_fd_wrap(void *tls_session, int sock, struct nc_tls_ctx *tls_ctx)
     mbedtls_ssl_set_bio(tls_session, tls_ctx->sock, nc_server_tls_send, nc_server_tls_recv, NULL);
 }
 
-int
-nc_server_tls_handshake_step_wrap(void *tls_session)
+/**
+ * @brief Process the result of a TLS handshake step.
+ *
+ * @param[in] rc Return value of mbedtls_ssl_handshake().
+ * @param[out] events poll(2) events to wait for if the handshake is not finished.
+ * @return 1 on success, 0 if the handshake is not finished, negative number on error.
+ */
+static int
+nc_tls_handshake_step_result(int rc, short *events)
 {
-    int rc = 0;
-
-    rc = mbedtls_ssl_handshake(tls_session);
     if (!rc) {
         return 1;
-    } else if ((rc == MBEDTLS_ERR_SSL_WANT_READ) || (rc == MBEDTLS_ERR_SSL_WANT_WRITE)) {
+    } else if (rc == MBEDTLS_ERR_SSL_WANT_READ) {
+        *events = POLLIN;
+        return 0;
+    } else if (rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        *events = POLLOUT;
         return 0;
     } else {
         return rc;
@@ -994,39 +1217,56 @@ nc_server_tls_handshake_step_wrap(void *tls_session)
 }
 
 int
-nc_client_tls_handshake_step_wrap(void *tls_session, int sock)
+nc_server_tls_handshake_step_wrap(void *tls_session, short *events)
 {
-    int rc = 0;
-    struct pollfd pfd = {sock, 0, 0};
+    return nc_tls_handshake_step_result(mbedtls_ssl_handshake(tls_session), events);
+}
 
-    rc = mbedtls_ssl_handshake(tls_session);
-    if (!rc) {
-        return 1;
-    } else if ((rc == MBEDTLS_ERR_SSL_WANT_READ) || (rc == MBEDTLS_ERR_SSL_WANT_WRITE)) {
-        /* check for EPIPE */
-        if (poll(&pfd, 1, 0) < 0) {
-            return -1;
-        } else {
-            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                return -1;
-            } else {
-                return 0;
-            }
-        }
-    } else {
-        return rc;
-    }
+int
+nc_client_tls_handshake_step_wrap(void *tls_session, short *events)
+{
+    return nc_tls_handshake_step_result(mbedtls_ssl_handshake(tls_session), events);
+}
+
+void
+nc_tls_enable_ktls_wrap(void *UNUSED(tls_session))
+{
+    VRB(NULL, "Kernel TLS offload not supported by mbedTLS.");
+}
+
+int
+nc_tls_get_ktls_wrap(void *UNUSED(tls_session))
+{
+    return 0;
+}
+
+void
+nc_tls_count_records_wrap(void *UNUSED(tls_session), uint64_t *UNUSED(records))
+{
+    /* counted by nc_tls_write_wrap(), every write is a single record */
 }
 
 void
 nc_tls_ctx_destroy_wrap(struct nc_tls_ctx *tls_ctx)
 {
-    nc_tls_rng_destroy(tls_ctx->ctr_drbg, tls_ctx->entropy);
+    nc_tls_rng_destroy(tls_ctx->rng);
     nc_tls_cert_destroy_wrap(tls_ctx->cert);
     nc_tls_privkey_destroy_wrap(tls_ctx->pkey);
     nc_tls_cert_store_destroy_wrap(tls_ctx->cert_store);
     nc_tls_crl_store_destroy_wrap(tls_ctx->crl_store);
     free(tls_ctx->sock);
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    if (tls_ctx->ticket) {
+        mbedtls_ssl_ticket_free(tls_ctx->ticket);
+        free(tls_ctx->ticket);
+    }
+#endif
+#ifdef MBEDTLS_SSL_CACHE_C
+    if (tls_ctx->cache) {
+        mbedtls_ssl_cache_free(tls_ctx->cache);
+        free(tls_ctx->cache);
+    }
+#endif
 }
 
 void *
@@ -1034,21 +1274,20 @@ nc_tls_import_privkey_file_wrap(const char *privkey_path)
 {
     int rc;
     mbedtls_pk_context *pkey;
-    mbedtls_ctr_drbg_context *ctr_drbg;
-    mbedtls_entropy_context *entropy;
+    struct nc_tls_rng *rng;
 
-    if (nc_tls_rng_new(&ctr_drbg, &entropy)) {
+    if (nc_tls_rng_new(&rng)) {
         return NULL;
     }
 
     pkey = nc_tls_pkey_new_wrap();
     if (!pkey) {
-        nc_tls_rng_destroy(ctr_drbg, entropy);
+        nc_tls_rng_destroy(rng);
         return NULL;
     }
 
-    rc = mbedtls_pk_parse_keyfile(pkey, privkey_path, NULL, mbedtls_ctr_drbg_random, ctr_drbg);
-    nc_tls_rng_destroy(ctr_drbg, entropy);
+    rc = mbedtls_pk_parse_keyfile(pkey, privkey_path, NULL, nc_tls_rng_random, rng);
+    nc_tls_rng_destroy(rng);
     if (rc) {
         nc_mbedtls_strerr(NULL, rc, "Parsing private key from file \"%s\" failed", privkey_path);
         nc_tls_privkey_destroy_wrap(pkey);
@@ -1128,7 +1367,7 @@ int
 nc_tls_init_ctx_wrap(void *cert, void *pkey, void *cert_store, void *crl_store, struct nc_tls_ctx *tls_ctx)
 {
     /* setup rng */
-    if (nc_tls_rng_new(&tls_ctx->ctr_drbg, &tls_ctx->entropy)) {
+    if (nc_tls_rng_new(&tls_ctx->rng)) {
         return 1;
     }
 
@@ -1142,6 +1381,18 @@ nc_tls_init_ctx_wrap(void *cert, void *pkey, void *cert_store, void *crl_store,
     return 0;
 }
 
+int
+nc_tls_init_session_ctx_wrap(struct nc_tls_ctx *tls_ctx)
+{
+    memset(tls_ctx, 0, sizeof *tls_ctx);
+
+    /* only the socket is specific for every session, the rest is owned by the shared context */
+    tls_ctx->sock = malloc(sizeof *tls_ctx->sock);
+    NC_CHECK_ERRMEM_RET(!tls_ctx->sock, 1);
+    *tls_ctx->sock = -1;
+    return 0;
+}
+
 int
 nc_tls_setup_config_from_ctx_wrap(struct nc_tls_ctx *tls_ctx, int side, void *tls_cfg)
 {
@@ -1159,7 +1410,7 @@ nc_tls_setup_config_from_ctx_wrap(struct nc_tls_ctx *tls_ctx, int side, void *tl
     }
 
     /* set config's rng */
-    mbedtls_ssl_conf_rng(tls_cfg, mbedtls_ctr_drbg_random, tls_ctx->ctr_drbg);
+    mbedtls_ssl_conf_rng(tls_cfg, nc_tls_rng_random, tls_ctx->rng);
     /* set config's cert and key */
     mbedtls_ssl_conf_own_cert(tls_cfg, tls_ctx->cert, tls_ctx->pkey);
     /* set config's CA and CRL cert store */
@@ -1304,7 +1555,11 @@ nc_tls_write_wrap(struct nc_session *session, const unsigned char *buf, size_t s
     mbedtls_ssl_context *tls_session = session->ti.tls.session;
 
     rc = mbedtls_ssl_write(tls_session, buf, size);
-    if (rc < 0) {
+    if (rc > 0) {
+        /* at most a single record is written */
+        ++session->ti.tls.records_out;
+        session->ti.tls.bytes_out += rc;
+    } else if (rc < 0) {
         switch (rc) {
         case MBEDTLS_ERR_SSL_WANT_READ:
         case MBEDTLS_ERR_SSL_WANT_WRITE:
@@ -1987,6 +2242,47 @@ nc_tls_get_cert_exp_time_wrap(void *cert)
     return timegm(&t);
 }
 
+time_t
+nc_tls_get_crl_next_update_wrap(const unsigned char *crl_data, size_t size)
+{
+    time_t ret = -1;
+    struct tm t = {0};
+    mbedtls_x509_crl crl;
+    mbedtls_x509_time *next_update;
+
+    mbedtls_x509_crl_init(&crl);
+
+    /* try DER first, then PEM */
+    if (mbedtls_x509_crl_parse_der(&crl, crl_data, size) && mbedtls_x509_crl_parse(&crl, crl_data, size + 1)) {
+        ERR(NULL, "Reading downloaded CRL failed.");
+        goto cleanup;
+    }
+
+    next_update = &crl.next_update;
+    if (!next_update->year) {
+        /* optional */
+        ret = 0;
+        goto cleanup;
+    }
+
+    t.tm_sec = next_update->sec;
+    t.tm_min = next_update->min;
+    t.tm_hour = next_update->hour;
+
+    t.tm_mday = next_update->day;
+    t.tm_mon = next_update->mon - 1;
+    t.tm_year = next_update->year - 1900;
+
+    /* let system figure out the DST */
+    t.tm_isdst = -1;
+
+    ret = timegm(&t);
+
+cleanup:
+    mbedtls_x509_crl_free(&crl);
+    return ret;
+}
+
 /**
  * @brief Convert the MbedTLS key export type to a label for the keylog file.
  *
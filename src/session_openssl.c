@@ -309,21 +309,15 @@ nc_server_tls_verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
     int ret = 0, depth, err;
     struct nc_tls_verify_cb_data *data;
     SSL *ssl;
-    SSL_CTX *ctx;
     X509 *cert;
 
-    /* retrieve callback data stored inside the SSL_CTX struct */
+    /* retrieve callback data stored inside the SSL struct */
     ssl = X509_STORE_CTX_get_ex_data(x509_ctx, SSL_get_ex_data_X509_STORE_CTX_idx());
     if (!ssl) {
         ERRINT;
         return 0;
     }
-    ctx = SSL_get_SSL_CTX(ssl);
-    if (!ctx) {
-        ERRINT;
-        return 0;
-    }
-    data = SSL_CTX_get_ex_data(ctx, 0);
+    data = SSL_get_ex_data(ssl, 0);
     if (!data) {
         ERRINT;
         return 0;
@@ -363,7 +357,7 @@ nc_server_tls_verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
              * if yes, this callback will be called again with the same cert, but with preverify_ok = 1
              */
             cert = X509_STORE_CTX_get0_cert(x509_ctx);
-            ret = nc_server_tls_verify_peer_cert(cert, data->opts);
+            ret = nc_server_tls_verify_peer_cert(cert, data->srv_ctx);
             if (ret) {
                 VRB(NULL, "Cert verify: fail (%s).", X509_verify_cert_error_string(X509_STORE_CTX_get_error(x509_ctx)));
                 ret = -1;
@@ -397,19 +391,123 @@ nc_server_tls_verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
 }
 
 void
-nc_server_tls_set_verify_wrap(void *tls_cfg, struct nc_tls_verify_cb_data *cb_data)
+nc_server_tls_set_verify_wrap(void *tls_cfg)
 {
-    /* set verify cb and its data */
-    SSL_CTX_set_ex_data(tls_cfg, 0, cb_data);
+    /* set verify cb */
     SSL_CTX_set_verify(tls_cfg, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nc_server_tls_verify_cb);
 }
 
+void
+nc_server_tls_set_verify_data_wrap(void *tls_session, struct nc_tls_verify_cb_data *cb_data)
+{
+    /* set verify cb data */
+    SSL_set_ex_data(tls_session, 0, cb_data);
+}
+
+int
+nc_server_tls_set_resumption_wrap(void *tls_cfg, uint32_t lifetime, struct nc_tls_ctx *UNUSED(tls_ctx))
+{
+    if (!lifetime) {
+        /* every client must do the full handshake */
+        SSL_CTX_set_session_cache_mode(tls_cfg, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_options(tls_cfg, SSL_OP_NO_TICKET);
+        SSL_CTX_set_num_tickets(tls_cfg, 0);
+        return 0;
+    }
+
+    /* sessions of clients with verified certificates are resumable only with a session ID context */
+    if (SSL_CTX_set_session_id_context(tls_cfg, (const unsigned char *)"libnetconf2", 11) != 1) {
+        ERR(NULL, "Setting TLS session ID context failed (%s).", ERR_reason_error_string(ERR_get_error()));
+        return 1;
+    }
+
+    /* TLS 1.2 session cache and stateless tickets, the ticket keys are generated for every config */
+    SSL_CTX_set_session_cache_mode(tls_cfg, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_timeout(tls_cfg, lifetime);
+    SSL_CTX_clear_options(tls_cfg, SSL_OP_NO_TICKET);
+    return 0;
+}
+
+int
+nc_server_tls_verify_resumed_wrap(void *tls_session, struct nc_tls_ctx *UNUSED(tls_ctx), struct nc_tls_verify_cb_data *cb_data)
+{
+    int ret = 1;
+    X509 *peer_cert;
+    STACK_OF(X509) *peer_chain;
+    X509_STORE_CTX *store_ctx = NULL;
+
+    peer_cert = SSL_get0_peer_certificate(tls_session);
+    if (!peer_cert) {
+        ERR(cb_data->session, "Resumed TLS session has no client certificate.");
+        return 1;
+    }
+
+    /* session tickets keep only the client certificate, not the intermediate certificates sent with it */
+    peer_chain = SSL_get_peer_cert_chain(tls_session);
+    if (!peer_chain) {
+        VRB(cb_data->session, "Resumed TLS session has no client certificate chain, verifying the certificate alone.");
+    }
+
+    store_ctx = X509_STORE_CTX_new();
+    NC_CHECK_ERRMEM_RET(!store_ctx, 1);
+
+    if (!X509_STORE_CTX_init(store_ctx, SSL_CTX_get_cert_store(SSL_get_SSL_CTX(tls_session)), peer_cert, peer_chain)) {
+        ERR(cb_data->session, "Initializing certificate verification failed (%s).", ERR_reason_error_string(ERR_get_error()));
+        goto cleanup;
+    }
+    X509_STORE_CTX_set_default(store_ctx, "ssl_client");
+
+    /* the verify callback expects its data in the session */
+    SSL_set_ex_data(tls_session, 0, cb_data);
+    X509_STORE_CTX_set_ex_data(store_ctx, SSL_get_ex_data_X509_STORE_CTX_idx(), tls_session);
+    X509_STORE_CTX_set_verify_cb(store_ctx, nc_server_tls_verify_cb);
+
+    if ((X509_verify_cert(store_ctx) == 1) && cb_data->session->username) {
+        ret = 0;
+    }
+
+cleanup:
+    X509_STORE_CTX_free(store_ctx);
+    return ret;
+}
+
 void
 nc_client_tls_set_verify_wrap(void *tls_cfg)
 {
     SSL_CTX_set_verify(tls_cfg, SSL_VERIFY_PEER, NULL);
 }
 
+void *
+nc_client_tls_get_resumable_wrap(void *tls_session)
+{
+    SSL_SESSION *resumable;
+
+    resumable = SSL_get1_session(tls_session);
+    if (resumable && !SSL_SESSION_is_resumable(resumable)) {
+        SSL_SESSION_free(resumable);
+        resumable = NULL;
+    }
+
+    return resumable;
+}
+
+int
+nc_client_tls_set_resumable_wrap(void *tls_session, void *resumable)
+{
+    if (SSL_set_session(tls_session, resumable) != 1) {
+        ERR(NULL, "Setting TLS session to resume failed (%s).", ERR_reason_error_string(ERR_get_error()));
+        return 1;
+    }
+
+    return 0;
+}
+
+void
+nc_client_tls_resumable_destroy_wrap(void *resumable)
+{
+    SSL_SESSION_free(resumable);
+}
+
 char *
 nc_server_tls_get_subject_wrap(void *cert)
 {
@@ -513,12 +611,6 @@ nc_tls_get_cert_wrap(void *chain, int idx, void **cert)
     *cert = sk_X509_value(chain, idx);
 }
 
-int
-nc_server_tls_certs_match_wrap(void *cert1, void *cert2)
-{
-    return !X509_cmp(cert1, cert2);
-}
-
 int
 nc_server_tls_md5_wrap(void *cert, unsigned char *buf)
 {
@@ -609,17 +701,29 @@ nc_tls_set_fd_wrap(void *tls_session, int sock, struct nc_tls_ctx *UNUSED(tls_ct
     SSL_set_fd(tls_session, sock);
 }
 
-int
-nc_server_tls_handshake_step_wrap(void *tls_session)
+/**
+ * @brief Process the result of a TLS handshake step.
+ *
+ * @param[in] tls_session TLS session.
+ * @param[in] ret Return value of SSL_accept() or SSL_connect().
+ * @param[out] events poll(2) events to wait for if the handshake is not finished.
+ * @return 1 on success, 0 if the handshake is not finished, -1 on error.
+ */
+static int
+nc_tls_handshake_step_result(void *tls_session, int ret, short *events)
 {
-    int ret = 0;
-
-    ret = SSL_accept(tls_session);
     if (ret == 1) {
         return 1;
     } else if (ret == -1) {
-        if ((SSL_get_error(tls_session, ret) == SSL_ERROR_WANT_READ) || (SSL_get_error(tls_session, ret) == SSL_ERROR_WANT_WRITE)) {
+        switch (SSL_get_error(tls_session, ret)) {
+        case SSL_ERROR_WANT_READ:
+            *events = POLLIN;
+            return 0;
+        case SSL_ERROR_WANT_WRITE:
+            *events = POLLOUT;
             return 0;
+        default:
+            break;
         }
     }
 
@@ -627,20 +731,37 @@ nc_server_tls_handshake_step_wrap(void *tls_session)
 }
 
 int
-nc_client_tls_handshake_step_wrap(void *tls_session, int UNUSED(sock))
+nc_server_tls_handshake_step_wrap(void *tls_session, short *events)
 {
-    int ret = 0;
+    return nc_tls_handshake_step_result(tls_session, SSL_accept(tls_session), events);
+}
 
-    ret = SSL_connect(tls_session);
-    if (ret == 1) {
-        return 1;
-    } else if (ret == -1) {
-        if ((SSL_get_error(tls_session, ret) == SSL_ERROR_WANT_READ) || (SSL_get_error(tls_session, ret) == SSL_ERROR_WANT_WRITE)) {
-            return 0;
-        }
+int
+nc_client_tls_handshake_step_wrap(void *tls_session, short *events)
+{
+    return nc_tls_handshake_step_result(tls_session, SSL_connect(tls_session), events);
+}
+
+void
+nc_tls_enable_ktls_wrap(void *tls_session)
+{
+    /* used only if OpenSSL was built with kTLS and the kernel supports the negotiated cipher suite */
+    SSL_set_options(tls_session, SSL_OP_ENABLE_KTLS);
+}
+
+int
+nc_tls_get_ktls_wrap(void *tls_session)
+{
+    int flags = 0;
+
+    if (BIO_get_ktls_send(SSL_get_wbio(tls_session))) {
+        flags |= NC_TLS_KTLS_TX;
+    }
+    if (BIO_get_ktls_recv(SSL_get_rbio(tls_session))) {
+        flags |= NC_TLS_KTLS_RX;
     }
 
-    return -1;
+    return flags;
 }
 
 void
@@ -739,6 +860,14 @@ nc_tls_init_ctx_wrap(void *cert, void *pkey, void *cert_store, void *crl_store,
     return 0;
 }
 
+int
+nc_tls_init_session_ctx_wrap(struct nc_tls_ctx *tls_ctx)
+{
+    /* no per-session data */
+    memset(tls_ctx, 0, sizeof *tls_ctx);
+    return 0;
+}
+
 /**
  * @brief Move CRLs from one store to another.
  *
@@ -998,6 +1127,38 @@ nc_tls_read_wrap(struct nc_session *session, unsigned char *buf, size_t size)
     return rc;
 }
 
+/**
+ * @brief Protocol message callback counting the application data records written.
+ *
+ * @param[in] write_p Whether the message is being written.
+ * @param[in] version Protocol version.
+ * @param[in] content_type Content type of the message.
+ * @param[in] buf Message.
+ * @param[in] len Length of @p buf.
+ * @param[in] ssl TLS session.
+ * @param[in] arg Record counter.
+ */
+static void
+nc_tls_record_count_clb(int write_p, int UNUSED(version), int content_type, const void *buf, size_t len,
+        SSL *UNUSED(ssl), void *arg)
+{
+    uint64_t *records = arg;
+
+    /* every record header, TLS 1.3 hides the real content type behind application data */
+    if (write_p && (content_type == SSL3_RT_HEADER) && (len >= SSL3_RT_HEADER_LENGTH) &&
+            (((const unsigned char *)buf)[0] == SSL3_RT_APPLICATION_DATA)) {
+        ++(*records);
+    }
+}
+
+void
+nc_tls_count_records_wrap(void *tls_session, uint64_t *records)
+{
+    /* count the records actually written instead of estimating them from the data size */
+    SSL_set_msg_callback_arg(tls_session, records);
+    SSL_set_msg_callback(tls_session, nc_tls_record_count_clb);
+}
+
 int
 nc_tls_write_wrap(struct nc_session *session, const unsigned char *buf, size_t size)
 {
@@ -1007,7 +1168,10 @@ nc_tls_write_wrap(struct nc_session *session, const unsigned char *buf, size_t s
 
     ERR_clear_error();
     rc = SSL_write(tls_session, buf, size);
-    if (rc < 1) {
+
+    if (rc > 0) {
+        session->ti.tls.bytes_out += rc;
+    } else {
         err = SSL_get_error(tls_session, rc);
         switch (err) {
         case SSL_ERROR_WANT_WRITE:
@@ -1465,6 +1629,55 @@ nc_tls_get_cert_exp_time_wrap(void *cert)
     return timegm(&t);
 }
 
+time_t
+nc_tls_get_crl_next_update_wrap(const unsigned char *crl_data, size_t size)
+{
+    time_t ret = -1;
+    X509_CRL *crl = NULL;
+    BIO *bio = NULL;
+    const unsigned char *der = crl_data;
+    const ASN1_TIME *next_update;
+    struct tm t = {0};
+
+    /* try DER first */
+    crl = d2i_X509_CRL(NULL, &der, size);
+    if (!crl) {
+        /* DER failed, try PEM next */
+        bio = BIO_new_mem_buf(crl_data, size);
+        if (!bio) {
+            ERR(NULL, "Creating new bio failed (%s).", ERR_reason_error_string(ERR_get_error()));
+            goto cleanup;
+        }
+
+        crl = PEM_read_bio_X509_CRL(bio, NULL, NULL, NULL);
+        if (!crl) {
+            ERR(NULL, "Parsing downloaded CRL failed (%s).", ERR_reason_error_string(ERR_get_error()));
+            goto cleanup;
+        }
+    }
+
+    next_update = X509_CRL_get0_nextUpdate(crl);
+    if (!next_update) {
+        /* optional */
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (!ASN1_TIME_to_tm(next_update, &t)) {
+        goto cleanup;
+    }
+
+    /* let system figure out the DST */
+    t.tm_isdst = -1;
+
+    ret = timegm(&t);
+
+cleanup:
+    X509_CRL_free(crl);
+    BIO_free(bio);
+    return ret;
+}
+
 /**
  * @brief Callback for writing a line in the keylog file.
  */
@@ -19,9 +19,11 @@
 
 #define _GNU_SOURCE
 
+#include <netdb.h>
 #include <poll.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 #include <libyang/libyang.h>
 
@@ -161,6 +163,25 @@ struct nc_keystore {
     uint16_t sym_key_count;                 /**< Count of stored symmetric keys. */
 };
 
+struct nc_auth_state;
+
+/**
+ * @brief Slow authentication verification performed by an authentication worker thread.
+ */
+struct nc_auth_job {
+    struct nc_session *session;         /**< Session being authenticated. */
+    ssh_message msg;                    /**< Authentication request, not yet replied to. */
+    int method;                         /**< Authentication method of @p msg. */
+    char *stored_pw;                    /**< Configured password, NULL if the system one is used (password method). */
+    char *received_pw;                  /**< Received cleartext password (password method). */
+
+    int (*verify)(struct nc_auth_job *job);                 /**< Verification, returns 0 on success. */
+    void (*done_clb)(struct nc_auth_job *job, int result);  /**< Completion callback, called by the worker. */
+    struct nc_auth_state *auth_state;   /**< Authentication state the job belongs to. */
+
+    struct nc_auth_job *next;           /**< Next job in the worker queue. */
+};
+
 /**
  * @brief Tracks the state of a client's authentication.
  */
@@ -169,6 +190,38 @@ struct nc_auth_state {
     int method_count;       /**< Number of authentication methods that the user supports. */
     int success_methods;    /**< Bit field of authentication methods that the user successfully authenticated with. */
     int success_count;      /**< Number of authentication methods that the user successfully authenticated with. */
+
+    uint16_t auth_timeout;      /**< Authentication timeout in seconds, 0 for none. */
+    struct timespec ts_timeout; /**< Absolute authentication timeout, if @p auth_timeout is set. */
+    char *endpt_name;           /**< Name of the endpoint the session was accepted on, for continuing the authentication. */
+    int channel_wait;           /**< Set once authenticated and waiting for the NETCONF channel to be opened. */
+    struct timespec ts_channel; /**< Absolute timeout of opening the NETCONF channel, if there is any. */
+
+    struct nc_auth_job job;     /**< Verification passed to an authentication worker, valid if job.msg is set. */
+    int job_pending;            /**< Set while @p job is queued or being verified. */
+    int job_result;             /**< Result of @p job once finished. */
+    int abandoned;              /**< Set if the session was freed while @p job was pending, the worker frees it. */
+    int notify_fd[2];           /**< Pipe written to once @p job finishes, -1 if not waited for by the caller. */
+    pthread_mutex_t job_lock;   /**< Lock for the job members. */
+    pthread_cond_t job_cond;    /**< Condition signalled when @p job is finished. */
+};
+
+/**
+ * @brief Parsed public keys of a user read from the system authorized keys file.
+ */
+struct nc_authkey_cache_entry {
+    char *username;             /**< Username the keys belong to. */
+    char *path;                 /**< Resolved path of the authorized keys file. */
+
+    dev_t dev;                  /**< Device of the file when it was read. */
+    ino_t ino;                  /**< Inode of the file when it was read. */
+    off_t size;                 /**< Size of the file when it was read. */
+    struct timespec mtime;      /**< Modification time of the file when it was read. */
+
+    ssh_key *keys;              /**< Imported public keys. */
+    uint16_t key_count;         /**< Number of imported public keys. */
+
+    uint64_t last_used;         /**< Value of the cache use counter when this entry was last used. */
 };
 
 /**
@@ -246,6 +299,46 @@ struct nc_cert_grouping {
 struct nc_curl_data {
     unsigned char *data;    /**< Downloaded data */
     size_t size;            /**< Size of downloaded data */
+    char *etag;             /**< HTTP ETag header of the downloaded data, if any */
+    long max_age;           /**< HTTP Cache-Control max-age of the downloaded data, -1 if not set */
+};
+
+/**
+ * @brief Cached CRL downloaded from a CRL distribution point.
+ */
+struct nc_crl_cache_entry {
+    char *uri;              /**< URI the CRL is downloaded from, key of the entry */
+    unsigned char *data;    /**< Downloaded CRL in DER or PEM, always NUL-terminated */
+    size_t size;            /**< Size of the CRL data without the terminating NUL */
+    char *etag;             /**< HTTP ETag of the data for conditional requests, if any */
+    time_t last_modified;   /**< Last modification time of the data for conditional requests, 0 if unknown */
+    time_t refresh_time;    /**< Time when the CRL is to be downloaded again */
+    uint32_t generation;    /**< CRL cache generation of the last change of this CRL */
+};
+
+/**
+ * @brief Reference to a cached CRL used by a TLS context, to learn whether the CRL has changed since.
+ */
+struct nc_crl_cache_ref {
+    char *uri;              /**< URI of the CRL */
+    uint32_t generation;    /**< Generation of the cached CRL that was used, 0 if it was not cached */
+};
+
+/**
+ * @brief Process-wide CRL cache shared by all the TLS sessions and refreshed by a background thread.
+ */
+struct nc_crl_cache {
+    struct nc_crl_cache_entry *entries; /**< Cached CRLs */
+    uint32_t entry_count;   /**< Count of cached CRLs */
+    uint32_t generation;    /**< Incremented whenever any cached CRL changes, the source of entry generations */
+
+    pthread_t tid;          /**< Refresh thread ID */
+    int thread_running;     /**< Flag whether the refresh thread was created and not joined yet */
+    int thread_stop;        /**< Flag for the refresh thread to terminate */
+    int thread_exited;      /**< Flag whether the refresh thread has exited, on its own on an error or when stopped */
+
+    pthread_mutex_t lock;   /**< Lock for accessing this structure */
+    pthread_cond_t cond;    /**< Condition for waking up the refresh thread */
 };
 
 /**
@@ -259,6 +352,64 @@ struct nc_ctn {
     struct nc_ctn *next;                /**< Linked-list reference to the next entry */
 };
 
+/**
+ * @brief Maximum size of a certificate fingerprint (SHA-512).
+ */
+#define NC_TLS_FP_MAX_LEN 64
+
+/**
+ * @brief Size of the digest (SHA-256) identifying trusted end-entity certificates.
+ */
+#define NC_TLS_EE_DIGEST_LEN 32
+
+/**
+ * @brief Cert-to-name fingerprint hash table record.
+ */
+struct nc_ctn_fp_rec {
+    uint8_t alg;                        /**< Fingerprint algorithm, 1 (MD5) to 6 (SHA-512) */
+    uint8_t len;                        /**< Length of the fingerprint */
+    unsigned char fp[NC_TLS_FP_MAX_LEN];    /**< Binary fingerprint */
+    uint32_t *idx;                      /**< Indices of the entries with this fingerprint, in the order of priority */
+    uint32_t idx_count;                 /**< Count of the entries with this fingerprint */
+};
+
+/**
+ * @brief Cert-to-name entries of an endpoint prepared for matching certificates.
+ */
+struct nc_server_tls_ctn_map {
+    struct nc_ctn *ctns;                /**< Copies of the valid entries in the order of priority, next is unused */
+    uint32_t ctn_count;                 /**< Count of the entries */
+    struct ly_ht *fp_ht;                /**< Hash table of struct nc_ctn_fp_rec keyed by (algorithm, fingerprint) */
+    uint32_t *any_idx;                  /**< Indices of the entries without a fingerprint matching any certificate */
+    uint32_t any_count;                 /**< Count of the entries without a fingerprint */
+    uint8_t fp_algs;                    /**< Bit-field of fingerprint algorithms used by the entries */
+};
+
+/**
+ * @brief Prebuilt server TLS context shared by all the sessions accepted on an endpoint.
+ *
+ * It is never modified once built, a new one is built instead.
+ */
+struct nc_server_tls_ctx {
+    void *tls_cfg;                      /**< TLS configuration (server cert and key, CA/CRL store, versions, ciphers) */
+    struct nc_tls_ctx ctx;              /**< TLS context owning the data referenced by the configuration */
+    uint32_t refcount;                  /**< Number of references, protected by server_opts.tls_ctx_lock */
+    struct nc_crl_cache_ref *crls;      /**< Cached CRLs the context was built with */
+    uint32_t crl_count;                 /**< Count of cached CRLs the context was built with */
+    struct nc_server_tls_ctn_map ctn_map;   /**< Cert-to-name entries of the endpoint and its referenced endpoint */
+    struct ly_ht *ee_certs;             /**< Hash set of SHA-256 digests of the trusted end-entity certificates */
+    time_t rotate_time;                 /**< Time a new context with new session ticket keys is built, 0 for never */
+};
+
+/**
+ * @brief State of a server-side TLS handshake in progress.
+ */
+struct nc_server_tls_hs {
+    struct nc_tls_verify_cb_data cb_data;   /**< Verify callback data of the session */
+    struct timespec ts_timeout;             /**< Absolute handshake timeout */
+    char *endpt_name;                       /**< Endpoint of the session when continued by nc_accept_continue() */
+};
+
 /**
  * @brief Server options for configuring the TLS transport protocol.
  */
@@ -291,6 +442,11 @@ struct nc_server_tls_opts {
     uint16_t cipher_count;                      /**< Number of TLS ciphers */
 
     struct nc_ctn *ctn;                         /**< Cert-to-name entries */
+
+    uint32_t resumption_lifetime;               /**< Lifetime of resumable sessions in seconds, 0 if resumption is disabled */
+    uint32_t ticket_key_rotation;               /**< Session ticket key rotation interval in seconds */
+
+    struct nc_server_tls_ctx *srv_ctx;          /**< Prebuilt TLS context, protected by server_opts.tls_ctx_lock */
 };
 
 #endif /* NC_ENABLED_SSH_TLS */
@@ -358,25 +514,73 @@ struct nc_client_ssh_opts {
     char *username;
 };
 
+/**
+ * @brief Client TLS session kept to be resumed by the next connection to the same server.
+ */
+struct nc_client_tls_resumable {
+    char *host;         /**< Expected hostname of the server the session was established with */
+    uint16_t port;      /**< Port of the server, 0 for Call Home */
+    void *session;      /**< Resumable TLS session */
+};
+
 struct nc_client_tls_opts {
     char *cert_path;
     char *key_path;
 
     char *ca_file;
     char *ca_dir;
+
+    struct nc_client_tls_resumable *resumables;
+    uint16_t resumable_count;
+
+    int ktls;
+    int drs;
 };
 
 #endif /* NC_ENABLED_SSH_TLS */
 
+/**
+ * @brief Client context shared by all the sessions with the same module set.
+ */
+struct nc_client_ctx_pool_entry {
+    char *fprint;                   /**< fingerprint of the module set and settings the context was filled with */
+    uint64_t hash;                  /**< hash of the fingerprint */
+    struct ly_ctx *ctx;             /**< shared context, must not be modified */
+    uint32_t refcount;              /**< number of sessions using the context, pool lock */
+    int not_strict;                 /**< whether some modules failed to be loaded into the context */
+    struct nc_client_ctx_pool_entry *next;
+};
+
+/**
+ * @brief Data for loading server modules into a client context on demand.
+ */
+struct nc_client_lazy_ctx {
+    pthread_mutex_t load_lock;      /**< lock for loading modules, protects modules */
+    pthread_rwlock_t ctx_lock;      /**< context lock, read for working with the context, write for loading modules */
+    struct module_info *modules;    /**< server modules, namespace of a module is cleared once it is loaded */
+    ly_module_imp_clb user_clb;     /**< user callback for retrieving modules */
+    void *user_data;                /**< user data for the callback */
+    int has_get_schema;             /**< whether the server supports get-schema */
+    pthread_t loader;               /**< thread loading a module, valid if loading is set */
+    int loading;                    /**< set while a module is being loaded, ctx write lock */
+};
+
 /**
  * @brief Stores data for the client monitoring thread.
  */
 struct nc_client_monitoring_thread_arg {
-    struct nc_session **sessions;   /**< Array of monitored sessions. */
+    struct nc_session **sessions;   /**< Array of monitored sessions, each session stores its index. */
     uint16_t session_count;         /**< Number of monitored sessions. */
-
-    struct pollfd *pfds;            /**< Array of poll file descriptors corresponding to the monitored sessions. */
-    nfds_t pfd_count;               /**< Number of poll file descriptors. */
+    uint16_t session_size;          /**< Allocated size of the sessions array. */
+    uint32_t removals;              /**< Number of sessions removed so far, events that raced with a removal are ignored. */
+
+#ifdef HAVE_EPOLL
+    int epfd;                       /**< Epoll instance with the monitored sessions and the wakeup eventfd. */
+    int evfd;                       /**< Eventfd to wake the monitoring thread up. */
+#else
+    struct pollfd *pfds;            /**< Wakeup pipe followed by the monitored sessions. */
+    int wakeup[2];                  /**< Pipe to wake the monitoring thread up. */
+#endif
 
     pthread_t tid;                  /**< Thread ID of the monitoring thread. */
     int thread_running;             /**< Flag representing the runningness of the monitoring thread. */
@@ -390,7 +594,12 @@ struct nc_client_monitoring_thread_arg {
 /* ACCESS unlocked */
 struct nc_client_opts {
     char *schema_searchpath;
+    char *module_cache_dir;         /**< directory of the persistent module cache, NULL if disabled */
+    size_t module_cache_size_max;   /**< maximum size of the module cache, 0 for no limit */
     int auto_context_fill_disabled;
+    int context_sharing_enabled;    /**< whether to share contexts of sessions with the same module set */
+    int context_lazy_enabled;       /**< whether to load server modules into new contexts on demand */
+    char **context_lazy_modules;    /**< modules to load right away if lazy loading is enabled */
     ly_module_imp_clb schema_clb;
     void *schema_clb_data;
     struct nc_keepalives ka;
@@ -409,7 +618,7 @@ struct nc_client_opts {
 
 /* ACCESS unlocked */
 struct nc_client_context {
-    unsigned int refcount;
+    ATOMIC_T refcount;
     struct nc_client_opts opts;
 
 #ifdef NC_ENABLED_SSH_TLS
@@ -532,6 +741,27 @@ struct nc_server_opts {
     void (*interactive_auth_data_free)(void *data);
 
     int (*user_verify_clb)(const struct nc_session *session);
+    int tls_ktls;                               /**< Whether kernel TLS offload is enabled for TLS sessions */
+    int tls_drs;                                /**< Whether dynamic record sizing is used by TLS sessions */
+
+    /* ACCESS locked - authentication worker pool */
+    struct {
+        pthread_t *tids;                /**< Authentication worker thread IDs. */
+        uint16_t thread_count;          /**< Number of running authentication workers. */
+        int stop;                       /**< Flag signalling the workers to terminate. */
+        struct nc_auth_job *queue;      /**< First queued job. */
+        struct nc_auth_job *queue_last; /**< Last queued job. */
+        pthread_mutex_t lock;           /**< Lock for the worker pool. */
+        pthread_cond_t cond;            /**< Condition signalled on a new job or stop. */
+    } auth_workers;
+
+    /* ACCESS locked - separate lock to not block the config while reading authorized keys files */
+    struct {
+        struct nc_authkey_cache_entry *entries;     /**< Cached users' system public keys. */
+        uint16_t entry_count;                       /**< Number of cached entries. */
+        uint64_t use_counter;                       /**< Incremented on every use, for LRU eviction. */
+        pthread_mutex_t lock;                       /**< Authorized keys cache lock. */
+    } authkey_cache;
 #endif /* NC_ENABLED_SSH_TLS */
 
 #ifdef NC_ENABLED_SSH_TLS
@@ -643,13 +873,46 @@ struct nc_server_opts {
 
     /* ACCESS unlocked */
     FILE *tls_keylog_file;                  /**< File to log TLS secrets to. */
+
+    pthread_mutex_t tls_ctx_lock;           /**< Lock for the prebuilt endpoint TLS contexts and their refcounts. */
 #endif
 };
 
 /**
- * Sleep time in usec to wait between nc_recv_notif() calls.
+ * Timeout in msec after which notification threads retry a session whose socket was left readable
+ * because another thread was reading the session. Otherwise they wait for data or a wakeup without a timeout.
+ */
+#define NC_CLIENT_NOTIF_BUSY_TIMEOUT 10
+
+/**
+ * Maximum number of pipelined \<get-schema\> RPCs waiting for their reply when retrieving server modules.
+ */
+#define NC_CLIENT_PREFETCH_WINDOW 16
+
+/**
+ * Number of worker threads of a connection batch without an explicit limit.
  */
-#define NC_CLIENT_NOTIF_THREAD_SLEEP 10000
+#define NC_CONNECT_BATCH_THREADS 8
+
+/**
+ * Maximum TLS record payload size, data written to TLS sessions are coalesced into records of this size.
+ */
+#define NC_TLS_RECORD_SIZE 16384
+
+/**
+ * TLS record payload size fitting into a single TCP segment, used by dynamic record sizing after idle.
+ */
+#define NC_TLS_RECORD_SIZE_SMALL 1360
+
+/**
+ * Idle time in msec after which dynamic record sizing starts sending small TLS records again.
+ */
+#define NC_TLS_DRS_IDLE_TIMEOUT 1000
+
+/**
+ * Count of bytes sent in small TLS records after idle before dynamic record sizing switches to full-sized records.
+ */
+#define NC_TLS_DRS_SMALL_BYTES 65536
 
 /**
  * Timeout in msec for transport-related data to arrive (ssh_handle_key_exchange(), SSL_accept(), SSL_connect()).
@@ -688,21 +951,37 @@ struct nc_server_opts {
  */
 #define NC_CH_CONNECT_TIMEOUT 500
 
+/**
+ * Time in msec to wait for a connection attempt to a host address before racing it with an attempt
+ * to the next address of the host (Connection Attempt Delay of RFC 8305).
+ */
+#define NC_SOCK_CONNECT_ATTEMPT_DELAY 250
+
 /**
  * Number of sockets kept waiting to be accepted.
  */
 #define NC_REVERSE_QUEUE 5
 
 /**
- * Time slept in msec in each cycle of the client monitoring thread.
+ * Maximum number of events processed in one wakeup of the client monitoring thread.
  */
-#define NC_CLIENT_MONITORING_BACKOFF 200
+#define NC_CLIENT_MONITORING_EVENTS 16
 
 /**
  * Timeout in msec for acquiring a lock of a client monitoring thread.
  */
 #define NC_CLIENT_MONITORING_LOCK_TIMEOUT 500
 
+/**
+ * Time in sec after which a cached CRL is downloaded again if neither its nextUpdate nor HTTP max-age is known.
+ */
+#define NC_CRL_CACHE_REFRESH_DEFAULT 3600
+
+/**
+ * Minimal time in sec between two downloads of a cached CRL, also used as the retry time after a failed download.
+ */
+#define NC_CRL_CACHE_REFRESH_MIN 60
+
 /**
  * TLS key log file environment variable name.
  */
@@ -732,10 +1011,32 @@ enum nc_version {
  */
 struct nc_msg_cont {
     struct ly_in *msg;
-    NC_MSG_TYPE type;         /**< can be either NC_MSG_REPLY or NC_MSG_NOTIF */
+    size_t size;              /**< size of the message in bytes */
     struct nc_msg_cont *next;
 };
 
+/**
+ * @brief FIFO queue of buffered messages of a single type.
+ */
+struct nc_msg_queue {
+    struct nc_msg_cont *head; /**< first (oldest) message */
+    struct nc_msg_cont *tail; /**< last (newest) message */
+};
+
+/**
+ * @brief RPC sent asynchronously and waiting for its reply.
+ */
+struct nc_rpc_pending {
+    uint64_t msgid;                 /**< message ID of the RPC */
+    NC_RPC_TYPE rpc_type;           /**< type of the RPC, its operation is duplicated only to parse the reply */
+    char *rpc_xml;                  /**< printed RPC operation for NC_RPC_ACT_GENERIC */
+    nc_rpc_reply_clb reply_clb;     /**< reply callback, NULL if the reply is received by nc_recv_reply_async() */
+    void *user_data;                /**< reply callback user data */
+    struct ly_in *msg;              /**< received reply, NULL until it arrives */
+    int discard;                    /**< set if the reply is no longer awaited and is dropped once received */
+    struct nc_rpc_pending *next;    /**< next received reply waiting for its callback */
+};
+
 /**
  * @brief NETCONF session structure
  */
@@ -769,12 +1070,26 @@ struct nc_session {
             struct nc_session *next; /**< pointer to the next NETCONF session on the same
                                           SSH session, but different SSH channel. If no such session exists, it is NULL.
                                           otherwise there is a ring list of the NETCONF sessions */
+            struct nc_auth_state *auth; /**< server authentication state, only until the NETCONF channel is opened */
         } libssh;
 
         struct {
             void *session;
             void *config;
             struct nc_tls_ctx ctx;
+            struct nc_server_tls_ctx *srv_ctx; /**< shared server TLS context owning config, if any */
+            struct nc_server_tls_hs *hs;    /**< server handshake state, only while the handshake is in progress */
+            uint8_t ktls;                   /**< NC_TLS_KTLS_* flags of the kernel TLS offload in use */
+            uint8_t resumed;                /**< whether the server handshake resumed a previous session */
+
+            /* SESSION IO locked */
+            char *wbuf;                     /**< buffer coalescing written data into full-sized records */
+            uint32_t wbuf_len;              /**< length of the data in wbuf */
+            int drs;                        /**< whether dynamic record sizing is used */
+            uint32_t drs_sent;              /**< bytes sent in small records since the last idle period */
+            struct timespec ts_last_write;  /**< time of the last record write */
+            uint64_t records_out;           /**< count of records sent */
+            uint64_t bytes_out;             /**< count of application data bytes sent in records */
         } tls;
 #endif /* NC_ENABLED_SSH_TLS */
     } ti;                          /**< transport implementation data */
@@ -809,11 +1124,31 @@ struct nc_session {
             /* client side only data */
             uint64_t msgid;
             char **cpblts;                 /**< list of server's capabilities on client side */
-            pthread_mutex_t msgs_lock;     /**< lock for the msgs buffer */
-            struct nc_msg_cont *msgs;      /**< queue for messages received of different type than expected */
+            pthread_mutex_t msgs_lock;     /**< lock for the message queues */
+            struct nc_msg_queue replies;   /**< queue for rpc-replies received while expecting a notification */
+            struct nc_msg_queue notifs;    /**< queue for notifications received while expecting an rpc-reply */
+            size_t msgs_size;              /**< size of all the messages in both queues */
+            size_t msgs_size_max;          /**< maximum size of all the buffered messages, 0 for no limit */
+            struct ly_ht *pending;         /**< RPCs sent asynchronously (struct nc_rpc_pending *) by message ID, MSGS lock */
+            struct nc_rpc_pending *ready;  /**< FIFO of received replies waiting for their callback, MSGS lock */
+            struct nc_rpc_pending *ready_last; /**< last item of the ready FIFO */
             ATOMIC_T ntf_thread_count;     /**< number of running notification threads */
             ATOMIC_T ntf_thread_running;   /**< flag whether there are notification threads for this session running or not */
+            int ntf_wakeup[2];             /**< pipe waking the notification threads up, created with the first of them */
             struct lyd_node *ext_data;     /**< LY ext data used in the context callback */
+            char *content_id;              /**< yang-library content-id (module-set-id) of the server, if known */
+            struct nc_client_ctx_pool_entry *ctx_entry; /**< shared context pool entry, if the context is from the pool */
+            struct nc_client_lazy_ctx *lazy; /**< on-demand module loading data, if enabled */
+            struct nc_client_pool_item *pool_item; /**< connection pool item, if the session is pooled */
+            NC_CLIENT_PARSE_MODE parse_mode; /**< how received replies and notifications are parsed */
+            struct ly_ctx *opaq_ctx;       /**< context without any modules for parsing into opaque nodes */
+            struct {
+                ATOMIC64_T count;
+                ATOMIC64_T bytes;
+                ATOMIC64_T usec;
+            } parse_stats[2];              /**< parse statistics, indexed by the parse mode */
+            int mon_fd;                    /**< duplicated session socket watched by the monitoring thread */
+            uint16_t mon_idx;              /**< index in the monitored sessions, monitoring thread lock */
         } client;
         struct {
             /* server side only data */
@@ -871,6 +1206,109 @@ struct nc_ntf_thread_arg {
     void (*free_data)(void *);
 };
 
+/**
+ * @brief Notification received by a dispatcher and waiting for a worker thread.
+ */
+struct nc_notif_disp_job {
+    struct nc_notif_disp_session *dsession; /**< dispatched session of the notification */
+    struct lyd_node *envp;                  /**< notification envelope */
+    struct lyd_node *op;                    /**< notification body */
+    struct nc_notif_disp_job *next;         /**< next job in the queue */
+};
+
+/**
+ * @brief Notification dispatcher worker thread.
+ */
+struct nc_notif_disp_worker {
+    pthread_t tid;                          /**< thread ID */
+    pthread_mutex_t lock;                   /**< lock for the job queue, running flag, and its sessions jobs and removed flags */
+    pthread_cond_t cond;                    /**< condition signalled on a new job or stop */
+    struct nc_notif_disp_job *jobs;         /**< FIFO of jobs */
+    struct nc_notif_disp_job *jobs_last;    /**< last job in the FIFO */
+    int running;                            /**< whether the worker should keep running */
+};
+
+/**
+ * @brief Session dispatched by a notification dispatcher.
+ */
+struct nc_notif_disp_session {
+    struct nc_session *session;
+    nc_notif_dispatch_clb notif_clb;
+    void *user_data;
+    void (*free_data)(void *);
+
+    struct nc_notif_disp_worker *worker;    /**< worker calling the callbacks, NULL for the dispatcher thread */
+    uint32_t jobs;                          /**< number of queued jobs of the session, worker lock */
+    int removed;                            /**< set once the session is no longer dispatched, worker lock */
+    int busy;                               /**< set while the session is being read by another thread */
+};
+
+/**
+ * @brief Notification dispatcher serving any number of client sessions by a single thread.
+ */
+struct nc_notif_dispatcher {
+    pthread_t tid;                          /**< dispatcher thread ID */
+    int tid_valid;                          /**< whether the dispatcher thread was created */
+    int wakeup[2];                          /**< pipe used to wake the dispatcher thread up */
+
+    pthread_mutex_t lock;                   /**< lock for the members below */
+    struct nc_notif_disp_session **sessions; /**< dispatched sessions */
+    uint16_t session_count;                 /**< number of dispatched sessions */
+    int running;                            /**< whether the dispatcher thread should keep running */
+
+    struct nc_notif_disp_worker *workers;   /**< worker threads calling the callbacks */
+    uint16_t worker_count;                  /**< number of worker threads */
+    uint16_t next_worker;                   /**< worker to assign to the next added session */
+};
+
+/**
+ * @brief Session kept in a client connection pool.
+ */
+struct nc_client_pool_item {
+    NC_TRANSPORT_IMPL ti;                   /**< transport of the session */
+    char *host;                             /**< server host, socket path for UNIX sockets */
+    uint16_t port;                          /**< server port */
+    char *username;                         /**< username, if any */
+    struct ly_ctx *ctx;                     /**< context requested for the session, if any */
+
+    struct nc_session *session;             /**< pooled session */
+    int lent;                               /**< whether the session is lent out */
+    int opening;                            /**< set while another channel is opened on its SSH connection */
+    struct timespec idle_expire;            /**< time the idle session expires */
+    struct nc_client_pool_item *next;
+};
+
+/**
+ * @brief Client connection pool.
+ */
+struct nc_client_pool {
+    pthread_mutex_t lock;                   /**< lock for the items, never held during any communication */
+    struct nc_client_pool_item *items;      /**< pooled sessions */
+
+    uint16_t max_idle;                      /**< maximum number of idle sessions of a key, 0 for no limit */
+    uint32_t idle_timeout;                  /**< time in seconds an idle session is kept, 0 for no limit */
+    uint16_t max_channels;                  /**< maximum number of sessions sharing a single SSH connection */
+};
+
+/**
+ * @brief Client connections established in parallel.
+ */
+struct nc_connect_batch {
+    pthread_mutex_t lock;                   /**< lock for the members below */
+    uint32_t next;                          /**< index of the next target to connect to */
+    uint32_t failed;                        /**< number of targets without a session */
+    int canceled;                           /**< whether no more targets should be connected to */
+
+    struct nc_connect_target *targets;      /**< targets to connect to, with duplicated hosts */
+    uint32_t target_count;                  /**< number of targets */
+    nc_connect_clb clb;                     /**< callback for each connected target */
+    void *clb_data;                         /**< arbitrary user data for the callback */
+    void *client_ctx;                       /**< client thread context shared by the worker threads */
+
+    pthread_t *tids;                        /**< worker threads */
+    uint16_t thread_count;                  /**< number of worker threads */
+};
+
 #ifdef NC_ENABLED_SSH_TLS
 
 /**
@@ -994,6 +1432,16 @@ void nc_realtime_get(struct timespec *ts);
  */
 int nc_poll(struct pollfd *pfd, uint16_t pfd_count, int timeout);
 
+/**
+ * @brief Wait until a socket is ready for the requested poll(2) events.
+ *
+ * @param[in] sock Socket to wait on.
+ * @param[in] events Events to wait for.
+ * @param[in] ts_timeout Absolute timeout, NULL for infinite.
+ * @return 1 if the socket is ready, 0 on timeout, -1 on error or if the connection was closed.
+ */
+int nc_sock_wait(int sock, short events, const struct timespec *ts_timeout);
+
 /**
  * @brief Enables/disables TCP keepalives.
  *
@@ -1053,6 +1501,89 @@ int nc_session_client_msgs_lock(struct nc_session *session, int *timeout, const
  */
 int nc_session_client_msgs_unlock(struct nc_session *session, const char *func);
 
+/**
+ * @brief Free all the messages in a client message queue.
+ *
+ * @param[in] session Client session of the queue.
+ * @param[in] queue Queue to free.
+ */
+void nc_client_msg_queue_free(struct nc_session *session, struct nc_msg_queue *queue);
+
+/**
+ * @brief Wake up the threads receiving notifications of a client session, if there are any.
+ *
+ * @param[in] session Client session.
+ */
+void nc_client_notif_wakeup(struct nc_session *session);
+
+/**
+ * @brief Free all the RPCs sent asynchronously and still waiting for their reply or callback.
+ *
+ * Callbacks are not called. Is expected to be called with the MSGS lock held or when no one else can access the session.
+ *
+ * @param[in] session Client session.
+ */
+void nc_client_rpc_pending_free_all(struct nc_session *session);
+
+/**
+ * @brief Stop waiting for the reply of an RPC sent by ::nc_send_rpc_async() without a callback.
+ *
+ * The reply is dropped once received, or right away if it has already been received.
+ *
+ * @param[in] session Client session.
+ * @param[in] msgid Message ID of the RPC.
+ */
+void nc_client_rpc_pending_discard(struct nc_session *session, uint64_t msgid);
+
+/**
+ * @brief Release a shared client context, it is freed when not used by any session.
+ *
+ * @param[in] entry Pool entry of the context.
+ */
+void nc_client_ctx_pool_release(struct nc_client_ctx_pool_entry *entry);
+
+/**
+ * @brief Read a YANG module from the module cache of the client.
+ *
+ * The text is verified against its hash, corrupted objects and dangling links are removed.
+ *
+ * @param[in] session Client session the module is retrieved for.
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @return Module content in YANG format, NULL if not cached.
+ */
+char *nc_module_cache_retrieve(struct nc_session *session, const char *name, const char *rev);
+
+/**
+ * @brief Store a YANG module retrieved from a server into the module cache of the client.
+ *
+ * Both the object with the module text and the link to it are created under a temporary name and renamed
+ * so that the concurrent readers never see incomplete files.
+ *
+ * @param[in] session Client session the module was retrieved for.
+ * @param[in] name Module name.
+ * @param[in] rev Module revision.
+ * @param[in] model_data Module content.
+ */
+void nc_module_cache_store(struct nc_session *session, const char *name, const char *rev, const char *model_data);
+
+/**
+ * @brief Evict the least recently used objects from a module cache until it fits its size limit.
+ *
+ * Only one process evicts at a time, others skip the eviction. Links to evicted objects are removed as well.
+ *
+ * @param[in] dir Module cache directory.
+ * @param[in] size_max Maximum size of all the cached objects.
+ */
+void nc_module_cache_evict(const char *dir, size_t size_max);
+
+/**
+ * @brief Free on-demand module loading data of a client session.
+ *
+ * @param[in] session Client session.
+ */
+void nc_client_lazy_ctx_free(struct nc_session *session);
+
 int nc_ps_lock(struct nc_pollsession *ps, uint8_t *id, const char *func);
 
 int nc_ps_unlock(struct nc_pollsession *ps, uint8_t id, const char *func);
@@ -1092,6 +1623,9 @@ int nc_sock_bind_inet(int sock, const char *address, uint16_t port, int is_ipv4)
 /**
  * @brief Create a socket connection.
  *
+ * All the addresses of @p dst_addr are raced, an attempt to the next address is started after
+ * ::NC_SOCK_CONNECT_ATTEMPT_DELAY or right after the previous attempt fails, and the first connected socket is used.
+ *
  * @param[in] src_addr Address to connect from.
  * @param[in] src_port Port to connect from.
  * @param[in] dst_addr Address to connect to.
@@ -1099,13 +1633,34 @@ int nc_sock_bind_inet(int sock, const char *address, uint16_t port, int is_ipv4)
  * @param[in] timeout_ms Timeout in ms for blocking the connect + select call (-1 for infinite).
  * @param[in] ka Keepalives parameters.
  * @param[in,out] sock_pending Previous pending socket. If set, equal to -1, and the connection is still in progress
- * after @p timeout, it is set to the pending socket but -1 is returned. If NULL, the socket is closed on timeout.
+ * after @p timeout, it is set to the pending socket of the first address still being connected to but -1 is returned.
+ * If NULL, the sockets are closed on timeout.
  * @param[out] ip_host Optional parameter with string IP address of the connected host.
  * @return Connected socket or -1 on error.
  */
 int nc_sock_connect(const char *src_addr, uint16_t src_port, const char *dst_addr, uint16_t dst_port, int timeout_ms,
         struct nc_keepalives *ka, int *sock_pending, char **ip_host);
 
+/**
+ * @brief Race connections to all the addresses of a host (RFC 8305).
+ *
+ * The addresses are tried with interleaved address families, starting with the family of the first
+ * (most preferred) address. A new attempt is started every ::NC_SOCK_CONNECT_ATTEMPT_DELAY or right after
+ * an attempt fails, while the previous attempts keep running, and the first connected socket wins.
+ *
+ * @param[in] src_addr Specific source address to bind to, used only for CH.
+ * @param[in] src_port Specific source port to bind to, used only for CH.
+ * @param[in] timeout_ms Timeout in ms to wait for a connection to be fully established, -1 to block.
+ * @param[out] sock_pending Optional socket of the first address still being connected to on timeout, is not changed
+ * otherwise. If NULL, all the sockets are closed on timeout.
+ * @param[in] res_list Addrinfo resources to connect to.
+ * @param[in] ka Keepalives to set.
+ * @param[out] res_conn Addrinfo resource of the connected socket.
+ * @return Connected socket or -1 on error.
+ */
+int nc_sock_connect_race(const char *src_addr, uint16_t src_port, int timeout_ms, int *sock_pending,
+        struct addrinfo *res_list, const struct nc_keepalives *ka, struct addrinfo **res_conn);
+
 /**
  * @brief Accept a new socket connection.
  *
@@ -1188,6 +1743,18 @@ NC_MSG_TYPE nc_connect_callhome(const char *host, uint16_t port, NC_TRANSPORT_IM
 
 #ifdef NC_ENABLED_SSH_TLS
 
+/**
+ * @brief Connect to a NETCONF server using SSH, see ::nc_connect_ssh().
+ *
+ * @param[in] host Hostname or address of the server, localhost if NULL.
+ * @param[in] port Port of the server, the default NETCONF SSH port if 0.
+ * @param[in] username Username for this connection, the one set by ::nc_client_ssh_set_username() or
+ * the current system user if NULL.
+ * @param[in] ctx Optional context for the session.
+ * @return Created session, NULL on error.
+ */
+struct nc_session *nc_connect_ssh_user(const char *host, uint16_t port, const char *username, struct ly_ctx *ctx);
+
 /**
  * @brief Accept a server Call Home connection on a socket.
  *
@@ -1204,11 +1771,51 @@ struct nc_session *nc_accept_callhome_ssh_sock(int sock, const char *host, uint1
  * @brief Establish SSH transport on a socket.
  *
  * @param[in] session Session structure of the new connection.
+ * @param[in] opts Endpoint SSH options.
  * @param[in] sock Socket of the new connection.
  * @param[in] timeout Transport operations timeout in msec (not SSH authentication one).
- * @return 1 on success, 0 on timeout, -1 on error.
+ * @param[out] fd If set, the authentication does not block and if not finished, the file descriptor to wait for.
+ * @param[out] events poll(2) events to wait for on @p fd.
+ * @return 1 on success, 0 on timeout, -1 on error, 2 if the authentication is not finished (only if @p fd set).
+ */
+int nc_accept_ssh_session(struct nc_session *session, struct nc_server_ssh_opts *opts, int sock, int timeout, int *fd,
+        short *events);
+
+/**
+ * @brief Continue authenticating an SSH session and open its NETCONF channel.
+ *
+ * Must be called with the CONFIG lock held.
+ *
+ * @param[in] session Session with the SSH key exchange finished.
+ * @param[in] opts Endpoint SSH options.
+ * @param[in] timeout Transport operations timeout in msec (not SSH authentication one).
+ * @param[out] fd If set, the authentication and opening the channel do not block and if not finished, the file
+ * descriptor to wait for.
+ * @param[out] events poll(2) events to wait for on @p fd.
+ * @return 1 on success, 0 on timeout, -1 on error, 2 if the channel is not opened yet (only if @p fd set).
+ */
+int nc_accept_ssh_session_step(struct nc_session *session, struct nc_server_ssh_opts *opts, int timeout, int *fd,
+        short *events);
+
+/**
+ * @brief Wait until the socket of an SSH session is ready for the pending libssh operation.
+ *
+ * @param[in] session NETCONF session with an SSH session.
+ * @param[in] ts_timeout Absolute timeout, NULL for infinite.
+ * @return 1 if the socket is ready, 0 on timeout, -1 on error or if the connection was closed.
  */
-int nc_accept_ssh_session(struct nc_session *session, struct nc_server_ssh_opts *opts, int sock, int timeout);
+int nc_server_ssh_wait_fd(const struct nc_session *session, const struct timespec *ts_timeout);
+
+/**
+ * @brief Release the authentication state of a server SSH session.
+ *
+ * If an authentication worker still verifies a request of the session, the session is passed to it
+ * and freed once the verification finishes.
+ *
+ * @param[in] session Session with an authentication state.
+ * @return 0 if the state was freed, 1 if the session was passed to a worker and must not be used anymore.
+ */
+int nc_server_ssh_auth_state_release(struct nc_session *session);
 
 /**
  * @brief Process a SSH message.
@@ -1221,6 +1828,16 @@ int nc_accept_ssh_session(struct nc_session *session, struct nc_server_ssh_opts
  */
 int nc_session_ssh_msg(struct nc_session *session, struct nc_server_ssh_opts *opts, ssh_message msg, struct nc_auth_state *auth_state);
 
+/**
+ * @brief Free all the cached system authorized keys of all the users.
+ */
+void nc_server_ssh_authkey_cache_flush(void);
+
+/**
+ * @brief Stop all the authentication worker threads.
+ */
+void nc_server_ssh_auth_workers_stop(void);
+
 void nc_client_ssh_destroy_opts(void);
 void _nc_client_ssh_destroy_opts(struct nc_client_ssh_opts *opts);
 
@@ -1231,12 +1848,103 @@ struct nc_session *nc_accept_callhome_tls_sock(int sock, const char *host, uint1
  * @brief Establish TLS transport on a socket.
  *
  * @param[in] session Session structure of the new connection.
+ * @param[in] opts TLS options of the endpoint.
  * @param[in] sock Socket of the new connection.
  * @param[in] timeout Transport operations timeout in msec.
  * @return 1 on success, 0 on timeout, -1 on error.
  */
 int nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opts, int sock, int timeout);
 
+/**
+ * @brief Create a TLS session on a socket and prepare its handshake, without performing any step of it.
+ *
+ * @param[in] session Session structure of the new connection.
+ * @param[in] opts TLS options of the endpoint.
+ * @param[in] sock Socket of the new connection, always assigned to the session or closed.
+ * @param[in] timeout Handshake timeout in msec, -1 for infinite.
+ * @return 0 on success, -1 on error.
+ */
+int nc_accept_tls_session_start(struct nc_session *session, struct nc_server_tls_opts *opts, int sock, int timeout);
+
+/**
+ * @brief Perform a step of a TLS handshake prepared by ::nc_accept_tls_session_start().
+ *
+ * Never blocks, the socket is expected to be ready for the @p events returned by the previous step.
+ * Must be called with the CONFIG lock held.
+ *
+ * @param[in] session Session with the TLS handshake in progress.
+ * @param[out] events If the handshake is not finished, poll(2) events to wait for on the socket.
+ * @return 1 if the handshake finished and the client was authenticated, 0 if the handshake is not finished,
+ * -1 on error.
+ */
+int nc_accept_tls_session_step(struct nc_session *session, short *events);
+
+/**
+ * @brief Prepare a session with an established TLS session for communication.
+ *
+ * Stores the kernel TLS offload used and starts counting the records sent.
+ *
+ * @param[in] session Session with the TLS handshake finished.
+ */
+void nc_session_tls_established(struct nc_session *session);
+
+/**
+ * @brief Release a reference of a prebuilt server TLS context, free it if it was the last one.
+ *
+ * @param[in] srv_ctx Server TLS context to release, may be NULL.
+ */
+void nc_server_tls_ctx_unref(struct nc_server_tls_ctx *srv_ctx);
+
+/**
+ * @brief Prepare the cert-to-name entries of an endpoint (and its referenced endpoint) for matching.
+ *
+ * @param[in] opts Endpoint TLS options.
+ * @param[in] referenced_endpt Referenced endpoint, if any.
+ * @param[out] map Prepared map.
+ * @return 0 on success, -1 on error.
+ */
+int nc_server_tls_ctn_map_build(const struct nc_server_tls_opts *opts, const struct nc_endpt *referenced_endpt,
+        struct nc_server_tls_ctn_map *map);
+
+/**
+ * @brief Free the prepared cert-to-name entries.
+ *
+ * @param[in] map Prepared cert-to-name entries.
+ */
+void nc_server_tls_ctn_map_free(struct nc_server_tls_ctn_map *map);
+
+/**
+ * @brief Map a certificate chain to a username using the prepared cert-to-name entries.
+ *
+ * The digests of every certificate are computed at most once and only for the algorithms used. The first
+ * entry (by priority) matching any certificate that provides a username wins.
+ *
+ * @param[in] map Prepared cert-to-name entries.
+ * @param[in] cert_chain Certificate chain of the peer.
+ * @param[out] username Mapped username.
+ * @return 0 on success, 1 if no entry matched, -1 on error.
+ */
+int nc_server_tls_cert_to_name(const struct nc_server_tls_ctn_map *map, void *cert_chain, char **username);
+
+/**
+ * @brief Drop the TLS contexts of all the TLS endpoints and Call Home endpoints built from a previous configuration.
+ *
+ * Sessions accepted before the contexts are rebuilt build them on their own.
+ *
+ * THE config_lock HAS TO BE WRITE-LOCKED PRIOR TO CALLING THIS
+ */
+void nc_server_tls_ctx_drop(void);
+
+/**
+ * @brief Build new TLS contexts of all the TLS endpoints and Call Home endpoints, replacing the previous ones.
+ *
+ * Endpoints whose context fails to be built are left without one and it is built on the next accept.
+ * The CRLs not cached yet are downloaded with the config_lock unlocked.
+ *
+ * THE config_lock MUST NOT BE LOCKED PRIOR TO CALLING THIS
+ */
+void nc_server_tls_ctx_rebuild(void);
+
 void nc_client_tls_destroy_opts(void);
 void _nc_client_tls_destroy_opts(struct nc_client_tls_opts *opts);
 
@@ -1245,10 +1953,71 @@ void _nc_client_tls_destroy_opts(struct nc_client_tls_opts *opts);
  *
  * @param[in] leaf_cert Server/client certificate.
  * @param[in] cert_store CA/EE certificates store.
+ * @param[in,out] uncached Optional set of URIs to add the CRLs not cached yet to, they are not downloaded then.
+ * @param[in,out] uncached_count Count of @p uncached.
  * @param[out] crl_store Created CRL store.
+ * @param[out] crls Optional references to the cached CRLs added to @p crl_store.
+ * @param[out] crl_count Count of @p crls.
  * @return 0 on success, 1 on error.
  */
-int nc_session_tls_crl_from_cert_ext_fetch(void *leaf_cert, void *cert_store, void **crl_store);
+int nc_session_tls_crl_from_cert_ext_fetch(void *leaf_cert, void *cert_store, char ***uncached, uint32_t *uncached_count,
+        void **crl_store, struct nc_crl_cache_ref **crls, uint32_t *crl_count);
+
+/**
+ * @brief Add a CRL to a store, download it only if not already in the CRL cache.
+ *
+ * @param[in] uri URI of the CRL.
+ * @param[in] cached_only Whether not to download the CRL if it is not cached.
+ * @param[in] crl_store Optional CRL store to add the CRL to, if not set the CRL is only cached.
+ * @param[out] generation Optional generation of the cached CRL that was added.
+ * @return 0 on success, 1 on error, 2 if @p cached_only is set and the CRL is not cached.
+ */
+int nc_session_tls_crl_cache_get(const char *uri, int cached_only, void *crl_store, uint32_t *generation);
+
+/**
+ * @brief Learn whether any of the referenced cached CRLs has changed.
+ *
+ * @param[in] crls References to cached CRLs.
+ * @param[in] crl_count Count of @p crls.
+ * @return Whether any of the CRLs was refreshed, newly cached, or dropped from the cache.
+ */
+int nc_session_tls_crl_cache_changed(const struct nc_crl_cache_ref *crls, uint32_t crl_count);
+
+/**
+ * @brief Get the time a cached CRL is going to be downloaded again.
+ *
+ * @param[in] uri URI of the CRL.
+ * @return Refresh time, 0 if the CRL is not cached.
+ */
+time_t nc_session_tls_crl_cache_refresh_time(const char *uri);
+
+/**
+ * @brief Make a cached CRL be downloaded again by the refresh thread right away.
+ *
+ * @param[in] uri URI of the CRL.
+ * @return 0 on success, 1 if the CRL is not cached.
+ */
+int nc_session_tls_crl_cache_expire(const char *uri);
+
+/**
+ * @brief Free references to cached CRLs.
+ *
+ * @param[in] crls References to free.
+ * @param[in] crl_count Count of @p crls.
+ */
+void nc_session_tls_crl_cache_refs_free(struct nc_crl_cache_ref *crls, uint32_t crl_count);
+
+/**
+ * @brief Get the current generation of the CRL cache, it changes whenever any cached CRL is updated.
+ *
+ * @return CRL cache generation.
+ */
+uint32_t nc_session_tls_crl_cache_generation(void);
+
+/**
+ * @brief Stop the CRL cache refresh thread and free all the cached CRLs.
+ */
+void nc_session_tls_crl_cache_destroy(void);
 
 #endif /* NC_ENABLED_SSH_TLS */
 
@@ -1298,6 +2067,37 @@ int nc_read_msg_poll_io(struct nc_session *session, int io_timeout, struct ly_in
  */
 int nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **msg, int passing_io_lock);
 
+/**
+ * @brief Callback for the data of a message read by ::nc_read_msg_poll_stream_io().
+ *
+ * @param[in] data Message data read and not consumed yet, without any framing, null-terminated.
+ * @param[in] len Length of @p data.
+ * @param[in] last Whether @p data end with the end of the message.
+ * @param[in] clb_data Arbitrary callback data.
+ * @return Number of bytes consumed from the beginning of @p data, they are discarded and the rest is passed
+ * again with more data;
+ * @return -1 on error, the rest of the message is read without calling the callback again.
+ */
+typedef ssize_t (*nc_read_msg_clb)(const char *data, size_t len, int last, void *clb_data);
+
+/**
+ * @brief Read a message from the wire and pass it to a callback in parts, as it is being read.
+ *
+ * Only the data not consumed by the callback are kept so the whole message never needs to be held in memory.
+ * The callback is called with the session IO lock held.
+ *
+ * @param[in] session NETCONF session from which the message is being read.
+ * @param[in] io_timeout Timeout in milliseconds. Negative value means infinite timeout,
+ *            zero value causes to return immediately.
+ * @param[in] clb Callback to pass the message data to.
+ * @param[in] clb_data Arbitrary data for @p clb.
+ * @return 1 on success, even if @p clb failed.
+ * @return 0 on timeout.
+ * @return -1 on error.
+ * @return -2 on malformed message error.
+ */
+int nc_read_msg_poll_stream_io(struct nc_session *session, int io_timeout, nc_read_msg_clb clb, void *clb_data);
+
 /**
  * @brief Write message into wire.
  *
@@ -1324,6 +2124,19 @@ int nc_read_msg_io(struct nc_session *session, int io_timeout, struct ly_in **ms
  */
 NC_MSG_TYPE nc_write_msg_io(struct nc_session *session, int io_timeout, int type, ...);
 
+/**
+ * @brief Write an \<rpc\> with a pre-printed content on a client session.
+ *
+ * @param[in] session Session to write to.
+ * @param[in] io_timeout Timeout in msec for acquiring the IO lock.
+ * @param[in] rpc_tail The rest of the \<rpc\> after the message-id attribute value.
+ * @param[in] rpc_tail_len Length of @p rpc_tail.
+ * @param[out] msgid Message ID of the written RPC.
+ * @return #NC_MSG_RPC on success, #NC_MSG_WOULDBLOCK if the IO lock could not be acquired, #NC_MSG_ERROR on error.
+ */
+NC_MSG_TYPE nc_write_rpc_prepared_io(struct nc_session *session, int io_timeout, const char *rpc_tail,
+        uint32_t rpc_tail_len, uint64_t *msgid);
+
 /**
  * @brief Check whether a session is still connected (on transport layer).
  *
@@ -58,6 +58,12 @@ struct nc_server_opts server_opts = {
     .hello_lock = PTHREAD_RWLOCK_INITIALIZER,
     .config_lock = PTHREAD_RWLOCK_INITIALIZER,
     .ch_client_lock = PTHREAD_RWLOCK_INITIALIZER,
+#ifdef NC_ENABLED_SSH_TLS
+    .auth_workers.lock = PTHREAD_MUTEX_INITIALIZER,
+    .auth_workers.cond = PTHREAD_COND_INITIALIZER,
+    .authkey_cache.lock = PTHREAD_MUTEX_INITIALIZER,
+    .tls_ctx_lock = PTHREAD_MUTEX_INITIALIZER,
+#endif
     .idle_timeout = 180,    /**< default idle timeout (not in config for UNIX socket) */
 };
 
@@ -958,6 +964,8 @@ nc_server_destroy(void)
 #ifdef NC_ENABLED_SSH_TLS
     free(server_opts.authkey_path_fmt);
     server_opts.authkey_path_fmt = NULL;
+    nc_server_ssh_authkey_cache_flush();
+    nc_server_ssh_auth_workers_stop();
     free(server_opts.pam_config_name);
     server_opts.pam_config_name = NULL;
     if (server_opts.interactive_auth_data && server_opts.interactive_auth_data_free) {
@@ -968,6 +976,7 @@ nc_server_destroy(void)
 
     nc_server_config_ks_keystore(NULL, NC_OP_DELETE);
     nc_server_config_ts_truststore(NULL, NC_OP_DELETE);
+    nc_session_tls_crl_cache_destroy();
     curl_global_cleanup();
     nc_tls_backend_destroy_wrap();
     ssh_finalize();
@@ -2572,16 +2581,57 @@ nc_server_endpt_count(void)
     return server_opts.endpt_count;
 }
 
-API NC_MSG_TYPE
-nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
+/**
+ * @brief Finish accepting a session with its transport established, perform the NETCONF handshake.
+ *
+ * @param[in,out] session New session, freed and set to NULL on error.
+ * @return NC_MSG_HELLO on success, other values on error.
+ */
+static NC_MSG_TYPE
+nc_accept_finish(struct nc_session **session)
+{
+    NC_MSG_TYPE msgtype;
+    struct timespec ts_cur;
+
+    /* assign new SID atomically */
+    (*session)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
+
+    /* NETCONF handshake */
+    msgtype = nc_handshake_io(*session);
+    if (msgtype != NC_MSG_HELLO) {
+        nc_session_free(*session, NULL);
+        *session = NULL;
+        return msgtype;
+    }
+
+    nc_timeouttime_get(&ts_cur, 0);
+    (*session)->opts.server.last_rpc = ts_cur.tv_sec;
+    nc_realtime_get(&ts_cur);
+    (*session)->opts.server.session_start = ts_cur;
+    (*session)->status = NC_STATUS_RUNNING;
+
+    return msgtype;
+}
+
+/**
+ * @brief Accept a new session on the listening endpoints.
+ *
+ * @param[in] timeout Timeout for receiving a new connection in msec.
+ * @param[in] ctx Context for the session to use.
+ * @param[out] session New session.
+ * @param[out] fd Socket of a session with the TLS handshake in progress, only if @p events is set.
+ * @param[out] events If set, a TLS handshake is only started and if not finished, poll(2) events
+ * to wait for on @p fd are returned.
+ * @return NC_MSG_HELLO on success, NC_MSG_WOULDBLOCK on timeout or if a TLS handshake is in progress
+ * (@p session set), other values on error.
+ */
+static NC_MSG_TYPE
+_nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session, int *fd, short *events)
 {
     NC_MSG_TYPE msgtype;
     int sock = -1, ret;
     char *host = NULL;
     uint16_t port, bind_idx;
-    struct timespec ts_cur;
-
-    NC_CHECK_ARG_RET(NULL, ctx, session, NC_MSG_ERROR);
 
     NC_CHECK_SRV_INIT_RET(NC_MSG_ERROR);
 
@@ -2624,7 +2674,9 @@ nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
     /* sock gets assigned to session or closed */
 #ifdef NC_ENABLED_SSH_TLS
     if (server_opts.endpts[bind_idx].ti == NC_TI_SSH) {
-        ret = nc_accept_ssh_session(*session, server_opts.endpts[bind_idx].opts.ssh, sock, NC_TRANSPORT_TIMEOUT);
+        /* with events set, only start the authentication, it is finished by nc_accept_continue() */
+        ret = nc_accept_ssh_session(*session, server_opts.endpts[bind_idx].opts.ssh, sock, NC_TRANSPORT_TIMEOUT,
+                events ? fd : NULL, events);
         sock = -1;
         if (ret < 0) {
             msgtype = NC_MSG_ERROR;
@@ -2632,6 +2684,36 @@ nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
         } else if (!ret) {
             msgtype = NC_MSG_WOULDBLOCK;
             goto cleanup;
+        } else if (ret == 2) {
+            /* remember the endpoint to continue with */
+            (*session)->ti.libssh.auth->endpt_name = strdup(server_opts.endpts[bind_idx].name);
+            NC_CHECK_ERRMEM_GOTO(!(*session)->ti.libssh.auth->endpt_name, msgtype = NC_MSG_ERROR, cleanup);
+
+            /* CONFIG UNLOCK */
+            pthread_rwlock_unlock(&server_opts.config_lock);
+            return NC_MSG_WOULDBLOCK;
+        }
+    } else if ((server_opts.endpts[bind_idx].ti == NC_TI_TLS) && events) {
+        /* only start the handshake, it is finished by nc_accept_continue() */
+        *fd = sock;
+        (*session)->data = server_opts.endpts[bind_idx].opts.tls;
+        ret = nc_accept_tls_session_start(*session, server_opts.endpts[bind_idx].opts.tls, sock, NC_TRANSPORT_TIMEOUT);
+        sock = -1;
+        if (!ret) {
+            ret = nc_accept_tls_session_step(*session, events);
+        }
+        if (ret < 0) {
+            msgtype = NC_MSG_ERROR;
+            goto cleanup;
+        } else if (!ret) {
+            /* remember the endpoint to continue with, its options are valid only with the config locked */
+            (*session)->data = NULL;
+            (*session)->ti.tls.hs->endpt_name = strdup(server_opts.endpts[bind_idx].name);
+            NC_CHECK_ERRMEM_GOTO(!(*session)->ti.tls.hs->endpt_name, msgtype = NC_MSG_ERROR, cleanup);
+
+            /* CONFIG UNLOCK */
+            pthread_rwlock_unlock(&server_opts.config_lock);
+            return NC_MSG_WOULDBLOCK;
         }
     } else if (server_opts.endpts[bind_idx].ti == NC_TI_TLS) {
         (*session)->data = server_opts.endpts[bind_idx].opts.tls;
@@ -2645,6 +2727,10 @@ nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
             goto cleanup;
         }
     } else
+#else
+    /* just to avoid compiler warning, TLS handshakes are never started */
+    (void)fd;
+    (void)events;
 #endif /* NC_ENABLED_SSH_TLS */
     if (server_opts.endpts[bind_idx].ti == NC_TI_UNIX) {
         (*session)->data = server_opts.endpts[bind_idx].opts.unixsock;
@@ -2665,24 +2751,7 @@ nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
     /* CONFIG UNLOCK */
     pthread_rwlock_unlock(&server_opts.config_lock);
 
-    /* assign new SID atomically */
-    (*session)->id = ATOMIC_INC_RELAXED(server_opts.new_session_id);
-
-    /* NETCONF handshake */
-    msgtype = nc_handshake_io(*session);
-    if (msgtype != NC_MSG_HELLO) {
-        nc_session_free(*session, NULL);
-        *session = NULL;
-        return msgtype;
-    }
-
-    nc_timeouttime_get(&ts_cur, 0);
-    (*session)->opts.server.last_rpc = ts_cur.tv_sec;
-    nc_realtime_get(&ts_cur);
-    (*session)->opts.server.session_start = ts_cur;
-    (*session)->status = NC_STATUS_RUNNING;
-
-    return msgtype;
+    return nc_accept_finish(session);
 
 cleanup:
     /* CONFIG UNLOCK */
@@ -2697,6 +2766,111 @@ cleanup:
     return msgtype;
 }
 
+API NC_MSG_TYPE
+nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session **session)
+{
+    NC_CHECK_ARG_RET(NULL, ctx, session, NC_MSG_ERROR);
+
+    return _nc_accept(timeout, ctx, session, NULL, NULL);
+}
+
+#ifdef NC_ENABLED_SSH_TLS
+
+API NC_MSG_TYPE
+nc_accept_start(int timeout, const struct ly_ctx *ctx, struct nc_session **session, int *fd, short *events)
+{
+    NC_CHECK_ARG_RET(NULL, ctx, session, fd, events, NC_MSG_ERROR);
+
+    *fd = -1;
+    *events = 0;
+
+    return _nc_accept(timeout, ctx, session, fd, events);
+}
+
+API NC_MSG_TYPE
+nc_accept_continue(struct nc_session **session, int *fd, short *events)
+{
+    int ret;
+    uint16_t i;
+    struct nc_server_ssh_opts *opts = NULL;
+
+    NC_CHECK_ARG_RET(NULL, session, *session, fd, events, NC_MSG_ERROR);
+
+    if (((*session)->side == NC_SERVER) && ((*session)->ti_type == NC_TI_SSH) && (*session)->ti.libssh.auth) {
+        /* CONFIG LOCK */
+        pthread_rwlock_rdlock(&server_opts.config_lock);
+
+        /* the endpoint may have been changed meanwhile */
+        for (i = 0; i < server_opts.endpt_count; ++i) {
+            if ((server_opts.endpts[i].ti == NC_TI_SSH) &&
+                    !strcmp(server_opts.endpts[i].name, (*session)->ti.libssh.auth->endpt_name)) {
+                opts = server_opts.endpts[i].opts.ssh;
+                break;
+            }
+        }
+        if (opts) {
+            ret = nc_accept_ssh_session_step(*session, opts, NC_TRANSPORT_TIMEOUT, fd, events);
+        } else {
+            ERR(*session, "Endpoint \"%s\" of the session was removed.", (*session)->ti.libssh.auth->endpt_name);
+            ret = -1;
+        }
+
+        /* CONFIG UNLOCK */
+        pthread_rwlock_unlock(&server_opts.config_lock);
+
+        if (ret == 2) {
+            return NC_MSG_WOULDBLOCK;
+        } else if (ret != 1) {
+            /* a session with a pending authentication job is freed by the worker */
+            nc_session_free(*session, NULL);
+            *session = NULL;
+            return NC_MSG_ERROR;
+        }
+    } else if (((*session)->side == NC_SERVER) && ((*session)->ti_type == NC_TI_TLS) && (*session)->ti.tls.hs) {
+        /* CONFIG LOCK */
+        pthread_rwlock_rdlock(&server_opts.config_lock);
+
+        /* the endpoint options are available to the callbacks called during the handshake */
+        for (i = 0; i < server_opts.endpt_count; ++i) {
+            if ((server_opts.endpts[i].ti == NC_TI_TLS) &&
+                    !strcmp(server_opts.endpts[i].name, (*session)->ti.tls.hs->endpt_name)) {
+                (*session)->data = server_opts.endpts[i].opts.tls;
+                break;
+            }
+        }
+
+        ret = nc_accept_tls_session_step(*session, events);
+        (*session)->data = NULL;
+
+        /* CONFIG UNLOCK */
+        pthread_rwlock_unlock(&server_opts.config_lock);
+
+        if (!ret) {
+            if (nc_timeouttime_cur_diff(&(*session)->ti.tls.hs->ts_timeout) > 0) {
+                *fd = nc_tls_get_fd_wrap(*session);
+                return NC_MSG_WOULDBLOCK;
+            }
+            ERR(*session, "TLS accept timeout.");
+            ret = -1;
+        }
+        if (ret < 0) {
+            nc_session_free(*session, NULL);
+            *session = NULL;
+            return NC_MSG_ERROR;
+        }
+    } else {
+        ERR(*session, "Session does not have a TLS handshake or an SSH authentication in progress.");
+        return NC_MSG_ERROR;
+    }
+
+    *fd = -1;
+    *events = 0;
+    (*session)->data = NULL;
+    return nc_accept_finish(session);
+}
+
+#endif /* NC_ENABLED_SSH_TLS */
+
 #ifdef NC_ENABLED_SSH_TLS
 
 API int
@@ -2815,7 +2989,7 @@ nc_connect_ch_endpt(struct nc_ch_endpt *endpt, nc_server_ch_session_acquire_ctx_
 
     /* sock gets assigned to session or closed */
     if (endpt->ti == NC_TI_SSH) {
-        ret = nc_accept_ssh_session(*session, endpt->opts.ssh, sock, NC_TRANSPORT_TIMEOUT);
+        ret = nc_accept_ssh_session(*session, endpt->opts.ssh, sock, NC_TRANSPORT_TIMEOUT, NULL, NULL);
         (*session)->data = NULL;
 
         if (ret < 0) {
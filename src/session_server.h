@@ -447,6 +447,46 @@ NC_MSG_TYPE nc_accept(int timeout, const struct ly_ctx *ctx, struct nc_session *
 
 #ifdef NC_ENABLED_SSH_TLS
 
+/**
+ * @brief Accept a new session on all the listening endpoints without blocking on its TLS handshake
+ * or SSH authentication.
+ *
+ * Works the same as ::nc_accept() except that on TLS endpoints the TLS handshake and on SSH endpoints the SSH
+ * authentication and opening the NETCONF channel is only started. If it cannot be finished right away, the new session is returned together
+ * with a file descriptor and the poll(2) events the descriptor must become ready for. The session is then
+ * progressed by ::nc_accept_continue(), so that many handshakes can be driven by a single thread with
+ * an external poller. The file descriptor is either the session socket or, while an authentication worker
+ * (see ::nc_server_ssh_set_auth_thread_count()) verifies SSH credentials, a descriptor readable once it
+ * finishes. Once the transport is established, the NETCONF \<hello\> exchange is performed as by ::nc_accept().
+ *
+ * @param[in] timeout Timeout for receiving a new connection in milliseconds, 0 for
+ * non-blocking call, -1 for infinite waiting.
+ * @param[in] ctx Context for the session to use.
+ * @param[out] session New session, NULL on timeout.
+ * @param[out] fd File descriptor to wait for if the session is not established yet, -1 otherwise.
+ * @param[out] events poll(2) events to wait for on @p fd if the session is not established yet, 0 otherwise.
+ * @return NC_MSG_HELLO on success, NC_MSG_BAD_HELLO on client \<hello\> message parsing fail,
+ *         NC_MSG_WOULDBLOCK on timeout (@p session NULL) or if the session is not established yet (@p session set),
+ *         NC_MSG_ERROR on other errors.
+ */
+NC_MSG_TYPE nc_accept_start(int timeout, const struct ly_ctx *ctx, struct nc_session **session, int *fd, short *events);
+
+/**
+ * @brief Progress the TLS handshake or SSH authentication and channel opening of a session returned by
+ * ::nc_accept_start().
+ *
+ * Call it once the file descriptor is ready for the events returned by the previous call. If the handshake
+ * or the authentication does not finish within its timeout, the session is freed. The session must not be
+ * used in any other way until this function returns NC_MSG_HELLO.
+ *
+ * @param[in,out] session Session not established yet, freed and set to NULL on error.
+ * @param[in,out] fd File descriptor to wait for if the session is still not established, it may change.
+ * @param[out] events poll(2) events to wait for on @p fd if the session is still not established.
+ * @return NC_MSG_HELLO on success, NC_MSG_BAD_HELLO on client \<hello\> message parsing fail,
+ *         NC_MSG_WOULDBLOCK if the session is still not established, NC_MSG_ERROR on other errors.
+ */
+NC_MSG_TYPE nc_accept_continue(struct nc_session **session, int *fd, short *events);
+
 /**
  * @brief Accept a new NETCONF session on an SSH session of a running NETCONF @p orig_session.
  *        Call this function only when nc_ps_poll() returns #NC_PSPOLL_SSH_CHANNEL on @p orig_session.
@@ -550,6 +590,23 @@ int nc_server_ssh_kbdint_get_nanswers(const struct nc_session *session, ssh_sess
  */
 int nc_server_ssh_set_pam_conf_filename(const char *filename);
 
+/**
+ * @brief Set the number of threads verifying SSH password and Keyboard Interactive authentication.
+ *
+ * Hashing passwords and running PAM modules can take a long time, so if set, these verifications
+ * are passed to a dedicated pool of authentication worker threads. Sessions accepted by ::nc_accept_start()
+ * are returned while the verification is in progress, so the accepting thread can accept and authenticate
+ * other sessions meanwhile. ::nc_accept() still waits for the result. In both cases the authentication
+ * timeout is checked and a session that times out is freed by the worker once the verification finishes.
+ * Note that a custom Keyboard Interactive callback set by ::nc_server_ssh_set_interactive_auth_clb() is always
+ * called directly.
+ *
+ * @param[in] thread_count Number of authentication worker threads, 0 (default) to perform
+ * all the verifications synchronously.
+ * @return 0 on success, 1 on error.
+ */
+int nc_server_ssh_set_auth_thread_count(uint16_t thread_count);
+
 /** @} Server SSH */
 
 /**
@@ -578,6 +635,29 @@ const void *nc_session_get_client_cert(const struct nc_session *session);
  */
 void nc_server_tls_set_verify_clb(int (*verify_clb)(const struct nc_session *session));
 
+/**
+ * @brief Enable or disable kernel TLS (kTLS) offload of new TLS sessions, disabled by default.
+ *
+ * Once the handshake finishes, record encryption and decryption is handed over to the kernel if supported
+ * by the TLS library (only OpenSSL built with kTLS), the kernel (Linux tls module), and the negotiated
+ * cipher suite. Otherwise, the session silently falls back to user-space encryption. Messages on sessions
+ * with offloaded encryption are written directly to the socket. See ::nc_session_tls_get_ktls().
+ *
+ * @param[in] enabled Non-zero to enable the offload, 0 to disable it.
+ */
+void nc_server_tls_set_ktls(int enabled);
+
+/**
+ * @brief Enable or disable dynamic TLS record sizing of new TLS sessions, disabled by default.
+ *
+ * Messages are always sent in records as large as possible (16 kB). With dynamic record sizing, sessions
+ * that were idle for a while send small records fitting a single TCP segment first, so that the peer can
+ * start processing a message before the whole record arrives, and switch to large records for bulk data.
+ *
+ * @param[in] enabled Non-zero to enable dynamic record sizing, 0 to disable it.
+ */
+void nc_server_tls_set_dynamic_record_sizing(int enabled);
+
 /** @} Server TLS */
 
 #endif /* NC_ENABLED_SSH_TLS */
@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libssh/libssh.h>
 #include <libssh/server.h>
 #include <libyang/libyang.h>
@@ -614,6 +615,23 @@ error:
 
 #endif
 
+/**
+ * @brief Get poll(2) events to wait for on the socket of an SSH session.
+ *
+ * @param[in] session NETCONF session with an SSH session.
+ * @return Events, POLLOUT is included if libssh has data pending to be written.
+ */
+static short
+nc_server_ssh_poll_events(const struct nc_session *session)
+{
+    short events = POLLIN;
+
+    if (ssh_get_poll_flags(session->ti.libssh.session) & SSH_WRITE_PENDING) {
+        events |= POLLOUT;
+    }
+    return events;
+}
+
 /**
  * @brief Compare stored hashed password with a cleartext received password.
  *
@@ -665,10 +683,45 @@ nc_server_ssh_compare_password(const char *stored_pw, const char *received_pw)
     return ret;
 }
 
+int
+nc_server_ssh_wait_fd(const struct nc_session *session, const struct timespec *ts_timeout)
+{
+    struct pollfd pfd;
+    int r, timeout_ms = -1;
+
+    if (ssh_get_status(session->ti.libssh.session) & (SSH_CLOSED | SSH_CLOSED_ERROR)) {
+        /* libssh already processed EOF or an error */
+        return -1;
+    }
+
+    if (ts_timeout) {
+        timeout_ms = nc_timeouttime_cur_diff(ts_timeout);
+        if (timeout_ms < 1) {
+            return 0;
+        }
+    }
+
+    pfd.fd = ssh_get_fd(session->ti.libssh.session);
+    pfd.events = nc_server_ssh_poll_events(session);
+    pfd.revents = 0;
+
+    r = nc_poll(&pfd, 1, timeout_ms);
+    if (r == -1) {
+        return -1;
+    } else if (!r) {
+        return 0;
+    } else if ((pfd.revents & (POLLERR | POLLNVAL)) || ((pfd.revents & POLLHUP) && !(pfd.revents & POLLIN))) {
+        return -1;
+    }
+
+    /* any received data (including EOF) are processed by libssh */
+    return 1;
+}
+
 API int
 nc_server_ssh_kbdint_get_nanswers(const struct nc_session *session, ssh_session libssh_session)
 {
-    int ret = 0;
+    int ret = 0, r;
     struct timespec ts_timeout = {0};
     ssh_message reply = NULL;
     uint16_t auth_timeout = *((uint16_t *)session->data);
@@ -680,20 +733,16 @@ nc_server_ssh_kbdint_get_nanswers(const struct nc_session *session, ssh_session
     }
 
     /* wait for answers from the client */
-    do {
-        if (!nc_session_is_connected(session)) {
+    while (!(reply = ssh_message_get(libssh_session))) {
+        r = nc_server_ssh_wait_fd(session, auth_timeout ? &ts_timeout : NULL);
+        if (r == -1) {
             ERR(NULL, "SSH communication socket unexpectedly closed.");
             ret = -1;
             goto cleanup;
-        }
-
-        reply = ssh_message_get(libssh_session);
-        if (reply) {
+        } else if (!r) {
             break;
         }
-
-        usleep(NC_TIMEOUT_STEP);
-    } while (auth_timeout && (nc_timeouttime_cur_diff(&ts_timeout) >= 1));
+    }
     if (!reply) {
         ERR(NULL, "Authentication timeout.");
         ret = -1;
@@ -1046,11 +1095,363 @@ nc_server_ssh_set_authkey_path_format(const char *path)
         ret = 1;
     }
 
+    /* the cached keys may have been read from different files */
+    nc_server_ssh_authkey_cache_flush();
+
     /* CONFIG UNLOCK */
     pthread_rwlock_unlock(&server_opts.config_lock);
     return ret;
 }
 
+/**
+ * @brief Authentication worker thread, verifies queued authentication jobs.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+nc_server_ssh_auth_worker_thread(void *arg)
+{
+    struct nc_auth_job *job;
+    int result;
+
+    (void)arg;
+
+    /* AUTH WORKERS LOCK */
+    pthread_mutex_lock(&server_opts.auth_workers.lock);
+
+    while (1) {
+        while (!server_opts.auth_workers.stop && !server_opts.auth_workers.queue) {
+            pthread_cond_wait(&server_opts.auth_workers.cond, &server_opts.auth_workers.lock);
+        }
+        if (!server_opts.auth_workers.queue) {
+            /* stopping and no jobs left */
+            break;
+        }
+
+        /* dequeue a job */
+        job = server_opts.auth_workers.queue;
+        server_opts.auth_workers.queue = job->next;
+        if (!server_opts.auth_workers.queue) {
+            server_opts.auth_workers.queue_last = NULL;
+        }
+        job->next = NULL;
+
+        /* AUTH WORKERS UNLOCK */
+        pthread_mutex_unlock(&server_opts.auth_workers.lock);
+
+        /* the job must not be accessed after the completion callback */
+        result = job->verify(job);
+        job->done_clb(job, result);
+
+        /* AUTH WORKERS LOCK */
+        pthread_mutex_lock(&server_opts.auth_workers.lock);
+    }
+
+    /* AUTH WORKERS UNLOCK */
+    pthread_mutex_unlock(&server_opts.auth_workers.lock);
+    return NULL;
+}
+
+void
+nc_server_ssh_auth_workers_stop(void)
+{
+    uint16_t i, thread_count;
+    pthread_t *tids;
+
+    /* AUTH WORKERS LOCK */
+    pthread_mutex_lock(&server_opts.auth_workers.lock);
+
+    tids = server_opts.auth_workers.tids;
+    thread_count = server_opts.auth_workers.thread_count;
+    server_opts.auth_workers.tids = NULL;
+    server_opts.auth_workers.thread_count = 0;
+    server_opts.auth_workers.stop = 1;
+    pthread_cond_broadcast(&server_opts.auth_workers.cond);
+
+    /* AUTH WORKERS UNLOCK */
+    pthread_mutex_unlock(&server_opts.auth_workers.lock);
+
+    /* the queued jobs are still finished */
+    for (i = 0; i < thread_count; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    /* AUTH WORKERS LOCK */
+    pthread_mutex_lock(&server_opts.auth_workers.lock);
+    server_opts.auth_workers.stop = 0;
+    /* AUTH WORKERS UNLOCK */
+    pthread_mutex_unlock(&server_opts.auth_workers.lock);
+}
+
+API int
+nc_server_ssh_set_auth_thread_count(uint16_t thread_count)
+{
+    int r, ret = 0;
+    uint16_t i;
+
+    /* stop the current workers, if any */
+    nc_server_ssh_auth_workers_stop();
+    if (!thread_count) {
+        return 0;
+    }
+
+    /* AUTH WORKERS LOCK */
+    pthread_mutex_lock(&server_opts.auth_workers.lock);
+
+    server_opts.auth_workers.tids = calloc(thread_count, sizeof *server_opts.auth_workers.tids);
+    NC_CHECK_ERRMEM_GOTO(!server_opts.auth_workers.tids, ret = 1, cleanup);
+
+    for (i = 0; i < thread_count; i++) {
+        r = pthread_create(&server_opts.auth_workers.tids[i], NULL, nc_server_ssh_auth_worker_thread, NULL);
+        if (r) {
+            ERR(NULL, "Creating an authentication worker thread failed (%s).", strerror(r));
+            ret = 1;
+            break;
+        }
+        ++server_opts.auth_workers.thread_count;
+    }
+
+cleanup:
+    /* AUTH WORKERS UNLOCK */
+    pthread_mutex_unlock(&server_opts.auth_workers.lock);
+
+    if (ret) {
+        nc_server_ssh_auth_workers_stop();
+    }
+    return ret;
+}
+
+/**
+ * @brief Completion callback of an authentication job, stores the result in the authentication state.
+ *
+ * @param[in] job Finished job.
+ * @param[in] result Result of the verification.
+ */
+static void
+nc_server_ssh_auth_job_done(struct nc_auth_job *job, int result)
+{
+    struct nc_auth_state *auth_state = job->auth_state;
+    struct nc_session *session = job->session;
+    int abandoned;
+
+    /* JOB LOCK */
+    pthread_mutex_lock(&auth_state->job_lock);
+
+    auth_state->job_result = result;
+    auth_state->job_pending = 0;
+    abandoned = auth_state->abandoned;
+    if (!abandoned) {
+        pthread_cond_signal(&auth_state->job_cond);
+        if ((auth_state->notify_fd[1] > -1) && (write(auth_state->notify_fd[1], "", 1) == -1)) {
+            WRN(session, "Failed to notify about a finished authentication job (%s).", strerror(errno));
+        }
+    }
+
+    /* JOB UNLOCK */
+    pthread_mutex_unlock(&auth_state->job_lock);
+
+    if (abandoned) {
+        /* nobody waits for the result, free the session */
+        nc_session_free(session, NULL);
+    }
+}
+
+/**
+ * @brief Pass an authentication verification to the authentication workers.
+ *
+ * @param[in] auth_state Authentication state to store the job in.
+ * @param[in] session Session being authenticated.
+ * @param[in] msg Authentication request, replied to once the job finishes.
+ * @param[in] method Authentication method.
+ * @param[in] verify Verification to perform.
+ * @param[in] stored_pw Optional configured password to compare to, is duplicated.
+ * @return 0 if the job was queued, 1 if the workers are not running or on error.
+ */
+static int
+nc_server_ssh_auth_job_submit(struct nc_auth_state *auth_state, struct nc_session *session, ssh_message msg,
+        int method, int (*verify)(struct nc_auth_job *job), const char *stored_pw)
+{
+    int ret = 1;
+    struct nc_auth_job *job = &auth_state->job;
+
+    /* AUTH WORKERS LOCK */
+    pthread_mutex_lock(&server_opts.auth_workers.lock);
+
+    if (!server_opts.auth_workers.thread_count) {
+        goto cleanup;
+    }
+
+    /* prepare the job */
+    memset(job, 0, sizeof *job);
+    if (stored_pw) {
+        job->stored_pw = strdup(stored_pw);
+        NC_CHECK_ERRMEM_GOTO(!job->stored_pw, , cleanup);
+    }
+    if (method == SSH_AUTH_METHOD_PASSWORD) {
+        job->received_pw = strdup(ssh_message_auth_password(msg));
+        NC_CHECK_ERRMEM_GOTO(!job->received_pw, free(job->stored_pw); job->stored_pw = NULL, cleanup);
+    }
+    job->session = session;
+    job->msg = msg;
+    job->method = method;
+    job->verify = verify;
+    job->done_clb = nc_server_ssh_auth_job_done;
+    job->auth_state = auth_state;
+
+    /* JOB LOCK */
+    pthread_mutex_lock(&auth_state->job_lock);
+    auth_state->job_pending = 1;
+    /* JOB UNLOCK */
+    pthread_mutex_unlock(&auth_state->job_lock);
+
+    /* enqueue it */
+    if (server_opts.auth_workers.queue_last) {
+        server_opts.auth_workers.queue_last->next = job;
+    } else {
+        server_opts.auth_workers.queue = job;
+    }
+    server_opts.auth_workers.queue_last = job;
+    pthread_cond_signal(&server_opts.auth_workers.cond);
+    ret = 0;
+
+cleanup:
+    /* AUTH WORKERS UNLOCK */
+    pthread_mutex_unlock(&server_opts.auth_workers.lock);
+    return ret;
+}
+
+/**
+ * @brief Wait for the authentication job of a session to finish.
+ *
+ * @param[in] auth_state Authentication state with a submitted job.
+ * @param[in] timeout_ms Timeout in msec, -1 for infinite.
+ * @return 1 if the job finished, 0 on timeout.
+ */
+static int
+nc_server_ssh_auth_job_wait(struct nc_auth_state *auth_state, int timeout_ms)
+{
+    struct timespec ts_timeout;
+    int ret;
+
+    if (timeout_ms > -1) {
+        nc_timeouttime_get(&ts_timeout, timeout_ms);
+    }
+
+    /* JOB LOCK */
+    pthread_mutex_lock(&auth_state->job_lock);
+
+    while (auth_state->job_pending) {
+        if (timeout_ms > -1) {
+            if (pthread_cond_clockwait(&auth_state->job_cond, &auth_state->job_lock, COMPAT_CLOCK_ID, &ts_timeout)) {
+                break;
+            }
+        } else {
+            pthread_cond_wait(&auth_state->job_cond, &auth_state->job_lock);
+        }
+    }
+    ret = !auth_state->job_pending;
+
+    /* JOB UNLOCK */
+    pthread_mutex_unlock(&auth_state->job_lock);
+    return ret;
+}
+
+/**
+ * @brief Free the data of a finished authentication job.
+ *
+ * @param[in] job Job to clear, the message is freed as well.
+ */
+static void
+nc_server_ssh_auth_job_clear(struct nc_auth_job *job)
+{
+    ssh_message_free(job->msg);
+    free(job->stored_pw);
+    free(job->received_pw);
+    memset(job, 0, sizeof *job);
+}
+
+/**
+ * @brief Create the authentication state of a session.
+ *
+ * @param[in] session Session to authenticate.
+ * @param[in] opts Endpoint SSH options.
+ * @param[in] notify Whether the finished jobs should be notified about using a pipe.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_ssh_auth_state_new(struct nc_session *session, struct nc_server_ssh_opts *opts, int notify)
+{
+    struct nc_auth_state *auth_state;
+
+    auth_state = calloc(1, sizeof *auth_state);
+    NC_CHECK_ERRMEM_RET(!auth_state, -1);
+
+    auth_state->notify_fd[0] = -1;
+    auth_state->notify_fd[1] = -1;
+    if (notify && (pipe(auth_state->notify_fd) || (fcntl(auth_state->notify_fd[0], F_SETFL, O_NONBLOCK) == -1))) {
+        ERR(session, "Failed to create an authentication notification pipe (%s).", strerror(errno));
+        if (auth_state->notify_fd[0] > -1) {
+            close(auth_state->notify_fd[0]);
+            close(auth_state->notify_fd[1]);
+        }
+        free(auth_state);
+        return -1;
+    }
+
+    auth_state->auth_timeout = opts->auth_timeout;
+    if (auth_state->auth_timeout) {
+        nc_timeouttime_get(&auth_state->ts_timeout, auth_state->auth_timeout * 1000);
+    }
+    pthread_mutex_init(&auth_state->job_lock, NULL);
+    pthread_cond_init(&auth_state->job_cond, NULL);
+
+    /* store auth_timeout in session so we can retrieve it in kb interactive API */
+    session->data = &auth_state->auth_timeout;
+    session->ti.libssh.auth = auth_state;
+    return 0;
+}
+
+int
+nc_server_ssh_auth_state_release(struct nc_session *session)
+{
+    struct nc_auth_state *auth_state = session->ti.libssh.auth;
+
+    /* JOB LOCK */
+    pthread_mutex_lock(&auth_state->job_lock);
+
+    if (auth_state->job_pending) {
+        /* a worker still uses the session, let it free the session once finished */
+        auth_state->abandoned = 1;
+
+        /* JOB UNLOCK */
+        pthread_mutex_unlock(&auth_state->job_lock);
+        return 1;
+    }
+
+    /* JOB UNLOCK */
+    pthread_mutex_unlock(&auth_state->job_lock);
+
+    if (auth_state->job.msg) {
+        nc_server_ssh_auth_job_clear(&auth_state->job);
+    }
+    if (auth_state->notify_fd[0] > -1) {
+        close(auth_state->notify_fd[0]);
+        close(auth_state->notify_fd[1]);
+    }
+    if (session->data == &auth_state->auth_timeout) {
+        session->data = NULL;
+    }
+    session->ti.libssh.auth = NULL;
+
+    free(auth_state->endpt_name);
+    pthread_mutex_destroy(&auth_state->job_lock);
+    pthread_cond_destroy(&auth_state->job_cond);
+    free(auth_state);
+    return 0;
+}
+
 /**
  * @brief Get the public key type from binary data.
  *
@@ -1170,6 +1571,304 @@ nc_server_ssh_auth_pubkey_compare_key(ssh_key key, struct nc_public_key *pubkeys
     return ret;
 }
 
+/**
+ * @brief Free the cached data of an authorized keys cache entry.
+ *
+ * @param[in] entry Entry to free.
+ */
+static void
+nc_server_ssh_authkey_cache_entry_free(struct nc_authkey_cache_entry *entry)
+{
+    uint16_t i;
+
+    if (!entry) {
+        return;
+    }
+
+    free(entry->username);
+    free(entry->path);
+    for (i = 0; i < entry->key_count; i++) {
+        ssh_key_free(entry->keys[i]);
+    }
+    free(entry->keys);
+    memset(entry, 0, sizeof *entry);
+}
+
+void
+nc_server_ssh_authkey_cache_flush(void)
+{
+    uint16_t i;
+
+    /* AUTHKEY CACHE LOCK */
+    pthread_mutex_lock(&server_opts.authkey_cache.lock);
+
+    for (i = 0; i < server_opts.authkey_cache.entry_count; i++) {
+        nc_server_ssh_authkey_cache_entry_free(&server_opts.authkey_cache.entries[i]);
+    }
+    free(server_opts.authkey_cache.entries);
+    server_opts.authkey_cache.entries = NULL;
+    server_opts.authkey_cache.entry_count = 0;
+    server_opts.authkey_cache.use_counter = 0;
+
+    /* AUTHKEY CACHE UNLOCK */
+    pthread_mutex_unlock(&server_opts.authkey_cache.lock);
+}
+
+/**
+ * @brief Check whether the authorized keys file of a cache entry changed since it was read.
+ *
+ * @param[in] entry Cache entry to check.
+ * @param[in] st Current status of the file.
+ * @return Whether the file changed or not.
+ */
+static int
+nc_server_ssh_authkey_cache_entry_is_stale(const struct nc_authkey_cache_entry *entry, const struct stat *st)
+{
+    return (entry->dev != st->st_dev) || (entry->ino != st->st_ino) || (entry->size != st->st_size) ||
+           (entry->mtime.tv_sec != st->st_mtim.tv_sec) || (entry->mtime.tv_nsec != st->st_mtim.tv_nsec);
+}
+
+/**
+ * @brief (Re)load the public keys of a cache entry from its authorized keys file.
+ *
+ * @param[in] entry Cache entry with the path set, its keys are replaced.
+ * @param[in] st Status of the file obtained before reading it.
+ * @return 0 on success, 1 on error.
+ */
+static int
+nc_server_ssh_authkey_cache_entry_load(struct nc_authkey_cache_entry *entry, const struct stat *st)
+{
+    int ret = 0;
+    struct nc_public_key *pubkeys = NULL;
+    uint16_t pubkey_count = 0, i;
+
+    /* free any previous keys */
+    for (i = 0; i < entry->key_count; i++) {
+        ssh_key_free(entry->keys[i]);
+    }
+    free(entry->keys);
+    entry->keys = NULL;
+    entry->key_count = 0;
+
+    /* read the file */
+    if (nc_server_ssh_read_authorized_keys_file(entry->path, &pubkeys, &pubkey_count)) {
+        ERR(NULL, "Reading system keys failed.");
+        ret = 1;
+        goto cleanup;
+    }
+
+    /* import all the keys once so that they can be directly compared */
+    if (pubkey_count) {
+        entry->keys = calloc(pubkey_count, sizeof *entry->keys);
+        NC_CHECK_ERRMEM_GOTO(!entry->keys, ret = 1, cleanup);
+    }
+    for (i = 0; i < pubkey_count; i++) {
+        if (nc_server_ssh_create_ssh_pubkey(pubkeys[i].data, &entry->keys[entry->key_count])) {
+            /* skip */
+            ssh_key_free(entry->keys[entry->key_count]);
+            entry->keys[entry->key_count] = NULL;
+            continue;
+        }
+        ++entry->key_count;
+    }
+
+    /* remember the file it was read from */
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+
+cleanup:
+    for (i = 0; i < pubkey_count; i++) {
+        free(pubkeys[i].name);
+        free(pubkeys[i].data);
+    }
+    free(pubkeys);
+    return ret;
+}
+
+/**
+ * @brief Get the authorized keys cache entry of a user, read or re-read its keys if needed.
+ *
+ * AUTHKEY CACHE LOCK must be held.
+ *
+ * @param[in] username Username.
+ * @return Valid cache entry, NULL on error.
+ */
+static struct nc_authkey_cache_entry *
+nc_server_ssh_authkey_cache_get(const char *username)
+{
+    struct nc_authkey_cache_entry *entry = NULL, *mem;
+    struct stat st;
+    uint16_t i, lru = 0;
+
+    /* find the user */
+    for (i = 0; i < server_opts.authkey_cache.entry_count; i++) {
+        if (!strcmp(server_opts.authkey_cache.entries[i].username, username)) {
+            entry = &server_opts.authkey_cache.entries[i];
+            break;
+        }
+        if (server_opts.authkey_cache.entries[i].last_used < server_opts.authkey_cache.entries[lru].last_used) {
+            lru = i;
+        }
+    }
+
+    if (entry) {
+        /* check the file did not change */
+        if (stat(entry->path, &st)) {
+            ERR(NULL, "Unable to stat \"%s\" (%s).", entry->path, strerror(errno));
+            goto error;
+        }
+        if (nc_server_ssh_authkey_cache_entry_is_stale(entry, &st)) {
+            VRB(NULL, "Authorized keys file \"%s\" changed, reading it again.", entry->path);
+            if (nc_server_ssh_authkey_cache_entry_load(entry, &st)) {
+                goto error;
+            }
+        }
+    } else {
+        if (server_opts.authkey_cache.entry_count < NC_AUTHKEY_CACHE_SIZE) {
+            /* add a new entry */
+            mem = nc_realloc(server_opts.authkey_cache.entries,
+                    (server_opts.authkey_cache.entry_count + 1) * sizeof *server_opts.authkey_cache.entries);
+            NC_CHECK_ERRMEM_RET(!mem, NULL);
+            server_opts.authkey_cache.entries = mem;
+            entry = &server_opts.authkey_cache.entries[server_opts.authkey_cache.entry_count];
+            memset(entry, 0, sizeof *entry);
+            ++server_opts.authkey_cache.entry_count;
+        } else {
+            /* cache full, reuse the least recently used entry */
+            entry = &server_opts.authkey_cache.entries[lru];
+            nc_server_ssh_authkey_cache_entry_free(entry);
+        }
+
+        entry->username = strdup(username);
+        NC_CHECK_ERRMEM_GOTO(!entry->username, , error);
+
+        /* convert the path format to get the actual path */
+        if (nc_server_ssh_get_system_keys_path(username, &entry->path)) {
+            ERR(NULL, "Getting system keys path failed.");
+            goto error;
+        }
+
+        if (stat(entry->path, &st)) {
+            ERR(NULL, "Unable to stat \"%s\" (%s).", entry->path, strerror(errno));
+            goto error;
+        }
+        if (nc_server_ssh_authkey_cache_entry_load(entry, &st)) {
+            goto error;
+        }
+    }
+
+    entry->last_used = ++server_opts.authkey_cache.use_counter;
+    return entry;
+
+error:
+    if (entry) {
+        /* remove the entry, keep the array compact */
+        nc_server_ssh_authkey_cache_entry_free(entry);
+        i = entry - server_opts.authkey_cache.entries;
+        --server_opts.authkey_cache.entry_count;
+        if (i < server_opts.authkey_cache.entry_count) {
+            memcpy(entry, &server_opts.authkey_cache.entries[server_opts.authkey_cache.entry_count], sizeof *entry);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Compare SSH key with the user's cached system authorized keys.
+ *
+ * @param[in] username Username.
+ * @param[in] key Presented SSH key to compare.
+ * @return 0 if a matching key was found, non-zero otherwise.
+ */
+static int
+nc_server_ssh_auth_pubkey_compare_system_key(const char *username, ssh_key key)
+{
+    int ret = 1;
+    uint16_t i;
+    struct nc_authkey_cache_entry *entry;
+
+    /* AUTHKEY CACHE LOCK */
+    pthread_mutex_lock(&server_opts.authkey_cache.lock);
+
+    entry = nc_server_ssh_authkey_cache_get(username);
+    if (!entry) {
+        goto cleanup;
+    }
+
+    for (i = 0; i < entry->key_count; i++) {
+        if (!ssh_key_cmp(key, entry->keys[i], SSH_KEY_CMP_PUBLIC)) {
+            /* found a match */
+            ret = 0;
+            break;
+        }
+    }
+
+cleanup:
+    /* AUTHKEY CACHE UNLOCK */
+    pthread_mutex_unlock(&server_opts.authkey_cache.lock);
+    return ret;
+}
+
+/**
+ * @brief Authentication job verifying a password.
+ *
+ * @param[in] job Authentication job.
+ * @return 0 if the password matches, 1 otherwise.
+ */
+static int
+nc_server_ssh_auth_job_password(struct nc_auth_job *job)
+{
+    int rc;
+    char *password = job->stored_pw;
+
+    if (!password) {
+#ifdef HAVE_SHADOW
+        /* obtain pw from system */
+        password = nc_server_ssh_get_pwd_hash(job->session->username);
+        if (!password) {
+            return 1;
+        }
+#else
+        ERR(job->session, "Obtaining password from system not supported.");
+        return 1;
+#endif
+    }
+
+    /* compare the passwords */
+    rc = nc_server_ssh_compare_password(password, job->received_pw);
+
+    if (password != job->stored_pw) {
+        free(password);
+    }
+    return rc ? 1 : 0;
+}
+
+#if defined (HAVE_LIBPAM) || defined (HAVE_SHADOW)
+
+/**
+ * @brief Authentication job performing Keyboard-interactive authentication using PAM or the system.
+ *
+ * @param[in] job Authentication job.
+ * @return 0 if the authentication was successful, 1 otherwise.
+ */
+static int
+nc_server_ssh_auth_job_kbdint(struct nc_auth_job *job)
+{
+    int rc;
+
+#ifdef HAVE_LIBPAM
+    rc = nc_server_ssh_auth_kbdint_pam(job->session, job->session->username, job->msg);
+#else
+    rc = nc_server_ssh_auth_kbdint_system(job->session, job->session->username, job->msg);
+#endif
+
+    return rc ? 1 : 0;
+}
+
+#endif
+
 /**
  * @brief Handle authentication request for the None method.
  *
@@ -1200,11 +1899,13 @@ nc_server_ssh_auth_none(int local_users_supported, struct nc_auth_client *auth_c
  * @param[in] local_users_supported Whether the server supports local users.
  * @param[in] auth_client Configured client's authentication data.
  * @param[in] msg libssh message.
- * @return 0 if the authentication was successful, 1 if not (@p msg not yet replied to).
+ * @param[in] auth_state Authentication state to store a job in.
+ * @return 0 if the authentication was successful, 1 if not (@p msg not yet replied to),
+ * 2 if the verification was passed to an authentication worker (@p msg not yet replied to).
  */
 static int
 nc_server_ssh_auth_password(struct nc_session *session, int local_users_supported,
-        struct nc_auth_client *auth_client, ssh_message msg)
+        struct nc_auth_client *auth_client, ssh_message msg, struct nc_auth_state *auth_state)
 {
     int rc;
     char *password = NULL;
@@ -1218,7 +1919,15 @@ nc_server_ssh_auth_password(struct nc_session *session, int local_users_supporte
             VRB(session, "User \"%s\" does not have password method configured, but a request was received.", session->username);
             return 1;
         }
-    } else {
+    }
+
+    /* hashing the password may take long, let a worker do it */
+    if (!nc_server_ssh_auth_job_submit(auth_state, session, msg, SSH_AUTH_METHOD_PASSWORD,
+            nc_server_ssh_auth_job_password, password)) {
+        return 2;
+    }
+
+    if (!local_users_supported) {
 #ifdef HAVE_SHADOW
         /* obtain pw from system, this one needs to be free'd */
         password = nc_server_ssh_get_pwd_hash(session->username);
@@ -1254,37 +1963,49 @@ static int
 nc_server_ssh_auth_pubkey(struct nc_session *session, int local_users_supported,
         struct nc_auth_client *auth_client, ssh_message msg)
 {
-    int signature_state, ret = 0;
+    int signature_state, ret = 0, system_keys;
     struct nc_public_key *pubkeys = NULL;
     uint16_t pubkey_count = 0, i;
 
     assert(!local_users_supported || auth_client);
 
-    /* get the public keys */
-    if (!local_users_supported || (auth_client->store == NC_STORE_SYSTEM)) {
-        /* system user or the user has 'use system keys' configured, these need to be free'd */
-        ret = nc_server_ssh_get_system_keys(session->username, &pubkeys, &pubkey_count);
-        if (ret) {
-            goto cleanup;
-        }
-    } else if (auth_client->store == NC_STORE_LOCAL) {
-        pubkeys = auth_client->pubkeys;
-        pubkey_count = auth_client->pubkey_count;
-    } else if (auth_client->store == NC_STORE_TRUSTSTORE) {
-        ret = nc_server_ssh_ts_ref_get_keys(auth_client->ts_ref, &pubkeys, &pubkey_count);
-        if (ret) {
+    /* system user or the user has 'use system keys' configured */
+    system_keys = !local_users_supported || (auth_client->store == NC_STORE_SYSTEM);
+
+    if (system_keys && NC_AUTHKEY_CACHE_SIZE) {
+        /* compare the received pubkey with the cached authorized ones */
+        if (nc_server_ssh_auth_pubkey_compare_system_key(session->username, ssh_message_auth_pubkey(msg))) {
+            VRB(session, "User \"%s\" tried to use an unknown (unauthorized) public key.", session->username);
+            ret = 1;
             goto cleanup;
         }
     } else {
-        ERRINT;
-        return 1;
-    }
+        /* get the public keys */
+        if (system_keys) {
+            /* these need to be free'd */
+            ret = nc_server_ssh_get_system_keys(session->username, &pubkeys, &pubkey_count);
+            if (ret) {
+                goto cleanup;
+            }
+        } else if (auth_client->store == NC_STORE_LOCAL) {
+            pubkeys = auth_client->pubkeys;
+            pubkey_count = auth_client->pubkey_count;
+        } else if (auth_client->store == NC_STORE_TRUSTSTORE) {
+            ret = nc_server_ssh_ts_ref_get_keys(auth_client->ts_ref, &pubkeys, &pubkey_count);
+            if (ret) {
+                goto cleanup;
+            }
+        } else {
+            ERRINT;
+            return 1;
+        }
 
-    /* compare the received pubkey with the authorized ones */
-    if (nc_server_ssh_auth_pubkey_compare_key(ssh_message_auth_pubkey(msg), pubkeys, pubkey_count)) {
-        VRB(session, "User \"%s\" tried to use an unknown (unauthorized) public key.", session->username);
-        ret = 1;
-        goto cleanup;
+        /* compare the received pubkey with the authorized ones */
+        if (nc_server_ssh_auth_pubkey_compare_key(ssh_message_auth_pubkey(msg), pubkeys, pubkey_count)) {
+            VRB(session, "User \"%s\" tried to use an unknown (unauthorized) public key.", session->username);
+            ret = 1;
+            goto cleanup;
+        }
     }
 
     signature_state = ssh_message_auth_publickey_state(msg);
@@ -1295,7 +2016,7 @@ nc_server_ssh_auth_pubkey(struct nc_session *session, int local_users_supported,
     }
 
 cleanup:
-    if (!local_users_supported || (auth_client->store == NC_STORE_SYSTEM)) {
+    if (system_keys) {
         for (i = 0; i < pubkey_count; i++) {
             free(pubkeys[i].name);
             free(pubkeys[i].data);
@@ -1313,10 +2034,13 @@ cleanup:
  * @param[in] local_users_supported Whether the server supports local users.
  * @param[in] auth_client Configured client's authentication data.
  * @param[in] msg libssh message.
- * @return 0 if the authentication was successful, 1 if not.
+ * @param[in] auth_state Authentication state to store a job in.
+ * @return 0 if the authentication was successful, 1 if not,
+ * 2 if the authentication was passed to an authentication worker (@p msg not yet replied to).
  */
 static int
-nc_server_ssh_auth_kbdint(struct nc_session *session, int local_users_supported, struct nc_auth_client *auth_client, ssh_message msg)
+nc_server_ssh_auth_kbdint(struct nc_session *session, int local_users_supported, struct nc_auth_client *auth_client,
+        ssh_message msg, struct nc_auth_state *auth_state)
 {
     int rc = 0;
 
@@ -1328,6 +2052,14 @@ nc_server_ssh_auth_kbdint(struct nc_session *session, int local_users_supported,
     } else if (server_opts.interactive_auth_clb) {
         rc = server_opts.interactive_auth_clb(session, session->ti.libssh.session, msg, server_opts.interactive_auth_data);
     } else {
+#if defined (HAVE_LIBPAM) || defined (HAVE_SHADOW)
+        /* PAM modules and password hashing may take long, let a worker do it */
+        if (!nc_server_ssh_auth_job_submit(auth_state, session, msg, SSH_AUTH_METHOD_INTERACTIVE,
+                nc_server_ssh_auth_job_kbdint, NULL)) {
+            return 2;
+        }
+#endif
+
 #ifdef HAVE_LIBPAM
         /* authenticate using PAM */
         rc = nc_server_ssh_auth_kbdint_pam(session, session->username, msg);
@@ -1439,6 +2171,45 @@ nc_server_ssh_channel_subsystem(struct nc_session *session, ssh_channel channel,
     return 0;
 }
 
+/**
+ * @brief Process the result of an authentication method and reply to the request.
+ *
+ * @param[in] session NETCONF session.
+ * @param[in] msg libssh message with the authentication request.
+ * @param[in] method Type of the authentication method.
+ * @param[in] ret Result of the method, 0 on success, 1 on failure (@p msg not yet replied to),
+ * -1 on failure (@p msg was replied to).
+ * @param[in,out] auth_state Authentication state.
+ */
+static void
+nc_server_ssh_auth_reply(struct nc_session *session, ssh_message msg, int method, int ret, struct nc_auth_state *auth_state)
+{
+    const char *username = session->username;
+
+    if (!ret) {
+        auth_state->success_methods |= method;
+        auth_state->success_count++;
+
+        if (auth_state->success_count < auth_state->method_count) {
+            /* success, but he needs to do another method */
+            VRB(session, "User \"%s\" partially authenticated, but still needs to authenticate via the rest of his configured methods.", username);
+            ssh_set_auth_methods(session->ti.libssh.session, auth_state->methods & ~auth_state->success_methods);
+            ssh_message_auth_reply_success(msg, 1);
+        } else {
+            /* authenticated */
+            ssh_message_auth_reply_success(msg, 0);
+            session->flags |= NC_SESSION_SSH_AUTHENTICATED;
+            VRB(session, "User \"%s\" authenticated.", username);
+        }
+    } else if (ret == 1) {
+        /* failed attempt, msg wasnt yet replied to */
+        ++session->opts.server.ssh_auth_attempts;
+        VRB(session, "Failed user \"%s\" authentication attempt (#%d).", session->username,
+                session->opts.server.ssh_auth_attempts);
+        ssh_message_reply_default(msg);
+    }
+}
+
 /**
  * @brief Handle NETCONF SSH authentication.
  *
@@ -1540,15 +2311,16 @@ nc_server_ssh_auth(struct nc_session *session, struct nc_server_ssh_opts *opts,
 
     /* try authenticating, if local users are supported, then the configured user must authenticate via all of his
      * configured auth methods, otherwise for system users just one is needed,
-     * 0 return indicates success, 1 fail (msg not yet replied to), -1 fail (msg was replied to) */
+     * 0 return indicates success, 1 fail (msg not yet replied to), -1 fail (msg was replied to),
+     * 2 verification passed to a worker (msg not yet replied to) */
     if (method == SSH_AUTH_METHOD_NONE) {
         ret = nc_server_ssh_auth_none(local_users_supported, auth_client, msg);
     } else if (method == SSH_AUTH_METHOD_PASSWORD) {
-        ret = nc_server_ssh_auth_password(session, local_users_supported, auth_client, msg);
+        ret = nc_server_ssh_auth_password(session, local_users_supported, auth_client, msg, auth_state);
     } else if (method == SSH_AUTH_METHOD_PUBLICKEY) {
         ret = nc_server_ssh_auth_pubkey(session, local_users_supported, auth_client, msg);
     } else if (method == SSH_AUTH_METHOD_INTERACTIVE) {
-        ret = nc_server_ssh_auth_kbdint(session, local_users_supported, auth_client, msg);
+        ret = nc_server_ssh_auth_kbdint(session, local_users_supported, auth_client, msg, auth_state);
     } else {
         ++session->opts.server.ssh_auth_attempts;
         VRB(session, "Authentication method \"%s\" not supported.", str_method);
@@ -1556,29 +2328,12 @@ nc_server_ssh_auth(struct nc_session *session, struct nc_server_ssh_opts *opts,
         return 0;
     }
 
-    if (!ret) {
-        auth_state->success_methods |= method;
-        auth_state->success_count++;
-
-        if (auth_state->success_count < auth_state->method_count) {
-            /* success, but he needs to do another method */
-            VRB(session, "User \"%s\" partially authenticated, but still needs to authenticate via the rest of his configured methods.", username);
-            ssh_set_auth_methods(session->ti.libssh.session, auth_state->methods & ~auth_state->success_methods);
-            ssh_message_auth_reply_success(msg, 1);
-        } else {
-            /* authenticated */
-            ssh_message_auth_reply_success(msg, 0);
-            session->flags |= NC_SESSION_SSH_AUTHENTICATED;
-            VRB(session, "User \"%s\" authenticated.", username);
-        }
-    } else if (ret == 1) {
-        /* failed attempt, msg wasnt yet replied to */
-        ++session->opts.server.ssh_auth_attempts;
-        VRB(session, "Failed user \"%s\" authentication attempt (#%d).", session->username,
-                session->opts.server.ssh_auth_attempts);
-        ssh_message_reply_default(msg);
+    if (ret == 2) {
+        /* the result will be processed once the job finishes */
+        return 0;
     }
 
+    nc_server_ssh_auth_reply(session, msg, method, ret, auth_state);
     return 0;
 }
 
@@ -1773,38 +2528,64 @@ nc_session_ssh_msg(struct nc_session *session, struct nc_server_ssh_opts *opts,
     return 1;
 }
 
-/* ret 1 on success, 0 on timeout, -1 on error */
+/**
+ * @brief Open the NETCONF channel of an authenticated SSH session.
+ *
+ * @param[in] session Authenticated session.
+ * @param[in] opts Endpoint SSH options.
+ * @param[in] timeout Timeout of opening the channel.
+ * @param[out] fd If set, opening the channel does not block and if not finished, the file descriptor to wait for.
+ * @param[out] events poll(2) events to wait for on @p fd.
+ * @return 1 on success, 0 on timeout, -1 on error, 2 if the channel is not opened yet (only if @p fd set).
+ */
 static int
-nc_accept_ssh_session_open_netconf_channel(struct nc_session *session, struct nc_server_ssh_opts *opts, int timeout)
+nc_accept_ssh_session_open_netconf_channel(struct nc_session *session, struct nc_server_ssh_opts *opts, int timeout,
+        int *fd, short *events)
 {
-    struct timespec ts_timeout;
+    struct nc_auth_state *auth_state = session->ti.libssh.auth;
     ssh_message msg;
+    int r;
 
-    DBG(session, "Waiting for \"netconf\" SSH subsystem request...");
-
-    if (timeout) {
-        nc_timeouttime_get(&ts_timeout, timeout * 1000);
-    }
-    while (1) {
-        if (!nc_session_is_connected(session)) {
-            ERR(session, "Communication SSH socket unexpectedly closed.");
-            return -1;
+    if (!auth_state->channel_wait) {
+        DBG(session, "Waiting for \"netconf\" SSH subsystem request...");
+        if (timeout) {
+            nc_timeouttime_get(&auth_state->ts_channel, timeout * 1000);
         }
+        auth_state->channel_wait = 1;
+    }
 
-        msg = ssh_message_get(session->ti.libssh.session);
-        if (msg) {
+    while (1) {
+        /* process all the received messages */
+        while ((msg = ssh_message_get(session->ti.libssh.session))) {
             if (nc_session_ssh_msg(session, opts, msg, NULL)) {
                 ssh_message_reply_default(msg);
             }
             ssh_message_free(msg);
-        }
 
-        if (session->ti.libssh.channel && session->flags & NC_SESSION_SSH_SUBSYS_NETCONF) {
-            return 1;
+            if (session->ti.libssh.channel && session->flags & NC_SESSION_SSH_SUBSYS_NETCONF) {
+                return 1;
+            }
         }
 
-        usleep(NC_TIMEOUT_STEP);
-        if (timeout && (nc_timeouttime_cur_diff(&ts_timeout) < 1)) {
+        if (fd) {
+            if (ssh_get_status(session->ti.libssh.session) & (SSH_CLOSED | SSH_CLOSED_ERROR)) {
+                ERR(session, "Communication SSH socket unexpectedly closed.");
+                return -1;
+            } else if (!timeout || (nc_timeouttime_cur_diff(&auth_state->ts_channel) > 0)) {
+                /* wait for more data */
+                *fd = ssh_get_fd(session->ti.libssh.session);
+                *events = nc_server_ssh_poll_events(session);
+                return 2;
+            }
+            r = 0;
+        } else {
+            /* wait for more data */
+            r = nc_server_ssh_wait_fd(session, timeout ? &auth_state->ts_channel : NULL);
+        }
+        if (r == -1) {
+            ERR(session, "Communication SSH socket unexpectedly closed.");
+            return -1;
+        } else if (!r) {
             /* timeout */
             ERR(session, "Failed to start \"netconf\" SSH subsystem for too long, disconnecting.");
             break;
@@ -1871,46 +2652,100 @@ nc_ssh_bind_add_hostkeys(ssh_bind sbind, struct nc_server_ssh_opts *opts, uint16
     return 0;
 }
 
+/**
+ * @brief Authenticate a new SSH session.
+ *
+ * @param[in] session Session with the SSH key exchange finished.
+ * @param[in] opts Endpoint SSH options.
+ * @param[out] fd If set, the authentication does not block and if not finished, the file descriptor to wait for.
+ * @param[out] events poll(2) events to wait for on @p fd.
+ * @return 1 on success, 0 on timeout, -1 on error, 2 if the authentication is not finished (only if @p fd set).
+ */
 static int
-nc_accept_ssh_session_auth(struct nc_session *session, struct nc_server_ssh_opts *opts)
+nc_accept_ssh_session_auth(struct nc_session *session, struct nc_server_ssh_opts *opts, int *fd, short *events)
 {
-    struct timespec ts_timeout;
     ssh_message msg;
-    struct nc_auth_state auth_state = {0};
+    struct nc_auth_state *auth_state;
+    int r;
+    int32_t wait_ms;
+    char byte;
 
-    DBG(session, "SSH authentication...");
-
-    /* authenticate */
-    if (opts->auth_timeout) {
-        nc_timeouttime_get(&ts_timeout, opts->auth_timeout * 1000);
+    if (session->flags & NC_SESSION_SSH_AUTHENTICATED) {
+        /* resumed while opening the channel */
+        return 1;
     }
-    while (1) {
-        if (!nc_session_is_connected(session)) {
-            ERR(session, "Communication SSH socket unexpectedly closed.");
+
+    if (!session->ti.libssh.auth) {
+        DBG(session, "SSH authentication...");
+        if (nc_server_ssh_auth_state_new(session, opts, fd ? 1 : 0)) {
             return -1;
         }
+    }
+    auth_state = session->ti.libssh.auth;
 
-        msg = ssh_message_get(session->ti.libssh.session);
-        if (msg) {
-            if (nc_session_ssh_msg(session, opts, msg, &auth_state)) {
+    /* authenticate */
+    while (1) {
+        if (auth_state->job.msg) {
+            /* a worker is verifying the last request, the SSH session must not be touched meanwhile */
+            if (fd) {
+                wait_ms = 0;
+            } else if (auth_state->auth_timeout) {
+                wait_ms = nc_timeouttime_cur_diff(&auth_state->ts_timeout);
+                if (wait_ms < 0) {
+                    wait_ms = 0;
+                }
+            } else {
+                wait_ms = -1;
+            }
+            if (nc_server_ssh_auth_job_wait(auth_state, wait_ms)) {
+                if (auth_state->notify_fd[0] > -1) {
+                    /* consume the notification */
+                    while (read(auth_state->notify_fd[0], &byte, 1) == 1) {}
+                }
+                nc_server_ssh_auth_reply(session, auth_state->job.msg, auth_state->job.method, auth_state->job_result,
+                        auth_state);
+                nc_server_ssh_auth_job_clear(&auth_state->job);
+            } else if (fd && (!auth_state->auth_timeout || (nc_timeouttime_cur_diff(&auth_state->ts_timeout) > 0))) {
+                /* wait for the job */
+                *fd = auth_state->notify_fd[0];
+                *events = POLLIN;
+                return 2;
+            }
+        } else if ((msg = ssh_message_get(session->ti.libssh.session))) {
+            /* process the next received message */
+            if (nc_session_ssh_msg(session, opts, msg, auth_state)) {
                 ssh_message_reply_default(msg);
             }
-            ssh_message_free(msg);
+            if (msg != auth_state->job.msg) {
+                /* not passed to a worker */
+                ssh_message_free(msg);
+            }
+        } else if (fd && (!auth_state->auth_timeout || (nc_timeouttime_cur_diff(&auth_state->ts_timeout) > 0))) {
+            /* wait for more data */
+            *fd = ssh_get_fd(session->ti.libssh.session);
+            *events = nc_server_ssh_poll_events(session);
+            return 2;
+        } else if (!fd) {
+            /* no message, wait for more data */
+            r = nc_server_ssh_wait_fd(session, auth_state->auth_timeout ? &auth_state->ts_timeout : NULL);
+            if (r == -1) {
+                ERR(session, "Communication SSH socket unexpectedly closed.");
+                return -1;
+            }
         }
 
         if (session->flags & NC_SESSION_SSH_AUTHENTICATED) {
             break;
         }
 
-        usleep(NC_TIMEOUT_STEP);
-        if (opts->auth_timeout && (nc_timeouttime_cur_diff(&ts_timeout) < 1)) {
+        if (auth_state->auth_timeout && (nc_timeouttime_cur_diff(&auth_state->ts_timeout) < 1)) {
             /* timeout */
             break;
         }
     }
 
     if (!(session->flags & NC_SESSION_SSH_AUTHENTICATED)) {
-        /* timeout */
+        /* timeout, a pending job is abandoned once the session is freed */
         if (session->username) {
             ERR(session, "User \"%s\" failed to authenticate for too long, disconnecting.", session->username);
         } else {
@@ -1919,11 +2754,32 @@ nc_accept_ssh_session_auth(struct nc_session *session, struct nc_server_ssh_opts
         return 0;
     }
 
+    /* authenticated, no job can be pending, the state is released once the channel is opened */
     return 1;
 }
 
 int
-nc_accept_ssh_session(struct nc_session *session, struct nc_server_ssh_opts *opts, int sock, int timeout)
+nc_accept_ssh_session_step(struct nc_session *session, struct nc_server_ssh_opts *opts, int timeout, int *fd,
+        short *events)
+{
+    int rc;
+
+    rc = nc_accept_ssh_session_auth(session, opts, fd, events);
+    if (rc != 1) {
+        return rc;
+    }
+
+    /* open channel and request 'netconf' subsystem */
+    rc = nc_accept_ssh_session_open_netconf_channel(session, opts, timeout, fd, events);
+    if (rc == 1) {
+        nc_server_ssh_auth_state_release(session);
+    }
+    return rc;
+}
+
+int
+nc_accept_ssh_session(struct nc_session *session, struct nc_server_ssh_opts *opts, int sock, int timeout, int *fd,
+        short *events)
 {
     ssh_bind sbind = NULL;
     int rc = 1, r;
@@ -2009,9 +2865,14 @@ nc_accept_ssh_session(struct nc_session *session, struct nc_server_ssh_opts *opt
         nc_timeouttime_get(&ts_timeout, timeout);
     }
     while ((r = ssh_handle_key_exchange(session->ti.libssh.session)) == SSH_AGAIN) {
-        /* this tends to take longer */
-        usleep(NC_TIMEOUT_STEP * 20);
-        if ((timeout > -1) && (nc_timeouttime_cur_diff(&ts_timeout) < 1)) {
+        /* wait for the peer */
+        r = nc_server_ssh_wait_fd(session, (timeout > -1) ? &ts_timeout : NULL);
+        if (r == -1) {
+            ERR(session, "Communication SSH socket unexpectedly closed.");
+            rc = -1;
+            goto cleanup;
+        } else if (!r) {
+            r = SSH_AGAIN;
             break;
         }
     }
@@ -2029,18 +2890,8 @@ nc_accept_ssh_session(struct nc_session *session, struct nc_server_ssh_opts *opt
         goto cleanup;
     }
 
-    /* authenticate, store auth_timeout in session so we can retrieve it in kb interactive API */
-    session->data = &opts->auth_timeout;
-    rc = nc_accept_ssh_session_auth(session, opts);
-    session->data = NULL;
-    if (rc != 1) {
-        goto cleanup;
-    }
-
-    /* open channel and request 'netconf' subsystem */
-    if ((rc = nc_accept_ssh_session_open_netconf_channel(session, opts, timeout)) != 1) {
-        goto cleanup;
-    }
+    /* authenticate, open channel and request 'netconf' subsystem */
+    rc = nc_accept_ssh_session_step(session, opts, timeout, fd, events);
 
 cleanup:
     if (sock > -1) {
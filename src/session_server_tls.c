@@ -16,12 +16,14 @@
 
 #define _GNU_SOURCE
 
+#include <ctype.h>
 #include <errno.h>
 #include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <curl/curl.h>
@@ -116,125 +118,6 @@ nc_base64der_to_privkey(const char *in, const char *key_str)
     return pkey;
 }
 
-static char *
-nc_server_tls_digest_to_hex(const unsigned char *digest, unsigned int digest_len)
-{
-    unsigned int i;
-    char *hex;
-
-    hex = malloc(digest_len * 3);
-    NC_CHECK_ERRMEM_RET(!hex, NULL);
-
-    for (i = 0; i < digest_len - 1; ++i) {
-        sprintf(hex + (i * 3), "%02x:", digest[i]);
-    }
-    sprintf(hex + (i * 3), "%02x", digest[i]);
-
-    return hex;
-}
-
-static char *
-nc_server_tls_md5(void *cert)
-{
-    int rc;
-    unsigned int buf_len = 16;
-    unsigned char buf[buf_len];
-
-    /* compute MD-5 hash of cert and store it in buf */
-    rc = nc_server_tls_md5_wrap(cert, buf);
-    if (rc) {
-        return NULL;
-    }
-
-    /* convert the hash to hex */
-    return nc_server_tls_digest_to_hex(buf, buf_len);
-}
-
-static char *
-nc_server_tls_sha1(void *cert)
-{
-    int rc;
-    unsigned int buf_len = 20;
-    unsigned char buf[buf_len];
-
-    /* compute SHA-1 hash of cert and store it in buf */
-    rc = nc_server_tls_sha1_wrap(cert, buf);
-    if (rc) {
-        return NULL;
-    }
-
-    /* convert the hash to hex */
-    return nc_server_tls_digest_to_hex(buf, buf_len);
-}
-
-static char *
-nc_server_tls_sha224(void *cert)
-{
-    int rc;
-    unsigned int buf_len = 28;
-    unsigned char buf[buf_len];
-
-    /* compute SHA-224 hash of cert and store it in buf */
-    rc = nc_server_tls_sha224_wrap(cert, buf);
-    if (rc) {
-        return NULL;
-    }
-
-    /* convert the hash to hex */
-    return nc_server_tls_digest_to_hex(buf, buf_len);
-}
-
-static char *
-nc_server_tls_sha256(void *cert)
-{
-    int rc;
-    unsigned int buf_len = 32;
-    unsigned char buf[buf_len];
-
-    /* compute SHA-256 hash of cert and store it in buf */
-    rc = nc_server_tls_sha256_wrap(cert, buf);
-    if (rc) {
-        return NULL;
-    }
-
-    /* convert the hash to hex */
-    return nc_server_tls_digest_to_hex(buf, buf_len);
-}
-
-static char *
-nc_server_tls_sha384(void *cert)
-{
-    int rc;
-    unsigned int buf_len = 48;
-    unsigned char buf[buf_len];
-
-    /* compute SHA-384 hash of cert and store it in buf */
-    rc = nc_server_tls_sha384_wrap(cert, buf);
-    if (rc) {
-        return NULL;
-    }
-
-    /* convert the hash to hex */
-    return nc_server_tls_digest_to_hex(buf, buf_len);
-}
-
-static char *
-nc_server_tls_sha512(void *cert)
-{
-    int rc;
-    unsigned int buf_len = 64;
-    unsigned char buf[buf_len];
-
-    /* compute SHA-512 hash of cert and store it in buf */
-    rc = nc_server_tls_sha512_wrap(cert, buf);
-    if (rc) {
-        return NULL;
-    }
-
-    /* convert the hash to hex */
-    return nc_server_tls_digest_to_hex(buf, buf_len);
-}
-
 static int
 nc_server_tls_get_username(void *cert, struct nc_ctn *ctn, char **username)
 {
@@ -327,193 +210,326 @@ nc_server_tls_get_username(void *cert, struct nc_ctn *ctn, char **username)
     return 0;
 }
 
+/**
+ * @brief Certificate digest functions indexed by the cert-to-name fingerprint algorithm.
+ */
+static const struct {
+    int (*digest)(void *cert, unsigned char *buf);
+    uint8_t len;
+} nc_server_tls_fp_algs[] = {
+    {NULL, 0},
+    {nc_server_tls_md5_wrap, 16},
+    {nc_server_tls_sha1_wrap, 20},
+    {nc_server_tls_sha224_wrap, 28},
+    {nc_server_tls_sha256_wrap, 32},
+    {nc_server_tls_sha384_wrap, 48},
+    {nc_server_tls_sha512_wrap, 64}
+};
+
+#define NC_TLS_FP_ALG_COUNT 7
+
+/**
+ * @brief Parse a cert-to-name fingerprint "<alg>:<hex>:<hex>:..." into the algorithm and binary form.
+ *
+ * @param[in] fingerprint Fingerprint to parse.
+ * @param[out] rec Record to fill the algorithm, length and fingerprint of.
+ * @return 0 on success, 1 if not a valid fingerprint.
+ */
 static int
-nc_server_tls_cert_to_name(struct nc_ctn *ctn, void *cert_chain, char **username)
+nc_server_tls_fp_parse(const char *fingerprint, struct nc_ctn_fp_rec *rec)
 {
-    int ret = 1, i, cert_count, fingerprint_match;
-    char *digest_md5, *digest_sha1, *digest_sha224;
-    char *digest_sha256, *digest_sha384, *digest_sha512;
-    void *cert;
+    unsigned int byte;
+    const char *ptr;
 
-    /* first make sure the entry is valid */
-    if (!ctn->map_type || ((ctn->map_type == NC_TLS_CTN_SPECIFIED) && !ctn->name)) {
-        VRB(NULL, "Cert verify CTN: entry with id %u not valid, skipping.", ctn->id);
+    if ((sscanf(fingerprint, "%2x", &byte) != 1) || !byte || (byte >= NC_TLS_FP_ALG_COUNT)) {
         return 1;
     }
+    rec->alg = byte;
+    rec->len = 0;
 
-    cert_count = nc_tls_get_num_certs_wrap(cert_chain);
-    for (i = 0; i < cert_count; i++) {
-        /* reset the flag */
-        fingerprint_match = 0;
-
-        /*get next cert */
-        nc_tls_get_cert_wrap(cert_chain, i, &cert);
-        if (!cert) {
-            ERR(NULL, "Failed to get certificate from the chain.");
-            ret = -1;
-            goto cleanup;
+    for (ptr = fingerprint + 2; *ptr; ptr += 3) {
+        if ((*ptr != ':') || (rec->len == NC_TLS_FP_MAX_LEN) || !isxdigit(ptr[1]) || !isxdigit(ptr[2]) ||
+                (sscanf(ptr + 1, "%2x", &byte) != 1)) {
+            return 1;
         }
+        rec->fp[rec->len++] = byte;
+    }
 
-        if (!ctn->fingerprint) {
-            /* if ctn has no fingerprint, it will match any certificate */
-            fingerprint_match = 1;
-
-            /* MD5 */
-        } else if (!strncmp(ctn->fingerprint, "01", 2)) {
-            digest_md5 = nc_server_tls_md5(cert);
-            if (!digest_md5) {
-                ret = -1;
-                goto cleanup;
-            }
+    if (rec->len != nc_server_tls_fp_algs[rec->alg].len) {
+        return 1;
+    }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_md5)) {
-                /* we got ourselves a potential winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                fingerprint_match = 1;
-            }
-            free(digest_md5);
+    return 0;
+}
 
-            /* SHA-1 */
-        } else if (!strncmp(ctn->fingerprint, "02", 2)) {
-            digest_sha1 = nc_server_tls_sha1(cert);
-            if (!digest_sha1) {
-                ret = -1;
-                goto cleanup;
-            }
+/**
+ * @brief Get the hash of a fingerprint record.
+ *
+ * @param[in] rec Fingerprint record.
+ * @return Hash of the algorithm and fingerprint.
+ */
+static uint32_t
+nc_server_tls_fp_hash(const struct nc_ctn_fp_rec *rec)
+{
+    uint32_t hash;
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha1)) {
-                /* we got ourselves a potential winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                fingerprint_match = 1;
-            }
-            free(digest_sha1);
+    hash = lyht_hash_multi(0, (const char *)&rec->alg, 1);
+    hash = lyht_hash_multi(hash, (const char *)rec->fp, rec->len);
+    return lyht_hash_multi(hash, NULL, 0);
+}
 
-            /* SHA-224 */
-        } else if (!strncmp(ctn->fingerprint, "03", 2)) {
-            digest_sha224 = nc_server_tls_sha224(cert);
-            if (!digest_sha224) {
-                ret = -1;
-                goto cleanup;
-            }
+/**
+ * @brief Fingerprint hash table value equal callback.
+ */
+static ly_bool
+nc_server_tls_fp_equal(void *val1_p, void *val2_p, ly_bool UNUSED(mod), void *UNUSED(cb_data))
+{
+    struct nc_ctn_fp_rec *rec1 = val1_p, *rec2 = val2_p;
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha224)) {
-                /* we got ourselves a potential winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                fingerprint_match = 1;
-            }
-            free(digest_sha224);
+    return (rec1->alg == rec2->alg) && (rec1->len == rec2->len) && !memcmp(rec1->fp, rec2->fp, rec1->len);
+}
 
-            /* SHA-256 */
-        } else if (!strncmp(ctn->fingerprint, "04", 2)) {
-            digest_sha256 = nc_server_tls_sha256(cert);
-            if (!digest_sha256) {
-                ret = -1;
-                goto cleanup;
-            }
+/**
+ * @brief Fingerprint hash table value free callback.
+ */
+static void
+nc_server_tls_fp_free(void *val_p)
+{
+    struct nc_ctn_fp_rec *rec = val_p;
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha256)) {
-                /* we got ourselves a potential winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                fingerprint_match = 1;
-            }
-            free(digest_sha256);
+    free(rec->idx);
+}
 
-            /* SHA-384 */
-        } else if (!strncmp(ctn->fingerprint, "05", 2)) {
-            digest_sha384 = nc_server_tls_sha384(cert);
-            if (!digest_sha384) {
-                ret = -1;
-                goto cleanup;
-            }
+void
+nc_server_tls_ctn_map_free(struct nc_server_tls_ctn_map *map)
+{
+    uint32_t i;
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha384)) {
-                /* we got ourselves a potential winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                fingerprint_match = 1;
-            }
-            free(digest_sha384);
+    for (i = 0; i < map->ctn_count; i++) {
+        free(map->ctns[i].name);
+    }
+    free(map->ctns);
+    lyht_free(map->fp_ht, nc_server_tls_fp_free);
+    free(map->any_idx);
+    memset(map, 0, sizeof *map);
+}
 
-            /* SHA-512 */
-        } else if (!strncmp(ctn->fingerprint, "06", 2)) {
-            digest_sha512 = nc_server_tls_sha512(cert);
-            if (!digest_sha512) {
-                ret = -1;
-                goto cleanup;
-            }
+/**
+ * @brief Add cert-to-name entries to a map.
+ *
+ * @param[in] ctn First entry of a list ordered by priority.
+ * @param[in,out] map Map to add to.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_tls_ctn_map_add(const struct nc_ctn *ctn, struct nc_server_tls_ctn_map *map)
+{
+    struct nc_ctn *entry;
+    struct nc_ctn_fp_rec rec = {0}, *match;
+    uint32_t *idx;
+    void *mem;
+
+    for ( ; ctn; ctn = ctn->next) {
+        /* first make sure the entry is valid */
+        if (!ctn->map_type || ((ctn->map_type == NC_TLS_CTN_SPECIFIED) && !ctn->name)) {
+            VRB(NULL, "Cert verify CTN: entry with id %u not valid, skipping.", ctn->id);
+            continue;
+        }
+        if (ctn->fingerprint && nc_server_tls_fp_parse(ctn->fingerprint, &rec)) {
+            WRN(NULL, "Unknown fingerprint algorithm used (%s), skipping.", ctn->fingerprint);
+            continue;
+        }
 
-            if (!strcasecmp(ctn->fingerprint + 3, digest_sha512)) {
-                /* we got ourselves a potential winner! */
-                VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
-                fingerprint_match = 1;
-            }
-            free(digest_sha512);
+        /* copy the entry */
+        mem = realloc(map->ctns, (map->ctn_count + 1) * sizeof *map->ctns);
+        NC_CHECK_ERRMEM_RET(!mem, -1);
+        map->ctns = mem;
+        entry = &map->ctns[map->ctn_count];
+        memset(entry, 0, sizeof *entry);
+        entry->id = ctn->id;
+        entry->map_type = ctn->map_type;
+        if (ctn->name) {
+            entry->name = strdup(ctn->name);
+            NC_CHECK_ERRMEM_RET(!entry->name, -1);
+        }
+        ++map->ctn_count;
 
-            /* unknown */
-        } else {
-            WRN(NULL, "Unknown fingerprint algorithm used (%s), skipping.", ctn->fingerprint);
+        if (!ctn->fingerprint) {
+            /* matches any certificate */
+            mem = realloc(map->any_idx, (map->any_count + 1) * sizeof *map->any_idx);
+            NC_CHECK_ERRMEM_RET(!mem, -1);
+            map->any_idx = mem;
+            map->any_idx[map->any_count++] = map->ctn_count - 1;
             continue;
         }
 
-        if (fingerprint_match) {
-            /* found a fingerprint match, try to obtain the username */
-            ret = nc_server_tls_get_username(cert, ctn, username);
-            if (ret == -1) {
-                /* fatal error */
-                goto cleanup;
-            } else if (!ret) {
-                /* username found */
-                goto cleanup;
+        /* find the record of the fingerprint or insert a new one */
+        if (lyht_find(map->fp_ht, &rec, nc_server_tls_fp_hash(&rec), (void **)&match)) {
+            rec.idx = NULL;
+            rec.idx_count = 0;
+            if (lyht_insert(map->fp_ht, &rec, nc_server_tls_fp_hash(&rec), (void **)&match)) {
+                ERRINT;
+                return -1;
             }
         }
+        idx = realloc(match->idx, (match->idx_count + 1) * sizeof *match->idx);
+        NC_CHECK_ERRMEM_RET(!idx, -1);
+        match->idx = idx;
+        match->idx[match->idx_count++] = map->ctn_count - 1;
+
+        map->fp_algs |= 1 << rec.alg;
     }
 
-cleanup:
-    return ret;
+    return 0;
+}
+
+int
+nc_server_tls_ctn_map_build(const struct nc_server_tls_opts *opts, const struct nc_endpt *referenced_endpt,
+        struct nc_server_tls_ctn_map *map)
+{
+    memset(map, 0, sizeof *map);
+
+    map->fp_ht = lyht_new(8, sizeof(struct nc_ctn_fp_rec), nc_server_tls_fp_equal, NULL, 1);
+    NC_CHECK_ERRMEM_RET(!map->fp_ht, -1);
+
+    /* the endpoint's own entries take precedence over the referenced ones */
+    if (nc_server_tls_ctn_map_add(opts->ctn, map)) {
+        goto error;
+    }
+    if (referenced_endpt && nc_server_tls_ctn_map_add(referenced_endpt->opts.tls->ctn, map)) {
+        goto error;
+    }
+
+    return 0;
+
+error:
+    nc_server_tls_ctn_map_free(map);
+    return -1;
 }
 
+/**
+ * @brief Cert-to-name candidate, an entry matching a certificate in the chain.
+ */
+struct nc_ctn_candidate {
+    uint32_t idx;       /**< Index of the entry */
+    int cert_idx;       /**< Index of the certificate in the chain */
+};
+
 static int
-_nc_server_tls_cert_to_name(struct nc_server_tls_opts *opts, void *cert_chain, char **username)
+nc_server_tls_ctn_candidate_cmp(const void *ptr1, const void *ptr2)
 {
-    int ret = 1;
-    struct nc_endpt *referenced_endpt;
-    struct nc_ctn *ctn;
+    const struct nc_ctn_candidate *cand1 = ptr1, *cand2 = ptr2;
 
-    for (ctn = opts->ctn; ctn; ctn = ctn->next) {
-        ret = nc_server_tls_cert_to_name(ctn, cert_chain, username);
-        if (ret != 1) {
-            /* fatal error or success */
-            goto cleanup;
-        }
+    if (cand1->idx != cand2->idx) {
+        return (cand1->idx < cand2->idx) ? -1 : 1;
     }
+    return cand1->cert_idx - cand2->cert_idx;
+}
 
-    /* do the same for referenced endpoint's ctn entries */
-    if (opts->referenced_endpt_name) {
-        if (nc_server_get_referenced_endpt(opts->referenced_endpt_name, &referenced_endpt)) {
-            ERRINT;
+int
+nc_server_tls_cert_to_name(const struct nc_server_tls_ctn_map *map, void *cert_chain, char **username)
+{
+    int ret = 1, i, cert_count;
+    uint32_t j, cand_count = 0;
+    uint8_t alg;
+    struct nc_ctn_fp_rec rec, *match;
+    struct nc_ctn_candidate *cands = NULL, *mem;
+    void *cert;
+
+    cert_count = nc_tls_get_num_certs_wrap(cert_chain);
+    for (i = 0; i < cert_count; i++) {
+        nc_tls_get_cert_wrap(cert_chain, i, &cert);
+        if (!cert) {
+            ERR(NULL, "Failed to get certificate from the chain.");
             ret = -1;
             goto cleanup;
         }
 
-        for (ctn = referenced_endpt->opts.tls->ctn; ctn; ctn = ctn->next) {
-            ret = nc_server_tls_cert_to_name(ctn, cert_chain, username);
-            if (ret != 1) {
-                /* fatal error or success */
+        /* compute each used digest of the certificate once and look up the entries with such fingerprint */
+        for (alg = 1; alg < NC_TLS_FP_ALG_COUNT; alg++) {
+            if (!(map->fp_algs & (1 << alg))) {
+                continue;
+            }
+
+            rec.alg = alg;
+            rec.len = nc_server_tls_fp_algs[alg].len;
+            if (nc_server_tls_fp_algs[alg].digest(cert, rec.fp)) {
+                ret = -1;
                 goto cleanup;
             }
+            if (lyht_find(map->fp_ht, &rec, nc_server_tls_fp_hash(&rec), (void **)&match)) {
+                continue;
+            }
+
+            VRB(NULL, "Cert verify CTN: entry with a matching fingerprint found.");
+            mem = realloc(cands, (cand_count + match->idx_count) * sizeof *cands);
+            NC_CHECK_ERRMEM_GOTO(!mem, ret = -1, cleanup);
+            cands = mem;
+            for (j = 0; j < match->idx_count; j++) {
+                cands[cand_count].idx = match->idx[j];
+                cands[cand_count].cert_idx = i;
+                ++cand_count;
+            }
+        }
+
+        /* entries without a fingerprint match every certificate */
+        if (map->any_count) {
+            mem = realloc(cands, (cand_count + map->any_count) * sizeof *cands);
+            NC_CHECK_ERRMEM_GOTO(!mem, ret = -1, cleanup);
+            cands = mem;
+            for (j = 0; j < map->any_count; j++) {
+                cands[cand_count].idx = map->any_idx[j];
+                cands[cand_count].cert_idx = i;
+                ++cand_count;
+            }
         }
     }
 
+    /* try the matches in the order of entry priority and then certificate position in the chain */
+    if (cand_count) {
+        qsort(cands, cand_count, sizeof *cands, nc_server_tls_ctn_candidate_cmp);
+    }
+    for (j = 0; j < cand_count; j++) {
+        nc_tls_get_cert_wrap(cert_chain, cands[j].cert_idx, &cert);
+        ret = nc_server_tls_get_username(cert, &map->ctns[cands[j].idx], username);
+        if (ret != 1) {
+            /* fatal error or username found */
+            goto cleanup;
+        }
+    }
+    ret = 1;
+
 cleanup:
+    free(cands);
     return ret;
 }
 
+/**
+ * @brief Trusted end-entity certificate hash set value equal callback.
+ */
+static ly_bool
+nc_server_tls_ee_equal(void *val1_p, void *val2_p, ly_bool UNUSED(mod), void *UNUSED(cb_data))
+{
+    return !memcmp(val1_p, val2_p, NC_TLS_EE_DIGEST_LEN);
+}
+
+/**
+ * @brief Add end-entity certificates to the trusted end-entity certificate hash set.
+ *
+ * Certificates that cannot be parsed are skipped so that they do not prevent other clients from connecting.
+ *
+ * @param[in] ee_certs End-entity certificates to add.
+ * @param[in] ee_set Hash set to add to.
+ * @return 0 on success, -1 on error.
+ */
 static int
-_nc_server_tls_verify_peer_cert(void *peer_cert, struct nc_cert_grouping *ee_certs)
+nc_server_tls_ee_set_add(struct nc_cert_grouping *ee_certs, struct ly_ht *ee_set)
 {
-    int i, ret;
+    int rc;
     void *cert;
     struct nc_certificate *certs;
-    uint16_t cert_count;
+    uint16_t i, cert_count;
+    unsigned char digest[NC_TLS_EE_DIGEST_LEN];
 
     if (ee_certs->store == NC_STORE_LOCAL) {
         /* local definition */
@@ -528,46 +544,74 @@ _nc_server_tls_verify_peer_cert(void *peer_cert, struct nc_cert_grouping *ee_cer
     }
 
     for (i = 0; i < cert_count; i++) {
-        /* import stored cert */
+        /* import stored cert and remember only its digest */
         cert = nc_base64der_to_cert(certs[i].data);
-
-        /* compare stored with received */
-        ret = nc_server_tls_certs_match_wrap(peer_cert, cert);
+        if (!cert) {
+            WRN(NULL, "Failed to parse end-entity certificate \"%s\", skipping.", certs[i].name);
+            continue;
+        }
+        rc = nc_server_tls_sha256_wrap(cert, digest);
         nc_tls_cert_destroy_wrap(cert);
-        if (ret) {
-            /* found a match */
-            VRB(NULL, "Cert verify: fail, but the end-entity certificate is trusted, continuing.");
-            return 0;
+        if (rc) {
+            WRN(NULL, "Failed to get the digest of end-entity certificate \"%s\", skipping.", certs[i].name);
+            continue;
+        }
+
+        rc = lyht_insert(ee_set, digest, lyht_hash((const char *)digest, NC_TLS_EE_DIGEST_LEN), NULL);
+        if (rc && (rc != LY_EEXIST)) {
+            ERRINT;
+            return -1;
         }
     }
 
-    return 1;
+    return 0;
 }
 
-int
-nc_server_tls_verify_peer_cert(void *peer_cert, struct nc_server_tls_opts *opts)
+/**
+ * @brief Create the trusted end-entity certificate hash set of an endpoint (and its referenced endpoint).
+ *
+ * @param[in] opts Endpoint TLS options.
+ * @param[in] referenced_endpt Referenced endpoint, if any.
+ * @param[out] ee_set Created hash set.
+ * @return 0 on success, -1 on error.
+ */
+static int
+nc_server_tls_ee_set_build(struct nc_server_tls_opts *opts, struct nc_endpt *referenced_endpt, struct ly_ht **ee_set)
 {
-    int rc;
-    struct nc_endpt *referenced_endpt;
+    *ee_set = lyht_new(8, NC_TLS_EE_DIGEST_LEN, nc_server_tls_ee_equal, NULL, 1);
+    NC_CHECK_ERRMEM_RET(!*ee_set, -1);
 
-    rc = _nc_server_tls_verify_peer_cert(peer_cert, &opts->ee_certs);
-    if (!rc) {
-        return 0;
+    if (nc_server_tls_ee_set_add(&opts->ee_certs, *ee_set)) {
+        goto error;
+    }
+    if (referenced_endpt && nc_server_tls_ee_set_add(&referenced_endpt->opts.tls->ee_certs, *ee_set)) {
+        goto error;
     }
 
-    if (opts->referenced_endpt_name) {
-        if (nc_server_get_referenced_endpt(opts->referenced_endpt_name, &referenced_endpt)) {
-            ERRINT;
-            return -1;
-        }
+    return 0;
 
-        rc = _nc_server_tls_verify_peer_cert(peer_cert, &referenced_endpt->opts.tls->ee_certs);
-        if (!rc) {
-            return 0;
-        }
+error:
+    lyht_free(*ee_set, NULL);
+    *ee_set = NULL;
+    return -1;
+}
+
+int
+nc_server_tls_verify_peer_cert(void *peer_cert, struct nc_server_tls_ctx *srv_ctx)
+{
+    unsigned char digest[NC_TLS_EE_DIGEST_LEN];
+
+    if (nc_server_tls_sha256_wrap(peer_cert, digest)) {
+        return -1;
     }
 
-    return 1;
+    if (lyht_find(srv_ctx->ee_certs, digest, lyht_hash((const char *)digest, NC_TLS_EE_DIGEST_LEN), NULL)) {
+        return 1;
+    }
+
+    /* found a match */
+    VRB(NULL, "Cert verify: fail, but the end-entity certificate is trusted, continuing.");
+    return 0;
 }
 
 int
@@ -575,7 +619,6 @@ nc_server_tls_verify_cert(void *cert, int depth, int trusted, struct nc_tls_veri
 {
     int ret = 0;
     char *subject = NULL, *issuer = NULL;
-    struct nc_server_tls_opts *opts = cb_data->opts;
     struct nc_session *session = cb_data->session;
     void *cert_chain = cb_data->chain;
 
@@ -600,7 +643,7 @@ nc_server_tls_verify_cert(void *cert, int depth, int trusted, struct nc_tls_veri
         if (!trusted) {
             /* peer cert is not trusted, so it must match any configured end-entity cert
              * on the given endpoint in order for the client to be authenticated */
-            ret = nc_server_tls_verify_peer_cert(cert, opts);
+            ret = nc_server_tls_verify_peer_cert(cert, cb_data->srv_ctx);
             if (ret) {
                 ERR(session, "Cert verify: fail (Client certificate not trusted and does not match any configured end-entity certificate).");
                 goto cleanup;
@@ -611,7 +654,7 @@ nc_server_tls_verify_cert(void *cert, int depth, int trusted, struct nc_tls_veri
          * the whole chain is needed in order to comply with the following issue:
          * https://github.com/CESNET/netopeer2/issues/1596
          */
-        ret = _nc_server_tls_cert_to_name(opts, cert_chain, &session->username);
+        ret = nc_server_tls_cert_to_name(&cb_data->srv_ctx->ctn_map, cert_chain, &session->username);
         if (ret == -1) {
             /* fatal error */
             goto cleanup;
@@ -661,6 +704,30 @@ nc_server_tls_set_verify_clb(int (*verify_clb)(const struct nc_session *session)
     pthread_rwlock_unlock(&server_opts.config_lock);
 }
 
+API void
+nc_server_tls_set_ktls(int enabled)
+{
+    /* CONFIG LOCK */
+    pthread_rwlock_wrlock(&server_opts.config_lock);
+
+    server_opts.tls_ktls = enabled ? 1 : 0;
+
+    /* CONFIG UNLOCK */
+    pthread_rwlock_unlock(&server_opts.config_lock);
+}
+
+API void
+nc_server_tls_set_dynamic_record_sizing(int enabled)
+{
+    /* CONFIG LOCK */
+    pthread_rwlock_wrlock(&server_opts.config_lock);
+
+    server_opts.tls_drs = enabled ? 1 : 0;
+
+    /* CONFIG UNLOCK */
+    pthread_rwlock_unlock(&server_opts.config_lock);
+}
+
 int
 nc_server_tls_load_server_cert_key(struct nc_server_tls_opts *opts, void **srv_cert, void **srv_pkey)
 {
@@ -788,23 +855,31 @@ nc_server_tls_get_num_certs(struct nc_cert_grouping *certs_grp)
     return count;
 }
 
-int
-nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opts, int sock, int timeout)
+/**
+ * @brief Build a new server TLS context from endpoint options.
+ *
+ * @param[in] opts Endpoint TLS options.
+ * @param[in,out] uncached Optional set of URIs to add the CRLs not cached yet to, they are not downloaded then.
+ * @param[in,out] uncached_count Count of @p uncached.
+ * @param[out] srv_ctx Built server TLS context with a single reference.
+ * @return 0 on success, non-zero on error.
+ */
+static int
+nc_server_tls_ctx_build(struct nc_server_tls_opts *opts, char ***uncached, uint32_t *uncached_count,
+        struct nc_server_tls_ctx **srv_ctx)
 {
-    int rc, timeouted = 0;
-    struct timespec ts_timeout;
-    struct nc_tls_verify_cb_data cb_data = {0};
-    struct nc_endpt *referenced_endpt;
+    struct nc_endpt *referenced_endpt = NULL;
+    struct nc_server_tls_ctx *new_ctx = NULL;
     void *tls_cfg, *srv_cert, *srv_pkey, *cert_store, *crl_store;
     uint32_t cert_count = 0;
 
     tls_cfg = srv_cert = srv_pkey = cert_store = crl_store = NULL;
+    *srv_ctx = NULL;
 
-    /* set verify cb data */
-    cb_data.session = session;
-    cb_data.opts = opts;
+    new_ctx = calloc(1, sizeof *new_ctx);
+    NC_CHECK_ERRMEM_RET(!new_ctx, 1);
 
-    /* prepare TLS context from which a session will be created */
+    /* prepare TLS config from which sessions will be created */
     tls_cfg = nc_tls_config_new_wrap(NC_SERVER);
     if (!tls_cfg) {
         goto fail;
@@ -818,25 +893,25 @@ nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opt
 
     /* load server's key and certificate */
     if (nc_server_tls_load_server_cert_key(opts, &srv_cert, &srv_pkey)) {
-        ERR(session, "Loading server certificate and/or private key failed.");
+        ERR(NULL, "Loading server certificate and/or private key failed.");
         goto fail;
     }
 
     /* load trusted CA certificates */
     if (nc_server_tls_load_trusted_certs(&opts->ca_certs, cert_store)) {
-        ERR(session, "Loading server CA certs failed.");
+        ERR(NULL, "Loading server CA certs failed.");
         goto fail;
     }
 
     /* load referenced endpoint's trusted CA certs if set */
     if (opts->referenced_endpt_name) {
         if (nc_server_get_referenced_endpt(opts->referenced_endpt_name, &referenced_endpt)) {
-            ERR(session, "Referenced endpoint \"%s\" not found.", opts->referenced_endpt_name);
+            ERR(NULL, "Referenced endpoint \"%s\" not found.", opts->referenced_endpt_name);
             goto fail;
         }
 
         if (nc_server_tls_load_trusted_certs(&referenced_endpt->opts.tls->ca_certs, cert_store)) {
-            ERR(session, "Loading server CA certs from referenced endpoint failed.");
+            ERR(NULL, "Loading server CA certs from referenced endpoint failed.");
             goto fail;
         }
     }
@@ -851,19 +926,32 @@ nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opt
                 nc_server_tls_get_num_certs(&referenced_endpt->opts.tls->ee_certs);
     }
     if (cert_count <= 0) {
-        ERR(session, "Neither CA nor end-entity certificates configured.");
+        ERR(NULL, "Neither CA nor end-entity certificates configured.");
         goto fail;
     }
 
-    if (nc_session_tls_crl_from_cert_ext_fetch(srv_cert, cert_store, &crl_store)) {
-        ERR(session, "Loading server CRL failed.");
+    /* prepare cert-to-name entries */
+    if (nc_server_tls_ctn_map_build(opts, referenced_endpt, &new_ctx->ctn_map)) {
+        goto fail;
+    }
+
+    /* prepare trusted end-entity certificates */
+    if (nc_server_tls_ee_set_build(opts, referenced_endpt, &new_ctx->ee_certs)) {
+        ERR(NULL, "Loading server end-entity certs failed.");
+        goto fail;
+    }
+
+    /* any of these CRLs refreshed from now on makes this context stale */
+    if (nc_session_tls_crl_from_cert_ext_fetch(srv_cert, cert_store, uncached, uncached_count, &crl_store,
+            &new_ctx->crls, &new_ctx->crl_count)) {
+        ERR(NULL, "Loading server CRL failed.");
         goto fail;
     }
 
     /* set supported TLS versions */
     if (opts->tls_versions) {
         if (nc_server_tls_set_tls_versions_wrap(tls_cfg, opts->tls_versions)) {
-            ERR(session, "Setting supported server TLS versions failed.");
+            ERR(NULL, "Setting supported server TLS versions failed.");
             goto fail;
         }
     }
@@ -873,11 +961,11 @@ nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opt
         nc_server_tls_set_cipher_suites_wrap(tls_cfg, opts->ciphers);
     }
 
-    /* set verify flags, callback and its data */
-    nc_server_tls_set_verify_wrap(tls_cfg, &cb_data);
+    /* set verify flags and callback, its data are set for every session */
+    nc_server_tls_set_verify_wrap(tls_cfg);
 
     /* init TLS context and store data which may be needed later in it */
-    if (nc_tls_init_ctx_wrap(srv_cert, srv_pkey, cert_store, crl_store, &session->ti.tls.ctx)) {
+    if (nc_tls_init_ctx_wrap(srv_cert, srv_pkey, cert_store, crl_store, &new_ctx->ctx)) {
         goto fail;
     }
 
@@ -885,17 +973,362 @@ nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opt
     srv_cert = srv_pkey = cert_store = crl_store = NULL;
 
     /* setup config from ctx */
-    if (nc_tls_setup_config_from_ctx_wrap(&session->ti.tls.ctx, NC_SERVER, tls_cfg)) {
+    if (nc_tls_setup_config_from_ctx_wrap(&new_ctx->ctx, NC_SERVER, tls_cfg)) {
+        goto fail;
+    }
+
+    /* session cache and tickets, their keys are rotated by building a new context */
+    if (nc_server_tls_set_resumption_wrap(tls_cfg, opts->resumption_lifetime, &new_ctx->ctx)) {
+        ERR(NULL, "Setting TLS session resumption failed.");
+        goto fail;
+    }
+    if (opts->resumption_lifetime) {
+        new_ctx->rotate_time = time(NULL) + opts->ticket_key_rotation;
+    }
+    new_ctx->tls_cfg = tls_cfg;
+    new_ctx->refcount = 1;
+
+    *srv_ctx = new_ctx;
+    return 0;
+
+fail:
+    nc_tls_config_destroy_wrap(tls_cfg);
+    nc_tls_ctx_destroy_wrap(&new_ctx->ctx);
+    nc_server_tls_ctn_map_free(&new_ctx->ctn_map);
+    lyht_free(new_ctx->ee_certs, NULL);
+    nc_session_tls_crl_cache_refs_free(new_ctx->crls, new_ctx->crl_count);
+    free(new_ctx);
+    nc_tls_cert_destroy_wrap(srv_cert);
+    nc_tls_privkey_destroy_wrap(srv_pkey);
+    nc_tls_cert_store_destroy_wrap(cert_store);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+    return 1;
+}
+
+void
+nc_server_tls_ctx_unref(struct nc_server_tls_ctx *srv_ctx)
+{
+    uint32_t refcount;
+
+    if (!srv_ctx) {
+        return;
+    }
+
+    /* TLS CTX LOCK */
+    pthread_mutex_lock(&server_opts.tls_ctx_lock);
+    refcount = --srv_ctx->refcount;
+    /* TLS CTX UNLOCK */
+    pthread_mutex_unlock(&server_opts.tls_ctx_lock);
+
+    if (refcount) {
+        return;
+    }
+
+    /* last reference, the config references the context so it must be freed first */
+    nc_tls_config_destroy_wrap(srv_ctx->tls_cfg);
+    nc_tls_ctx_destroy_wrap(&srv_ctx->ctx);
+    nc_server_tls_ctn_map_free(&srv_ctx->ctn_map);
+    lyht_free(srv_ctx->ee_certs, NULL);
+    nc_session_tls_crl_cache_refs_free(srv_ctx->crls, srv_ctx->crl_count);
+    free(srv_ctx);
+}
+
+/**
+ * @brief Replace the prebuilt TLS context of an endpoint.
+ *
+ * @param[in] opts Endpoint TLS options.
+ * @param[in] srv_ctx New server TLS context, its reference is moved to @p opts, may be NULL.
+ */
+static void
+nc_server_tls_ctx_set(struct nc_server_tls_opts *opts, struct nc_server_tls_ctx *srv_ctx)
+{
+    struct nc_server_tls_ctx *old_ctx;
+
+    /* TLS CTX LOCK */
+    pthread_mutex_lock(&server_opts.tls_ctx_lock);
+    old_ctx = opts->srv_ctx;
+    opts->srv_ctx = srv_ctx;
+    /* TLS CTX UNLOCK */
+    pthread_mutex_unlock(&server_opts.tls_ctx_lock);
+
+    /* sessions created from the old context keep it alive until they are freed */
+    nc_server_tls_ctx_unref(old_ctx);
+}
+
+/**
+ * @brief Build a new TLS context of an endpoint from the cached CRLs and set it.
+ *
+ * @param[in] opts Endpoint TLS options.
+ * @param[in] name Endpoint name.
+ * @param[in] retry Whether to only build the context if not set by a previous call, even if some CRLs are not cached.
+ * @param[in,out] uncached Set of URIs to add the CRLs not cached yet to.
+ * @param[in,out] uncached_count Count of @p uncached.
+ */
+static void
+nc_server_tls_ctx_endpt_build(struct nc_server_tls_opts *opts, const char *name, int retry, char ***uncached,
+        uint32_t *uncached_count)
+{
+    struct nc_server_tls_ctx *srv_ctx = NULL;
+    uint32_t prev_count = *uncached_count;
+    int built;
+
+    if (retry) {
+        /* TLS CTX LOCK */
+        pthread_mutex_lock(&server_opts.tls_ctx_lock);
+        built = opts->srv_ctx ? 1 : 0;
+        /* TLS CTX UNLOCK */
+        pthread_mutex_unlock(&server_opts.tls_ctx_lock);
+
+        if (built) {
+            return;
+        }
+    }
+
+    if (nc_server_tls_ctx_build(opts, uncached, uncached_count, &srv_ctx)) {
+        VRB(NULL, "Building TLS context of endpoint \"%s\" failed, it will be built once it is used.", name);
+    } else if (!retry && (*uncached_count > prev_count)) {
+        /* built again once the CRLs are downloaded */
+        nc_server_tls_ctx_unref(srv_ctx);
+    } else {
+        nc_server_tls_ctx_set(opts, srv_ctx);
+    }
+}
+
+/**
+ * @brief Drop or build new TLS contexts of all the TLS endpoints and Call Home endpoints.
+ *
+ * @param[in] build Whether to build new contexts or only drop the current ones.
+ * @param[in] retry Whether to only build the contexts not built by a previous call.
+ * @param[in,out] uncached Set of URIs to add the CRLs not cached yet to, if @p build.
+ * @param[in,out] uncached_count Count of @p uncached.
+ */
+static void
+nc_server_tls_ctx_update(int build, int retry, char ***uncached, uint32_t *uncached_count)
+{
+    uint16_t i, j;
+    struct nc_server_tls_opts *opts;
+
+    for (i = 0; i < server_opts.endpt_count; i++) {
+        if (server_opts.endpts[i].ti != NC_TI_TLS) {
+            continue;
+        }
+
+        opts = server_opts.endpts[i].opts.tls;
+        if (build) {
+            nc_server_tls_ctx_endpt_build(opts, server_opts.endpts[i].name, retry, uncached, uncached_count);
+        } else {
+            nc_server_tls_ctx_set(opts, NULL);
+        }
+    }
+
+    /* CH CLIENT LOCK */
+    pthread_rwlock_rdlock(&server_opts.ch_client_lock);
+
+    for (i = 0; i < server_opts.ch_client_count; i++) {
+        for (j = 0; j < server_opts.ch_clients[i].ch_endpt_count; j++) {
+            if (server_opts.ch_clients[i].ch_endpts[j].ti != NC_TI_TLS) {
+                continue;
+            }
+
+            opts = server_opts.ch_clients[i].ch_endpts[j].opts.tls;
+            if (build) {
+                nc_server_tls_ctx_endpt_build(opts, server_opts.ch_clients[i].ch_endpts[j].name, retry, uncached,
+                        uncached_count);
+            } else {
+                nc_server_tls_ctx_set(opts, NULL);
+            }
+        }
+    }
+
+    /* CH CLIENT UNLOCK */
+    pthread_rwlock_unlock(&server_opts.ch_client_lock);
+}
+
+/**
+ * @brief Free a set of URIs.
+ *
+ * @param[in] uris URIs to free.
+ * @param[in] uri_count Count of @p uris.
+ */
+static void
+nc_server_tls_uris_free(char **uris, uint32_t uri_count)
+{
+    uint32_t i;
+
+    for (i = 0; i < uri_count; i++) {
+        free(uris[i]);
+    }
+    free(uris);
+}
+
+void
+nc_server_tls_ctx_drop(void)
+{
+    nc_server_tls_ctx_update(0, 0, NULL, NULL);
+}
+
+void
+nc_server_tls_ctx_rebuild(void)
+{
+    char **uris = NULL;
+    uint32_t uri_count = 0, i;
+
+    /* CONFIG LOCK */
+    pthread_rwlock_rdlock(&server_opts.config_lock);
+
+    /* build the contexts with all their CRLs cached, collect the others */
+    nc_server_tls_ctx_update(1, 0, &uris, &uri_count);
+
+    /* CONFIG UNLOCK */
+    pthread_rwlock_unlock(&server_opts.config_lock);
+
+    if (!uri_count) {
+        return;
+    }
+
+    /* download the CRLs into the cache, accepting sessions and applying configuration are not blocked */
+    for (i = 0; i < uri_count; i++) {
+        if (nc_session_tls_crl_cache_get(uris[i], 0, NULL, NULL)) {
+            WRN(NULL, "Failed to fetch CRL from \"%s\".", uris[i]);
+        }
+    }
+    nc_server_tls_uris_free(uris, uri_count);
+    uris = NULL;
+    uri_count = 0;
+
+    /* CONFIG LOCK */
+    pthread_rwlock_rdlock(&server_opts.config_lock);
+
+    /* build the rest, the configuration may have changed meanwhile, without the CRLs failed to be downloaded */
+    nc_server_tls_ctx_update(1, 1, &uris, &uri_count);
+
+    /* CONFIG UNLOCK */
+    pthread_rwlock_unlock(&server_opts.config_lock);
+
+    nc_server_tls_uris_free(uris, uri_count);
+}
+
+/**
+ * @brief Check whether a prebuilt TLS context should be replaced by a new one.
+ *
+ * @param[in] srv_ctx Server TLS context.
+ * @return Whether the context is stale.
+ */
+static int
+nc_server_tls_ctx_is_stale(const struct nc_server_tls_ctx *srv_ctx)
+{
+    if (nc_session_tls_crl_cache_changed(srv_ctx->crls, srv_ctx->crl_count)) {
+        /* CRLs of this context were refreshed */
+        return 1;
+    }
+
+    if (srv_ctx->rotate_time && (time(NULL) >= srv_ctx->rotate_time)) {
+        /* session ticket keys should be rotated */
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get a reference of the prebuilt TLS context of an endpoint, build it if there is none.
+ *
+ * A context built with any CRLs that have since been refreshed or with session ticket keys
+ * that should be rotated is replaced by a new one.
+ *
+ * @param[in] opts Endpoint TLS options.
+ * @param[out] srv_ctx Referenced server TLS context.
+ * @return 0 on success, non-zero on error.
+ */
+static int
+nc_server_tls_ctx_get(struct nc_server_tls_opts *opts, struct nc_server_tls_ctx **srv_ctx)
+{
+    struct nc_server_tls_ctx *new_ctx = NULL, *old_ctx = NULL;
+
+    /* TLS CTX LOCK */
+    pthread_mutex_lock(&server_opts.tls_ctx_lock);
+    *srv_ctx = opts->srv_ctx;
+    if (*srv_ctx) {
+        ++(*srv_ctx)->refcount;
+    }
+    /* TLS CTX UNLOCK */
+    pthread_mutex_unlock(&server_opts.tls_ctx_lock);
+
+    if (*srv_ctx && !nc_server_tls_ctx_is_stale(*srv_ctx)) {
+        return 0;
+    }
+
+    /* not built yet, building failed on config change, CRLs were refreshed, or ticket keys expired, try again */
+    if (nc_server_tls_ctx_build(opts, NULL, NULL, &new_ctx)) {
+        if (*srv_ctx) {
+            WRN(NULL, "Rebuilding TLS context failed, using the previous one.");
+            return 0;
+        }
+        return 1;
+    }
+    nc_server_tls_ctx_unref(*srv_ctx);
+
+    /* TLS CTX LOCK */
+    pthread_mutex_lock(&server_opts.tls_ctx_lock);
+    if (!opts->srv_ctx || nc_server_tls_ctx_is_stale(opts->srv_ctx)) {
+        /* store it in the endpoint */
+        old_ctx = opts->srv_ctx;
+        opts->srv_ctx = new_ctx;
+        ++new_ctx->refcount;
+        new_ctx = NULL;
+    }
+    *srv_ctx = opts->srv_ctx;
+    ++(*srv_ctx)->refcount;
+    /* TLS CTX UNLOCK */
+    pthread_mutex_unlock(&server_opts.tls_ctx_lock);
+
+    /* the replaced one and the one built concurrently by another thread */
+    nc_server_tls_ctx_unref(old_ctx);
+    nc_server_tls_ctx_unref(new_ctx);
+    return 0;
+}
+
+int
+nc_accept_tls_session_start(struct nc_session *session, struct nc_server_tls_opts *opts, int sock, int timeout)
+{
+    struct nc_server_tls_ctx *srv_ctx = NULL;
+
+    /* get the shared TLS config prepared for the endpoint */
+    if (nc_server_tls_ctx_get(opts, &srv_ctx)) {
+        ERR(session, "Preparing server TLS context failed.");
         goto fail;
     }
-    session->ti.tls.config = tls_cfg;
-    tls_cfg = NULL;
+
+    /* init the per-session part of the TLS context */
+    if (nc_tls_init_session_ctx_wrap(&session->ti.tls.ctx)) {
+        goto fail;
+    }
+
+    /* the session holds the reference now */
+    session->ti.tls.config = srv_ctx->tls_cfg;
+    session->ti.tls.srv_ctx = srv_ctx;
 
     /* fill session data and create TLS session from config */
     session->ti_type = NC_TI_TLS;
     if (!(session->ti.tls.session = nc_tls_session_new_wrap(session->ti.tls.config))) {
+        srv_ctx = NULL;
         goto fail;
     }
+    if (server_opts.tls_ktls) {
+        nc_tls_enable_ktls_wrap(session->ti.tls.session);
+    }
+    session->ti.tls.drs = server_opts.tls_drs;
+
+    /* set verify cb data of this session, they must live as long as the handshake */
+    session->ti.tls.hs = calloc(1, sizeof *session->ti.tls.hs);
+    NC_CHECK_ERRMEM_GOTO(!session->ti.tls.hs, srv_ctx = NULL, fail);
+    session->ti.tls.hs->cb_data.session = session;
+    session->ti.tls.hs->cb_data.srv_ctx = srv_ctx;
+    srv_ctx = NULL;
+    if (timeout > -1) {
+        nc_timeouttime_get(&session->ti.tls.hs->ts_timeout, timeout);
+    }
+    nc_server_tls_set_verify_data_wrap(session->ti.tls.session, &session->ti.tls.hs->cb_data);
 
     /* if keylog file is set, log the tls secrets there */
     if (server_opts.tls_keylog_file) {
@@ -905,42 +1338,73 @@ nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opt
     /* set session fd */
     nc_tls_set_fd_wrap(session->ti.tls.session, sock, &session->ti.tls.ctx);
 
-    sock = -1;
+    return 0;
 
-    /* do the handshake */
-    if (timeout > -1) {
-        nc_timeouttime_get(&ts_timeout, timeout);
-    }
-    while ((rc = nc_server_tls_handshake_step_wrap(session->ti.tls.session)) == 0) {
-        usleep(NC_TIMEOUT_STEP);
-        if ((timeout > -1) && (nc_timeouttime_cur_diff(&ts_timeout) < 1)) {
-            ERR(session, "TLS accept timeout.");
-            timeouted = 1;
-            goto fail;
-        }
+fail:
+    close(sock);
+    nc_server_tls_ctx_unref(srv_ctx);
+    return -1;
+}
+
+int
+nc_accept_tls_session_step(struct nc_session *session, short *events)
+{
+    int rc;
+
+    rc = nc_server_tls_handshake_step_wrap(session->ti.tls.session, events);
+    if (!rc) {
+        return 0;
     }
 
     /* check if handshake was ok */
     if (nc_server_tls_accept_check(rc, session->ti.tls.session) != 1) {
-        goto fail;
+        return -1;
     }
 
-    return 1;
-
-fail:
-    if (sock > -1) {
-        close(sock);
+    if (!session->username) {
+        /* a previous session was resumed without calling the verify callback,
+         * the client must still be authenticated using its certificate */
+        VRB(session, "TLS session resumed.");
+        session->ti.tls.resumed = 1;
+        if (nc_server_tls_verify_resumed_wrap(session->ti.tls.session, &session->ti.tls.srv_ctx->ctx,
+                &session->ti.tls.hs->cb_data)) {
+            ERR(session, "Client certificate of the resumed TLS session not authenticated.");
+            return -1;
+        }
     }
 
-    nc_tls_config_destroy_wrap(tls_cfg);
-    nc_tls_cert_destroy_wrap(srv_cert);
-    nc_tls_privkey_destroy_wrap(srv_pkey);
-    nc_tls_cert_store_destroy_wrap(cert_store);
-    nc_tls_crl_store_destroy_wrap(crl_store);
+    /* verify cb data are no longer valid */
+    nc_server_tls_set_verify_data_wrap(session->ti.tls.session, NULL);
+    free(session->ti.tls.hs->endpt_name);
+    free(session->ti.tls.hs);
+    session->ti.tls.hs = NULL;
 
-    if (timeouted) {
-        return 0;
-    } else {
+    nc_session_tls_established(session);
+
+    return 1;
+}
+
+int
+nc_accept_tls_session(struct nc_session *session, struct nc_server_tls_opts *opts, int sock, int timeout)
+{
+    int rc;
+    short events;
+
+    if (nc_accept_tls_session_start(session, opts, sock, timeout)) {
         return -1;
     }
+
+    /* do the handshake, waiting for the socket to become ready for whatever the TLS backend needs */
+    while (!(rc = nc_accept_tls_session_step(session, &events))) {
+        rc = nc_sock_wait(sock, events, (timeout > -1) ? &session->ti.tls.hs->ts_timeout : NULL);
+        if (!rc) {
+            ERR(session, "TLS accept timeout.");
+            return 0;
+        } else if (rc < 0) {
+            ERR(session, "Communication socket unexpectedly closed.");
+            return -1;
+        }
+    }
+
+    return (rc == 1) ? 1 : -1;
 }
@@ -16,6 +16,8 @@
 #ifndef _SESSION_WRAPPER_H_
 #define _SESSION_WRAPPER_H_
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "config.h"
@@ -26,20 +28,36 @@
 #include <mbedtls/entropy.h>
 #include <mbedtls/pk.h>
 #include <mbedtls/ssl.h>
+#include <mbedtls/ssl_cache.h>
+#include <mbedtls/ssl_ticket.h>
 #include <mbedtls/x509_crl.h>
 #include <mbedtls/x509_crt.h>
 
+/**
+ * @brief Random bit generator, it may be used by several threads at once.
+ */
+struct nc_tls_rng {
+    mbedtls_entropy_context entropy;    /**< Entropy. */
+    mbedtls_ctr_drbg_context ctr_drbg;  /**< Random bit generator. */
+    pthread_mutex_t lock;               /**< Lock for the generator, MbedTLS may be built without threading support. */
+};
+
 /**
  * @brief Context from which a TLS session may be created.
  */
 struct nc_tls_ctx {
     int *sock;                          /**< Socket FD. */
-    mbedtls_entropy_context *entropy;   /**< Entropy. */
-    mbedtls_ctr_drbg_context *ctr_drbg; /**< Random bit generator. */
+    struct nc_tls_rng *rng;             /**< Random bit generator shared by all the sessions created from the context. */
     mbedtls_x509_crt *cert;             /**< Certificate. */
     mbedtls_pk_context *pkey;           /**< Private key. */
     mbedtls_x509_crt *cert_store;       /**< CA certificates store. */
     mbedtls_x509_crl *crl_store;        /**< CRL store. */
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    mbedtls_ssl_ticket_context *ticket; /**< Server session ticket keys. */
+#endif
+#ifdef MBEDTLS_SSL_CACHE_C
+    mbedtls_ssl_cache_context *cache;   /**< Server session cache. */
+#endif
 };
 
 #else
@@ -65,7 +83,7 @@ struct nc_tls_ctx {
  */
 struct nc_tls_verify_cb_data {
     struct nc_session *session;         /**< NETCONF session. */
-    struct nc_server_tls_opts *opts;    /**< TLS server options. */
+    struct nc_server_tls_ctx *srv_ctx;  /**< Server TLS context the session was created from. */
     void *chain;                        /**< Certificate chain used to verify the client cert. */
 };
 
@@ -208,12 +226,46 @@ int nc_server_tls_add_crl_to_store_wrap(const unsigned char *crl_data, size_t si
 int nc_server_tls_set_tls_versions_wrap(void *tls_cfg, unsigned int tls_versions);
 
 /**
- * @brief Set TLS server's verify flags, verify cb and its data.
+ * @brief Set TLS server's verify flags and verify cb.
+ *
+ * @param[in] tls_cfg TLS configuration.
+ */
+void nc_server_tls_set_verify_wrap(void *tls_cfg);
+
+/**
+ * @brief Set TLS server's verify cb data of a single session.
+ *
+ * The configuration may be shared by several sessions, so the data are always stored in the session.
+ *
+ * @param[in] tls_session TLS session.
+ * @param[in] cb_data Verify callback data.
+ */
+void nc_server_tls_set_verify_data_wrap(void *tls_session, struct nc_tls_verify_cb_data *cb_data);
+
+/**
+ * @brief Set TLS server's session resumption (session cache and session tickets).
+ *
+ * Must be called after the configuration was set up from the context.
  *
  * @param[in] tls_cfg TLS configuration.
+ * @param[in] lifetime Lifetime of resumable sessions in seconds, 0 to disable resumption.
+ * @param[in,out] tls_ctx TLS context storing the resumption data.
+ * @return 0 on success, non-zero on fail.
+ */
+int nc_server_tls_set_resumption_wrap(void *tls_cfg, uint32_t lifetime, struct nc_tls_ctx *tls_ctx);
+
+/**
+ * @brief Verify the client certificate of a resumed TLS session.
+ *
+ * The verify callback is not called when a session is resumed, so the certificate kept
+ * from the original handshake is verified again using the same callback.
+ *
+ * @param[in] tls_session Resumed TLS session.
+ * @param[in] tls_ctx TLS context the session was created from.
  * @param[in] cb_data Verify callback data.
+ * @return 0 if the client was authenticated, non-zero otherwise.
  */
-void nc_server_tls_set_verify_wrap(void *tls_cfg, struct nc_tls_verify_cb_data *cb_data);
+int nc_server_tls_verify_resumed_wrap(void *tls_session, struct nc_tls_ctx *tls_ctx, struct nc_tls_verify_cb_data *cb_data);
 
 /**
  * @brief Set TLS client's verify flags.
@@ -222,6 +274,30 @@ void nc_server_tls_set_verify_wrap(void *tls_cfg, struct nc_tls_verify_cb_data *
  */
 void nc_client_tls_set_verify_wrap(void *tls_cfg);
 
+/**
+ * @brief Get a resumable copy of an established client TLS session.
+ *
+ * @param[in] tls_session TLS session.
+ * @return Resumable session, NULL if the session can not be resumed or on fail.
+ */
+void * nc_client_tls_get_resumable_wrap(void *tls_session);
+
+/**
+ * @brief Set a previously established session to be resumed by a new client TLS session.
+ *
+ * @param[in] tls_session New TLS session, before the handshake.
+ * @param[in] resumable Resumable session, it is not consumed.
+ * @return 0 on success, non-zero on fail.
+ */
+int nc_client_tls_set_resumable_wrap(void *tls_session, void *resumable);
+
+/**
+ * @brief Destroy a resumable client TLS session.
+ *
+ * @param[in] resumable Resumable session to destroy.
+ */
+void nc_client_tls_resumable_destroy_wrap(void *resumable);
+
 /**
  * @brief Verify the certificate.
  *
@@ -237,10 +313,10 @@ int nc_server_tls_verify_cert(void *cert, int depth, int trusted, struct nc_tls_
  * @brief Check if the peer certificate matches any configured ee certs.
  *
  * @param[in] peer_cert Peer certificate.
- * @param[in] opts TLS options.
+ * @param[in] srv_ctx Server TLS context with the trusted ee certs.
  * @return 0 on success, non-zero on fail.
  */
-int nc_server_tls_verify_peer_cert(void *peer_cert, struct nc_server_tls_opts *opts);
+int nc_server_tls_verify_peer_cert(void *peer_cert, struct nc_server_tls_ctx *srv_ctx);
 
 /**
  * @brief Get the subject of the certificate.
@@ -309,15 +385,6 @@ int nc_tls_get_num_certs_wrap(void *chain);
  */
 void nc_tls_get_cert_wrap(void *chain, int idx, void **cert);
 
-/**
- * @brief Compare two certificates.
- *
- * @param[in] cert1 Certificate 1.
- * @param[in] cert2 Certificate 2.
- * @return 1 if the certificates match, 0 otherwise.
- */
-int nc_server_tls_certs_match_wrap(void *cert1, void *cert2);
-
 /**
  * @brief Get the MD5 digest of the certificate.
  *
@@ -385,18 +452,42 @@ void nc_tls_set_fd_wrap(void *tls_session, int sock, struct nc_tls_ctx *tls_ctx)
  * @brief Perform a server-side step of the TLS handshake.
  *
  * @param[in] tls_session TLS session.
+ * @param[out] events If the handshake is not finished, poll(2) events (POLLIN or POLLOUT) to wait for on the socket.
  * @return 1 on success, 0 if the handshake is not finished, negative number on error.
  */
-int nc_server_tls_handshake_step_wrap(void *tls_session);
+int nc_server_tls_handshake_step_wrap(void *tls_session, short *events);
 
 /**
  * @brief Perform a client-side step of the TLS handshake.
  *
  * @param[in] tls_session TLS session.
- * @param[in] sock Socket FD.
+ * @param[out] events If the handshake is not finished, poll(2) events (POLLIN or POLLOUT) to wait for on the socket.
  * @return 1 on success, 0 if the handshake is not finished, negative number on error.
  */
-int nc_client_tls_handshake_step_wrap(void *tls_session, int sock);
+int nc_client_tls_handshake_step_wrap(void *tls_session, short *events);
+
+/**
+ * @brief Enable kernel TLS offload of a TLS session if supported, must be called before the handshake.
+ *
+ * @param[in] tls_session TLS session.
+ */
+void nc_tls_enable_ktls_wrap(void *tls_session);
+
+/**
+ * @brief Get the kernel TLS offload used by an established TLS session.
+ *
+ * @param[in] tls_session TLS session.
+ * @return Bit-field of NC_TLS_KTLS_* flags.
+ */
+int nc_tls_get_ktls_wrap(void *tls_session);
+
+/**
+ * @brief Start counting the application data records written by an established TLS session.
+ *
+ * @param[in] tls_session TLS session.
+ * @param[in] records Counter to increment, it must exist as long as @p tls_session.
+ */
+void nc_tls_count_records_wrap(void *tls_session, uint64_t *records);
 
 /**
  * @brief Destroy a TLS context.
@@ -447,6 +538,16 @@ int nc_client_tls_set_hostname_wrap(void *tls_session, const char *hostname);
  */
 int nc_tls_init_ctx_wrap(void *cert, void *pkey, void *cert_store, void *crl_store, struct nc_tls_ctx *tls_ctx);
 
+/**
+ * @brief Initialize a TLS context of a session created from a shared TLS configuration.
+ *
+ * Only the per-session data are initialized, certificates, keys and stores are owned by the shared context.
+ *
+ * @param[in,out] tls_ctx TLS context.
+ * @return 0 on success, non-zero on fail.
+ */
+int nc_tls_init_session_ctx_wrap(struct nc_tls_ctx *tls_ctx);
+
 /**
  * @brief Setup a TLS configuration from a TLS context.
  *
@@ -742,6 +843,16 @@ void nc_server_tls_set_cipher_suites_wrap(void *tls_cfg, void *cipher_suites);
  */
 time_t nc_tls_get_cert_exp_time_wrap(void *cert);
 
+/**
+ * @brief Get the time of the next update of a CRL.
+ *
+ * @param[in] crl_data CRL data in DER or PEM, must be NUL-terminated.
+ * @param[in] size Size of the CRL data without the terminating NUL.
+ *
+ * @return Calendar time of the next update (it is in GMT), 0 if not set, or -1 on error.
+ */
+time_t nc_tls_get_crl_next_update_wrap(const unsigned char *crl_data, size_t size);
+
 /**
  * @brief Set the session to log TLS secrets for.
  *
@@ -16,16 +16,21 @@
 #define _GNU_SOURCE
 
 #include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <cmocka.h>
+#include <libssh/server.h>
 
 #include "ln2_test.h"
+#include "session_p.h"
 
 struct test_auth_ssh_data {
     const char *username;
@@ -118,6 +123,106 @@ test_nc_auth_ssh_password(void **state)
     }
 }
 
+static void
+test_nc_auth_ssh_password_worker(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+    struct ln2_test_ctx *test_ctx = *state;
+    struct test_auth_ssh_data *test_data = test_ctx->test_data;
+
+    /* verify the password in an authentication worker thread */
+    ret = nc_server_ssh_set_auth_thread_count(2);
+    assert_int_equal(ret, 0);
+
+    test_data->username = "test_pw";
+
+    ret = pthread_create(&tids[0], NULL, client_thread_ssh, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, ln2_glob_test_server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+static void *
+server_thread_accept_start(void *arg)
+{
+    int ret, fd, wouldblock = 0;
+    short events;
+    NC_MSG_TYPE msgtype;
+    struct pollfd pfd;
+    struct nc_session *session = NULL;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    msgtype = nc_accept_start(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session, &fd, &events);
+
+    /* drive the authentication as an external poller would, the accepting thread is never blocked */
+    while (msgtype == NC_MSG_WOULDBLOCK) {
+        assert_non_null(session);
+        assert_int_not_equal(fd, -1);
+        assert_int_equal(events, POLLIN);
+        ++wouldblock;
+
+        pfd.fd = fd;
+        pfd.events = events;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, NC_ACCEPT_TIMEOUT);
+        assert_int_equal(ret, 1);
+
+        msgtype = nc_accept_continue(&session, &fd, &events);
+    }
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+    assert_true(wouldblock > 0);
+    assert_string_equal(nc_session_get_username(session), "test_pw");
+
+    ret = nc_ps_add_session(ps, session);
+    assert_int_equal(ret, 0);
+
+    /* poll until the session is terminated by the client */
+    do {
+        ret = nc_ps_poll(ps, NC_PS_POLL_TIMEOUT, NULL);
+    } while (!(ret & NC_PSPOLL_SESSION_TERM));
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void
+test_nc_auth_ssh_password_worker_async(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+    struct ln2_test_ctx *test_ctx = *state;
+    struct test_auth_ssh_data *test_data = test_ctx->test_data;
+
+    /* the accepting thread waits for the worker in a poller */
+    ret = nc_server_ssh_set_auth_thread_count(1);
+    assert_int_equal(ret, 0);
+
+    test_data->username = "test_pw";
+
+    ret = pthread_create(&tids[0], NULL, client_thread_ssh, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_accept_start, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    ret = nc_server_ssh_set_auth_thread_count(0);
+    assert_int_equal(ret, 0);
+}
+
 static void
 test_nc_auth_ssh_none(void **state)
 {
@@ -271,6 +376,57 @@ test_nc_auth_ssh_banner(void **state)
     }
 }
 
+static void
+test_nc_server_ssh_wait_fd(void **state)
+{
+    int ret, sock[2];
+    ssh_bind sbind;
+    struct nc_session session = {0};
+    struct timespec ts_start, ts_timeout;
+
+    (void)state;
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sock);
+    assert_int_equal(ret, 0);
+
+    /* server SSH session on one end of the pair, nothing exchanged yet */
+    sbind = ssh_bind_new();
+    assert_non_null(sbind);
+    ret = ssh_bind_options_set(sbind, SSH_BIND_OPTIONS_HOSTKEY, TESTS_DIR "/data/key_rsa");
+    assert_int_equal(ret, SSH_OK);
+    session.ti_type = NC_TI_SSH;
+    session.ti.libssh.session = ssh_new();
+    assert_non_null(session.ti.libssh.session);
+    ret = ssh_bind_accept_fd(sbind, session.ti.libssh.session, sock[0]);
+    assert_int_equal(ret, SSH_OK);
+    ssh_set_blocking(session.ti.libssh.session, 0);
+
+    /* no data, waits for the whole timeout */
+    nc_timeouttime_get(&ts_start, 0);
+    nc_timeouttime_get(&ts_timeout, 100);
+    ret = nc_server_ssh_wait_fd(&session, &ts_timeout);
+    assert_int_equal(ret, 0);
+    assert_true(nc_timeouttime_cur_diff(&ts_start) <= -90);
+
+    /* elapsed timeout, returns right away */
+    ret = nc_server_ssh_wait_fd(&session, &ts_timeout);
+    assert_int_equal(ret, 0);
+
+    /* data from the peer make the socket ready */
+    ret = write(sock[1], "SSH-2.0-test\r\n", 14);
+    assert_int_equal(ret, 14);
+    nc_timeouttime_get(&ts_timeout, 1000);
+    ret = nc_server_ssh_wait_fd(&session, &ts_timeout);
+    assert_int_equal(ret, 1);
+    ret = nc_server_ssh_wait_fd(&session, NULL);
+    assert_int_equal(ret, 1);
+
+    /* the socket is closed by libssh */
+    ssh_free(session.ti.libssh.session);
+    ssh_bind_free(sbind);
+    close(sock[1]);
+}
+
 static int
 setup_ssh(void **state)
 {
@@ -335,13 +491,16 @@ main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_nc_auth_ssh_password, setup_ssh, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_auth_ssh_password_worker, setup_ssh, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_auth_ssh_password_worker_async, setup_ssh, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_auth_ssh_none, setup_ssh, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_auth_ssh_rsa_pubkey, setup_ssh, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_auth_ssh_ec256_pubkey, setup_ssh, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_auth_ssh_ec384_pubkey, setup_ssh, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_auth_ssh_ec521_pubkey, setup_ssh, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_auth_ssh_ed25519_pubkey, setup_ssh, ln2_glob_test_teardown),
-        cmocka_unit_test_setup_teardown(test_nc_auth_ssh_banner, setup_ssh, ln2_glob_test_teardown)
+        cmocka_unit_test_setup_teardown(test_nc_auth_ssh_banner, setup_ssh, ln2_glob_test_teardown),
+        cmocka_unit_test(test_nc_server_ssh_wait_fd)
     };
 
     /* try to get ports from the environment, otherwise use the default */
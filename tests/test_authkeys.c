@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <cmocka.h>
 
@@ -213,6 +214,87 @@ test_nc_authkey_bad_path(void **arg)
     }
 }
 
+static void
+test_authkey_write_file(const char *path, const char *pubkey_path)
+{
+    FILE *in, *out;
+    char buf[1024];
+    size_t len;
+
+    /* copy the public key as the only line of the authorized keys file */
+    in = fopen(pubkey_path, "r");
+    assert_non_null(in);
+    out = fopen(path, "w");
+    assert_non_null(out);
+
+    while ((len = fread(buf, 1, sizeof buf, in))) {
+        assert_int_equal(fwrite(buf, 1, len, out), len);
+    }
+    fputc('\n', out);
+
+    fclose(in);
+    fclose(out);
+}
+
+static void
+test_authkey_connect(void **arg)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    /* client */
+    ret = pthread_create(&tids[0], NULL, client_thread, *arg);
+    assert_int_equal(ret, 0);
+
+    /* server */
+    ret = pthread_create(&tids[1], NULL, server_thread, *arg);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    /* the client adds its key pair on every connect */
+    while (nc_client_ssh_get_keypair_count()) {
+        nc_client_ssh_del_keypair(0);
+    }
+}
+
+static void
+test_nc_authkey_file_changed(void **arg)
+{
+    int ret;
+    const char *path = BUILD_DIR "/tests/authorized_keys_changed";
+    struct test_authkey_data *test_data;
+
+    test_data = (*(struct ln2_test_ctx **)arg)->test_data;
+
+    /* authorized keys file with only the ed25519 key */
+    test_authkey_write_file(path, TESTS_DIR "/data/id_ed25519.pub");
+    ret = nc_server_ssh_set_authkey_path_format(path);
+    assert_int_equal(ret, 0);
+
+    test_data->pubkey_path = TESTS_DIR "/data/id_ed25519.pub";
+    test_data->privkey_path = TESTS_DIR "/data/id_ed25519";
+    test_data->expect_ok = 1;
+    test_authkey_connect(arg);
+
+    /* the keys are cached now, replace the file and the old key must no longer work */
+    unlink(path);
+    test_authkey_write_file(path, TESTS_DIR "/data/id_ecdsa521.pub");
+
+    test_data->expect_ok = 0;
+    test_authkey_connect(arg);
+
+    /* the new key is read from the changed file */
+    test_data->pubkey_path = TESTS_DIR "/data/id_ecdsa521.pub";
+    test_data->privkey_path = TESTS_DIR "/data/id_ecdsa521";
+    test_data->expect_ok = 1;
+    test_authkey_connect(arg);
+
+    unlink(path);
+}
+
 static int
 setup_f(void **state)
 {
@@ -256,6 +338,7 @@ main(void)
         cmocka_unit_test_setup_teardown(test_nc_authkey_ok, setup_f, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_authkey_bad_key, setup_f, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_authkey_bad_path, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_authkey_file_changed, setup_f, ln2_glob_test_teardown),
     };
 
     /* try to get ports from the environment, otherwise use the default */
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <cmocka.h>
 
@@ -33,6 +34,16 @@
 int TEST_PORT = 10050;
 const char *TEST_PORT_STR = "10050";
 
+/* time in msec the monitoring callback must be called in after the server closes a session */
+#define TEST_MONITORING_BOUND 1000
+
+struct monitoring_state {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t closed_count;      /* number of the sessions reported as closed */
+    uint32_t last_id;           /* ID of the last session reported as closed */
+};
+
 void
 monitoring_clb(struct nc_session *sess, void *user_data)
 {
@@ -134,6 +145,156 @@ server_thread(void *arg)
     return NULL;
 }
 
+static void
+monitoring_bound_clb(struct nc_session *sess, void *user_data)
+{
+    struct monitoring_state *mstate = user_data;
+
+    pthread_mutex_lock(&mstate->lock);
+    ++mstate->closed_count;
+    mstate->last_id = nc_session_get_id(sess);
+    pthread_cond_signal(&mstate->cond);
+    pthread_mutex_unlock(&mstate->lock);
+
+    nc_session_free(sess, NULL);
+}
+
+/**
+ * @brief Wait until the monitoring callback reports a closed session within the bound.
+ *
+ * @param[in] mstate Monitoring state.
+ * @param[in] closed_count Number of the sessions to be reported as closed.
+ * @return ID of the last session reported as closed.
+ */
+static uint32_t
+monitoring_wait_closed(struct monitoring_state *mstate, uint32_t closed_count)
+{
+    struct timespec ts;
+    uint32_t id;
+    int r = 0;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += TEST_MONITORING_BOUND / 1000;
+    ts.tv_nsec += (TEST_MONITORING_BOUND % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ++ts.tv_sec;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&mstate->lock);
+    while (!r && (mstate->closed_count < closed_count)) {
+        r = pthread_cond_timedwait(&mstate->cond, &mstate->lock, &ts);
+    }
+    assert_int_equal(mstate->closed_count, closed_count);
+    id = mstate->last_id;
+    pthread_mutex_unlock(&mstate->lock);
+
+    return id;
+}
+
+static void *
+client_thread_bound(void *arg)
+{
+    int ret;
+    uint32_t id[2];
+    struct nc_session *session[2];
+    struct ln2_test_ctx *test_ctx = arg;
+    struct monitoring_state mstate = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
+    ret = nc_client_monitoring_thread_start(monitoring_bound_clb, &mstate, NULL);
+    assert_int_equal(ret, 0);
+
+    nc_client_ssh_set_knownhosts_mode(NC_SSH_KNOWNHOSTS_SKIP);
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+    ret = nc_client_ssh_set_username("test_client_monitoring");
+    assert_int_equal(ret, 0);
+    ret = nc_client_ssh_add_keypair(TESTS_DIR "/data/key_rsa.pub", TESTS_DIR "/data/key_rsa");
+    assert_int_equal(ret, 0);
+
+    /* both sessions are added while the monitoring thread is already waiting */
+    pthread_barrier_wait(&test_ctx->barrier);
+    session[0] = nc_connect_ssh("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session[0]);
+    id[0] = nc_session_get_id(session[0]);
+    session[1] = nc_connect_ssh("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session[1]);
+    id[1] = nc_session_get_id(session[1]);
+
+    /* the server closes the second session, only it is reported */
+    pthread_barrier_wait(&test_ctx->barrier);
+    pthread_barrier_wait(&test_ctx->barrier);
+    assert_int_equal(monitoring_wait_closed(&mstate, 1), id[1]);
+
+    /* the server closes the first session too */
+    pthread_barrier_wait(&test_ctx->barrier);
+    pthread_barrier_wait(&test_ctx->barrier);
+    assert_int_equal(monitoring_wait_closed(&mstate, 2), id[0]);
+
+    nc_client_monitoring_thread_stop();
+    pthread_cond_destroy(&mstate.cond);
+    pthread_mutex_destroy(&mstate.lock);
+    return NULL;
+}
+
+/**
+ * @brief Accept an SSH session whose socket is reset once closed.
+ *
+ * @param[in] test_ctx Test context.
+ * @return Accepted session.
+ */
+static struct nc_session *
+server_accept_linger(struct ln2_test_ctx *test_ctx)
+{
+    struct nc_session *session = NULL;
+    struct linger ling = {1, 0};
+    int fd;
+
+    assert_int_equal(nc_accept(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session), NC_MSG_HELLO);
+    fd = ssh_get_fd(session->ti.libssh.session);
+    assert_int_not_equal(fd, -1);
+    assert_int_equal(setsockopt(fd, SOL_SOCKET, SO_LINGER, &ling, sizeof ling), 0);
+
+    return session;
+}
+
+static void *
+server_thread_bound(void *arg)
+{
+    struct nc_session *session[2];
+    struct ln2_test_ctx *test_ctx = arg;
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    session[0] = server_accept_linger(test_ctx);
+    session[1] = server_accept_linger(test_ctx);
+
+    /* close the sessions one by one once the client is ready to measure */
+    pthread_barrier_wait(&test_ctx->barrier);
+    nc_session_free(session[1], NULL);
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    nc_session_free(session[0], NULL);
+    pthread_barrier_wait(&test_ctx->barrier);
+    return NULL;
+}
+
+static void
+test_nc_client_monitoring_bound(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    ret = pthread_create(&tids[0], NULL, client_thread_bound, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_bound, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
 static void
 test_nc_client_monitoring(void **state)
 {
@@ -188,7 +349,8 @@ int
 main(void)
 {
     const struct CMUnitTest tests[] = {
-        cmocka_unit_test_setup_teardown(test_nc_client_monitoring, setup, ln2_glob_test_teardown)
+        cmocka_unit_test_setup_teardown(test_nc_client_monitoring, setup, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_client_monitoring_bound, setup, ln2_glob_test_teardown)
     };
 
     /* try to get ports from the environment, otherwise use the default */
@@ -0,0 +1,318 @@
+/**
+ * @file test_connect_batch.c
+ * @brief libnetconf2 parallel client connections test
+ *
+ * @copyright
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+
+#include "ln2_test.h"
+
+#define TEST_SOCKET_PATH "/tmp/nc2_test_connect_batch_sock"
+#define TEST_SESSION_COUNT 8
+#define BACKOFF_TIMEOUT_USECS 100
+
+int TEST_PORT = 10050;
+const char *TEST_PORT_STR = "10050";
+
+struct batch_result {
+    pthread_mutex_t lock;
+    int connected;
+    int failed;
+};
+
+static void *
+server_thread(void *arg)
+{
+    int ret, del_session_count = 0, sleep_count = 0;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session, *new_session;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    while (del_session_count < TEST_SESSION_COUNT) {
+        msgtype = nc_accept(0, test_ctx->ctx, &new_session);
+        if (msgtype == NC_MSG_HELLO) {
+            ret = nc_ps_add_session(ps, new_session);
+            assert_int_equal(ret, 0);
+        }
+
+        ret = nc_ps_poll(ps, 0, &session);
+        if (ret & NC_PSPOLL_SESSION_TERM) {
+            nc_ps_del_session(ps, session);
+            nc_session_free(session, NULL);
+            del_session_count++;
+        } else if ((msgtype != NC_MSG_HELLO) && (ret & (NC_PSPOLL_TIMEOUT | NC_PSPOLL_NOSESSIONS))) {
+            usleep(BACKOFF_TIMEOUT_USECS);
+            sleep_count++;
+            assert_int_not_equal(sleep_count, 50000);
+        }
+    }
+
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void
+connect_clb(const struct nc_connect_target *target, struct nc_session *session, void *user_data)
+{
+    struct batch_result *result = user_data;
+
+    /* LOCK */
+    pthread_mutex_lock(&result->lock);
+    if (session) {
+        assert_string_equal(target->host, TEST_SOCKET_PATH);
+        assert_int_equal(nc_session_get_status(session), NC_STATUS_RUNNING);
+        ++result->connected;
+    } else {
+        assert_string_not_equal(target->host, TEST_SOCKET_PATH);
+        ++result->failed;
+    }
+    /* UNLOCK */
+    pthread_mutex_unlock(&result->lock);
+
+    /* the server counts the terminated sessions */
+    nc_session_free(session, NULL);
+}
+
+static void *
+client_thread(void *arg)
+{
+    int ret, i;
+    struct nc_connect_target targets[TEST_SESSION_COUNT + 1] = {0};
+    struct nc_connect_batch *batch;
+    struct batch_result result = {0};
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < TEST_SESSION_COUNT; ++i) {
+        targets[i].ti = NC_TI_UNIX;
+        targets[i].host = TEST_SOCKET_PATH;
+    }
+
+    /* a target nobody listens on */
+    targets[i].ti = NC_TI_UNIX;
+    targets[i].host = "/tmp/nc2_test_connect_batch_none";
+
+    pthread_mutex_init(&result.lock, NULL);
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    batch = nc_connect_batch_start(targets, TEST_SESSION_COUNT + 1, 3, connect_clb, &result);
+    assert_non_null(batch);
+
+    ret = nc_connect_batch_wait(batch);
+    assert_int_equal(ret, 1);
+    assert_int_equal(result.connected, TEST_SESSION_COUNT);
+    assert_int_equal(result.failed, 1);
+
+    pthread_mutex_destroy(&result.lock);
+    return NULL;
+}
+
+static void
+test_nc_connect_batch(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+#ifdef NC_ENABLED_SSH_TLS
+
+static void
+connect_ssh_clb(const struct nc_connect_target *target, struct nc_session *session, void *user_data)
+{
+    struct batch_result *result = user_data;
+
+    assert_int_equal(target->ti, NC_TI_SSH);
+    assert_non_null(session);
+    assert_int_equal(nc_session_get_ti(session), NC_TI_SSH);
+    assert_string_equal(nc_session_get_username(session), "client_1");
+
+    /* LOCK */
+    pthread_mutex_lock(&result->lock);
+    ++result->connected;
+    /* UNLOCK */
+    pthread_mutex_unlock(&result->lock);
+
+    nc_session_free(session, NULL);
+}
+
+static void *
+client_thread_ssh(void *arg)
+{
+    int ret, i;
+    struct nc_connect_target targets[TEST_SESSION_COUNT] = {0};
+    struct nc_connect_batch *batch;
+    struct batch_result result = {0};
+    struct ln2_test_ctx *test_ctx = arg;
+
+    /* the workers use the settings of this thread */
+    nc_client_ssh_set_knownhosts_mode(NC_SSH_KNOWNHOSTS_SKIP);
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_ssh_add_keypair(TESTS_DIR "/data/id_ed25519.pub", TESTS_DIR "/data/id_ed25519");
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_ssh_set_username("client_1");
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < TEST_SESSION_COUNT; ++i) {
+        targets[i].ti = NC_TI_SSH;
+        targets[i].host = "127.0.0.1";
+        targets[i].port = TEST_PORT;
+    }
+
+    pthread_mutex_init(&result.lock, NULL);
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    /* the default number of workers */
+    batch = nc_connect_batch_start(targets, TEST_SESSION_COUNT, 0, connect_ssh_clb, &result);
+    assert_non_null(batch);
+
+    ret = nc_connect_batch_wait(batch);
+    assert_int_equal(ret, 0);
+    assert_int_equal(result.connected, TEST_SESSION_COUNT);
+
+    pthread_mutex_destroy(&result.lock);
+    return NULL;
+}
+
+static void
+test_nc_connect_batch_ssh(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_ssh, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+#endif /* NC_ENABLED_SSH_TLS */
+
+static void
+test_nc_connect_batch_invalid(void **state)
+{
+    struct nc_connect_target target = {0};
+
+    (void)state;
+
+    target.ti = NC_TI_UNIX;
+    assert_null(nc_connect_batch_start(&target, 1, 1, connect_clb, NULL));
+    assert_null(nc_connect_batch_start(NULL, 1, 1, connect_clb, NULL));
+    assert_int_equal(nc_connect_batch_wait(NULL), 0);
+}
+
+static int
+setup_f(void **state)
+{
+    int ret;
+    struct ln2_test_ctx *test_ctx;
+
+    ret = ln2_glob_test_setup(&test_ctx);
+    assert_int_equal(ret, 0);
+
+    *state = test_ctx;
+
+    ret = nc_server_add_endpt_unix_socket_listen("unix", TEST_SOCKET_PATH, 0700, -1, -1);
+    assert_int_equal(ret, 0);
+
+    return 0;
+}
+
+#ifdef NC_ENABLED_SSH_TLS
+
+static int
+setup_ssh_f(void **state)
+{
+    int ret;
+    struct lyd_node *tree = NULL;
+    struct ln2_test_ctx *test_ctx;
+
+    ret = ln2_glob_test_setup(&test_ctx);
+    assert_int_equal(ret, 0);
+
+    *state = test_ctx;
+
+    ret = nc_server_config_add_address_port(test_ctx->ctx, "endpt", NC_TI_SSH, "127.0.0.1", TEST_PORT, &tree);
+    assert_int_equal(ret, 0);
+
+    ret = nc_server_config_add_ssh_hostkey(test_ctx->ctx, "endpt", "hostkey", TESTS_DIR "/data/key_ecdsa", NULL, &tree);
+    assert_int_equal(ret, 0);
+
+    ret = nc_server_config_add_ssh_user_pubkey(test_ctx->ctx, "endpt", "client_1", "pubkey", TESTS_DIR "/data/id_ed25519.pub", &tree);
+    assert_int_equal(ret, 0);
+
+    ret = nc_server_config_setup_data(tree);
+    assert_int_equal(ret, 0);
+
+    lyd_free_all(tree);
+
+    return 0;
+}
+
+#endif /* NC_ENABLED_SSH_TLS */
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_nc_connect_batch, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_connect_batch_invalid, setup_f, ln2_glob_test_teardown),
+#ifdef NC_ENABLED_SSH_TLS
+        cmocka_unit_test_setup_teardown(test_nc_connect_batch_ssh, setup_ssh_f, ln2_glob_test_teardown),
+#endif /* NC_ENABLED_SSH_TLS */
+    };
+
+    /* try to get ports from the environment, otherwise use the default */
+    if (ln2_glob_test_get_ports(1, &TEST_PORT, &TEST_PORT_STR)) {
+        return 1;
+    }
+
+    setenv("CMOCKA_TEST_ABORT", "1", 1);
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,487 @@
+/**
+ * @file test_crl_cache.c
+ * @brief libnetconf2 CRL cache test
+ *
+ * @copyright
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+
+#include "ln2_test.h"
+#include "session_p.h"
+#include "session_wrapper.h"
+
+#define CRL_PATH BUILD_DIR "/tests/crl_cache.pem"
+#define CRL_URI "file://" CRL_PATH
+
+/* HTTP server serving CRLs with caching headers */
+struct test_http_path {
+    const char *path;           /* path of the CRL */
+    int status;                 /* status to respond with unless the ETag matches */
+    const char *etag;           /* ETag of the CRL */
+    const char *cache_control;  /* Cache-Control header value */
+    int requests;               /* number of requests received */
+    char if_none_match[64];     /* If-None-Match header of the last request */
+};
+
+struct test_http_state {
+    int sock;
+    uint16_t port;
+    pthread_t tid;
+    int stop;
+    char *crl;
+    size_t crl_len;
+    struct test_http_path paths[2];
+    pthread_mutex_t lock;
+};
+
+static void
+test_http_respond(struct test_http_state *st, int sock)
+{
+    char req[2048], uri[64], resp[512], *ptr, *end;
+    size_t len = 0;
+    ssize_t r;
+    int i, status, not_modified = 0;
+    struct test_http_path *p = NULL;
+
+    /* read the whole request */
+    while (len < sizeof req - 1) {
+        r = recv(sock, req + len, sizeof req - 1 - len, 0);
+        if (r <= 0) {
+            return;
+        }
+        len += r;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n")) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&st->lock);
+
+    for (i = 0; i < 2; i++) {
+        if (st->paths[i].path && (sscanf(req, "GET %63s", uri) == 1) && !strcmp(uri, st->paths[i].path)) {
+            p = &st->paths[i];
+        }
+    }
+
+    if (!p) {
+        pthread_mutex_unlock(&st->lock);
+        len = sprintf(resp, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send(sock, resp, len, 0);
+        return;
+    }
+
+    ++p->requests;
+    p->if_none_match[0] = '\0';
+    if ((ptr = strcasestr(req, "If-None-Match: "))) {
+        ptr += 15;
+        end = strstr(ptr, "\r\n");
+        snprintf(p->if_none_match, sizeof p->if_none_match, "%.*s", (int)(end - ptr), ptr);
+        not_modified = !strcmp(p->if_none_match, p->etag);
+    }
+    status = p->status;
+
+    if (status != 200) {
+        len = sprintf(resp, "HTTP/1.1 %d Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    } else if (not_modified) {
+        len = sprintf(resp, "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nCache-Control: %s\r\nConnection: close\r\n\r\n",
+                p->etag, p->cache_control);
+    } else {
+        len = sprintf(resp, "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\nETag: %s\r\nCache-Control: %s\r\n"
+                "Connection: close\r\n\r\n", st->crl_len, p->etag, p->cache_control);
+    }
+
+    pthread_mutex_unlock(&st->lock);
+
+    send(sock, resp, len, 0);
+    if ((status == 200) && !not_modified) {
+        send(sock, st->crl, st->crl_len, 0);
+    }
+}
+
+static void *
+test_http_thread(void *arg)
+{
+    struct test_http_state *st = arg;
+    struct pollfd pfd = {.fd = st->sock, .events = POLLIN};
+    int sock, stop = 0;
+
+    while (!stop) {
+        if (poll(&pfd, 1, 50) == 1) {
+            sock = accept(st->sock, NULL, NULL);
+            if (sock > -1) {
+                test_http_respond(st, sock);
+                close(sock);
+            }
+        }
+
+        pthread_mutex_lock(&st->lock);
+        stop = st->stop;
+        pthread_mutex_unlock(&st->lock);
+    }
+
+    return NULL;
+}
+
+static int
+setup_http(void **state)
+{
+    struct test_http_state *st;
+    struct sockaddr_in addr = {0};
+    socklen_t addr_len = sizeof addr;
+    FILE *f;
+    long size;
+
+    st = calloc(1, sizeof *st);
+    assert_non_null(st);
+    pthread_mutex_init(&st->lock, NULL);
+
+    /* the served CRL */
+    f = fopen(TESTS_DIR "/data/crl.pem", "r");
+    assert_non_null(f);
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    st->crl = malloc(size);
+    assert_non_null(st->crl);
+    assert_int_equal(fread(st->crl, 1, size, f), size);
+    st->crl_len = size;
+    fclose(f);
+
+    /* listen on any free local port */
+    st->sock = socket(AF_INET, SOCK_STREAM, 0);
+    assert_int_not_equal(st->sock, -1);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(st->sock, (struct sockaddr *)&addr, sizeof addr), 0);
+    assert_int_equal(listen(st->sock, 8), 0);
+    assert_int_equal(getsockname(st->sock, (struct sockaddr *)&addr, &addr_len), 0);
+    st->port = ntohs(addr.sin_port);
+
+    st->paths[0] = (struct test_http_path) {"/a.crl", 200, "\"a1\"", "max-age=600", 0, ""};
+    st->paths[1] = (struct test_http_path) {"/b.crl", 200, "\"b1\"", "no-cache", 0, ""};
+
+    assert_int_equal(pthread_create(&st->tid, NULL, test_http_thread, st), 0);
+
+    *state = st;
+    return 0;
+}
+
+static int
+teardown_http(void **state)
+{
+    struct test_http_state *st = *state;
+
+    /* stop the refresh thread before the server */
+    nc_session_tls_crl_cache_destroy();
+
+    pthread_mutex_lock(&st->lock);
+    st->stop = 1;
+    pthread_mutex_unlock(&st->lock);
+    pthread_join(st->tid, NULL);
+
+    close(st->sock);
+    pthread_mutex_destroy(&st->lock);
+    free(st->crl);
+    free(st);
+    return 0;
+}
+
+static void
+test_http_uri(struct test_http_state *st, int idx, char *uri, size_t size)
+{
+    snprintf(uri, size, "http://127.0.0.1:%u%s", st->port, st->paths[idx].path);
+}
+
+static int
+test_http_requests(struct test_http_state *st, int idx)
+{
+    int requests;
+
+    pthread_mutex_lock(&st->lock);
+    requests = st->paths[idx].requests;
+    pthread_mutex_unlock(&st->lock);
+
+    return requests;
+}
+
+static void
+test_http_wait_requests(struct test_http_state *st, int idx, int requests)
+{
+    int i;
+
+    /* the refresh thread downloads the CRL asynchronously */
+    for (i = 0; (i < 500) && (test_http_requests(st, idx) < requests); i++) {
+        usleep(10000);
+    }
+    assert_int_equal(test_http_requests(st, idx), requests);
+
+    /* let the refresh thread store the result, it holds the cache lock while doing so */
+    usleep(50000);
+}
+
+static void
+test_crl_write_file(const char *src_path)
+{
+    FILE *src, *dst;
+    char buf[256];
+    size_t len;
+
+    dst = fopen(CRL_PATH, "w");
+    assert_non_null(dst);
+
+    if (src_path) {
+        src = fopen(src_path, "r");
+        assert_non_null(src);
+        while ((len = fread(buf, 1, sizeof buf, src))) {
+            assert_int_equal(fwrite(buf, 1, len, dst), len);
+        }
+        fclose(src);
+    } else {
+        /* not a CRL */
+        fputs("garbage\n", dst);
+    }
+
+    fclose(dst);
+}
+
+static void
+test_nc_crl_cache_hit(void **UNUSED(state))
+{
+    int ret;
+    uint32_t gen;
+    void *crl_store;
+
+    test_crl_write_file(TESTS_DIR "/data/crl.pem");
+
+    /* first use downloads the CRL and changes the cache */
+    gen = nc_session_tls_crl_cache_generation();
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    ret = nc_session_tls_crl_cache_get(CRL_URI, 0, crl_store, NULL);
+    assert_int_equal(ret, 0);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+    assert_int_not_equal(nc_session_tls_crl_cache_generation(), gen);
+    gen = nc_session_tls_crl_cache_generation();
+
+    /* break the file, the CRL is served from the cache without downloading it again */
+    test_crl_write_file(NULL);
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    ret = nc_session_tls_crl_cache_get(CRL_URI, 0, crl_store, NULL);
+    assert_int_equal(ret, 0);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+    assert_int_equal(nc_session_tls_crl_cache_generation(), gen);
+
+    /* without the cache, the broken file is downloaded and rejected */
+    nc_session_tls_crl_cache_destroy();
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    ret = nc_session_tls_crl_cache_get(CRL_URI, 0, crl_store, NULL);
+    assert_int_equal(ret, 1);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+}
+
+static void
+test_nc_crl_cache_missing(void **UNUSED(state))
+{
+    int ret;
+    uint32_t gen;
+    void *crl_store;
+
+    unlink(CRL_PATH);
+
+    /* failed download is not cached */
+    gen = nc_session_tls_crl_cache_generation();
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    ret = nc_session_tls_crl_cache_get(CRL_URI, 0, crl_store, NULL);
+    assert_int_equal(ret, 1);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+    assert_int_equal(nc_session_tls_crl_cache_generation(), gen);
+}
+
+static void
+test_nc_crl_cache_cached_only(void **UNUSED(state))
+{
+    void *crl_store;
+
+    test_crl_write_file(TESTS_DIR "/data/crl.pem");
+
+    /* not cached, not downloaded */
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    assert_int_equal(nc_session_tls_crl_cache_get(CRL_URI, 1, crl_store, NULL), 2);
+
+    /* only downloaded into the cache */
+    assert_int_equal(nc_session_tls_crl_cache_get(CRL_URI, 0, NULL, NULL), 0);
+
+    /* cached now */
+    assert_int_equal(nc_session_tls_crl_cache_get(CRL_URI, 1, crl_store, NULL), 0);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+}
+
+static void
+test_nc_crl_cache_http_etag(void **state)
+{
+    struct test_http_state *st = *state;
+    struct nc_crl_cache_ref ref = {0};
+    char uri[128];
+    void *crl_store;
+    time_t now;
+
+    test_http_uri(st, 0, uri, sizeof uri);
+    ref.uri = uri;
+
+    /* first download, unconditional */
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    assert_int_equal(nc_session_tls_crl_cache_get(uri, 0, crl_store, &ref.generation), 0);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+    assert_int_not_equal(ref.generation, 0);
+    assert_int_equal(test_http_requests(st, 0), 1);
+    assert_string_equal(st->paths[0].if_none_match, "");
+
+    /* Cache-Control max-age comes before the CRL nextUpdate */
+    now = time(NULL);
+    assert_in_range(nc_session_tls_crl_cache_refresh_time(uri), now + 590, now + 600);
+
+    /* the refresh thread asks conditionally and the CRL is not modified */
+    assert_int_equal(nc_session_tls_crl_cache_expire(uri), 0);
+    test_http_wait_requests(st, 0, 2);
+    assert_string_equal(st->paths[0].if_none_match, "\"a1\"");
+    assert_int_equal(nc_session_tls_crl_cache_changed(&ref, 1), 0);
+    now = time(NULL);
+    assert_in_range(nc_session_tls_crl_cache_refresh_time(uri), now + 590, now + 600);
+
+    /* a new ETag means a new CRL */
+    pthread_mutex_lock(&st->lock);
+    st->paths[0].etag = "\"a2\"";
+    pthread_mutex_unlock(&st->lock);
+    assert_int_equal(nc_session_tls_crl_cache_expire(uri), 0);
+    test_http_wait_requests(st, 0, 3);
+    assert_string_equal(st->paths[0].if_none_match, "\"a1\"");
+    assert_int_equal(nc_session_tls_crl_cache_changed(&ref, 1), 1);
+
+    /* and its ETag is used next time */
+    assert_int_equal(nc_session_tls_crl_cache_expire(uri), 0);
+    test_http_wait_requests(st, 0, 4);
+    assert_string_equal(st->paths[0].if_none_match, "\"a2\"");
+}
+
+static void
+test_nc_crl_cache_http_no_cache(void **state)
+{
+    struct test_http_state *st = *state;
+    char uri[128];
+    void *crl_store;
+    time_t now;
+
+    test_http_uri(st, 1, uri, sizeof uri);
+
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    assert_int_equal(nc_session_tls_crl_cache_get(uri, 0, crl_store, NULL), 0);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+
+    /* no-cache is limited by the minimal refresh period */
+    now = time(NULL);
+    assert_in_range(nc_session_tls_crl_cache_refresh_time(uri), now + NC_CRL_CACHE_REFRESH_MIN - 5,
+            now + NC_CRL_CACHE_REFRESH_MIN);
+}
+
+static void
+test_nc_crl_cache_refresh_scoped(void **state)
+{
+    struct test_http_state *st = *state;
+    struct nc_crl_cache_ref ref_a = {0}, ref_b = {0};
+    char uri_a[128], uri_b[128];
+    void *crl_store;
+    time_t now;
+
+    test_http_uri(st, 0, uri_a, sizeof uri_a);
+    test_http_uri(st, 1, uri_b, sizeof uri_b);
+    ref_a.uri = uri_a;
+    ref_b.uri = uri_b;
+
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    assert_int_equal(nc_session_tls_crl_cache_get(uri_a, 0, crl_store, &ref_a.generation), 0);
+    assert_int_equal(nc_session_tls_crl_cache_get(uri_b, 0, crl_store, &ref_b.generation), 0);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+
+    /* refreshing one CRL does not affect contexts using only the other one */
+    pthread_mutex_lock(&st->lock);
+    st->paths[0].etag = "\"a2\"";
+    pthread_mutex_unlock(&st->lock);
+    assert_int_equal(nc_session_tls_crl_cache_expire(uri_a), 0);
+    test_http_wait_requests(st, 0, 2);
+    assert_int_equal(nc_session_tls_crl_cache_changed(&ref_a, 1), 1);
+    assert_int_equal(nc_session_tls_crl_cache_changed(&ref_b, 1), 0);
+
+    /* failed refresh keeps the previous CRL and retries later */
+    pthread_mutex_lock(&st->lock);
+    st->paths[1].status = 500;
+    pthread_mutex_unlock(&st->lock);
+    assert_int_equal(nc_session_tls_crl_cache_expire(uri_b), 0);
+    test_http_wait_requests(st, 1, 2);
+    assert_int_equal(nc_session_tls_crl_cache_changed(&ref_b, 1), 0);
+    now = time(NULL);
+    assert_in_range(nc_session_tls_crl_cache_refresh_time(uri_b), now + NC_CRL_CACHE_REFRESH_MIN - 5,
+            now + NC_CRL_CACHE_REFRESH_MIN);
+
+    crl_store = nc_tls_crl_store_new_wrap();
+    assert_non_null(crl_store);
+    assert_int_equal(nc_session_tls_crl_cache_get(uri_b, 0, crl_store, NULL), 0);
+    nc_tls_crl_store_destroy_wrap(crl_store);
+    assert_int_equal(test_http_requests(st, 1), 2);
+
+    /* CRLs dropped from the cache are changed as well */
+    nc_session_tls_crl_cache_destroy();
+    assert_int_equal(nc_session_tls_crl_cache_changed(&ref_b, 1), 1);
+}
+
+static int
+teardown_f(void **UNUSED(state))
+{
+    nc_session_tls_crl_cache_destroy();
+    unlink(CRL_PATH);
+    return 0;
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_teardown(test_nc_crl_cache_hit, teardown_f),
+        cmocka_unit_test_teardown(test_nc_crl_cache_missing, teardown_f),
+        cmocka_unit_test_teardown(test_nc_crl_cache_cached_only, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_crl_cache_http_etag, setup_http, teardown_http),
+        cmocka_unit_test_setup_teardown(test_nc_crl_cache_http_no_cache, setup_http, teardown_http),
+        cmocka_unit_test_setup_teardown(test_nc_crl_cache_refresh_scoped, setup_http, teardown_http),
+    };
+
+    nc_verbosity(NC_VERB_VERBOSE);
+    setenv("CMOCKA_TEST_ABORT", "1", 1);
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
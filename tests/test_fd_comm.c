@@ -16,11 +16,13 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -66,6 +68,23 @@ my_getconfig_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
     return nc_server_reply_data(data, NC_WD_EXPLICIT, NC_PARAMTYPE_FREE);
 }
 
+struct nc_server_reply *
+my_getconfig_nacm_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    struct lyd_node *data;
+
+    assert_string_equal(rpc->schema->name, "get-config");
+    assert_ptr_equal(session, server_session);
+
+    lyd_new_path(NULL, session->ctx, "/ietf-netconf:get-config/data", NULL, LYD_NEW_VAL_OUTPUT, &data);
+    assert_non_null(data);
+    lyd_new_path(data, NULL, "/ietf-netconf-acm:nacm/rule-list[name='a']/group", "*", LYD_NEW_VAL_OUTPUT, NULL);
+    lyd_new_path(data, NULL, "/ietf-netconf-acm:nacm/rule-list[name='b']/group", "*", LYD_NEW_VAL_OUTPUT, NULL);
+    lyd_new_path(data, NULL, "/ietf-netconf-acm:nacm/rule-list[name='c']/group", "*", LYD_NEW_VAL_OUTPUT, NULL);
+
+    return nc_server_reply_data(data, NC_WD_EXPLICIT, NC_PARAMTYPE_FREE);
+}
+
 struct nc_server_reply *
 my_commit_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
 {
@@ -232,6 +251,379 @@ test_send_recv_ok_11(void **state)
     test_send_recv_ok();
 }
 
+static void
+test_send_recv_prepared(void **state)
+{
+    int ret, i;
+    uint64_t msgid, prev_msgid = 0;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_rpc_prepared *prep;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    /* client RPC, printed once */
+    rpc = nc_rpc_get("<modules-state xmlns=\"urn:ietf:params:xml:ns:yang:ietf-yang-library\"/>", 0, 0);
+    assert_non_null(rpc);
+    prep = nc_rpc_prepare(client_session, rpc);
+    assert_non_null(prep);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    for (i = 0; i < 3; ++i) {
+        msgtype = nc_send_rpc_prepared(client_session, prep, 0, &msgid);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+        if (i) {
+            assert_int_equal(msgid, prev_msgid + 1);
+        }
+        prev_msgid = msgid;
+
+        /* server RPC, send reply */
+        ret = nc_ps_poll(ps, 0, NULL);
+        assert_int_equal(ret, NC_PSPOLL_RPC);
+
+        /* client reply */
+        msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_null(op);
+        assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+        lyd_free_tree(envp);
+    }
+
+    nc_ps_free(ps);
+    nc_rpc_prepared_free(prep);
+    nc_rpc_free(rpc);
+}
+
+static void
+send_recv_get(struct lyd_node **envp, struct lyd_node **op)
+{
+    int ret;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct nc_pollsession *ps;
+
+    /* client RPC */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* server RPC, send reply */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    nc_ps_free(ps);
+
+    /* client reply */
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, envp, op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+}
+
+static void
+opaq_notif_clb(struct nc_session *session, const struct lyd_node *envp, const struct lyd_node *op, void *user_data)
+{
+    (void)user_data;
+
+    assert_ptr_equal(session, client_session);
+    assert_null(envp->schema);
+    assert_null(op->schema);
+    assert_string_equal(LYD_NAME(op), "notificationComplete");
+
+    pthread_mutex_lock(&state_lock);
+    ++glob_state;
+    pthread_mutex_unlock(&state_lock);
+}
+
+static void
+test_send_recv_opaq(void **state)
+{
+    int ret, i;
+    uint64_t saved_usec;
+    NC_MSG_TYPE msgtype;
+    struct lyd_node *envp, *op, *notif_tree;
+    struct nc_client_parse_stats stats;
+    struct nc_notif_dispatcher *disp;
+    struct nc_server_notif *notif;
+    struct timespec ts;
+    char *buf;
+
+    (void)state;
+
+    ret = nc_client_session_set_parse_mode(client_session, NC_CLIENT_PARSE_OPAQ);
+    assert_int_equal(ret, 0);
+
+    /* client reply, all opaque in the envelopes */
+    send_recv_get(&envp, &op);
+    assert_null(op);
+    assert_null(envp->schema);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+    assert_null(lyd_child(envp)->schema);
+    lyd_free_tree(envp);
+
+    ret = nc_client_session_get_parse_stats(client_session, &stats);
+    assert_int_equal(ret, 0);
+    assert_int_equal(stats.schema_count, 0);
+    assert_int_equal(stats.opaq_count, 1);
+    assert_true(stats.opaq_bytes > 0);
+
+    /* nothing to estimate the saved time from */
+    assert_int_equal(stats.saved_usec, 0);
+
+    /* parse a reply using the session context */
+    ret = nc_client_session_set_parse_mode(client_session, NC_CLIENT_PARSE_SCHEMA);
+    assert_int_equal(ret, 0);
+
+    send_recv_get(&envp, &op);
+    assert_null(op);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+    lyd_free_tree(envp);
+
+    ret = nc_client_session_get_parse_stats(client_session, &stats);
+    assert_int_equal(ret, 0);
+    assert_int_equal(stats.schema_count, 1);
+    assert_true(stats.schema_bytes > 0);
+    assert_int_equal(stats.opaq_count, 1);
+
+    /* the opaque bytes parsed at the average rate of the session context minus the time actually spent */
+    saved_usec = 0;
+    if ((double)stats.schema_usec / stats.schema_bytes * stats.opaq_bytes > stats.opaq_usec) {
+        saved_usec = (double)stats.schema_usec / stats.schema_bytes * stats.opaq_bytes - stats.opaq_usec;
+    }
+    assert_int_equal(stats.saved_usec, saved_usec);
+
+    /* opaque <notificationComplete> stops the notifications being dispatched */
+    ret = nc_client_session_set_parse_mode(client_session, NC_CLIENT_PARSE_OPAQ);
+    assert_int_equal(ret, 0);
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    pthread_mutex_lock(&state_lock);
+    glob_state = 0;
+    pthread_mutex_unlock(&state_lock);
+
+    disp = nc_notif_dispatcher_new(1);
+    assert_non_null(disp);
+    assert_int_equal(nc_notif_dispatcher_add_session(disp, client_session, opaq_notif_clb, NULL, NULL), 0);
+
+    lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &notif_tree);
+    assert_non_null(notif_tree);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ly_time_ts2str(&ts, &buf);
+    notif = nc_server_notif_new(notif_tree, buf, NC_PARAMTYPE_FREE);
+    assert_non_null(notif);
+
+    nc_session_inc_notif_status(server_session);
+    msgtype = nc_server_notif_send(server_session, notif, 100);
+    nc_server_notif_free(notif);
+    assert_int_equal(msgtype, NC_MSG_NOTIF);
+
+    for (i = 0; i < 1000; ++i) {
+        pthread_mutex_lock(&state_lock);
+        if ((glob_state == 1) && !ATOMIC_LOAD_RELAXED(client_session->opts.client.ntf_thread_count)) {
+            pthread_mutex_unlock(&state_lock);
+            break;
+        }
+        pthread_mutex_unlock(&state_lock);
+        usleep(1000);
+    }
+    assert_int_equal(glob_state, 1);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(client_session->opts.client.ntf_thread_count), 0);
+
+    nc_notif_dispatcher_free(disp);
+
+    ret = nc_client_session_get_parse_stats(client_session, &stats);
+    assert_int_equal(ret, 0);
+    assert_int_equal(stats.opaq_count, 2);
+}
+
+static int
+stream_clb(struct nc_session *session, struct lyd_node *subtree, void *user_data)
+{
+    int *counts = user_data;
+    struct lyd_node *node;
+
+    assert_ptr_equal(session, client_session);
+    assert_string_equal(LYD_NAME(subtree), "nacm");
+    assert_non_null(subtree->schema);
+
+    /* parts and rule-lists */
+    ++counts[0];
+    LY_LIST_FOR(lyd_child(subtree), node) {
+        if (!strcmp(LYD_NAME(node), "rule-list")) {
+            ++counts[1];
+        }
+    }
+    return 0;
+}
+
+static void
+test_send_recv_stream(void **state)
+{
+    int ret, counts[2];
+    uint32_t batch;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp;
+    struct lysc_node *node;
+    struct nc_pollsession *ps;
+
+    (void)state;
+
+    node = (struct lysc_node *)lys_find_path(ctx, NULL, "/ietf-netconf:get-config", 0);
+    node->priv = my_getconfig_nacm_rpc_clb;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc);
+
+    for (batch = 0; batch < 3; batch += 2) {
+        /* client RPC */
+        msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+
+        /* server RPC, send reply */
+        ret = nc_ps_poll(ps, 0, NULL);
+        assert_int_equal(ret, NC_PSPOLL_RPC);
+
+        /* client reply, the whole nacm container or its children in batches */
+        memset(counts, 0, sizeof counts);
+        msgtype = nc_recv_reply_stream(client_session, rpc, msgid, 0, batch, stream_clb, counts, &envp);
+        assert_int_equal(msgtype, NC_MSG_REPLY);
+        assert_non_null(envp);
+        lyd_free_tree(envp);
+
+        if (!batch) {
+            assert_int_equal(counts[0], 1);
+        } else {
+            assert_true(counts[0] >= 2);
+        }
+        assert_int_equal(counts[1], 3);
+    }
+
+    /* reply without data */
+    node->priv = my_getconfig_rpc_clb;
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    memset(counts, 0, sizeof counts);
+    msgtype = nc_recv_reply_stream(client_session, rpc, msgid, 0, 2, stream_clb, counts, &envp);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_non_null(envp);
+    lyd_free_tree(envp);
+    assert_int_equal(counts[0], 0);
+
+    nc_ps_free(ps);
+    nc_rpc_free(rpc);
+}
+
+/**
+ * @brief Write a large rpc-reply with nacm rule-lists, in many chunks for NETCONF 1.1.
+ */
+static void
+write_stream_reply(int fd, uint64_t msgid, uint32_t rule_list_count, enum nc_version version)
+{
+    char *msg, *ptr, hdr[16];
+    size_t len, off, chunk;
+    uint32_t i;
+
+    msg = malloc(256 + rule_list_count * 64);
+    assert_non_null(msg);
+
+    ptr = msg + sprintf(msg, "<rpc-reply xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\" message-id=\"%" PRIu64 "\">"
+            "<data><nacm xmlns=\"urn:ietf:params:xml:ns:yang:ietf-netconf-acm\">", msgid);
+    for (i = 0; i < rule_list_count; ++i) {
+        ptr += sprintf(ptr, "<rule-list><name>rl%05" PRIu32 "</name><group>*</group></rule-list>", i);
+    }
+    ptr += sprintf(ptr, "</nacm></data></rpc-reply>");
+    len = ptr - msg;
+
+    if (version == NC_VERSION_10) {
+        assert_int_equal(write(fd, msg, len), len);
+        assert_int_equal(write(fd, "]]>]]>", 6), 6);
+    } else {
+        for (off = 0; off < len; off += chunk) {
+            chunk = (len - off < 1000) ? len - off : 1000;
+            sprintf(hdr, "\n#%zu\n", chunk);
+            assert_int_equal(write(fd, hdr, strlen(hdr)), strlen(hdr));
+            assert_int_equal(write(fd, msg + off, chunk), chunk);
+        }
+        assert_int_equal(write(fd, "\n##\n", 4), 4);
+    }
+
+    free(msg);
+}
+
+static void
+test_send_recv_stream_parts(void **state)
+{
+    int counts[2];
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp;
+
+    (void)state;
+
+    rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc);
+
+    /* the reply is read in several parts, the rule-lists passed in batches */
+    client_session->version = NC_VERSION_11;
+    write_stream_reply(server_session->ti.fd.out, 1, 500, NC_VERSION_11);
+
+    memset(counts, 0, sizeof counts);
+    msgtype = nc_recv_reply_stream(client_session, rpc, 1, 0, 50, stream_clb, counts, &envp);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_non_null(envp);
+    lyd_free_tree(envp);
+    assert_int_equal(counts[0], 10);
+    assert_int_equal(counts[1], 500);
+
+    /* end-of-message framing, the whole container at once */
+    client_session->version = NC_VERSION_10;
+    write_stream_reply(server_session->ti.fd.out, 2, 500, NC_VERSION_10);
+
+    memset(counts, 0, sizeof counts);
+    msgtype = nc_recv_reply_stream(client_session, rpc, 2, 0, 0, stream_clb, counts, &envp);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_non_null(envp);
+    lyd_free_tree(envp);
+    assert_int_equal(counts[0], 1);
+    assert_int_equal(counts[1], 500);
+
+    /* the session can still be used */
+    write_stream_reply(server_session->ti.fd.out, 3, 1, NC_VERSION_10);
+
+    memset(counts, 0, sizeof counts);
+    msgtype = nc_recv_reply_stream(client_session, rpc, 3, 0, 0, stream_clb, counts, &envp);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    lyd_free_tree(envp);
+    assert_int_equal(counts[1], 1);
+
+    nc_rpc_free(rpc);
+}
+
 static void
 test_send_recv_error(void)
 {
@@ -358,6 +750,172 @@ test_send_recv_data_11(void **state)
     test_send_recv_data();
 }
 
+static void
+async_reply_clb(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE type, const struct lyd_node *envp,
+        const struct lyd_node *op, void *user_data)
+{
+    uint64_t *msgids = user_data;
+
+    assert_ptr_equal(session, client_session);
+    assert_int_equal(type, NC_MSG_REPLY);
+    assert_non_null(envp);
+
+    /* replies are dispatched in the order they were received */
+    if (!msgids[0]) {
+        assert_null(op);
+        assert_string_equal(LYD_NAME(lyd_child(envp)), "ok");
+        msgids[0] = msgid;
+    } else {
+        assert_non_null(op);
+        msgids[1] = msgid;
+    }
+}
+
+static void
+test_send_recv_async(void)
+{
+    int ret, i;
+    uint64_t msgid[3], clb_msgid[2] = {0};
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc[3];
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+
+    /* client RPCs, all sent before any reply is received */
+    rpc[0] = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc[0]);
+    rpc[1] = nc_rpc_getconfig(NC_DATASTORE_RUNNING, NULL, 0, 0);
+    assert_non_null(rpc[1]);
+    rpc[2] = nc_rpc_kill(1);
+    assert_non_null(rpc[2]);
+
+    msgtype = nc_send_rpc_async(client_session, rpc[0], 0, async_reply_clb, clb_msgid, &msgid[0]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    msgtype = nc_send_rpc_async(client_session, rpc[1], 0, async_reply_clb, clb_msgid, &msgid[1]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    msgtype = nc_send_rpc_async(client_session, rpc[2], 0, NULL, NULL, &msgid[2]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* server RPCs, send replies */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    for (i = 0; i < 3; ++i) {
+        ret = nc_ps_poll(ps, 0, NULL);
+        assert_true(ret & NC_PSPOLL_RPC);
+    }
+
+    /* server finished */
+    nc_ps_free(ps);
+
+    /* client reply to the last RPC, the other replies are routed meanwhile */
+    msgtype = nc_recv_reply_async(client_session, msgid[2], 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_string_equal(LYD_NAME(lyd_child(envp)), "rpc-error");
+    assert_null(op);
+    lyd_free_tree(envp);
+
+    /* no such RPC anymore */
+    msgtype = nc_recv_reply_async(client_session, msgid[2], 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_ERROR);
+
+    /* client reply callbacks */
+    ret = nc_recv_reply_dispatch(client_session, 0);
+    assert_int_equal(ret, 2);
+    assert_int_equal(clb_msgid[0], msgid[0]);
+    assert_int_equal(clb_msgid[1], msgid[1]);
+
+    /* nothing else to dispatch */
+    ret = nc_recv_reply_dispatch(client_session, 0);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 3; ++i) {
+        nc_rpc_free(rpc[i]);
+    }
+}
+
+static void
+test_send_recv_async_10(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    test_send_recv_async();
+}
+
+static void
+test_send_recv_async_11(void **state)
+{
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    test_send_recv_async();
+}
+
+static void
+test_send_recv_async_discard(void **state)
+{
+    int ret, i;
+    uint64_t msgid[3];
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    /* 2 RPCs whose replies are no longer awaited and one synchronous */
+    for (i = 0; i < 2; ++i) {
+        msgtype = nc_send_rpc_async(client_session, rpc, 0, NULL, NULL, &msgid[i]);
+        assert_int_equal(msgtype, NC_MSG_RPC);
+    }
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid[2]);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    /* the first reply received before being discarded */
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_true(ret & NC_PSPOLL_RPC);
+    msgtype = nc_recv_reply_async(client_session, msgid[1], 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_WOULDBLOCK);
+    nc_client_rpc_pending_discard(client_session, msgid[0]);
+
+    /* the second reply received after */
+    nc_client_rpc_pending_discard(client_session, msgid[1]);
+    for (i = 0; i < 2; ++i) {
+        ret = nc_ps_poll(ps, 0, NULL);
+        assert_true(ret & NC_PSPOLL_RPC);
+    }
+    nc_ps_free(ps);
+
+    /* the discarded replies are dropped, not mistaken for the reply of the synchronous RPC */
+    msgtype = nc_recv_reply(client_session, rpc, msgid[2], 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+
+    for (i = 0; i < 2; ++i) {
+        msgtype = nc_recv_reply_async(client_session, msgid[i], 0, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_ERROR);
+    }
+
+    nc_rpc_free(rpc);
+}
+
 static void *
 server_send_notif_thread(void *arg)
 {
@@ -503,6 +1061,82 @@ test_send_recv_notif_11(void **state)
     test_send_recv_notif();
 }
 
+static void
+dispatcher_notif_clb(struct nc_session *session, const struct lyd_node *envp, const struct lyd_node *op, void *user_data)
+{
+    (void)envp;
+    (void)user_data;
+
+    assert_ptr_equal(session, client_session);
+    assert_string_equal(op->schema->name, "notificationComplete");
+
+    pthread_mutex_lock(&state_lock);
+    ++glob_state;
+    pthread_mutex_unlock(&state_lock);
+}
+
+static void
+dispatcher_free_data(void *user_data)
+{
+    *(int *)user_data = 1;
+}
+
+static void
+test_notif_dispatcher(void **state)
+{
+    int i, freed = 0;
+    NC_MSG_TYPE msg_type;
+    struct nc_notif_dispatcher *disp;
+    struct lyd_node *notif_tree;
+    struct nc_server_notif *notif;
+    struct timespec ts;
+    char *buf;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_11;
+    client_session->version = NC_VERSION_11;
+
+    pthread_mutex_lock(&state_lock);
+    glob_state = 0;
+    pthread_mutex_unlock(&state_lock);
+
+    /* callbacks called in a worker */
+    disp = nc_notif_dispatcher_new(1);
+    assert_non_null(disp);
+    assert_int_equal(nc_notif_dispatcher_add_session(disp, client_session, dispatcher_notif_clb, &freed,
+            dispatcher_free_data), 0);
+
+    /* server notification */
+    lyd_new_path(NULL, ctx, "/nc-notifications:notificationComplete", NULL, 0, &notif_tree);
+    assert_non_null(notif_tree);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ly_time_ts2str(&ts, &buf);
+    notif = nc_server_notif_new(notif_tree, buf, NC_PARAMTYPE_FREE);
+    assert_non_null(notif);
+
+    nc_session_inc_notif_status(server_session);
+    msg_type = nc_server_notif_send(server_session, notif, 100);
+    nc_server_notif_free(notif);
+    assert_int_equal(msg_type, NC_MSG_NOTIF);
+
+    /* wait for the callback and the session to stop being dispatched after <notificationComplete> */
+    for (i = 0; i < 1000; ++i) {
+        pthread_mutex_lock(&state_lock);
+        if ((glob_state == 1) && !ATOMIC_LOAD_RELAXED(client_session->opts.client.ntf_thread_count)) {
+            pthread_mutex_unlock(&state_lock);
+            break;
+        }
+        pthread_mutex_unlock(&state_lock);
+        usleep(1000);
+    }
+    assert_int_equal(glob_state, 1);
+    assert_int_equal(ATOMIC_LOAD_RELAXED(client_session->opts.client.ntf_thread_count), 0);
+    assert_int_equal(freed, 1);
+
+    nc_notif_dispatcher_free(disp);
+}
+
 static void
 test_send_recv_malformed_10(void **state)
 {
@@ -554,6 +1188,104 @@ test_send_recv_malformed_10(void **state)
     assert_null(op);
 }
 
+static void
+test_recv_msg_buffer_limit(void **state)
+{
+    int ret, i;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct nc_pollsession *ps;
+    const char *notif;
+
+    (void)state;
+
+    server_session->version = NC_VERSION_10;
+    client_session->version = NC_VERSION_10;
+
+    /* room for 2 notifications only */
+    notif =
+            "<notification xmlns=\"urn:ietf:params:xml:ns:netconf:notification:1.0\">"
+            "<eventTime>2024-01-01T00:00:00Z</eventTime>"
+            "<notificationComplete xmlns=\"urn:ietf:params:xml:ns:netmod:notification\"/>"
+            "</notification>";
+    nc_client_session_set_msg_buffer_limit(client_session, 2 * strlen(notif));
+
+    /* server notifications */
+    for (i = 0; i < 3; ++i) {
+        assert_int_equal(write(server_session->ti.fd.out, notif, strlen(notif)), strlen(notif));
+        assert_int_equal(write(server_session->ti.fd.out, "]]>]]>", 6), 6);
+    }
+
+    /* client RPC */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* server RPC, send reply */
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+
+    /* server finished */
+    nc_ps_free(ps);
+
+    /* client reply, all the notifications are read first */
+    for (i = 0; i < 3; ++i) {
+        msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_NOTIF);
+    }
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    lyd_free_tree(envp);
+
+    /* only 2 notifications were buffered */
+    for (i = 0; i < 2; ++i) {
+        msgtype = nc_recv_notif(client_session, 0, &envp, &op);
+        assert_int_equal(msgtype, NC_MSG_NOTIF);
+        assert_string_equal(LYD_NAME(op), "notificationComplete");
+        lyd_free_tree(envp);
+        lyd_free_tree(op);
+    }
+    msgtype = nc_recv_notif(client_session, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_WOULDBLOCK);
+
+    /* no room for any message, but replies are still buffered */
+    nc_client_session_set_msg_buffer_limit(client_session, 1);
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(client_session, rpc, 0, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+    nc_ps_add_session(ps, server_session);
+    ret = nc_ps_poll(ps, 0, NULL);
+    assert_int_equal(ret, NC_PSPOLL_RPC);
+    nc_ps_free(ps);
+
+    /* the reply is read and buffered while waiting for a notification */
+    msgtype = nc_recv_notif(client_session, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+
+    msgtype = nc_recv_reply(client_session, rpc, msgid, 0, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    nc_rpc_free(rpc);
+    assert_null(op);
+    lyd_free_tree(envp);
+
+    nc_client_session_set_msg_buffer_limit(client_session, 0);
+}
+
 int
 main(void)
 {
@@ -599,10 +1331,19 @@ main(void)
         cmocka_unit_test_setup_teardown(test_send_recv_data_10, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_notif_10, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_malformed_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_async_10, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_recv_msg_buffer_limit, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_notif_dispatcher, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_ok_11, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_error_11, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_data_11, setup_sessions, teardown_sessions),
         cmocka_unit_test_setup_teardown(test_send_recv_notif_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_async_11, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_async_discard, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_prepared, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_opaq, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_stream, setup_sessions, teardown_sessions),
+        cmocka_unit_test_setup_teardown(test_send_recv_stream_parts, setup_sessions, teardown_sessions),
     };
 
     ret = cmocka_run_group_tests(comm, NULL, NULL);
@@ -0,0 +1,419 @@
+/**
+ * @file test_module_cache.c
+ * @brief libnetconf2 client module cache test
+ *
+ * @copyright
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+
+#include "ln2_test.h"
+#include "session_p.h"
+
+#define MODULE_COUNT 8
+#define THREAD_COUNT 4
+#define THREAD_ITERATIONS 100
+
+struct test_state {
+    char dir[64];
+    struct nc_session *session;
+    void *client_ctx;
+};
+
+/**
+ * @brief Get the text of a test module.
+ */
+static char *
+module_text(int idx)
+{
+    char *text;
+
+    assert_int_not_equal(asprintf(&text, "module mod%d {\n  namespace \"urn:mod%d\";\n  prefix m%d;\n}\n",
+            idx, idx, idx), -1);
+    return text;
+}
+
+/**
+ * @brief Count the directory entries of a kind in the module cache.
+ */
+static int
+count_entries(const char *dir, int links, const char *prefix)
+{
+    DIR *d;
+    struct dirent *ent;
+    struct stat st;
+    int count = 0;
+
+    d = opendir(dir);
+    assert_non_null(d);
+    while ((ent = readdir(d))) {
+        if (prefix && strncmp(ent->d_name, prefix, strlen(prefix))) {
+            continue;
+        } else if (!prefix && (ent->d_name[0] == '.')) {
+            continue;
+        }
+        if (fstatat(dirfd(d), ent->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+            continue;
+        }
+        if ((links && S_ISLNK(st.st_mode)) || (!links && S_ISREG(st.st_mode))) {
+            ++count;
+        }
+    }
+    closedir(d);
+
+    return count;
+}
+
+/**
+ * @brief Get the path of the object a module cache link points to.
+ */
+static char *
+object_path(const char *dir, const char *key)
+{
+    char *path, target[32];
+    ssize_t r;
+
+    assert_int_not_equal(asprintf(&path, "%s/%s", dir, key), -1);
+    r = readlink(path, target, sizeof target - 1);
+    assert_true(r > 0);
+    target[r] = '\0';
+    free(path);
+
+    assert_int_not_equal(asprintf(&path, "%s/%s", dir, target), -1);
+    return path;
+}
+
+static int
+setup_f(void **state)
+{
+    struct test_state *st;
+
+    st = calloc(1, sizeof *st);
+    assert_non_null(st);
+    strcpy(st->dir, "/tmp/ln2_module_cache_XXXXXX");
+    assert_non_null(mkdtemp(st->dir));
+    assert_int_equal(nc_client_set_module_cache(st->dir, 0), 0);
+
+    st->session = calloc(1, sizeof *st->session);
+    assert_non_null(st->session);
+    st->session->side = NC_CLIENT;
+    st->client_ctx = nc_client_get_thread_context();
+
+    *state = st;
+    return 0;
+}
+
+static int
+teardown_f(void **state)
+{
+    struct test_state *st = *state;
+    DIR *d;
+    struct dirent *ent;
+
+    d = opendir(st->dir);
+    assert_non_null(d);
+    while ((ent = readdir(d))) {
+        if (strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..")) {
+            unlinkat(dirfd(d), ent->d_name, 0);
+        }
+    }
+    closedir(d);
+    rmdir(st->dir);
+
+    nc_client_set_module_cache(NULL, 0);
+    free(st->session->opts.client.content_id);
+    free(st->session);
+    free(st);
+    return 0;
+}
+
+static void
+test_nc_module_cache_hit_miss(void **state)
+{
+    struct test_state *st = *state;
+    char *text, *data;
+
+    text = module_text(0);
+
+    /* miss */
+    assert_null(nc_module_cache_retrieve(st->session, "mod0", "2024-01-01"));
+
+    /* hit */
+    nc_module_cache_store(st->session, "mod0", "2024-01-01", text);
+    data = nc_module_cache_retrieve(st->session, "mod0", "2024-01-01");
+    assert_non_null(data);
+    assert_string_equal(data, text);
+    free(data);
+
+    /* different revision */
+    assert_null(nc_module_cache_retrieve(st->session, "mod0", "2025-01-01"));
+
+    /* no revision and no content-id, never cached */
+    nc_module_cache_store(st->session, "mod0", NULL, text);
+    assert_null(nc_module_cache_retrieve(st->session, "mod0", NULL));
+
+    /* no revision but a content-id */
+    st->session->opts.client.content_id = strdup("42");
+    nc_module_cache_store(st->session, "mod0", NULL, text);
+    data = nc_module_cache_retrieve(st->session, "mod0", NULL);
+    assert_non_null(data);
+    assert_string_equal(data, text);
+    free(data);
+
+    /* another server content */
+    free(st->session->opts.client.content_id);
+    st->session->opts.client.content_id = strdup("43");
+    assert_null(nc_module_cache_retrieve(st->session, "mod0", NULL));
+
+    /* the same text stored only once */
+    assert_int_equal(count_entries(st->dir, 0, NULL), 1);
+    assert_int_equal(count_entries(st->dir, 1, NULL), 2);
+
+    free(text);
+}
+
+static void
+test_nc_module_cache_corrupted(void **state)
+{
+    struct test_state *st = *state;
+    char *text, *obj;
+    int fd;
+
+    text = module_text(0);
+    nc_module_cache_store(st->session, "mod0", "2024-01-01", text);
+
+    /* corrupt the object */
+    obj = object_path(st->dir, "mod0@2024-01-01.yang");
+    fd = open(obj, O_WRONLY);
+    assert_int_not_equal(fd, -1);
+    assert_int_equal(write(fd, "x", 1), 1);
+    close(fd);
+
+    /* miss, the object is removed */
+    assert_null(nc_module_cache_retrieve(st->session, "mod0", "2024-01-01"));
+    assert_int_equal(access(obj, F_OK), -1);
+
+    free(obj);
+    free(text);
+}
+
+static void
+test_nc_module_cache_dangling(void **state)
+{
+    struct test_state *st = *state;
+    char *text, *obj, *data;
+
+    text = module_text(0);
+    nc_module_cache_store(st->session, "mod0", "2024-01-01", text);
+
+    /* evicted by another process */
+    obj = object_path(st->dir, "mod0@2024-01-01.yang");
+    assert_int_equal(unlink(obj), 0);
+
+    /* miss, the dangling link is removed */
+    assert_null(nc_module_cache_retrieve(st->session, "mod0", "2024-01-01"));
+    assert_int_equal(count_entries(st->dir, 1, NULL), 0);
+
+    /* stored again */
+    nc_module_cache_store(st->session, "mod0", "2024-01-01", text);
+    data = nc_module_cache_retrieve(st->session, "mod0", "2024-01-01");
+    assert_non_null(data);
+    assert_string_equal(data, text);
+    free(data);
+
+    free(obj);
+    free(text);
+}
+
+static void
+test_nc_module_cache_evict(void **state)
+{
+    struct test_state *st = *state;
+    char *texts[3], *obj, name[16], rev[16], key[32];
+    struct timespec times[2] = {0};
+    size_t size = 0;
+    int i;
+
+    /* stored in the past, mod0 the least recently used */
+    for (i = 0; i < 3; ++i) {
+        texts[i] = module_text(i);
+        size += strlen(texts[i]);
+        sprintf(name, "mod%d", i);
+        sprintf(rev, "2024-01-0%d", i + 1);
+        sprintf(key, "%s@%s.yang", name, rev);
+        nc_module_cache_store(st->session, name, rev, texts[i]);
+
+        obj = object_path(st->dir, key);
+        times[0].tv_sec = times[1].tv_sec = 1000000 + i;
+        assert_int_equal(utimensat(AT_FDCWD, obj, times, 0), 0);
+        free(obj);
+    }
+    assert_int_equal(count_entries(st->dir, 0, NULL), 3);
+
+    /* fits */
+    nc_module_cache_evict(st->dir, size);
+    assert_int_equal(count_entries(st->dir, 0, NULL), 3);
+    assert_int_equal(count_entries(st->dir, 1, NULL), 3);
+
+    /* mark mod0 as recently used */
+    obj = nc_module_cache_retrieve(st->session, "mod0", "2024-01-01");
+    assert_non_null(obj);
+    free(obj);
+
+    /* room for 2 modules only, mod1 is evicted with its link */
+    nc_module_cache_evict(st->dir, size - 1);
+    assert_int_equal(count_entries(st->dir, 0, NULL), 2);
+    assert_int_equal(count_entries(st->dir, 1, NULL), 2);
+    assert_null(nc_module_cache_retrieve(st->session, "mod1", "2024-01-02"));
+    obj = nc_module_cache_retrieve(st->session, "mod0", "2024-01-01");
+    assert_non_null(obj);
+    free(obj);
+    obj = nc_module_cache_retrieve(st->session, "mod2", "2024-01-03");
+    assert_non_null(obj);
+    free(obj);
+
+    /* evicted when storing */
+    assert_int_equal(nc_client_set_module_cache(st->dir, 1), 0);
+    nc_module_cache_store(st->session, "mod1", "2024-01-02", texts[1]);
+    assert_int_equal(count_entries(st->dir, 0, NULL), 0);
+    assert_int_equal(count_entries(st->dir, 1, NULL), 0);
+
+    for (i = 0; i < 3; ++i) {
+        free(texts[i]);
+    }
+}
+
+struct thread_arg {
+    struct test_state *st;
+    int idx;
+    int evict;
+};
+
+static void *
+writer_thread(void *arg)
+{
+    struct thread_arg *targ = arg;
+    struct nc_session *session;
+    char *texts[MODULE_COUNT], *data, name[16];
+    int i, m;
+
+    /* use the module cache of the main thread */
+    nc_client_set_thread_context(targ->st->client_ctx);
+
+    session = calloc(1, sizeof *session);
+    assert_non_null(session);
+    session->side = NC_CLIENT;
+
+    for (m = 0; m < MODULE_COUNT; ++m) {
+        texts[m] = module_text(m);
+    }
+
+    for (i = 0; i < THREAD_ITERATIONS; ++i) {
+        /* shared with the other threads */
+        m = (targ->idx + i) % MODULE_COUNT;
+        sprintf(name, "mod%d", m);
+        nc_module_cache_store(session, name, "2024-01-01", texts[m]);
+
+        data = nc_module_cache_retrieve(session, name, "2024-01-01");
+        if (!targ->evict) {
+            /* a link stored by another thread never breaks the just stored one */
+            assert_non_null(data);
+        }
+        if (data) {
+            /* never an incomplete or another module */
+            assert_string_equal(data, texts[m]);
+            free(data);
+        }
+    }
+
+    for (m = 0; m < MODULE_COUNT; ++m) {
+        free(texts[m]);
+    }
+    free(session);
+    return NULL;
+}
+
+static void
+run_writers(struct test_state *st, int evict)
+{
+    pthread_t tids[THREAD_COUNT];
+    struct thread_arg targs[THREAD_COUNT];
+    int i;
+
+    for (i = 0; i < THREAD_COUNT; ++i) {
+        targs[i].st = st;
+        targs[i].idx = i;
+        targs[i].evict = evict;
+        assert_int_equal(pthread_create(&tids[i], NULL, writer_thread, &targs[i]), 0);
+    }
+    for (i = 0; i < THREAD_COUNT; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+
+    /* no temporary files left */
+    assert_int_equal(count_entries(st->dir, 0, ".tmp."), 0);
+    assert_int_equal(count_entries(st->dir, 1, ".tmp."), 0);
+}
+
+static void
+test_nc_module_cache_concurrent(void **state)
+{
+    struct test_state *st = *state;
+    char *text, *data;
+
+    /* all the modules fit */
+    run_writers(st, 0);
+    assert_int_equal(count_entries(st->dir, 0, NULL), MODULE_COUNT);
+    assert_int_equal(count_entries(st->dir, 1, NULL), MODULE_COUNT);
+
+    /* room for a few modules only, modules are evicted while being stored and read */
+    text = module_text(0);
+    assert_int_equal(nc_client_set_module_cache(st->dir, 3 * strlen(text)), 0);
+    run_writers(st, 1);
+    assert_true(count_entries(st->dir, 0, NULL) <= 3);
+
+    /* no dangling links after the last eviction */
+    nc_module_cache_evict(st->dir, 3 * strlen(text));
+    assert_int_equal(count_entries(st->dir, 1, NULL), count_entries(st->dir, 0, NULL));
+
+    /* still working */
+    nc_module_cache_store(st->session, "mod0", "2024-01-01", text);
+    data = nc_module_cache_retrieve(st->session, "mod0", "2024-01-01");
+    assert_non_null(data);
+    assert_string_equal(data, text);
+    free(data);
+    free(text);
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_nc_module_cache_hit_miss, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_module_cache_corrupted, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_module_cache_dangling, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_module_cache_evict, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_nc_module_cache_concurrent, setup_f, teardown_f),
+    };
+
+    setenv("CMOCKA_TEST_ABORT", "1", 1);
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,160 @@
+/**
+ * @file test_sock_connect.c
+ * @brief libnetconf2 racing TCP connections to several addresses test
+ *
+ * @copyright
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+
+#include "ln2_test.h"
+#include "session_p.h"
+
+/* connect timeout, the race must finish well before it */
+#define TEST_CONNECT_TIMEOUT 5000
+
+/* TEST-NET-1 address (RFC 5737), nothing ever answers a connection to it */
+#define TEST_UNREACHABLE_ADDR "192.0.2.1"
+
+struct race_state {
+    int listen_sock;
+    struct sockaddr_in unreachable;
+    struct sockaddr_in reachable;
+    struct addrinfo res[2];
+};
+
+static void
+test_sock_connect_race(void **state)
+{
+    int sock;
+    struct race_state *st = *state;
+    struct nc_keepalives ka = {0};
+    struct addrinfo *res_conn;
+    struct timespec ts_start, ts_end;
+    long elapsed_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+
+    /* the unreachable address is tried first */
+    sock = nc_sock_connect_race(NULL, 0, TEST_CONNECT_TIMEOUT, NULL, &st->res[0], &ka, &res_conn);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+    elapsed_ms = (ts_end.tv_sec - ts_start.tv_sec) * 1000 + (ts_end.tv_nsec - ts_start.tv_nsec) / 1000000;
+
+    assert_int_not_equal(sock, -1);
+    assert_ptr_equal(res_conn, &st->res[1]);
+
+    /* connected to the reachable address after at most one attempt delay, not after the timeout */
+    assert_true(elapsed_ms < TEST_CONNECT_TIMEOUT / 5);
+
+    close(sock);
+}
+
+static void
+test_sock_connect_race_timeout(void **state)
+{
+    int sock, sock_pending = -1;
+    struct race_state *st = *state;
+    struct nc_keepalives ka = {0};
+    struct addrinfo *res_conn, res_unreachable;
+
+    /* only the unreachable address */
+    res_unreachable = st->res[0];
+    res_unreachable.ai_next = NULL;
+
+    sock = nc_sock_connect_race(NULL, 0, 100, &sock_pending, &res_unreachable, &ka, &res_conn);
+    assert_int_equal(sock, -1);
+    assert_null(res_conn);
+
+    /* either still in progress and kept pending, or failed right away without a route */
+    if (sock_pending > -1) {
+        close(sock_pending);
+    }
+}
+
+static int
+setup_f(void **state)
+{
+    int ret;
+    struct race_state *st;
+    socklen_t len;
+
+    st = calloc(1, sizeof *st);
+    assert_non_null(st);
+
+    /* listen on any free local port */
+    st->listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    assert_int_not_equal(st->listen_sock, -1);
+
+    st->reachable.sin_family = AF_INET;
+    st->reachable.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ret = bind(st->listen_sock, (struct sockaddr *)&st->reachable, sizeof st->reachable);
+    assert_int_equal(ret, 0);
+    ret = listen(st->listen_sock, 1);
+    assert_int_equal(ret, 0);
+
+    len = sizeof st->reachable;
+    ret = getsockname(st->listen_sock, (struct sockaddr *)&st->reachable, &len);
+    assert_int_equal(ret, 0);
+
+    st->unreachable.sin_family = AF_INET;
+    st->unreachable.sin_port = st->reachable.sin_port;
+    ret = inet_pton(AF_INET, TEST_UNREACHABLE_ADDR, &st->unreachable.sin_addr);
+    assert_int_equal(ret, 1);
+
+    /* the addrinfo list as returned by getaddrinfo() */
+    st->res[0].ai_family = AF_INET;
+    st->res[0].ai_socktype = SOCK_STREAM;
+    st->res[0].ai_protocol = IPPROTO_TCP;
+    st->res[0].ai_addrlen = sizeof st->unreachable;
+    st->res[0].ai_addr = (struct sockaddr *)&st->unreachable;
+    st->res[0].ai_next = &st->res[1];
+
+    st->res[1] = st->res[0];
+    st->res[1].ai_addr = (struct sockaddr *)&st->reachable;
+    st->res[1].ai_next = NULL;
+
+    *state = st;
+    return 0;
+}
+
+static int
+teardown_f(void **state)
+{
+    struct race_state *st = *state;
+
+    close(st->listen_sock);
+    free(st);
+    return 0;
+}
+
+int
+main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_sock_connect_race, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_sock_connect_race_timeout, setup_f, teardown_f),
+    };
+
+    setenv("CMOCKA_TEST_ABORT", "1", 1);
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -15,18 +15,41 @@
 
 #define _GNU_SOURCE
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <pthread.h>
 #include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <cmocka.h>
 
 #include "ln2_test.h"
+#include "session_p.h"
+#include "session_wrapper.h"
+
+#ifndef HAVE_MBEDTLS
+# include <openssl/ssl.h>
+# include <openssl/x509.h>
+#endif
 
 #define KEYLOG_FILENAME "ln2_test_tls_keylog.txt"
 
+#ifndef TCP_ULP
+# define TCP_ULP 31
+#endif
+
+/* fingerprints of the client certificate and of its CA */
+#define CLIENT_FP_SHA256 "04:85:6B:75:D1:1A:86:E0:D8:FE:5B:BD:72:F5:73:1D:07:EA:32:BF:09:11:21:6A:6E:23:78:8E:B6:D5:73:C3:2D"
+#define CLIENT_FP_MD5 "01:EF:76:F1:5C:1C:EA:A4:2C:1A:6F:C5:4D:0F:36:B1:3C"
+#define CA_FP_SHA1 "02:E5:3F:E7:C7:28:8D:F8:3B:EC:AC:AB:85:AB:76:48:68:47:0D:B5:C3"
+#define SERVER_FP_SHA256 "04:35:50:57:47:22:39:CF:D1:07:50:9D:2F:E5:2D:42:09:3D:3B:8A:E7:68:B0:C5:78:47:78:19:B7:76:79:0E:FA"
+
 int TEST_PORT = 10050;
 const char *TEST_PORT_STR = "10050";
 
@@ -101,6 +124,628 @@ test_nc_tls_ec_key(void **state)
     }
 }
 
+static void
+test_nc_tls_bad_ee_cert(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+    struct ln2_test_ctx *test_ctx;
+    struct lyd_node *node;
+
+    assert_non_null(state);
+    test_ctx = *state;
+
+    /* add another end-entity cert and break its data */
+    ret = nc_server_config_add_tls_client_cert(test_ctx->ctx, "endpt", "bad_cert", TESTS_DIR "/data/server.crt",
+            (struct lyd_node **)&test_ctx->test_data);
+    assert_int_equal(ret, 0);
+    ret = lyd_find_path(test_ctx->test_data, "/ietf-netconf-server:netconf-server/listen/endpoints/endpoint[name='endpt']/"
+            "tls/tls-server-parameters/client-authentication/ee-certs/inline-definition/certificate[name='bad_cert']/"
+            "cert-data", 0, &node);
+    assert_int_equal(ret, 0);
+    ret = lyd_change_term(node, "AAAA");
+    assert_int_equal(ret, 0);
+
+    ret = nc_server_config_setup_data(test_ctx->test_data);
+    assert_int_equal(ret, 0);
+
+    /* the bad cert is skipped and the client is still authenticated */
+    ret = pthread_create(&tids[0], NULL, client_thread, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, ln2_glob_test_server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+static void *
+server_thread_ctx_change(void *arg)
+{
+    int ret, term_count = 0;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session = NULL;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    /* accept a session created from the TLS context built on config apply */
+    pthread_barrier_wait(&test_ctx->barrier);
+    msgtype = nc_accept(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+    ret = nc_ps_add_session(ps, session);
+    assert_int_equal(ret, 0);
+
+    /* change the server cert while the session using the previous context is still alive */
+    ret = nc_server_config_add_tls_server_cert(test_ctx->ctx, "endpt", TESTS_DIR "/data/ec_server.key",
+            NULL, TESTS_DIR "/data/ec_server.crt", (struct lyd_node **)&test_ctx->test_data);
+    assert_int_equal(ret, 0);
+    ret = nc_server_config_setup_data(test_ctx->test_data);
+    assert_int_equal(ret, 0);
+
+    /* accept a session created from the new context */
+    pthread_barrier_wait(&test_ctx->barrier);
+    msgtype = nc_accept(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+    ret = nc_ps_add_session(ps, session);
+    assert_int_equal(ret, 0);
+
+    /* poll until both the sessions are terminated by the client */
+    do {
+        ret = nc_ps_poll(ps, NC_PS_POLL_TIMEOUT, NULL);
+        if (ret & NC_PSPOLL_SESSION_TERM) {
+            ++term_count;
+            nc_ps_clear(ps, 0, NULL);
+        }
+    } while (term_count < 2);
+
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void *
+client_thread_ctx_change(void *arg)
+{
+    int ret;
+    struct nc_session *session1, *session2;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_cert_key_paths(TESTS_DIR "/data/client.crt", TESTS_DIR "/data/client.key");
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_trusted_ca_paths(NULL, TESTS_DIR "/data");
+    assert_int_equal(ret, 0);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    session1 = nc_connect_tls("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session1);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    session2 = nc_connect_tls("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session2);
+
+    nc_session_free(session1, NULL);
+    nc_session_free(session2, NULL);
+    return NULL;
+}
+
+static void
+test_nc_tls_ctx_change(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_ctx_change, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_ctx_change, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+/**
+ * @brief Learn whether both the TLS library and the kernel support TLS offload.
+ */
+static int
+ktls_supported(void)
+{
+#if defined (HAVE_MBEDTLS) || defined (OPENSSL_NO_KTLS)
+    return 0;
+#else
+    int lsock, csock, ssock, ret = 0;
+    struct sockaddr_in addr = {0};
+    socklen_t addr_len = sizeof addr;
+
+    /* the "tls" upper layer protocol can only be set on a connected socket */
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    csock = socket(AF_INET, SOCK_STREAM, 0);
+    assert_true((lsock > -1) && (csock > -1));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(lsock, (struct sockaddr *)&addr, sizeof addr), 0);
+    assert_int_equal(listen(lsock, 1), 0);
+    assert_int_equal(getsockname(lsock, (struct sockaddr *)&addr, &addr_len), 0);
+    assert_int_equal(connect(csock, (struct sockaddr *)&addr, sizeof addr), 0);
+    ssock = accept(lsock, NULL, NULL);
+    assert_int_not_equal(ssock, -1);
+
+    if (!setsockopt(csock, SOL_TCP, TCP_ULP, "tls", sizeof "tls")) {
+        ret = 1;
+    }
+
+    close(ssock);
+    close(csock);
+    close(lsock);
+    return ret;
+#endif
+}
+
+/**
+ * @brief Connect, exchange a message, and check the kernel TLS offload of the session.
+ */
+static void
+client_session_ktls(struct ln2_test_ctx *test_ctx, int enabled)
+{
+    int ret;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_cert_key_paths(TESTS_DIR "/data/client.crt", TESTS_DIR "/data/client.key");
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_trusted_ca_paths(NULL, TESTS_DIR "/data");
+    assert_int_equal(ret, 0);
+
+    nc_client_tls_set_ktls(enabled);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    session = nc_connect_tls("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session);
+
+    /* supported by the kernel for the TLS 1.2 AES-GCM cipher suites in both directions */
+    assert_int_equal(nc_session_tls_get_ktls(session), enabled ? (NC_TLS_KTLS_TX | NC_TLS_KTLS_RX) : 0);
+
+    /* bulk reply, written directly to the socket by the server if its encryption is offloaded */
+    rpc = nc_rpc_getschema("ietf-netconf", NULL, NULL, NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(session, rpc, 1000, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    msgtype = nc_recv_reply(session, rpc, msgid, 2000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    assert_non_null(op);
+
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+    nc_rpc_free(rpc);
+    nc_client_tls_set_ktls(0);
+    nc_session_free(session, NULL);
+}
+
+static void *
+client_thread_ktls(void *arg)
+{
+    client_session_ktls(arg, 1);
+    return NULL;
+}
+
+static void *
+client_thread_ktls_fallback(void *arg)
+{
+    client_session_ktls(arg, 0);
+    return NULL;
+}
+
+static void *
+server_thread_ktls(void *arg)
+{
+    int ret;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session = NULL;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    msgtype = nc_accept(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+
+    /* the server offloads the encryption as well */
+    assert_int_equal(nc_session_tls_get_ktls(session), NC_TLS_KTLS_TX | NC_TLS_KTLS_RX);
+
+    ret = nc_ps_add_session(ps, session);
+    assert_int_equal(ret, 0);
+
+    do {
+        ret = nc_ps_poll(ps, NC_PS_POLL_TIMEOUT, NULL);
+    } while (!(ret & NC_PSPOLL_SESSION_TERM));
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void
+test_nc_tls_ktls(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+    struct ln2_test_ctx *test_ctx;
+    struct lyd_node *node = NULL;
+
+    assert_non_null(state);
+    test_ctx = *state;
+
+    if (!ktls_supported()) {
+        /* TLS library built without kernel TLS or the kernel "tls" module not available */
+        skip();
+    }
+
+    /* TLS 1.2 is offloaded in both directions by all the kernels supporting kernel TLS */
+    ret = lyd_new_path(test_ctx->test_data, NULL, "/ietf-netconf-server:netconf-server/listen/endpoints/"
+            "endpoint[name='endpt']/tls/tls-server-parameters/hello-params/tls-versions/tls-version",
+            "ietf-tls-common:tls12", 0, &node);
+    assert_int_equal(ret, 0);
+    ret = nc_server_config_setup_data(test_ctx->test_data);
+    assert_int_equal(ret, 0);
+
+    nc_server_tls_set_ktls(1);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_ktls, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_ktls, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    nc_server_tls_set_ktls(0);
+}
+
+static void
+test_nc_tls_ktls_fallback(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_ktls_fallback, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, ln2_glob_test_server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+/**
+ * @brief Send a bulk message and get the records and bytes it was sent in.
+ */
+static void
+send_bulk_rpc(struct nc_session *session, const char *config, uint64_t *records, uint64_t *bytes)
+{
+    int ret;
+    uint64_t msgid, records_before, bytes_before;
+    NC_MSG_TYPE msgtype;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+
+    ret = nc_session_tls_get_record_stats(session, &records_before, &bytes_before);
+    assert_int_equal(ret, 0);
+
+    rpc = nc_rpc_edit(NC_DATASTORE_RUNNING, 0, 0, 0, config, NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(session, rpc, 1000, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    ret = nc_session_tls_get_record_stats(session, records, bytes);
+    assert_int_equal(ret, 0);
+    *records -= records_before;
+    *bytes -= bytes_before;
+
+    /* any reply */
+    msgtype = nc_recv_reply(session, rpc, msgid, 2000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+    nc_rpc_free(rpc);
+}
+
+static void *
+client_thread_record_stats(void *arg)
+{
+    int ret;
+    uint64_t msgid, records, bytes, records2, bytes2;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct ln2_test_ctx *test_ctx = arg;
+    char *config;
+    const size_t config_len = 4 * NC_TLS_DRS_SMALL_BYTES;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_cert_key_paths(TESTS_DIR "/data/client.crt", TESTS_DIR "/data/client.key");
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_trusted_ca_paths(NULL, TESTS_DIR "/data");
+    assert_int_equal(ret, 0);
+
+    nc_client_tls_set_dynamic_record_sizing(1);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    session = nc_connect_tls("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session);
+
+    /* at least the <hello> was sent */
+    ret = nc_session_tls_get_record_stats(session, &records, &bytes);
+    assert_int_equal(ret, 0);
+    assert_true(records > 0);
+    assert_true(bytes >= records);
+
+    rpc = nc_rpc_getschema("ietf-netconf", NULL, NULL, NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(session, rpc, 1000, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+
+    /* the chunk header, the message, and the end tag were all sent in a single record */
+    ret = nc_session_tls_get_record_stats(session, &records2, &bytes2);
+    assert_int_equal(ret, 0);
+    assert_int_equal(records2, records + 1);
+    assert_true(bytes2 > bytes);
+
+    msgtype = nc_recv_reply(session, rpc, msgid, 2000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+    nc_rpc_free(rpc);
+
+    /* bulk configuration */
+    config = malloc(config_len + 1);
+    assert_non_null(config);
+    memset(config, ' ', config_len);
+    memcpy(config, "<cfg xmlns=\"urn:test\">", 22);
+    memcpy(config + config_len - 6, "</cfg>", 6);
+    config[config_len] = '\0';
+
+    /* the first bytes are sent in small records after the session start */
+    send_bulk_rpc(session, config, &records, &bytes);
+    assert_true(bytes > config_len);
+    assert_true(records > NC_TLS_DRS_SMALL_BYTES / NC_TLS_RECORD_SIZE_SMALL);
+
+    /* no idle period, all the records are full-sized except the last one */
+    send_bulk_rpc(session, config, &records, &bytes);
+    assert_true(bytes > config_len);
+    assert_int_equal(records, (bytes + NC_TLS_RECORD_SIZE - 1) / NC_TLS_RECORD_SIZE);
+
+    free(config);
+    nc_client_tls_set_dynamic_record_sizing(0);
+    nc_session_free(session, NULL);
+    return NULL;
+}
+
+static void
+test_nc_tls_record_stats(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    nc_server_tls_set_dynamic_record_sizing(1);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_record_stats, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, ln2_glob_test_server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    nc_server_tls_set_dynamic_record_sizing(0);
+}
+
+static void *
+server_thread_accept_start(void *arg)
+{
+    int ret, fd;
+    short events;
+    NC_MSG_TYPE msgtype;
+    struct pollfd pfd;
+    struct nc_session *session = NULL;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    msgtype = nc_accept_start(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session, &fd, &events);
+
+    /* drive the TLS handshake by waiting on the socket as an external poller would */
+    while (msgtype == NC_MSG_WOULDBLOCK) {
+        assert_non_null(session);
+        assert_int_not_equal(fd, -1);
+        assert_true(events & (POLLIN | POLLOUT));
+
+        pfd.fd = fd;
+        pfd.events = events;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, NC_ACCEPT_TIMEOUT);
+        assert_int_equal(ret, 1);
+
+        msgtype = nc_accept_continue(&session, &fd, &events);
+    }
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+    assert_string_equal(nc_session_get_username(session), "client");
+
+    ret = nc_ps_add_session(ps, session);
+    assert_int_equal(ret, 0);
+
+    /* poll until the session is terminated by the client */
+    do {
+        ret = nc_ps_poll(ps, NC_PS_POLL_TIMEOUT, NULL);
+    } while (!(ret & NC_PSPOLL_SESSION_TERM));
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void
+test_nc_tls_accept_start(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_accept_start, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+static void *
+server_thread_resumption(void *arg)
+{
+    int ret, i, term_count = 0;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session = NULL;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    for (i = 0; i < 2; i++) {
+        pthread_barrier_wait(&test_ctx->barrier);
+        msgtype = nc_accept(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session);
+        assert_int_equal(msgtype, NC_MSG_HELLO);
+
+        /* the client is always mapped to its username, even if the session was resumed */
+        assert_string_equal(nc_session_get_username(session), "client");
+
+        /* only the second session is resumed */
+        assert_int_equal(session->ti.tls.resumed, i);
+#ifndef HAVE_MBEDTLS
+        assert_int_equal(SSL_session_reused(session->ti.tls.session), i);
+#endif
+
+        ret = nc_ps_add_session(ps, session);
+        assert_int_equal(ret, 0);
+    }
+
+    /* poll until both the sessions are terminated by the client */
+    do {
+        ret = nc_ps_poll(ps, NC_PS_POLL_TIMEOUT, NULL);
+        if (ret & NC_PSPOLL_SESSION_TERM) {
+            ++term_count;
+            nc_ps_clear(ps, 0, NULL);
+        }
+    } while (term_count < 2);
+
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void *
+client_thread_resumption(void *arg)
+{
+    int ret;
+    struct nc_session *session1, *session2;
+    struct nc_client_context *client_ctx;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_cert_key_paths(TESTS_DIR "/data/client.crt", TESTS_DIR "/data/client.key");
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_tls_set_trusted_ca_paths(NULL, TESTS_DIR "/data");
+    assert_int_equal(ret, 0);
+
+    /* full handshake, the session is kept for resumption */
+    pthread_barrier_wait(&test_ctx->barrier);
+    session1 = nc_connect_tls("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session1);
+#ifndef HAVE_MBEDTLS
+    assert_false(SSL_session_reused(session1->ti.tls.session));
+#endif
+
+    client_ctx = nc_client_get_thread_context();
+    assert_int_equal(client_ctx->tls_opts.resumable_count, 1);
+
+    /* resumed handshake */
+    pthread_barrier_wait(&test_ctx->barrier);
+    session2 = nc_connect_tls("127.0.0.1", TEST_PORT, NULL);
+    assert_non_null(session2);
+    assert_int_equal(client_ctx->tls_opts.resumable_count, 1);
+#ifndef HAVE_MBEDTLS
+    assert_true(SSL_session_reused(session2->ti.tls.session));
+#endif
+
+    nc_session_free(session1, NULL);
+    nc_session_free(session2, NULL);
+    return NULL;
+}
+
+static void
+test_nc_tls_resumption(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+    struct ln2_test_ctx *test_ctx;
+
+    assert_non_null(state);
+    test_ctx = *state;
+
+    ret = nc_server_config_add_tls_session_resumption(test_ctx->ctx, "endpt", 300, 0, (struct lyd_node **)&test_ctx->test_data);
+    assert_int_equal(ret, 0);
+
+    ret = nc_server_config_setup_data(test_ctx->test_data);
+    assert_int_equal(ret, 0);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_resumption, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_resumption, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
 static void
 check_keylog_file(const char *filename)
 {
@@ -159,6 +804,181 @@ test_nc_tls_keylog(void **state)
     check_keylog_file(KEYLOG_FILENAME);
 }
 
+static void *
+ctn_chain_new(void)
+{
+    void *client, *ca;
+
+#ifndef HAVE_MBEDTLS
+    STACK_OF(X509) *chain;
+#endif
+
+    client = nc_tls_import_cert_file_wrap(TESTS_DIR "/data/client.crt");
+    assert_non_null(client);
+    ca = nc_tls_import_cert_file_wrap(TESTS_DIR "/data/serverca.pem");
+    assert_non_null(ca);
+
+#ifdef HAVE_MBEDTLS
+    /* the chain is a linked list */
+    assert_int_equal(nc_tls_add_cert_to_store_wrap(ca, client), 0);
+    return client;
+#else
+    chain = sk_X509_new_null();
+    assert_non_null(chain);
+    assert_int_not_equal(sk_X509_push(chain, client), 0);
+    assert_int_not_equal(sk_X509_push(chain, ca), 0);
+    return chain;
+#endif
+}
+
+static void
+ctn_chain_free(void *chain)
+{
+#ifdef HAVE_MBEDTLS
+    nc_tls_cert_destroy_wrap(chain);
+#else
+    sk_X509_pop_free(chain, X509_free);
+#endif
+}
+
+/* map the client chain using cert-to-name entries given as (id, fingerprint, map type, name) */
+static int
+ctn_map_chain(const struct nc_ctn *ctns, uint32_t ctn_count, const struct nc_ctn *ref_ctns, uint32_t ref_ctn_count,
+        char **username)
+{
+    int ret;
+    uint32_t i;
+    struct nc_ctn *own, *ref;
+    struct nc_server_tls_opts opts = {0}, ref_opts = {0};
+    struct nc_endpt ref_endpt = {0};
+    struct nc_server_tls_ctn_map map;
+    void *chain;
+
+    /* link the entries */
+    own = calloc(ctn_count + 1, sizeof *own);
+    ref = calloc(ref_ctn_count + 1, sizeof *ref);
+    assert_true(own && ref);
+    for (i = 0; i < ctn_count; i++) {
+        own[i] = ctns[i];
+        own[i].next = (i + 1 < ctn_count) ? &own[i + 1] : NULL;
+    }
+    for (i = 0; i < ref_ctn_count; i++) {
+        ref[i] = ref_ctns[i];
+        ref[i].next = (i + 1 < ref_ctn_count) ? &ref[i + 1] : NULL;
+    }
+    opts.ctn = ctn_count ? own : NULL;
+    ref_opts.ctn = ref_ctn_count ? ref : NULL;
+    ref_endpt.opts.tls = &ref_opts;
+
+    assert_int_equal(nc_server_tls_ctn_map_build(&opts, ref_ctn_count ? &ref_endpt : NULL, &map), 0);
+
+    chain = ctn_chain_new();
+    *username = NULL;
+    ret = nc_server_tls_cert_to_name(&map, chain, username);
+    ctn_chain_free(chain);
+
+    nc_server_tls_ctn_map_free(&map);
+    free(own);
+    free(ref);
+    return ret;
+}
+
+static void
+test_nc_tls_ctn_priority(void **UNUSED(state))
+{
+    char *username;
+    const struct nc_ctn ctns[] = {
+        {1, CA_FP_SHA1, NC_TLS_CTN_SPECIFIED, "ca_user", NULL},
+        {2, CLIENT_FP_SHA256, NC_TLS_CTN_SPECIFIED, "client_user", NULL}
+    };
+    const struct nc_ctn ctns_rev[] = {
+        {1, CLIENT_FP_SHA256, NC_TLS_CTN_SPECIFIED, "client_user", NULL},
+        {2, CA_FP_SHA1, NC_TLS_CTN_SPECIFIED, "ca_user", NULL}
+    };
+
+    /* the entry with the lowest id wins even if it matches a certificate deeper in the chain */
+    assert_int_equal(ctn_map_chain(ctns, 2, NULL, 0, &username), 0);
+    assert_string_equal(username, "ca_user");
+    free(username);
+
+    assert_int_equal(ctn_map_chain(ctns_rev, 2, NULL, 0, &username), 0);
+    assert_string_equal(username, "client_user");
+    free(username);
+}
+
+static void
+test_nc_tls_ctn_no_match(void **UNUSED(state))
+{
+    char *username;
+    const struct nc_ctn ctns[] = {
+        {1, SERVER_FP_SHA256, NC_TLS_CTN_SPECIFIED, "server_user", NULL}
+    };
+
+    /* fingerprint of a certificate not in the chain */
+    assert_int_equal(ctn_map_chain(ctns, 1, NULL, 0, &username), 1);
+    assert_null(username);
+
+    /* no entries at all */
+    assert_int_equal(ctn_map_chain(NULL, 0, NULL, 0, &username), 1);
+    assert_null(username);
+}
+
+static void
+test_nc_tls_ctn_any_fp(void **UNUSED(state))
+{
+    char *username;
+    const struct nc_ctn ctns[] = {
+        {1, SERVER_FP_SHA256, NC_TLS_CTN_SPECIFIED, "server_user", NULL},
+        {2, NULL, NC_TLS_CTN_COMMON_NAME, NULL, NULL}
+    };
+
+    /* an entry without a fingerprint matches the client certificate first */
+    assert_int_equal(ctn_map_chain(ctns, 2, NULL, 0, &username), 0);
+    assert_string_equal(username, "client");
+    free(username);
+}
+
+static void
+test_nc_tls_ctn_fallthrough(void **UNUSED(state))
+{
+    char *username;
+    const struct nc_ctn ctns[] = {
+        {1, "0A:00:11", NC_TLS_CTN_SPECIFIED, "bad_alg_user", NULL},
+        {2, CLIENT_FP_MD5, NC_TLS_CTN_SPECIFIED, NULL, NULL},
+        {3, CLIENT_FP_SHA256, NC_TLS_CTN_SAN_ANY, NULL, NULL},
+        {4, CLIENT_FP_SHA256, NC_TLS_CTN_SAN_RFC822_NAME, NULL, NULL},
+        {5, CLIENT_FP_MD5, NC_TLS_CTN_SPECIFIED, "md5_user", NULL},
+        {6, CLIENT_FP_SHA256, NC_TLS_CTN_SPECIFIED, "sha256_user", NULL}
+    };
+
+    /* invalid entries are skipped and the client has no SANs so the first entry providing a username wins */
+    assert_int_equal(ctn_map_chain(ctns, 6, NULL, 0, &username), 0);
+    assert_string_equal(username, "md5_user");
+    free(username);
+}
+
+static void
+test_nc_tls_ctn_referenced(void **UNUSED(state))
+{
+    char *username;
+    const struct nc_ctn ctns[] = {
+        {5, CA_FP_SHA1, NC_TLS_CTN_SPECIFIED, "own_user", NULL}
+    };
+    const struct nc_ctn ref_ctns[] = {
+        {1, CLIENT_FP_SHA256, NC_TLS_CTN_SPECIFIED, "ref_user", NULL}
+    };
+
+    /* entries of the endpoint itself take precedence over the referenced ones regardless of the id */
+    assert_int_equal(ctn_map_chain(ctns, 1, ref_ctns, 1, &username), 0);
+    assert_string_equal(username, "own_user");
+    free(username);
+
+    /* the referenced entries are used if none of the own entries match */
+    assert_int_equal(ctn_map_chain(NULL, 0, ref_ctns, 1, &username), 0);
+    assert_string_equal(username, "ref_user");
+    free(username);
+}
+
 static void
 test_nc_tls_free_test_data(void *test_data)
 {
@@ -224,7 +1044,19 @@ main(void)
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_nc_tls, setup_f, ln2_glob_test_teardown),
         cmocka_unit_test_setup_teardown(test_nc_tls_ec_key, setup_f, ln2_glob_test_teardown),
-        cmocka_unit_test_setup_teardown(test_nc_tls_keylog, keylog_setup_f, ln2_glob_test_teardown)
+        cmocka_unit_test_setup_teardown(test_nc_tls_bad_ee_cert, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_tls_ctx_change, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_tls_resumption, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_tls_accept_start, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_tls_ktls, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_tls_ktls_fallback, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_tls_record_stats, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_tls_keylog, keylog_setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test(test_nc_tls_ctn_priority),
+        cmocka_unit_test(test_nc_tls_ctn_no_match),
+        cmocka_unit_test(test_nc_tls_ctn_any_fp),
+        cmocka_unit_test(test_nc_tls_ctn_fallthrough),
+        cmocka_unit_test(test_nc_tls_ctn_referenced)
     };
 
     /* try to get ports from the environment, otherwise use the default */
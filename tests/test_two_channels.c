@@ -26,12 +26,16 @@
 #include <cmocka.h>
 
 #include "ln2_test.h"
+#include "session_p.h"
 
 #define BACKOFF_TIMEOUT_USECS 100
 
 int TEST_PORT = 10050;
 const char *TEST_PORT_STR = "10050";
 
+/* number of sessions the server thread waits for to be closed */
+int server_session_count;
+
 static void *
 server_thread(void *arg)
 {
@@ -44,7 +48,7 @@ server_thread(void *arg)
     ps = nc_ps_new();
     assert_non_null(ps);
 
-    while (del_session_count < 2) {
+    while (del_session_count < server_session_count) {
         msgtype = nc_accept(0, test_ctx->ctx, &new_session);
 
         if (msgtype == NC_MSG_HELLO) {
@@ -121,6 +125,7 @@ test_nc_two_channels(void **state)
     int ret, i;
     pthread_t tids[2];
 
+    server_session_count = 2;
     ret = pthread_create(&tids[0], NULL, client_thread, *state);
     assert_int_equal(ret, 0);
     ret = pthread_create(&tids[1], NULL, server_thread, *state);
@@ -131,6 +136,70 @@ test_nc_two_channels(void **state)
     }
 }
 
+static void *
+client_thread_pool(void *arg)
+{
+    int ret, i;
+    struct nc_client_pool *pool;
+    struct nc_session *sessions[3], *session;
+
+    (void) arg;
+
+    nc_client_ssh_set_knownhosts_mode(NC_SSH_KNOWNHOSTS_SKIP);
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+
+    ret = nc_client_ssh_add_keypair(TESTS_DIR "/data/id_ed25519.pub", TESTS_DIR "/data/id_ed25519");
+    assert_int_equal(ret, 0);
+
+    pool = nc_client_pool_new(0, 0, 2);
+    assert_non_null(pool);
+
+    /* a new connection */
+    sessions[0] = nc_client_pool_get(pool, NC_TI_SSH, "127.0.0.1", TEST_PORT, "client_1", NULL);
+    assert_non_null(sessions[0]);
+
+    /* the session is lent, another channel on its connection */
+    sessions[1] = nc_client_pool_get(pool, NC_TI_SSH, "127.0.0.1", TEST_PORT, "client_1", NULL);
+    assert_non_null(sessions[1]);
+    assert_ptr_equal(sessions[1]->ti.libssh.session, sessions[0]->ti.libssh.session);
+
+    /* the connection is full, a new one */
+    sessions[2] = nc_client_pool_get(pool, NC_TI_SSH, "127.0.0.1", TEST_PORT, "client_1", NULL);
+    assert_non_null(sessions[2]);
+    assert_ptr_not_equal(sessions[2]->ti.libssh.session, sessions[0]->ti.libssh.session);
+
+    for (i = 0; i < 3; i++) {
+        nc_client_pool_put(pool, sessions[i]);
+    }
+
+    /* an idle channel is lent again */
+    session = nc_client_pool_get(pool, NC_TI_SSH, "127.0.0.1", TEST_PORT, "client_1", NULL);
+    assert_true((session == sessions[0]) || (session == sessions[1]) || (session == sessions[2]));
+    nc_client_pool_put(pool, session);
+
+    nc_client_pool_free(pool);
+    return NULL;
+}
+
+static void
+test_nc_pool_channels(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    server_session_count = 3;
+    ret = pthread_create(&tids[0], NULL, client_thread_pool, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
 static int
 setup_f(void **state)
 {
@@ -168,6 +237,7 @@ main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_nc_two_channels, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_pool_channels, setup_f, ln2_glob_test_teardown),
     };
 
     /* try to get ports from the environment, otherwise use the default */
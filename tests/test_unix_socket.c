@@ -15,6 +15,7 @@
 
 #define _GNU_SOURCE
 
+#include <dirent.h>
 #include <errno.h>
 #include <pthread.h>
 #include <setjmp.h>
@@ -22,10 +23,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <cmocka.h>
 
 #include "ln2_test.h"
+#include "session_p.h"
+
+#define CTX_POOL_SESSION_COUNT 4
 
 static void *
 client_thread(void *arg)
@@ -63,6 +68,445 @@ test_nc_connect_unix_socket(void **state)
     }
 }
 
+static void *
+server_thread_ctx_pool(void *arg)
+{
+    int ret, accepted = 0;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    /* the sessions are accepted while the others are being served */
+    while ((accepted < CTX_POOL_SESSION_COUNT) || nc_ps_session_count(ps)) {
+        if (accepted < CTX_POOL_SESSION_COUNT) {
+            msgtype = nc_accept(10, test_ctx->ctx, &session);
+            if (msgtype == NC_MSG_HELLO) {
+                ret = nc_ps_add_session(ps, session);
+                assert_int_equal(ret, 0);
+                ++accepted;
+            } else {
+                assert_int_equal(msgtype, NC_MSG_WOULDBLOCK);
+            }
+        }
+
+        session = NULL;
+        ret = nc_ps_poll(ps, 10, &session);
+        if (ret & NC_PSPOLL_SESSION_TERM) {
+            nc_ps_del_session(ps, session);
+            nc_session_free(session, NULL);
+        }
+    }
+
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void *
+client_thread_ctx_pool(void *arg)
+{
+    int ret;
+    struct nc_session *sessions[CTX_POOL_SESSION_COUNT];
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+    nc_client_set_new_session_context_sharing(1);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    /* the same fingerprint, the context is shared */
+    sessions[0] = nc_connect_unix("/tmp/nc2_test_unix_sock", NULL);
+    assert_non_null(sessions[0]);
+    sessions[1] = nc_connect_unix("/tmp/nc2_test_unix_sock", NULL);
+    assert_non_null(sessions[1]);
+    assert_ptr_equal(nc_session_get_ctx(sessions[0]), nc_session_get_ctx(sessions[1]));
+    assert_non_null(sessions[1]->opts.client.ctx_entry);
+    assert_ptr_equal(sessions[0]->opts.client.ctx_entry, sessions[1]->opts.client.ctx_entry);
+    assert_int_equal(sessions[1]->opts.client.ctx_entry->refcount, 2);
+
+    /* different client settings and so a different fingerprint, a separate context */
+    ret = nc_client_set_schema_searchpath(MODULES_DIR "/");
+    assert_int_equal(ret, 0);
+    sessions[2] = nc_connect_unix("/tmp/nc2_test_unix_sock", NULL);
+    assert_non_null(sessions[2]);
+    assert_ptr_not_equal(nc_session_get_ctx(sessions[0]), nc_session_get_ctx(sessions[2]));
+    assert_ptr_not_equal(sessions[0]->opts.client.ctx_entry, sessions[2]->opts.client.ctx_entry);
+    assert_int_equal(sessions[2]->opts.client.ctx_entry->refcount, 1);
+
+    /* released by the freed sessions */
+    nc_session_free(sessions[0], NULL);
+    assert_int_equal(sessions[1]->opts.client.ctx_entry->refcount, 1);
+    nc_session_free(sessions[1], NULL);
+
+    /* the released context is no longer in the pool, a new one is compiled */
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+    sessions[3] = nc_connect_unix("/tmp/nc2_test_unix_sock", NULL);
+    assert_non_null(sessions[3]);
+    assert_non_null(sessions[3]->opts.client.ctx_entry);
+    assert_int_equal(sessions[3]->opts.client.ctx_entry->refcount, 1);
+    assert_ptr_not_equal(nc_session_get_ctx(sessions[3]), nc_session_get_ctx(sessions[2]));
+
+    nc_session_free(sessions[2], NULL);
+    nc_session_free(sessions[3], NULL);
+    nc_client_set_new_session_context_sharing(0);
+    return NULL;
+}
+
+static void
+test_nc_client_ctx_pool(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_ctx_pool, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_ctx_pool, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+static void *
+client_thread_prefetch(void *arg)
+{
+    int ret;
+    uint64_t msgid;
+    char dir[] = "/tmp/ln2_prefetch_XXXXXX";
+    NC_MSG_TYPE msgtype;
+    DIR *d;
+    struct dirent *ent;
+    struct nc_session *session;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    /* no modules available locally, more of them are retrieved than fit the window of pipelined RPCs */
+    assert_non_null(mkdtemp(dir));
+    ret = nc_client_set_schema_searchpath(dir);
+    assert_int_equal(ret, 0);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    session = nc_connect_unix("/tmp/nc2_test_unix_sock", NULL);
+    assert_non_null(session);
+    assert_non_null(ly_ctx_get_module_implemented(nc_session_get_ctx(session), "ietf-netconf-server"));
+    assert_non_null(ly_ctx_get_module_implemented(nc_session_get_ctx(session), "ietf-keystore"));
+
+    /* no replies to the pipelined RPCs left */
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(session, rpc, 1000, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    msgtype = nc_recv_reply(session, rpc, msgid, 2000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+    nc_rpc_free(rpc);
+
+    nc_session_free(session, NULL);
+
+    /* the retrieved modules were stored in the search path */
+    d = opendir(dir);
+    assert_non_null(d);
+    while ((ent = readdir(d))) {
+        if (ent->d_name[0] != '.') {
+            unlinkat(dirfd(d), ent->d_name, 0);
+        }
+    }
+    closedir(d);
+    rmdir(dir);
+    return NULL;
+}
+
+static void
+test_nc_ctx_prefetch(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_prefetch, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, ln2_glob_test_server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+static void *
+server_thread_pool(void *arg)
+{
+    int ret;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session;
+    struct nc_pollsession *ps;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ps = nc_ps_new();
+    assert_non_null(ps);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    /* the first session is closed while idle in the pool */
+    msgtype = nc_accept(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+    pthread_barrier_wait(&test_ctx->barrier);
+    nc_session_free(session, NULL);
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    /* the second one is served until closed by the client */
+    msgtype = nc_accept(NC_ACCEPT_TIMEOUT, test_ctx->ctx, &session);
+    assert_int_equal(msgtype, NC_MSG_HELLO);
+    ret = nc_ps_add_session(ps, session);
+    assert_int_equal(ret, 0);
+    do {
+        ret = nc_ps_poll(ps, NC_PS_POLL_TIMEOUT, NULL);
+    } while (!(ret & NC_PSPOLL_SESSION_TERM));
+
+    nc_ps_clear(ps, 1, NULL);
+    nc_ps_free(ps);
+    return NULL;
+}
+
+static void *
+client_thread_pool(void *arg)
+{
+    int ret;
+    uint32_t id;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_client_pool *pool;
+    struct nc_session *session;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+    pool = nc_client_pool_new(0, 0, 0);
+    assert_non_null(pool);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    session = nc_client_pool_get(pool, NC_TI_UNIX, "/tmp/nc2_test_unix_sock", 0, NULL, NULL);
+    assert_non_null(session);
+    id = nc_session_get_id(session);
+    nc_client_pool_put(pool, session);
+
+    /* the idle session is lent again */
+    session = nc_client_pool_get(pool, NC_TI_UNIX, "/tmp/nc2_test_unix_sock", 0, NULL, NULL);
+    assert_non_null(session);
+    assert_int_equal(nc_session_get_id(session), id);
+    nc_client_pool_put(pool, session);
+
+    /* the server closes the idle session */
+    pthread_barrier_wait(&test_ctx->barrier);
+    pthread_barrier_wait(&test_ctx->barrier);
+
+    /* it is detected and a new session connected instead */
+    session = nc_client_pool_get(pool, NC_TI_UNIX, "/tmp/nc2_test_unix_sock", 0, NULL, NULL);
+    assert_non_null(session);
+    assert_int_not_equal(nc_session_get_id(session), id);
+
+    rpc = nc_rpc_get(NULL, 0, 0);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(session, rpc, 1000, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    msgtype = nc_recv_reply(session, rpc, msgid, 2000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+    nc_rpc_free(rpc);
+
+    nc_client_pool_put(pool, session);
+    nc_client_pool_free(pool);
+    return NULL;
+}
+
+static void
+test_nc_client_pool(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+
+    assert_non_null(state);
+
+    ret = pthread_create(&tids[0], NULL, client_thread_pool, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, server_thread_pool, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+static const char *lazy_rpc_mod =
+        "module lazy-rpc {yang-version 1.1; namespace \"urn:lazy-rpc\"; prefix lr;"
+        "rpc act {input {leaf aug {type string;}} output {leaf out {type string;}}}}";
+
+static const char *lazy_aug_mods[] = {
+    "module lazy-aug-sync {yang-version 1.1; namespace \"urn:lazy-aug-sync\"; prefix las;"
+    "import lazy-rpc {prefix lr;} augment \"/lr:act/lr:output\" {leaf aug-out {type string;}}}",
+    "module lazy-aug-async {yang-version 1.1; namespace \"urn:lazy-aug-async\"; prefix laa;"
+    "import lazy-rpc {prefix lr;} augment \"/lr:act/lr:output\" {leaf aug-out {type string;}}}"
+};
+
+static struct nc_server_reply *
+lazy_act_rpc_clb(struct lyd_node *rpc, struct nc_session *session)
+{
+    int ret;
+    char *path;
+    struct lyd_node *output;
+
+    /* the output is augmented by the module requested in the input */
+    ret = lyd_new_path(NULL, session->ctx, "/lazy-rpc:act/out", "a", LYD_NEW_VAL_OUTPUT, &output);
+    assert_int_equal(ret, LY_SUCCESS);
+    ret = asprintf(&path, "%s:aug-out", lyd_get_value(lyd_child(rpc)));
+    assert_int_not_equal(ret, -1);
+    ret = lyd_new_path(output, NULL, path, "b", LYD_NEW_VAL_OUTPUT, NULL);
+    assert_int_equal(ret, LY_SUCCESS);
+    free(path);
+
+    return nc_server_reply_data(output, NC_WD_EXPLICIT, NC_PARAMTYPE_FREE);
+}
+
+static void
+check_lazy_act_reply(const struct lyd_node *op, const char *aug_mod)
+{
+    const struct lyd_node *node;
+
+    /* the augmenting module was loaded only for the reply, the output parsed according to it */
+    assert_non_null(op);
+    assert_non_null(op->schema);
+    assert_string_equal(op->schema->name, "act");
+    node = lyd_child(op);
+    assert_non_null(node);
+    assert_string_equal(LYD_NAME(node), "out");
+    node = node->next;
+    assert_non_null(node);
+    assert_non_null(node->schema);
+    assert_string_equal(node->schema->name, "aug-out");
+    assert_string_equal(node->schema->module->name, aug_mod);
+    assert_string_equal(lyd_get_value(node), "b");
+}
+
+static void
+lazy_act_reply_clb(struct nc_session *session, uint64_t msgid, NC_MSG_TYPE type, const struct lyd_node *envp,
+        const struct lyd_node *op, void *user_data)
+{
+    int *called = user_data;
+
+    (void)session;
+    (void)msgid;
+    (void)envp;
+
+    assert_int_equal(type, NC_MSG_REPLY);
+    check_lazy_act_reply(op, "lazy-aug-async");
+    *called = 1;
+}
+
+static void *
+client_thread_lazy_augment(void *arg)
+{
+    int ret, called = 0;
+    uint64_t msgid;
+    NC_MSG_TYPE msgtype;
+    struct nc_session *session;
+    const struct ly_ctx *ctx;
+    struct nc_rpc *rpc;
+    struct lyd_node *envp, *op;
+    struct ln2_test_ctx *test_ctx = arg;
+
+    ret = nc_client_set_schema_searchpath(MODULES_DIR);
+    assert_int_equal(ret, 0);
+    ret = nc_client_set_new_session_context_lazy(1, NULL);
+    assert_int_equal(ret, 0);
+
+    pthread_barrier_wait(&test_ctx->barrier);
+    session = nc_connect_unix("/tmp/nc2_test_unix_sock", NULL);
+    assert_non_null(session);
+    ctx = nc_session_get_ctx(session);
+    assert_null(ly_ctx_get_module_implemented(ctx, "lazy-rpc"));
+
+    /* the RPC module is loaded when sending it, the reply recompiles it by loading the augmenting module */
+    rpc = nc_rpc_act_generic_xml("<act xmlns=\"urn:lazy-rpc\"><aug>lazy-aug-sync</aug></act>", NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc(session, rpc, 1000, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    assert_non_null(ly_ctx_get_module_implemented(ctx, "lazy-rpc"));
+    assert_null(ly_ctx_get_module_implemented(ctx, "lazy-aug-sync"));
+
+    msgtype = nc_recv_reply(session, rpc, msgid, 2000, &envp, &op);
+    assert_int_equal(msgtype, NC_MSG_REPLY);
+    check_lazy_act_reply(op, "lazy-aug-sync");
+    lyd_free_tree(envp);
+    lyd_free_tree(op);
+    nc_rpc_free(rpc);
+
+    /* the same for an asynchronous RPC, its reply is parsed only once received */
+    rpc = nc_rpc_act_generic_xml("<act xmlns=\"urn:lazy-rpc\"><aug>lazy-aug-async</aug></act>", NC_PARAMTYPE_CONST);
+    assert_non_null(rpc);
+    msgtype = nc_send_rpc_async(session, rpc, 1000, lazy_act_reply_clb, &called, &msgid);
+    assert_int_equal(msgtype, NC_MSG_RPC);
+    nc_rpc_free(rpc);
+    assert_null(ly_ctx_get_module_implemented(ctx, "lazy-aug-async"));
+
+    while (!called) {
+        ret = nc_recv_reply_dispatch(session, 2000);
+        assert_int_not_equal(ret, -1);
+    }
+
+    nc_session_free(session, NULL);
+    nc_client_set_new_session_context_lazy(0, NULL);
+    return NULL;
+}
+
+static void
+test_nc_lazy_ctx_augment(void **state)
+{
+    int ret, i;
+    pthread_t tids[2];
+    struct lysc_node *node;
+    struct ln2_test_ctx *test_ctx;
+
+    assert_non_null(state);
+    test_ctx = *state;
+
+    /* the server implements an RPC and modules augmenting its output */
+    ret = lys_parse_mem(test_ctx->ctx, lazy_rpc_mod, LYS_IN_YANG, NULL);
+    assert_int_equal(ret, LY_SUCCESS);
+    for (i = 0; i < 2; i++) {
+        ret = lys_parse_mem(test_ctx->ctx, lazy_aug_mods[i], LYS_IN_YANG, NULL);
+        assert_int_equal(ret, LY_SUCCESS);
+    }
+    node = (struct lysc_node *)lys_find_path(test_ctx->ctx, NULL, "/lazy-rpc:act", 0);
+    assert_non_null(node);
+    node->priv = lazy_act_rpc_clb;
+
+    ret = pthread_create(&tids[0], NULL, client_thread_lazy_augment, *state);
+    assert_int_equal(ret, 0);
+    ret = pthread_create(&tids[1], NULL, ln2_glob_test_server_thread, *state);
+    assert_int_equal(ret, 0);
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
 static int
 setup_f(void **state)
 {
@@ -88,6 +532,10 @@ main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_nc_connect_unix_socket, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_client_ctx_pool, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_ctx_prefetch, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_lazy_ctx_augment, setup_f, ln2_glob_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nc_client_pool, setup_f, ln2_glob_test_teardown),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);